@@ -1,3 +1,9 @@
+if(SIMULATOR_64_BIT)
+  set(SIMULATOR_ARCHITECTURE_FLAG "")
+else(SIMULATOR_64_BIT)
+  set(SIMULATOR_ARCHITECTURE_FLAG "-m32")
+endif(SIMULATOR_64_BIT)
+
 if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
   if(ENABLE_SANITIZERS)
     set(SANITIZER  "-fsanitize=address -fsanitize=undefined -fsanitize=integer-divide-by-zero -fsanitize=unreachable -fsanitize=vla-bound -fsanitize=null -fsanitize=return -fsanitize=enum -fsanitize=bool -fsanitize=vptr -fsanitize=pointer-overflow")
@@ -5,8 +11,8 @@ if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
     set(SANITIZER  "")
   endif(ENABLE_SANITIZERS)
   
-  set(CMAKE_C_FLAGS           "-include ${PROJECT_SOURCE_DIR}/cherrysim/SystemTest.h -m32 -Wno-unknown-pragmas -fno-builtin -fno-strict-aliasing -fomit-frame-pointer -std=gnu99" CACHE INTERNAL "c compiler flags")
-  set(CMAKE_CXX_FLAGS         "-include ${PROJECT_SOURCE_DIR}/cherrysim/SystemTest.h -m32 -Wno-unknown-pragmas -fprofile-arcs -ftest-coverage -fno-builtin -fno-strict-aliasing -fomit-frame-pointer -fdata-sections -ffunction-sections -fsingle-precision-constant -std=c++17 -pthread ${SANITIZER} -fno-omit-frame-pointer " CACHE INTERNAL "cxx compiler flags")
+  set(CMAKE_C_FLAGS           "-include ${PROJECT_SOURCE_DIR}/cherrysim/SystemTest.h ${SIMULATOR_ARCHITECTURE_FLAG} -Wno-unknown-pragmas -fno-builtin -fno-strict-aliasing -fomit-frame-pointer -std=gnu99" CACHE INTERNAL "c compiler flags")
+  set(CMAKE_CXX_FLAGS         "-include ${PROJECT_SOURCE_DIR}/cherrysim/SystemTest.h ${SIMULATOR_ARCHITECTURE_FLAG} -Wno-unknown-pragmas -fprofile-arcs -ftest-coverage -fno-builtin -fno-strict-aliasing -fomit-frame-pointer -fdata-sections -ffunction-sections -fsingle-precision-constant -std=c++17 -pthread ${SANITIZER} -fno-omit-frame-pointer " CACHE INTERNAL "cxx compiler flags")
   set(CMAKE_EXE_LINKER_FLAGS  "-rdynamic -fprofile-arcs -ftest-coverage ${SANITIZER} -fno-omit-frame-pointer"  CACHE INTERNAL "exe link flags")
 
   set(CMAKE_C_FLAGS_DEBUG     "-Og -g3 -ggdb3"  CACHE INTERNAL "c debug compiler flags")
@@ -48,7 +54,9 @@ elseif(CMAKE_CXX_COMPILER_ID STREQUAL "Clang")
   target_compile_options_multi("${SIMULATOR_TARGETS}" "-Wno-constant-logical-operand")
   target_compile_options_multi("${SIMULATOR_TARGETS}" "-Wno-missing-field-initializers") # Overly paranoid warning that hinders value initialization (a = {})
   target_compile_options_multi("${SIMULATOR_TARGETS}" "--include=${PROJECT_SOURCE_DIR}/cherrysim/SystemTest.h")
-  target_compile_options_multi("${SIMULATOR_TARGETS}" "-m32")
+  if(NOT SIMULATOR_64_BIT)
+    target_compile_options_multi("${SIMULATOR_TARGETS}" "-m32")
+  endif()
   set(CMAKE_C_FLAGS           "-fno-builtin -fno-strict-aliasing -fomit-frame-pointer -std=gnu99" CACHE INTERNAL "c compiler flags")
   set(CMAKE_CXX_FLAGS         "-fprofile-arcs -ftest-coverage -fno-builtin -fno-strict-aliasing -fomit-frame-pointer -fdata-sections -ffunction-sections -std=c++17 -pthread -fno-omit-frame-pointer " CACHE INTERNAL "cxx compiler flags")
   set(CMAKE_EXE_LINKER_FLAGS  "-rdynamic -fprofile-arcs -ftest-coverage -fno-omit-frame-pointer"  CACHE INTERNAL "exe link flags")
@@ -37,6 +37,7 @@
 
 #include <malloc.h>
 #include <algorithm>
+#include <cmath>
 #include <thread>
 #include <sstream>
 #include <fstream>
@@ -45,10 +46,7 @@
 #include <functional>
 #include <json.hpp>
 #include <fstream>
-
-extern "C"{
-#include <dbscan.h>
-}
+#include <SimPlacement.h>
 
 #include <GlobalState.h>
 #include <Node.h>
@@ -117,14 +115,6 @@ ConnTypeResolver connTypeResolvers[] = {
 // These functions can start / stop / reset the simulator
 //#########################################################################################
 
-struct FlashFileHeader
-{
-    u32 version;
-    u32 sizeOfHeader;
-    u32 flashSize;
-    u32 amountOfNodes;
-};
-
 bool CherrySim::ShouldSimIvTrigger(u32 ivMs)
 {
     return (currentNode->state.timeMs % ivMs) == 0;
@@ -132,70 +122,20 @@ bool CherrySim::ShouldSimIvTrigger(u32 ivMs)
 
 void CherrySim::StoreFlashToFile()
 {
-    if (simConfig.storeFlashToFile == "") return;
-
-    std::ofstream file(simConfig.storeFlashToFile, std::ios::binary);
-    
-    FlashFileHeader ffh;
-    CheckedMemset(&ffh, 0, sizeof(ffh));
-
-    ffh.version = FM_VERSION;
-    ffh.sizeOfHeader = sizeof(ffh);
-    ffh.flashSize = SIM_MAX_FLASH_SIZE;
-    ffh.amountOfNodes = GetTotalNodes();
-
-    file.write((const char*)&ffh, sizeof(ffh));
-
-    for (u32 i = 0; i < GetTotalNodes(); i++)
-    {
-        file.write((const char*)this->nodes[i].flash, SIM_MAX_FLASH_SIZE);
-    }
+    //Only the pages that changed since the last store are written, see SimFlashStore
+    flashStore.Store([this](u32 nodeIndex) { return this->nodes[nodeIndex].flash; });
 }
 
 void CherrySim::LoadFlashFromFile()
 {
+    flashStore.Reset(simConfig.storeFlashToFile, SIM_MAX_FLASH_SIZE, GetTotalNodes(), FM_VERSION);
     if (simConfig.storeFlashToFile == "") return;
 
-    std::ifstream infile(simConfig.storeFlashToFile);
-
     //If file does not exist we just return
-    if (!infile.good())
+    if (!flashStore.Load([this](u32 nodeIndex) { return this->nodes[nodeIndex].flash; }))
     {
         printf("WARNING: Flash was not loaded from file as the file '%s' did not exist!", simConfig.storeFlashToFile.c_str());
-        return;
-    }
-
-    infile.seekg(0, std::ios::end);
-    size_t length = infile.tellg();
-    infile.seekg(0, std::ios::beg);
-    char* buffer = new char[length];
-    infile.read(buffer, length);
-
-    FlashFileHeader ffh;
-    CheckedMemset(&ffh, 0, sizeof(ffh));
-    ffh = *(FlashFileHeader*)(buffer);
-
-    if (
-        //=> We are not checking against the version as this is set to the FruityMesh version which is allowed to change
-           ffh.sizeOfHeader  != sizeof(ffh)
-        || ffh.flashSize     != SIM_MAX_FLASH_SIZE
-        || ffh.amountOfNodes != GetTotalNodes()
-        || length            != sizeof(ffh) + SIM_MAX_FLASH_SIZE * GetTotalNodes()
-        )
-    {
-        //Probably the correct action if this happens is to just remove the flash safe file (see simConfig.storeFlashToFile)
-        //This is NOT automatically performed here as it would be rather rude to just remove it in case the user accidentally
-        //launched a different version of CherrySim or another config.
-        SIMEXCEPTION(CorruptOrOutdatedSavefile);
-        return;
-    }
-
-    for (u32 i = 0; i < GetTotalNodes(); i++)
-    {
-        CheckedMemcpy(this->nodes[i].flash, buffer + SIM_MAX_FLASH_SIZE * i + sizeof(ffh), SIM_MAX_FLASH_SIZE);
     }
-
-    delete[] buffer;
 }
 
 #define AddSimulatedFeatureSet(featureset) \
@@ -323,12 +263,33 @@ CherrySim::CherrySim(const SimConfiguration &simConfig)
         // that we don't accidentally run the same stuff all the time.
         SIMEXCEPTION(IllegalStateException);
 #endif
-        auto replayPath = simConfig.replayPath;
-        const std::string replayFileContents = LoadFileContents(simConfig.replayPath.c_str());
-        CheckVersionFromReplayRecord(replayFileContents);
-        replayRecordEntries = ExtractReplayRecord(replayFileContents);
-        this->simConfig = ExtractSimConfigurationFromReplayRecord(replayFileContents);
-        this->simConfig.replayPath = replayPath; //Overwrite the replay path so that we know that we are currently in a replay
+        if (ReplayFileReader::IsReplayFile(simConfig.replayPath))
+        {
+            replayFileReader.reset(new ReplayFileReader(simConfig.replayPath));
+            if (replayFileReader->GetFmVersion() != FM_VERSION)
+            {
+                //The version from the replay file does not match the version from the current repository state.
+                SIMEXCEPTION(IllegalArgumentException);
+            }
+            this->simConfig = nlohmann::json::parse(replayFileReader->GetConfiguration()).get<SimConfiguration>();
+        }
+        else
+        {
+            const std::string replayFileContents = LoadFileContents(simConfig.replayPath.c_str());
+            CheckVersionFromReplayRecord(replayFileContents);
+            replayRecordEntries = ExtractReplayRecord(replayFileContents);
+            this->simConfig = ExtractSimConfigurationFromReplayRecord(replayFileContents);
+        }
+        //Overwrite the replay settings with the ones of the current run, e.g. so that we know that we are currently in a replay
+        this->simConfig.replayPath              = simConfig.replayPath;
+        this->simConfig.replayRecordPath        = simConfig.replayRecordPath;
+        this->simConfig.replaySeekTimeMs        = simConfig.replaySeekTimeMs;
+        this->simConfig.replayVerifyCheckpoints = simConfig.replayVerifyCheckpoints;
+        if (this->simConfig.replayRecordPath == this->simConfig.replayPath)
+        {
+            //Recording would overwrite the file that is currently replayed.
+            SIMEXCEPTION(IllegalArgumentException);
+        }
         if (this->simConfig.storeFlashToFile != "")
         {
             // Replaying a file that required persistent flash storage is currently not supported.
@@ -371,6 +332,13 @@ CherrySim::~CherrySim()
     if(server != nullptr) delete server;
     server = nullptr;
 
+    if (pcapWriter)
+    {
+        pcapWriter->Close();
+        printf("Pcap capture: %u packets captured, %u dropped" EOL, pcapWriter->GetNumCapturedPackets(), pcapWriter->GetNumDroppedPackets());
+        pcapWriter.reset();
+    }
+
     if (cherrySimInstance == this) cherrySimInstance = nullptr;
 }
 
@@ -392,9 +360,25 @@ void CherrySim::Init()
         TerminalPrintHandler(versionString.c_str());
     }
 
+    if (simConfig.replayRecordPath != "")
+    {
+        replayFileWriter.reset(new ReplayFileWriter(simConfig.replayRecordPath));
+        nlohmann::json configJson = simConfig;
+        replayFileWriter->WriteConfiguration(configJson.dump());
+        nextReplayCheckpointTimeMs = simState.simTimeMs + simConfig.replayCheckpointIntervalMs;
+    }
+    nextStatisticSnapshotTimeMs = simState.simTimeMs + simConfig.statisticSnapshotIntervalMs;
+    nextMemorySampleTimeMs = simState.simTimeMs + simConfig.memorySampleIntervalMs;
+
     //Generate a psuedo random number generator with a uniform distribution
     simState.rnd.SetSeed(simConfig.seed);
 
+    faultInjector.SetSeed(simConfig.seed);
+    if (simConfig.faultScenarioPath != "")
+    {
+        faultInjector.AddScenario(SimFaultInjector::LoadScenario(simConfig.faultScenarioPath));
+    }
+
     //Load site and device data from a json if given
     if (simConfig.importFromJson) {
         ImportDataFromJson();
@@ -408,6 +392,8 @@ void CherrySim::Init()
         new (&nodes[i]) NodeEntry;
     }
 
+    nodeIndexById.Reset(GetTotalNodes());
+    nodeIndexBySerialNumber.Reset(GetTotalNodes());
     for (u32 i = 0; i < GetTotalNodes(); i++) {
         InitNode(i);
     }
@@ -429,6 +415,16 @@ void CherrySim::Init()
         LoadPresetNodePositions();
     }
 
+    if (simConfig.pcapCapturePath != "")
+    {
+        std::vector<std::string> interfaceNames;
+        for (u32 i = 0; i < GetTotalNodes(); i++)
+        {
+            interfaceNames.push_back("node " + std::to_string(nodes[i].id) + " " + (const char*)(nodes[i].uicr.CUSTOMER + 2));
+        }
+        pcapWriter.reset(new SimPcapWriter(simConfig.pcapCapturePath, interfaceNames, simConfig.pcapCaptureBufferSize));
+    }
+
     server = new FruitySimServer();
 }
 
@@ -439,7 +435,12 @@ void CherrySim::ImportDataFromJson()
     json siteJson;
     json devicesJson;
 
-    if (simConfig.replayPath != "")
+    if (replayFileReader)
+    {
+        siteJson    = nlohmann::json::parse(replayFileReader->GetSite());
+        devicesJson = nlohmann::json::parse(replayFileReader->GetDevices());
+    }
+    else if (simConfig.replayPath != "")
     {
         const std::string replayFileContents = LoadFileContents(simConfig.replayPath.c_str());
         siteJson    = nlohmann::json::parse(ExtractAndCleanReplayToken(replayFileContents, "[!]SITE START:[!]",    "[!]SITE END[!]"));
@@ -463,6 +464,11 @@ void CherrySim::ImportDataFromJson()
         const std::string deviceString = "\n\n\n[!]DEVICES START:[!]\n\n\n" + devicesJson.dump(4) + "\n\n\n[!]DEVICES END[!]\n\n\n";
         TerminalPrintHandler(deviceString.c_str());
     }
+    if (replayFileWriter)
+    {
+        replayFileWriter->WriteSite(siteJson.dump());
+        replayFileWriter->WriteDevices(devicesJson.dump());
+    }
 
     //Get some data from the site
     simConfig.mapWidthInMeters = siteJson["results"][0]["lengthInMeter"];
@@ -513,7 +519,11 @@ void CherrySim::ImportPositionsFromJson()
 {
     json devicesJson;
 
-    if (simConfig.replayPath != "")
+    if (replayFileReader)
+    {
+        devicesJson = nlohmann::json::parse(replayFileReader->GetDevices());
+    }
+    else if (simConfig.replayPath != "")
     {
         const std::string replayFileContents = LoadFileContents(simConfig.replayPath.c_str());
         devicesJson = nlohmann::json::parse(ExtractAndCleanReplayToken(replayFileContents, "[!]DEVICES START:[!]", "[!]DEVICES END[!]"));
@@ -559,46 +569,15 @@ void CherrySim::ImportPositionsFromJson()
     }
 }
 
-void HelperPositionNodesRandomly(CherrySim &instance, std::vector<point_t> &points, u32 numberOfNodesToPlace)
+//This will position all nodes randomly and move them until all of them can be clustered (see SimPlacement.h)
+void CherrySim::PositionNodesRandomly()
 {
-    //Calculate the epsilon using the rssi threshold and the transmission powers
-    double epsilon = pow(10, ((double)-STABLE_CONNECTION_RSSI_THRESHOLD + SIMULATOR_NODE_DEFAULT_CALIBRATED_TX + SIMULATOR_NODE_DEFAULT_DBM_TX) / 10 / instance.N);
-
-    unsigned int minpts = 0; //a point must reach only one of another cluster to become part of its cluster
-
-    bool retry = true;
-    while (retry) {
-        //printf("try\n");
-        retry = false;
-
-        //Create 2D points for all node positions
-        for (u32 i = 0; i < instance.GetTotalNodes(); i++) {
-            points[i].cluster_id = -1; //unclassified
-            points[i].x = (double)instance.nodes[i].x * (double)instance.simConfig.mapWidthInMeters;
-            points[i].y = (double)instance.nodes[i].y * (double)instance.simConfig.mapHeightInMeters;
-            points[i].z = (double)instance.nodes[i].z * (double)instance.simConfig.mapElevationInMeters;
-        }
-
-        //Use dbscan algorithm to check how many clusters these nodes can generate
-        dbscan(points.data(), numberOfNodesToPlace, epsilon, minpts, euclidean_dist);
-
-        //printf("Epsilon for dbscan: %lf\n", epsilon);
-        //printf("Minimum points: %u\n", minpts);
-        //print_points(points, num_points);
-
-        for (u32 i = 0; i < numberOfNodesToPlace; i++) {
-            if (points[i].cluster_id != 0) {
-                retry = true;
-                instance.nodes[i].x = (float)instance.simState.rnd.NextU32() / (float)0xFFFFFFFF;
-                instance.nodes[i].y = (float)instance.simState.rnd.NextU32() / (float)0xFFFFFFFF;
-            }
-        }
+    u32 numNoneAssetNodes = GetTotalNodes() - GetAssetNodes();
+    if (simConfig.nodeDensity != 0)
+    {
+        SimPlacement::CalculateMapSizeForDensity(numNoneAssetNodes, simConfig.nodeDensity, simConfig.mapWidthInMeters, simConfig.mapHeightInMeters);
     }
-}
 
-//This will position all nodes randomly, by using dbscan to generate a configuration that can be clustered
-void CherrySim::PositionNodesRandomly()
-{
     //Set some random x and y position for all nodes
     for (u32 nodeIndex = 0; nodeIndex < GetTotalNodes(); nodeIndex++) {
         nodes[nodeIndex].x = (float)simState.rnd.NextU32() / (float)0xFFFFFFFF;
@@ -606,31 +585,45 @@ void CherrySim::PositionNodesRandomly()
         nodes[nodeIndex].z = 0;
     }
 
-    u32 numNoneAssetNodes = GetTotalNodes() - GetAssetNodes();
     //Next, we must check if the configuraton can cluster
-    std::vector<point_t> points = {};
-    points.resize(GetTotalNodes());
+    std::vector<ThreeDimStruct<float>> positions(GetTotalNodes());
+    for (u32 nodeIndex = 0; nodeIndex < GetTotalNodes(); nodeIndex++) {
+        positions[nodeIndex] = { nodes[nodeIndex].x, nodes[nodeIndex].y, nodes[nodeIndex].z };
+    }
+    SimPlacement placement(SimPlacement::CalculateConnectionRange(N), simConfig.mapWidthInMeters, simConfig.mapHeightInMeters, simConfig.mapElevationInMeters);
 
-    //Two passes for DBScan are required, once for none assets, once for assets.
+    //Two passes are required, once for none assets, once for assets.
     //This is necessary to make sure that assets are not considered as valid mesh
-    //nodes to DBScan.
-    HelperPositionNodesRandomly(*this, points, numNoneAssetNodes);
-    HelperPositionNodesRandomly(*this, points, GetTotalNodes());
-    
+    //nodes that could connect other nodes.
+    placement.PlaceConnected(positions, numNoneAssetNodes, simState.rnd, simConfig.attachUnconnectedNodes);
+    placement.PlaceConnected(positions, GetTotalNodes(), simState.rnd, simConfig.attachUnconnectedNodes);
+
+    for (u32 nodeIndex = 0; nodeIndex < GetTotalNodes(); nodeIndex++) {
+        nodes[nodeIndex].x = positions[nodeIndex].x;
+        nodes[nodeIndex].y = positions[nodeIndex].y;
+        nodes[nodeIndex].z = positions[nodeIndex].z;
+    }
 }
 
 
 NodeEntry * CherrySim::GetNodeEntryBySerialNumber(u32 serialNumber)
 {
-    for (u32 i = 0; i < GetTotalNodes(); i++)
-    {
-        NodeIndexSetter setter(i);
-        if (RamConfig->GetSerialNumberIndex() == serialNumber)
-        {
-            return &nodes[i];
-        }
-    }
-    return nullptr;
+    const u32 nodeIndex = nodeIndexBySerialNumber.Find(serialNumber);
+    if (nodeIndex == UINT32_MAX) return nullptr;
+    return &nodes[nodeIndex];
+}
+
+//Must be called whenever the id or serial number of a node might have changed
+void CherrySim::UpdateNodeLookupIndices(u32 nodeIndex)
+{
+    nodeIndexById.Set(nodeIndex, nodes[nodeIndex].id);
+    nodeIndexBySerialNumber.Set(nodeIndex, nodes[nodeIndex].gs.config.GetSerialNumberIndex());
+}
+
+bool CherrySim::AreNodeLookupIndicesConsistent() const
+{
+    return nodeIndexById.IsConsistent([this](u32 nodeIndex) { return nodes[nodeIndex].id; })
+        && nodeIndexBySerialNumber.IsConsistent([this](u32 nodeIndex) { return nodes[nodeIndex].gs.config.GetSerialNumberIndex(); });
 }
 
 std::string CherrySim::LoadFileContents(const char * path)
@@ -766,6 +759,73 @@ void CherrySim::CheckVersionFromReplayRecord(const std::string &fileContents)
     }
 }
 
+void CherrySim::ConvertTextReplayToBinary(const std::string& textLogPath, const std::string& binaryReplayPath)
+{
+    const std::string fileContents = LoadFileContents(textLogPath.c_str());
+    CheckVersionFromReplayRecord(fileContents);
+
+    ReplayFileWriter writer(binaryReplayPath);
+    writer.WriteConfiguration(ExtractAndCleanReplayToken(fileContents, "[!]CONFIGURATION START:[!]", "[!]CONFIGURATION END[!]"));
+    if (fileContents.find("[!]SITE START:[!]") != std::string::npos)
+    {
+        writer.WriteSite(ExtractAndCleanReplayToken(fileContents, "[!]SITE START:[!]", "[!]SITE END[!]"));
+        writer.WriteDevices(ExtractAndCleanReplayToken(fileContents, "[!]DEVICES START:[!]", "[!]DEVICES END[!]"));
+    }
+
+    //Text logs don't contain any checkpoints, so a converted replay can't be verified.
+    std::queue<ReplayRecordEntry> entries = ExtractReplayRecord(fileContents);
+    while (!entries.empty())
+    {
+        writer.WriteCommand(entries.front().time, entries.front().index, entries.front().command);
+        entries.pop();
+    }
+    writer.Finish();
+}
+
+void CherrySim::RecordReplayCommand(const std::string& command)
+{
+    if (replayFileWriter)
+    {
+        replayFileWriter->WriteCommand(simState.simTimeMs, currentNode->index, command);
+    }
+}
+
+u32 CherrySim::CalculateReplayStateHash() const
+{
+    u32 hash = simState.rnd.GetStateChecksum();
+    const u32 simStateValues[] = {
+        simState.simTimeMs,
+        simState.globalConnHandleCounter,
+        simState.globalEventIdCounter,
+        simState.globalPacketIdCounter,
+    };
+    hash = Utility::CalculateCrc32((const u8*)simStateValues, sizeof(simStateValues), hash);
+
+    for (u32 i = 0; i < GetTotalNodes(); i++)
+    {
+        const u32 nodeValues[] = {
+            (u32)nodes[i].id,
+            nodes[i].gs.node.clusterId,
+            (u32)nodes[i].gs.node.GetClusterSize(),
+            (u32)nodes[i].simulatedFrames,
+            nodes[i].restartCounter,
+            nodes[i].eventQueue.Size(),
+        };
+        hash = Utility::CalculateCrc32((const u8*)nodeValues, sizeof(nodeValues), hash);
+        for (const SimRandom& random : nodes[i].random)
+        {
+            const u32 randomChecksum = random.GetStateChecksum();
+            hash = Utility::CalculateCrc32((const u8*)&randomChecksum, sizeof(randomChecksum), hash);
+        }
+    }
+    return hash;
+}
+
+bool CherrySim::IsFastForwardingReplay() const
+{
+    return simConfig.replayPath != "" && simState.simTimeMs < simConfig.replaySeekTimeMs;
+}
+
 void CherrySim::LoadPresetNodePositions()
 {
     if (simConfig.preDefinedPositions.size() != 0)
@@ -792,7 +852,7 @@ void CherrySim::SimulateStepForAllNodes()
         std::this_thread::sleep_for(std::chrono::milliseconds(50));
     }
 
-    if (simConfig.realTime)
+    if (simConfig.realTime && !IsFastForwardingReplay())
     {
         auto currentTime = std::chrono::steady_clock::now();
         auto diff = currentTime - lastTick;
@@ -823,6 +883,24 @@ void CherrySim::SimulateStepForAllNodes()
         GS->terminal.PutIntoTerminalCommandQueue(replayRecordEntries.front().command, false);
         replayRecordEntries.pop();
     }
+    if (replayFileReader)
+    {
+        const ReplayFileRecord* record = nullptr;
+        while ((record = replayFileReader->Peek()) != nullptr && record->time <= simState.simTimeMs)
+        {
+            //Checkpoints are verified at the end of a step, any that are still left here belong to the past.
+            if (record->type == ReplayRecordType::COMMAND)
+            {
+                std::string command = record->command;
+                NodeIndexSetter setter(record->index);
+                GS->terminal.PutIntoTerminalCommandQueue(command, false);
+            }
+            replayFileReader->Pop();
+        }
+    }
+
+    EvaluateMoveAnimations();
+    if (!faultInjector.IsEmpty()) SimulateFaults();
 
     //printf("-- %u --" EOL, simState.simTimeMs);
     for (u32 i = 0; i < GetTotalNodes(); i++) {
@@ -833,7 +911,7 @@ void CherrySim::SimulateStepForAllNodes()
             const int64_t frameOffset = currentNode->simulatedFrames - avgSimulatedFrames;
             // Sigmoid function, flipped on the Y-Axis.
             const double probability = 1.0 / (1 + std::exp((double)(frameOffset) * 0.1));
-            if (PSRNG(probability * UINT32_MAX))
+            if (NODE_PSRNG(SCHEDULING, probability * UINT32_MAX))
             {
                 simulateNode = false;
             }
@@ -872,7 +950,47 @@ void CherrySim::SimulateStepForAllNodes()
     //Run a check on the current clustering state
     if(simConfig.enableClusteringValidityCheck) CheckMeshingConsistency();
 
+    const bool wasFastForwardingReplay = IsFastForwardingReplay();
     simState.simTimeMs += simConfig.simTickDurationMs;
+    if (wasFastForwardingReplay && !IsFastForwardingReplay())
+    {
+        printf("Replay reached %u ms" EOL, simState.simTimeMs);
+    }
+
+    if (replayFileWriter && simConfig.replayCheckpointIntervalMs != 0 && simState.simTimeMs >= nextReplayCheckpointTimeMs)
+    {
+        replayFileWriter->WriteCheckpoint(simState.simTimeMs, CalculateReplayStateHash());
+        nextReplayCheckpointTimeMs = simState.simTimeMs + simConfig.replayCheckpointIntervalMs;
+    }
+    if (simConfig.statisticSnapshotIntervalMs != 0 && simState.simTimeMs >= nextStatisticSnapshotTimeMs)
+    {
+        statisticSnapshots.push_back({ simState.simTimeMs, SimStatistics::GetGlobalValues() });
+        nextStatisticSnapshotTimeMs = simState.simTimeMs + simConfig.statisticSnapshotIntervalMs;
+    }
+    if (simConfig.memorySampleIntervalMs != 0 && simState.simTimeMs >= nextMemorySampleTimeMs)
+    {
+        for (u32 i = 0; i < GetTotalNodes(); i++) SimMemory::Sample(nodes[i]);
+        nextMemorySampleTimeMs = simState.simTimeMs + simConfig.memorySampleIntervalMs;
+    }
+    if (replayFileReader)
+    {
+        const ReplayFileRecord* record = nullptr;
+        while ((record = replayFileReader->Peek()) != nullptr && record->type == ReplayRecordType::CHECKPOINT && record->time <= simState.simTimeMs)
+        {
+            if (simConfig.replayVerifyCheckpoints && record->time == simState.simTimeMs)
+            {
+                const u32 stateHash = CalculateReplayStateHash();
+                if (stateHash != record->stateHash)
+                {
+                    //The replay does not behave like the original simulation, e.g. because the
+                    //code changed in the meantime or something in the simulation is not deterministic.
+                    printf("Replay diverged at %u ms, expected state hash %u but got %u" EOL, simState.simTimeMs, record->stateHash, stateHash);
+                    SIMEXCEPTION(ReplayDivergedException);
+                }
+            }
+            replayFileReader->Pop();
+        }
+    }
     
     //Back up the flash every flashToFileWriteInterval's step.
     flashToFileWriteCycle++;
@@ -950,6 +1068,9 @@ TerminalCommandHandlerReturnType CherrySim::TerminalCommandHandler(const std::ve
             sim_print_statistics();
 
             printf("Enter 'sim sendstat {nodeId=0}' or 'sim routestat {nodeId=0}' for packet statistics" EOL);
+            printf("Enter 'sim nodecounters {nodeId}' for the statistics of a node or 'sim statcsv {path}' to export the statistic snapshots" EOL);
+            printf("Enter 'sim energy {nodeId}' for the energy usage or 'sim energycsv {path}' to export it" EOL);
+            printf("Enter 'sim memstat {nodeId}' for the memory occupancy or 'sim memcsv {path}' to export it" EOL);
 
             return TerminalCommandHandlerReturnType::SUCCESS;
         }
@@ -1117,6 +1238,114 @@ TerminalCommandHandlerReturnType CherrySim::TerminalCommandHandler(const std::ve
             PrintPacketStats(nodeId, "ROUTED");
             return TerminalCommandHandlerReturnType::SUCCESS;
         }
+        else if (commandArgs.size() >= 3 && commandArgs[1] == "nodecounters") {
+            //Print the SIMSTATCOUNT and SIMSTATAVG values that were collected by a single node
+            bool didError = false;
+            const NodeId nodeId = Utility::StringToU16(commandArgs[2].c_str(), &didError);
+            NodeEntry* node = FindNodeById(nodeId);
+            if (didError || node == nullptr) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+            SimStatistics::Print(node->statistics);
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (commandArgs.size() >= 3 && commandArgs[1] == "statcsv") {
+            //Export the snapshots of the statistics (see simConfig.statisticSnapshotIntervalMs)
+            if (!SimStatistics::WriteTimeSeriesCsv(commandArgs[2], statisticSnapshots)) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+            printf("Wrote %u statistic snapshots to %s" EOL, (u32)statisticSnapshots.size(), commandArgs[2].c_str());
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (commandArgs[1] == "energy") {
+            //Print the energy usage of all nodes or the breakdown of a single node, e.g. sim energy 3
+            if (commandArgs.size() >= 3) {
+                bool didError = false;
+                const NodeId nodeId = Utility::StringToU16(commandArgs[2].c_str(), &didError);
+                NodeEntry* node = FindNodeById(nodeId);
+                if (didError || node == nullptr) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+                SimEnergy::PrintNode(*node, simState.simTimeMs, energyModel);
+            }
+            else {
+                SimEnergy::PrintSummary(nodes, GetTotalNodes(), simState.simTimeMs, energyModel);
+            }
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (commandArgs.size() >= 3 && commandArgs[1] == "energycsv") {
+            if (!SimEnergy::WriteCsv(commandArgs[2], nodes, GetTotalNodes(), simState.simTimeMs, energyModel)) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+            printf("Wrote the energy usage of %u nodes to %s" EOL, GetTotalNodes(), commandArgs[2].c_str());
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (commandArgs[1] == "memstat") {
+            //Print the histograms and top offenders of all nodes or the memory occupancy of a single node, e.g. sim memstat 3
+            //Without periodic sampling (simConfig.memorySampleIntervalMs), every node is sampled once now
+            if (simConfig.memorySampleIntervalMs == 0) {
+                for (u32 i = 0; i < GetTotalNodes(); i++) SimMemory::Sample(nodes[i]);
+            }
+            if (commandArgs.size() >= 3) {
+                bool didError = false;
+                const NodeId nodeId = Utility::StringToU16(commandArgs[2].c_str(), &didError);
+                NodeEntry* node = FindNodeById(nodeId);
+                if (didError || node == nullptr) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+                SimMemory::PrintNode(*node);
+            }
+            else {
+                SimMemory::PrintSummary(nodes, GetTotalNodes(), 5);
+            }
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (commandArgs.size() >= 3 && commandArgs[1] == "memcsv") {
+            if (!SimMemory::WriteCsv(commandArgs[2], nodes, GetTotalNodes())) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+            printf("Wrote the memory occupancy of %u nodes to %s" EOL, GetTotalNodes(), commandArgs[2].c_str());
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (commandArgs.size() >= 3 && commandArgs[1] == "fault") {
+            //Faults can be added at runtime, e.g. sim fault add {"type":"packetLoss","node":3,"probability":0.5}
+            if (commandArgs[2] == "add" && commandArgs.size() >= 4) {
+                //The json must not contain spaces as the arguments are split by them
+                const nlohmann::json faultJson = nlohmann::json::parse(commandArgs[3], nullptr, false);
+                if (faultJson.is_discarded() || !SimFaultInjector::IsValidFault(faultJson)) {
+                    return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+                }
+                faultInjector.AddFault(faultJson.get<SimFault>());
+            }
+            else if (commandArgs[2] == "list") {
+                for (const SimFault& fault : faultInjector.GetFaults()) {
+                    const nlohmann::json j = fault;
+                    printf("%s" EOL, j.dump().c_str());
+                }
+            }
+            else if (commandArgs[2] == "clear") {
+                faultInjector.Clear();
+            }
+            else {
+                return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+            }
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (commandArgs[1] == "evtstat") {
+            //Print the occupancy of the SoftDevice event queue of all nodes
+            for (u32 i = 0; i < GetTotalNodes(); i++)
+            {
+                const SimBleEventQueue& queue = nodes[i].eventQueue;
+                printf("Node %u: events %u, max %u, capacity %u, overflows %u" EOL, nodes[i].id, queue.Size(), queue.GetMaxSize(), queue.GetCapacity(), queue.GetNumOverflows());
+            }
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (commandArgs.size() >= 4 && commandArgs[1] == "replaycmds") {
+            //Lists the commands of the current binary replay in the given time window, e.g. sim replaycmds 3600000 3660000
+            if (!replayFileReader) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+            const u32 fromMs = Utility::StringToU32(commandArgs[2].c_str());
+            const u32 toMs   = Utility::StringToU32(commandArgs[3].c_str());
+
+            //A separate reader is used so that the playback is not disturbed
+            ReplayFileReader reader(simConfig.replayPath);
+            reader.SeekToTime(fromMs);
+            for (const ReplayFileRecord* record = reader.Peek(); record != nullptr && record->time <= toMs; reader.Pop(), record = reader.Peek())
+            {
+                if (record->type == ReplayRecordType::COMMAND)
+                {
+                    printf("%u ms, node index %u: %s" EOL, record->time, record->index, record->command.c_str());
+                }
+            }
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
 
         else if (commandArgs[1] == "animation")
         {
@@ -1373,23 +1602,14 @@ TerminalCommandHandlerReturnType CherrySim::TerminalCommandHandler(const std::ve
         //sim set_position BBBBD 0.5 0.21 0.17
         else if (commandArgs.size() >= 5 && (commandArgs[1] == "set_position" || commandArgs[1] == "add_position" || commandArgs[1] == "set_position_norm" || commandArgs[1] == "add_position_norm"))
         {
-            size_t index = 0;
-            bool nodeFound = false;
-            for (u32 i = 0; i < GetTotalNodes(); i++)
-            {
-                const std::string serialNumberOfNode = nodes[i].gs.config.GetSerialNumber();
-                const std::string serialNumberToSearch = commandArgs[2];
-                if (serialNumberOfNode == serialNumberToSearch)
-                {
-                    index = i;
-                    nodeFound = true;
-                    break;
-                }
-            }
-            if (!nodeFound)
+            bool didError = false;
+            const u32 serialNumberIndex = Utility::GetIndexForSerial(commandArgs[2].c_str(), &didError);
+            const NodeEntry* node = didError ? nullptr : GetNodeEntryBySerialNumber(serialNumberIndex);
+            if (node == nullptr)
             {
                 return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
             }
+            const size_t index = node->index;
 
             float x = 0;
             float y = 0;
@@ -1457,7 +1677,7 @@ void CherrySim::TerminalPrintHandler(const char* message)
     if (terminalPrintListener != nullptr) {
         // If currentNode is nullptr, then we printed out something that does not belong to any node
         // This is probably some simulator log e.g. a replay command.
-        if (currentNode == nullptr || currentNode->id == simConfig.terminalId || simConfig.terminalId == 0) {
+        if ((currentNode == nullptr || currentNode->id == simConfig.terminalId || simConfig.terminalId == 0) && !IsFastForwardingReplay()) {
             terminalPrintListener->TerminalPrintHandler(currentNode, message);
         }
     }
@@ -1500,13 +1720,13 @@ void CherrySim::SetNode(u32 i)
     simFlashPtr = nodes[i].flash;
     simUartPtr = &(nodes[i].state.uartType);
 
-    __application_start_address = (uint32_t)simFlashPtr + FruityHal::GetSoftDeviceSize();
-    __application_end_address = (uint32_t)__application_start_address + ChipsetToApplicationSize(GET_CHIPSET());
-    __application_ram_start_address = (uint32_t)currentNode; //FIXME not the correct value, just adummy.
+    __application_start_address = (uintptr_t)simFlashPtr + FruityHal::GetSoftDeviceSize();
+    __application_end_address = __application_start_address + ChipsetToApplicationSize(GET_CHIPSET());
+    __application_ram_start_address = (uintptr_t)currentNode; //FIXME not the correct value, just adummy.
 
     //Point the linker sections for connectionTypeResolvers to the correct array
-    __start_conn_type_resolvers = (u32)connTypeResolvers;
-    __stop_conn_type_resolvers = ((u32)connTypeResolvers) + sizeof(connTypeResolvers);
+    __start_conn_type_resolvers = (uintptr_t)connTypeResolvers;
+    __stop_conn_type_resolvers = ((uintptr_t)connTypeResolvers) + sizeof(connTypeResolvers);
 
     //TODO: Find a better way to do this
     ChooseSimulatorTerminal();
@@ -1598,6 +1818,7 @@ void CherrySim::QueueInterruptCurrentNode(u32 pin)
         if (currentNode->gpioInitializedPins.find((u32)pin) != currentNode->gpioInitializedPins.end())
         {
             currentNode->interruptQueue.push(pin);
+            if (currentNode->callsUntilInterrupt == 0) currentNode->callsUntilInterrupt = DrawCallsUntilInterrupt();
         }
     }
 }
@@ -1630,6 +1851,12 @@ void CherrySim::InitNode(u32 i)
     nodes[i].index = i;
     nodes[i].id = i + 1;
 
+    //Keyed by the id so that the random numbers of a node stay the same if other nodes are added
+    for (u32 stream = 0; stream < (u32)SimRandomStream::AMOUNT; stream++)
+    {
+        nodes[i].random[stream].SetSeed(simConfig.seed, nodes[i].id, (SimRandomStream)stream);
+    }
+
     //Initialize flash memory
     CheckedMemset(nodes[i].flash, 0xFF, sizeof(nodes[i].flash));
     //TODO: We could load a softdevice and app image into flash, would that help for something?
@@ -1638,6 +1865,8 @@ void CherrySim::InitNode(u32 i)
     nodes[i].address.addr_type = FruityHal::BleGapAddrType::RANDOM_STATIC;
     CheckedMemset(&nodes[i].address.addr, 0x00, 6);
     CheckedMemcpy(nodes[i].address.addr.data() + 2, &nodes[i].id, 2);
+
+    UpdateNodeLookupIndices(i);
 }
 void CherrySim::SetFeaturesets()
 {
@@ -1749,13 +1978,31 @@ void CherrySim::FlashNode(u32 i) {
     }
 }
 
-void CherrySim::ErasePage(u32 pageAddress)
+void CherrySim::ErasePage(uintptr_t pageAddress)
 {
     u32* p = (u32*)pageAddress;
 
     for (u32 i = 0; i < FruityHal::GetCodePageSize() / sizeof(u32); i++) {
         p[i] = 0xFFFFFFFF;
     }
+
+    flashStore.MarkDirty(currentNode->index, (u32)(pageAddress - FLASH_REGION_START_ADDRESS), FruityHal::GetCodePageSize());
+}
+
+//Provides a zeroed memory block of the given size. If reuse is set, a block that the node kept from
+//its last boot is used again as long as the size did not change. Returns true if it had to be allocated.
+static bool PrepareNodeMemoryBlock(u8*& block, u32& blockSize, u32 requiredSize, bool reuse)
+{
+    const bool allocate = !reuse || block == nullptr || blockSize != requiredSize;
+    if (allocate)
+    {
+        delete[] (uint64_t*)block;
+        //Modules are padded to 8 bytes and may need an alignment of 8, e.g. if they contain pointers in a 64 bit build
+        block = (u8*)new uint64_t[requiredSize / sizeof(uint64_t) + 1];
+        blockSize = requiredSize;
+    }
+    CheckedMemset(block, 0, blockSize);
+    return allocate;
 }
 
 void CherrySim::BootCurrentNode()
@@ -1769,6 +2016,7 @@ void CherrySim::BootCurrentNode()
     currentNode->uicr.BOOTLOADERADDR = ChipsetToBootloaderAddr(GetChipset_CherrySim());
     //Put some data where the bootloader is supposed to be (add a version number)
     *((u32*)&currentNode->flash[currentNode->uicr.BOOTLOADERADDR + 1024]) = 123;
+    flashStore.MarkDirty(currentNode->index, currentNode->uicr.BOOTLOADERADDR + 1024, sizeof(u32));
 
     if (currentNode->ficr.CODESIZE * currentNode->ficr.CODEPAGESIZE > SIM_MAX_FLASH_SIZE)
     {
@@ -1785,6 +2033,7 @@ void CherrySim::BootCurrentNode()
     currentNode->bme280WasInit     = false;
     currentNode->gpioInitializedPins.clear();
     currentNode->interruptQueue = {};
+    currentNode->callsUntilInterrupt = 0;
     currentNode->lastMovementSimTimeMs = 0;
 
     //Place a new GlobalState instance into our NodeEntry
@@ -1800,9 +2049,8 @@ void CherrySim::BootCurrentNode()
     //Reset our GPIO Peripheral
     CheckedMemset(simGpioPtr, 0x00, sizeof(NRF_GPIO_Type));
 
-    //Create a queue for events    if (simGlobalStatePtr != nullptr) {
-    currentNode->eventQueue.~deque();
-    new (&(currentNode->eventQueue)) std::queue<simBleEvent>();
+    //Clear all events that were queued before the reset
+    currentNode->eventQueue.Clear();
 
     //Set the Ble stack parameters in the node so that we can use them later
     SetBleStack(currentNode);
@@ -1811,19 +2059,24 @@ void CherrySim::BootCurrentNode()
     currentNode->state.~SoftdeviceState();
     new (&currentNode->state) SoftdeviceState();
 
-    //Allocate halMemory
-    const u32 halMemorySize = FruityHal::GetHalMemorySize() / sizeof(u32) + 1;
-    u32* halMemory = new u32[halMemorySize];
-    CheckedMemset(halMemory, 0, halMemorySize * sizeof(u32));
-    GS->halMemory = halMemory;
+    const NodeBootTemplate& bootTemplate = GetNodeBootTemplate();
+
+    //Prepare halMemory
+    if (PrepareNodeMemoryBlock(currentNode->halMemory, currentNode->halMemorySize, bootTemplate.halMemorySize, simConfig.fastNodeBoot))
+    {
+        amountOfNodeMemoryAllocations++;
+    }
+    GS->halMemory = currentNode->halMemory;
 
     //############## Boot the node using the FruityMesh boot routine
     BootFruityMesh();
 
-    //Create memory for modules
-    const u32 moduleMemoryBlockSize = INITIALIZE_MODULES(false);
-    currentNode->moduleMemoryBlock = (u8*)new u32[moduleMemoryBlockSize / sizeof(u32) + 1];
-    GS->moduleAllocator.SetMemory(currentNode->moduleMemoryBlock, moduleMemoryBlockSize);
+    //Prepare memory for modules
+    if (PrepareNodeMemoryBlock(currentNode->moduleMemoryBlock, currentNode->moduleMemoryBlockSize, bootTemplate.moduleMemoryBlockSize, simConfig.fastNodeBoot))
+    {
+        amountOfNodeMemoryAllocations++;
+    }
+    GS->moduleAllocator.SetMemory(currentNode->moduleMemoryBlock, currentNode->moduleMemoryBlockSize);
     //Boot the modules
     BootModules();
 
@@ -1833,6 +2086,9 @@ void CherrySim::BootCurrentNode()
     //Lets us do some configuration after the boot
     Conf::GetInstance().terminalMode = TerminalMode::PROMPT;
     Conf::GetInstance().defaultLedMode = LedMode::OFF;
+
+    //The serial number is loaded from the UICR and flash during the boot
+    UpdateNodeLookupIndices(currentNode->index);
 }
 
 void CherrySim::ResetCurrentNode(RebootReason rebootReason, bool throwException) {
@@ -1841,8 +2097,11 @@ void CherrySim::ResetCurrentNode(RebootReason rebootReason, bool throwException)
     //Save the node index because it will be gone after node shutdown
     u32 index = currentNode->index;
 
-    //Clean up node
-    ShutdownCurrentNode();
+    //Clean up node. With fastNodeBoot its memory is kept instead, so that BootCurrentNode can reuse it
+    if (!simConfig.fastNodeBoot)
+    {
+        ShutdownCurrentNode();
+    }
 
     //Disconnect all simulator connections to this node
     for (int i = 0; i < currentNode->state.configuredTotalConnectionCount; i++) {
@@ -1866,11 +2125,30 @@ void CherrySim::ResetCurrentNode(RebootReason rebootReason, bool throwException)
 }
 
 void CherrySim::ShutdownCurrentNode() {
-    delete[] currentNode->moduleMemoryBlock;
     //Cast is needed because the following passage from the C++ Standard:
     //"This implies that an object cannot be deleted using a pointer of type void* because there are no objects of type void"
-    u32* halMemory = (u32*)GS->halMemory;
-    delete[] halMemory;
+    delete[] (uint64_t*)currentNode->moduleMemoryBlock;
+    currentNode->moduleMemoryBlock = nullptr;
+    currentNode->moduleMemoryBlockSize = 0;
+    delete[] (uint64_t*)currentNode->halMemory;
+    currentNode->halMemory = nullptr;
+    currentNode->halMemorySize = 0;
+    GS->halMemory = nullptr;
+}
+
+const CherrySim::NodeBootTemplate& CherrySim::GetNodeBootTemplate()
+{
+    auto entry = nodeBootTemplates.find(currentNode->nodeConfiguration);
+    if (entry != nodeBootTemplates.end() && simConfig.fastNodeBoot)
+    {
+        return entry->second;
+    }
+
+    NodeBootTemplate bootTemplate;
+    bootTemplate.halMemorySize = FruityHal::GetHalMemorySize();
+    //Only measures the modules of the featureset, nothing is created yet
+    bootTemplate.moduleMemoryBlockSize = INITIALIZE_MODULES(false);
+    return nodeBootTemplates[currentNode->nodeConfiguration] = bootTemplate;
 }
 
 //################################## Flash Simulation #####################################
@@ -1881,7 +2159,7 @@ void CherrySim::ShutdownCurrentNode() {
 //#########################################################################################
 
 void CherrySim::SimulateFlashCommit() {
-    if (PSRNG(simConfig.asyncFlashCommitTimeProbability)) {
+    if (NODE_PSRNG(SCHEDULING, simConfig.asyncFlashCommitTimeProbability)) {
         SimCommitFlashOperations();
     }
 }
@@ -1893,7 +2171,8 @@ void CherrySim::SimCommitFlashOperations()
 {
     if (cherrySimInstance->simConfig.simulateAsyncFlash) {
         while (cherrySimInstance->currentNode->state.numWaitingFlashOperations > 0) {
-            DispatchSystemEvents(FruityHal::SystemEvents::FLASH_OPERATION_SUCCESS);
+            const bool fail = faultInjector.ShouldFailFlashOperation(currentNode->id);
+            DispatchSystemEvents(fail ? FruityHal::SystemEvents::FLASH_OPERATION_ERROR : FruityHal::SystemEvents::FLASH_OPERATION_SUCCESS);
             cherrySimInstance->currentNode->state.numWaitingFlashOperations--;
         }
     }
@@ -1924,6 +2203,18 @@ void CherrySim::SimulateBroadcast() {
     //Check for other nodes that are scanning and send them the events
     if (currentNode->state.advertisingActive) {
         if (ShouldSimIvTrigger(currentNode->state.advertisingIntervalMs)) {
+            if (pcapWriter)
+            {
+                pcapWriter->CaptureAdvertisement(
+                    currentNode->index,
+                    simState.simTimeMs,
+                    (u8)currentNode->state.advertisingType,
+                    currentNode->address.addr_type != FruityHal::BleGapAddrType::PUBLIC,
+                    currentNode->address.addr.data(),
+                    currentNode->state.advertisingData,
+                    currentNode->state.advertisingDataLength);
+            }
+
             //Distribute the event to all nodes in range
             for (u32 i = 0; i < GetTotalNodes(); i++) {
                 if (i != currentNode->index) {
@@ -1932,8 +2223,8 @@ void CherrySim::SimulateBroadcast() {
                     if (nodes[i].state.scanningActive) {
                         //If the random value hits the probability, the event is sent
                         uint32_t probability = CalculateReceptionProbability(currentNode, &nodes[i]);
-                        if (PSRNG(probability)) {
-                            simBleEvent s;
+                        if (GetLinkRandom(currentNode, &nodes[i], SimLinkRandom::RECEPTION).NextPsrng(probability) && !faultInjector.ShouldDropPacket(currentNode->id, nodes[i].id)) {
+                            simBleEvent& s = nodes[i].eventQueue.EmplaceBack();
                             s.globalId = simState.globalEventIdCounter++;
                             s.bleEvent.header.evt_id = BLE_GAP_EVT_ADV_REPORT;
                             s.bleEvent.header.evt_len = s.globalId;
@@ -1941,7 +2232,6 @@ void CherrySim::SimulateBroadcast() {
 
                             CheckedMemcpy(&s.bleEvent.evt.gap_evt.params.adv_report.data, &currentNode->state.advertisingData, currentNode->state.advertisingDataLength);
                             s.bleEvent.evt.gap_evt.params.adv_report.dlen = currentNode->state.advertisingDataLength;
-                            CheckedMemset(&s.bleEvent.evt.gap_evt.params.adv_report.peer_addr, 0, sizeof(s.bleEvent.evt.gap_evt.params.adv_report.peer_addr));
                             s.bleEvent.evt.gap_evt.params.adv_report.peer_addr.addr_type = (u8)currentNode->address.addr_type;
                             static_assert(sizeof(s.bleEvent.evt.gap_evt.params.adv_report.peer_addr.addr) == sizeof(currentNode->address.addr), "See next line.");
                             CheckedMemcpy(&s.bleEvent.evt.gap_evt.params.adv_report.peer_addr.addr, &currentNode->address.addr, sizeof(currentNode->address.addr));
@@ -1949,8 +2239,6 @@ void CherrySim::SimulateBroadcast() {
                             s.bleEvent.evt.gap_evt.params.adv_report.rssi = (i8)GetReceptionRssi(currentNode, &nodes[i]);
                             s.bleEvent.evt.gap_evt.params.adv_report.scan_rsp = 0;
                             s.bleEvent.evt.gap_evt.params.adv_report.type = (u8)currentNode->state.advertisingType;
-
-                            nodes[i].eventQueue.push_back(s);
                         }
                     }
                     //If the other node is connecting
@@ -1959,7 +2247,7 @@ void CherrySim::SimulateBroadcast() {
                         if (memcmp(&nodes[i].state.connectingPartnerAddr, &currentNode->address, sizeof(FruityHal::BleGapAddr)) == 0) {
                             //If the random value hits the probability, the event is sent
                             uint32_t probability = CalculateReceptionProbability(currentNode, &nodes[i]);
-                            if (PSRNG(probability)) {
+                            if (GetLinkRandom(currentNode, &nodes[i], SimLinkRandom::RECEPTION).NextPsrng(probability) && !faultInjector.ShouldDropPacket(currentNode->id, nodes[i].id)) {
 
                                 ConnectMasterToSlave(&nodes[i], currentNode);
 
@@ -2059,8 +2347,7 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     freeInConnection->lastReceivedPacketTimestampMs = simState.simTimeMs;
 
     //Generate an event for the current node
-    simBleEvent s2;
-    CheckedMemset(&s2, 0, sizeof(s2));
+    simBleEvent& s2 = slave->eventQueue.EmplaceBack();
     s2.globalId = simState.globalEventIdCounter++;
     s2.bleEvent.header.evt_id = BLE_GAP_EVT_CONNECTED;
     s2.bleEvent.header.evt_len = s2.globalId;
@@ -2071,8 +2358,6 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     s2.bleEvent.evt.gap_evt.params.connected.peer_addr = Convert(&master->address);
     s2.bleEvent.evt.gap_evt.params.connected.role = BLE_GAP_ROLE_PERIPH;
 
-    slave->eventQueue.push_back(s2);
-
     //###### Remote node
 
     u8 activeCentralConnCount = 0;
@@ -2116,8 +2401,7 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     freeOutConnection->partnerConnection = freeInConnection;
 
     //Generate an event for the remote node
-    simBleEvent s;
-    CheckedMemset(&s, 0, sizeof(s));
+    simBleEvent& s = master->eventQueue.EmplaceBack();
     s.globalId = simState.globalEventIdCounter++;
     s.bleEvent.header.evt_id = BLE_GAP_EVT_CONNECTED;
     s.bleEvent.header.evt_len = s.globalId;
@@ -2128,8 +2412,6 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     s.bleEvent.evt.gap_evt.params.connected.peer_addr = Convert(&slave->address);
     s.bleEvent.evt.gap_evt.params.connected.role = BLE_GAP_ROLE_CENTRAL;
 
-    master->eventQueue.push_back(s);
-
     //Disable connecting for the other node because we just got the remote SoftDevice a connection
     master->state.connectingActive = false;
 }
@@ -2173,26 +2455,22 @@ u32 CherrySim::DisconnectSimulatorConnection(SoftdeviceConnection* connection, u
     //#### Our own node
     connection->connectionActive = false;
 
-    simBleEvent s1;
-    CheckedMemset(&s1, 0, sizeof(s1));
+    simBleEvent& s1 = connection->owningNode->eventQueue.EmplaceBack();
     s1.globalId = simState.globalEventIdCounter++;
     s1.bleEvent.header.evt_id = BLE_GAP_EVT_DISCONNECTED;
     s1.bleEvent.header.evt_len = s1.globalId;
     s1.bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
     s1.bleEvent.evt.gap_evt.params.disconnected.reason = hciReason;
-    connection->owningNode->eventQueue.push_back(s1);
 
     //#### Remote node
     partnerConnection->connectionActive = false;
 
-    simBleEvent s2;
-    CheckedMemset(&s2, 0, sizeof(s2));
+    simBleEvent& s2 = partnerNode->eventQueue.EmplaceBack();
     s2.globalId = simState.globalEventIdCounter++;
     s2.bleEvent.header.evt_id = BLE_GAP_EVT_DISCONNECTED;
     s2.bleEvent.header.evt_len = s2.globalId;
     s2.bleEvent.evt.gap_evt.conn_handle = partnerConnection->connectionHandle;
     s2.bleEvent.evt.gap_evt.params.disconnected.reason = hciReasonPartner;
-    partnerNode->eventQueue.push_back(s2);
 
     return NRF_SUCCESS;
 }
@@ -2201,15 +2479,12 @@ void CherrySim::SimulateTimeouts() {
     if (currentNode->state.connectingActive && currentNode->state.connectingTimeoutTimestampMs <= (i32)simState.simTimeMs) {
         currentNode->state.connectingActive = false;
 
-        simBleEvent s;
-        CheckedMemset(&s, 0, sizeof(s));
+        simBleEvent& s = currentNode->eventQueue.EmplaceBack();
         s.globalId = simState.globalEventIdCounter++;
         s.bleEvent.header.evt_id = BLE_GAP_EVT_TIMEOUT;
         s.bleEvent.header.evt_len = s.globalId;
         s.bleEvent.evt.gap_evt.conn_handle = BLE_CONN_HANDLE_INVALID;
         s.bleEvent.evt.gap_evt.params.timeout.src = BLE_GAP_TIMEOUT_SRC_CONN;
-
-        currentNode->eventQueue.push_back(s);
     }
 }
 
@@ -2263,15 +2538,12 @@ SoftDeviceBufferedPacket* getNextPacketToWrite(SoftdeviceConnection* connection)
 void CherrySim::SendUnreliableTxCompleteEvent(NodeEntry* node, int connHandle, u8 packetCount)
 {
     if (packetCount > 0) {
-        simBleEvent s2;
-        CheckedMemset(&s2, 0, sizeof(s2));
+        simBleEvent& s2 = node->eventQueue.EmplaceBack();
         s2.globalId = simState.globalEventIdCounter++;
         s2.bleEvent.header.evt_id = BLE_GATTC_EVT_WRITE_CMD_TX_COMPLETE;
         s2.bleEvent.header.evt_len = s2.globalId;
         s2.bleEvent.evt.gattc_evt.conn_handle = connHandle;
         s2.bleEvent.evt.gattc_evt.params.write_cmd_tx_complete.count = packetCount;
-
-        node->eventQueue.push_back(s2);
     }
 }
 
@@ -2307,19 +2579,23 @@ void CherrySim::SimulateConnections() {
                 u8 numPacketsToSend;
                 u32 unreliablePacketsSent = 0;
 
-                if (numConnections == 1) numPacketsToSend = (u8)PSRNGINT(0, SIM_NUM_UNRELIABLE_BUFFERS);
-                else if (numConnections == 2) numPacketsToSend = (u8)PSRNGINT(0, 5);
-                else numPacketsToSend = (u8)PSRNGINT(0, 3);
+                if (numConnections == 1) numPacketsToSend = (u8)NODE_PSRNGINT(CONNECTION, 0, SIM_NUM_UNRELIABLE_BUFFERS);
+                else if (numConnections == 2) numPacketsToSend = (u8)NODE_PSRNGINT(CONNECTION, 0, 5);
+                else numPacketsToSend = (u8)NODE_PSRNGINT(CONNECTION, 0, 3);
 
                 const double rssiMult = CalculateReceptionProbability(connection->owningNode, connection->partner);
-                if (rssiMult == 0)
+                if (rssiMult == 0 || faultInjector.ShouldDropPacket(currentNode->id, connection->partner->id))
                 {
                     numPacketsToSend = 0;
                 }
                 else
                 {
                     currentNode->state.connections[i].lastReceivedPacketTimestampMs = this->simState.simTimeMs;
+
+                    //A stalled connection is kept alive by empty packets, but does not send any data
+                    if (faultInjector.IsTxStalled(currentNode->id, connection->partner->id)) numPacketsToSend = 0;
                 }
+                const u32 latencyMs = faultInjector.GetLatencyMs(currentNode->id, connection->partner->id);
                 
 
                 //Simulate timeouts if messages can't be send anymore.
@@ -2345,6 +2621,7 @@ void CherrySim::SimulateConnections() {
                 for (int k = 0; k < numPacketsToSend; k++) {
                     SoftDeviceBufferedPacket* packet = getNextPacketToWrite(connection);
                     if (packet == nullptr) break;
+                    if (latencyMs != 0 && simState.simTimeMs - packet->queueTimeMs < latencyMs) break;
 
                     //Notifications
                     if (packet->isHvx) {
@@ -2373,8 +2650,7 @@ void CherrySim::SimulateConnections() {
 
                         //Generate the event that the write was successful immediately
                         //TODO: Could be postponed a bit to better match the real world
-                        simBleEvent s2;
-                        CheckedMemset(&s2, 0, sizeof(s2));
+                        simBleEvent& s2 = currentNode->eventQueue.EmplaceBack();
                         s2.globalId = simState.globalEventIdCounter++;
                         s2.bleEvent.header.evt_id = BLE_GATTC_EVT_WRITE_RSP;
                         s2.bleEvent.header.evt_len = s2.globalId;
@@ -2382,7 +2658,6 @@ void CherrySim::SimulateConnections() {
                         s2.bleEvent.evt.gattc_evt.gatt_status = (u16)FruityHal::BleGattEror::SUCCESS;
                         //Save the global packet id so that we can track where a packet was generated after we receive it
                         s2.additionalInfo = packet->globalPacketId;
-                        currentNode->eventQueue.push_back(s2);
 
 
 
@@ -2408,15 +2683,12 @@ void CherrySim::SimulateConnections() {
                 NodeEntry* master = i == 0 ? connection->partner : currentNode;
                 NodeEntry* slave = i == 0 ? currentNode : connection->partner;
 
-                simBleEvent s;
-                CheckedMemset(&s, 0, sizeof(s));
+                simBleEvent& s = currentNode->eventQueue.EmplaceBack();
                 s.globalId = simState.globalEventIdCounter++;
                 s.bleEvent.header.evt_id = BLE_GAP_EVT_RSSI_CHANGED;
                 s.bleEvent.header.evt_len = s.globalId;
                 s.bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
                 s.bleEvent.evt.gap_evt.params.rssi_changed.rssi = (i8)GetReceptionRssi(master, slave);
-
-                currentNode->eventQueue.push_back(s);
             }
         }
     }
@@ -2425,7 +2697,7 @@ void CherrySim::SimulateConnections() {
     if (simConfig.connectionTimeoutProbabilityPerSec != 0) {
         for (int i = 0; i < currentNode->state.configuredTotalConnectionCount; i++) {
             if (currentNode->state.connections[i].connectionActive) {
-                if (PSRNG(simConfig.connectionTimeoutProbabilityPerSec)) {
+                if (NODE_PSRNG(CONNECTION, simConfig.connectionTimeoutProbabilityPerSec)) {
                     SIMSTATCOUNT("simulatedTimeouts");
                     printf("Simulated Connection Loss for node %d to partner %d (handle %d)" EOL, currentNode->id, currentNode->state.connections[i].partner->id, currentNode->state.connections[i].connectionHandle);
                     DisconnectSimulatorConnection(&currentNode->state.connections[i], BLE_HCI_CONNECTION_TIMEOUT, BLE_HCI_CONNECTION_TIMEOUT);
@@ -2457,18 +2729,6 @@ void CherrySim::GenerateWrite(SoftDeviceBufferedPacket* bufferedPacket) {
         printf("%s" EOL, j.dump().c_str());
     }
 
-    //Generate WRITE event at our partners side
-    simBleEvent s;
-    s.globalId = simState.globalEventIdCounter++;
-    s.bleEvent.header.evt_id = BLE_GATTS_EVT_WRITE;
-    s.bleEvent.header.evt_len = s.globalId;
-
-    //Save the global packet id so that we can track where a packet was generated after we receive it
-    s.additionalInfo = bufferedPacket->globalPacketId;
-
-    //Generate write event in partners event queue
-    s.bleEvent.evt.gatts_evt.conn_handle = conn_handle;
-
 #ifdef SIM_ENABLED
     //If we are dealing with a non mesh access connection, we can check if the message type is invalid and throw an error
     BaseConnection *bc = GS->cm.GetRawConnectionFromHandle(conn_handle);
@@ -2487,13 +2747,39 @@ void CherrySim::GenerateWrite(SoftDeviceBufferedPacket* bufferedPacket) {
     }
 #endif
 
+    if (pcapWriter)
+    {
+        pcapWriter->CaptureAttPacket(
+            sender->index,
+            simState.simTimeMs,
+            conn_handle,
+            true,
+            p_write_params.write_op == BLE_GATT_OP_WRITE_REQ ? 0x12 : 0x52, //ATT Write Request / Write Command
+            p_write_params.handle,
+            p_write_params.p_value,
+            p_write_params.len,
+            receiver->id,
+            bufferedPacket->globalPacketId);
+    }
+
+    AddPacketEnergyUsage(sender, receiver, p_write_params.len);
+
+    //Generate WRITE event in our partners event queue
+    simBleEvent& s = receiver->eventQueue.EmplaceBack();
+    s.globalId = simState.globalEventIdCounter++;
+    s.bleEvent.header.evt_id = BLE_GATTS_EVT_WRITE;
+    s.bleEvent.header.evt_len = s.globalId;
+
+    //Save the global packet id so that we can track where a packet was generated after we receive it
+    s.additionalInfo = bufferedPacket->globalPacketId;
+
+    s.bleEvent.evt.gatts_evt.conn_handle = conn_handle;
+
     CheckedMemcpy(&s.bleEvent.evt.gatts_evt.params.write.data, p_write_params.p_value, p_write_params.len);
     s.bleEvent.evt.gatts_evt.params.write.handle = p_write_params.handle;
     s.bleEvent.evt.gatts_evt.params.write.len = p_write_params.len;
     s.bleEvent.evt.gatts_evt.params.write.offset = 0;
     s.bleEvent.evt.gatts_evt.params.write.op = p_write_params.write_op;
-
-    receiver->eventQueue.push_back(s);
 }
 
 void CherrySim::GenerateNotification(SoftDeviceBufferedPacket* bufferedPacket) {
@@ -2512,13 +2798,30 @@ void CherrySim::GenerateNotification(SoftDeviceBufferedPacket* bufferedPacket) {
         j["reliable"] = false;
         j["timeMs"] = simState.simTimeMs;
         char buffer[128];
-        Logger::ConvertBufferToHexString(hvx_params.p_data, (u32)hvx_params.p_len, buffer, 128);
+        Logger::ConvertBufferToHexString(hvx_params.p_data, (u32)(uintptr_t)hvx_params.p_len, buffer, 128);
         j["data"] = buffer;
         printf("%s" EOL, j.dump().c_str());
     }
 
+    if (pcapWriter)
+    {
+        pcapWriter->CaptureAttPacket(
+            sender->index,
+            simState.simTimeMs,
+            conn_handle,
+            false,
+            hvx_params.type == BLE_GATT_HVX_INDICATION ? 0x1D : 0x1B, //ATT Handle Value Indication / Notification
+            hvx_params.handle,
+            hvx_params.p_data,
+            (u32)(uintptr_t)hvx_params.p_len,
+            receiver->id,
+            bufferedPacket->globalPacketId);
+    }
+
+    AddPacketEnergyUsage(sender, receiver, (u32)(uintptr_t)hvx_params.p_len);
+
     //Generate HVX event at our partners side
-    simBleEvent s;
+    simBleEvent& s = receiver->eventQueue.EmplaceBack();
     s.globalId = simState.globalEventIdCounter++;
     s.bleEvent.header.evt_id = BLE_GATTC_EVT_HVX;
     s.bleEvent.header.evt_len = s.globalId;
@@ -2526,13 +2829,11 @@ void CherrySim::GenerateNotification(SoftDeviceBufferedPacket* bufferedPacket) {
 
     //jstodo check this workaround again.
     // This is a workaround for hvxParams keeping only pointer to len.
-    CheckedMemcpy(&s.bleEvent.evt.gattc_evt.params.hvx.data, hvx_params.p_data, (u32)hvx_params.p_len);
+    CheckedMemcpy(&s.bleEvent.evt.gattc_evt.params.hvx.data, hvx_params.p_data, (u32)(uintptr_t)hvx_params.p_len);
     s.bleEvent.evt.gattc_evt.params.hvx.handle = hvx_params.handle;
     // This is a workaround for hvxParams keeping only pointer to len.
-    s.bleEvent.evt.gattc_evt.params.hvx.len = (u16)(u32)hvx_params.p_len;
+    s.bleEvent.evt.gattc_evt.params.hvx.len = (u16)(u32)(uintptr_t)hvx_params.p_len;
     s.bleEvent.evt.gattc_evt.params.hvx.type = hvx_params.type;
-
-    receiver->eventQueue.push_back(s);
 }
 
 void CherrySim::StartServiceDiscovery(u16 connHandle, const ble_uuid_t &p_uuid, int discoveryTimeMs)
@@ -2613,117 +2914,133 @@ void CherrySim::SimulateClcData() {
 }
 #endif //GITHUB_RELEASE
 
+//Evaluates the animations of all moving nodes at once. The positions are only applied once each
+//node is simulated so that nodes earlier in the step still see the old positions of the others.
+void CherrySim::EvaluateMoveAnimations()
+{
+    moveAnimationEngine.BeginSync();
+    for (u32 i = 0; i < GetTotalNodes(); i++)
+    {
+        if (nodes[i].animation.IsStarted()) moveAnimationEngine.Sync(i, nodes[i].animation);
+    }
+    moveAnimationEngine.Evaluate(simState.simTimeMs);
+}
+
 void CherrySim::SimulateMovement()
 {
     if (currentNode->animation.IsStarted())
     {
-        auto pos = currentNode->animation.Evaluate(simState.simTimeMs);
+        ThreeDimStruct<float> pos = {};
+        bool finished = false;
+        if (moveAnimationEngine.GetPosition(currentNode->index, currentNode->animation, simState.simTimeMs, pos, finished))
+        {
+            //Same as MoveAnimation::Evaluate does once a non looped animation is over
+            if (finished) currentNode->animation = MoveAnimation();
+        }
+        else
+        {
+            //E.g. the animation was started by a command during this step
+            pos = currentNode->animation.Evaluate(simState.simTimeMs);
+        }
         SetPosition(currentNode->index, pos.x, pos.y, pos.z);
     }
 }
 
 //################################## Battery Usage Simulation #############################
-// Checks the features that are activated on a node and estimates the battery usage
+// Estimates the energy that each node draws from its battery, see SimEnergyModel
 //#########################################################################################
 
 void CherrySim::SimulateBatteryUsage()
 {
-    //Have a look at: https://devzone.nordicsemi.com/b/blog/posts/nrf51-current-consumption-for-common-scenarios
-    //or: https://github.com/mwaylabs/fruitymesh/wiki/Battery-Consumption
-
-    //TODO: Make measurements and check online resources to find out current consumption
-    //TODO: provide values for nrf52
-    //TODO: Take into account what changes at 0 dbm and at +4dmb
-    //TODO: Take into account that each sent packet consumes power in addition to the connectionInterval itself
-    //TODO: If too much activity happens at the same time, the scheduler will postpone tasks and use less energy (also relevant for connection / advertising, etc,... performance)
-
-    u32 divider = 1000UL / simConfig.simTickDurationMs;
-
-    //All current usages are given as nano ampere per step
-    u32 idleDraw = 10 * 1000 / divider; //10 uA idle current usage
-    u32 ledUsage = 10 * 1000 * 1000 / divider; //10 mA led on usage
-    u32 adv20Ms = 800 * 1000 / divider; //imaginary value for 20ms advertising
-    u32 adv100Ms = 220 * 1000 / divider; //220 uA advertising at 100ms interval
-    u32 adv200Ms = 110 * 1000 / divider; //110 uA advertising at 200ms interval
-    u32 adv400Ms = 84 * 1000 / divider; //84 uA advertising at 400ms interval
-    u32 adv1000Ms = 70 * 1000 / divider; //70 uA advertising at 1000ms interval
-    u32 adv2000Ms = 50 * 1000 / divider; //50 uA advertising at 2000ms interval
-    u32 adv4000Ms = 63 * 1000 / divider; //63 uA advertising at 4000ms interval
-    u32 adv30000Ms = 30 * 1000 / divider; //30 uA advertising at 30000ms interval
-    u32 conn100Ms = 130 * 1000 / divider; //70 uA per connection at 100ms interval
-    u32 conn7_5Ms = 1000 * 1000 / divider; //1000 uA per connection at 7.5ms interval (imaginary value)
-    u32 conn10Ms = 900 * 1000 / divider; //900 uA per connection at 10ms interval (imaginary value)
-    u32 conn15Ms = 750 * 1000 / divider; //750 uA per connection at 15ms interval (imaginary value)
-    u32 conn30Ms = 600 * 1000 / divider; //600 uA per connection at 30ms interval (imaginary value)
-    u32 conn90Ms = 300 * 1000 / divider; //300 uA per connection at 90ms interval (imaginary value)
-
-    //Other values
-    u32 scanUsage = 11 * 1000 * 1000 / divider; //11mA for scanning at 100% duty cycle
-
-
-    //Next, we add up all the numbers for all active features
-    currentNode->nanoAmperePerMsTotal += idleDraw;
+    //Activities that last for the whole step are added here, the charge of single events such as
+    //packets, flash operations and processed events is added where they are simulated
+    const SimEnergyModel& model = energyModel;
+    const u32 stepMs = simConfig.simTickDurationMs;
+    const i8 txPower = currentNode->state.txPower;
+
+    AddEnergyUsage(currentNode, SimEnergySubsystem::IDLE, SimEnergyModel::GetCharge(model.idleCurrentMicroAmpere, stepMs * 1000ULL));
 
     if (currentNode->ledOn) {
-        currentNode->nanoAmperePerMsTotal += ledUsage;
+        AddEnergyUsage(currentNode, SimEnergySubsystem::LED, SimEnergyModel::GetCharge(model.ledCurrentMicroAmpere, stepMs * 1000ULL));
     }
 
     if (currentNode->state.advertisingActive) {
-        if (currentNode->state.advertisingIntervalMs == 20) currentNode->nanoAmperePerMsTotal += adv20Ms;
-        else if (currentNode->state.advertisingIntervalMs == 100) currentNode->nanoAmperePerMsTotal += adv100Ms;
-        else if (currentNode->state.advertisingIntervalMs == 200) currentNode->nanoAmperePerMsTotal += adv200Ms;
-        else if (currentNode->state.advertisingIntervalMs == 400) currentNode->nanoAmperePerMsTotal += adv400Ms;
-        else if (currentNode->state.advertisingIntervalMs == 1000) currentNode->nanoAmperePerMsTotal += adv1000Ms;
-        else if (currentNode->state.advertisingIntervalMs == 4000) currentNode->nanoAmperePerMsTotal += adv4000Ms;
-        else if (currentNode->state.advertisingIntervalMs == 2000) currentNode->nanoAmperePerMsTotal += adv2000Ms;
-        else if (currentNode->state.advertisingIntervalMs == 30000) currentNode->nanoAmperePerMsTotal += adv30000Ms;
-        else {
-            printf("Adv interval not integrated into battery test, %u" EOL, (u32)currentNode->state.advertisingIntervalMs);
+        if (currentNode->state.advertisingIntervalMs <= 0) {
+            printf("Adv interval not valid for battery simulation, %d" EOL, currentNode->state.advertisingIntervalMs);
             SIMEXCEPTION(IllegalAdvertismentStateException);
         }
+        else {
+            const bool listensForRequests = currentNode->state.advertisingType != FruityHal::BleGapAdvType::ADV_NONCONN_IND;
+            const uint64_t eventCharge = model.GetAdvertisingEventCharge(currentNode->state.advertisingDataLength, txPower, listensForRequests);
+            AddEnergyUsage(currentNode, SimEnergySubsystem::ADVERTISING, eventCharge * stepMs / (u32)currentNode->state.advertisingIntervalMs);
+        }
     }
 
     if (currentNode->state.scanningActive) {
-        u32 scanDutyCycle = currentNode->state.scanWindowMs * 1000UL / currentNode->state.scanIntervalMs;
-        u32 usagePerStepWithGivenDutyCycle = scanUsage * scanDutyCycle / 1000;
-        currentNode->nanoAmperePerMsTotal += usagePerStepWithGivenDutyCycle;
+        AddEnergyUsage(currentNode, SimEnergySubsystem::SCANNING, model.GetScanningCharge(currentNode->state.scanWindowMs, currentNode->state.scanIntervalMs, stepMs));
     }
 
     if (currentNode->state.connectingActive) {
-        u32 scanDutyCycle = currentNode->state.connectingWindowMs * 1000UL / currentNode->state.connectingIntervalMs;
-        u32 usagePerStepWithGivenDutyCycle = scanUsage * scanDutyCycle / 1000;
-        currentNode->nanoAmperePerMsTotal += usagePerStepWithGivenDutyCycle;
+        AddEnergyUsage(currentNode, SimEnergySubsystem::SCANNING, model.GetScanningCharge(currentNode->state.connectingWindowMs, currentNode->state.connectingIntervalMs, stepMs));
     }
 
+    //Every connection has a connection event per interval, even if no data is sent
     for (u32 i = 0; i < currentNode->state.configuredTotalConnectionCount; i++) {
         SoftdeviceConnection* conn = currentNode->state.connections + i;
         if (conn->connectionActive) {
-            if (conn->connectionInterval == 100) {
-                currentNode->nanoAmperePerMsTotal += conn100Ms;
-            }
-            else if (conn->connectionInterval == 7) {
-                currentNode->nanoAmperePerMsTotal += conn7_5Ms;
-            }
-            else if (conn->connectionInterval == 10) {
-                currentNode->nanoAmperePerMsTotal += conn10Ms;
-            }
-            else if (conn->connectionInterval == 15) {
-                currentNode->nanoAmperePerMsTotal += conn15Ms;
-            }
-            else if (conn->connectionInterval == 30) {
-                currentNode->nanoAmperePerMsTotal += conn30Ms;
-            }
-            else if (conn->connectionInterval == 90) {
-                currentNode->nanoAmperePerMsTotal += conn90Ms;
-            }
-            else {
-                printf("Conn interval not integrated into battery test" EOL);
+            if (conn->connectionInterval <= 0) {
+                printf("Conn interval not valid for battery simulation" EOL);
                 SIMEXCEPTION(IllegalStateException);
+                continue;
             }
+            //The interval is stored in ms, 7 is used for the minimum interval of 7.5 ms
+            const u32 connectionIntervalUs = conn->connectionInterval == 7 ? 7500 : (u32)conn->connectionInterval * 1000;
+            AddEnergyUsage(currentNode, SimEnergySubsystem::CONNECTION_EVENTS, model.GetConnectionEventCharge(txPower) * stepMs * 1000 / connectionIntervalUs);
         }
     }
+}
 
-    //TODO: Add up current for connections according to connectionIntervals of each connection
+void CherrySim::AddEnergyUsage(NodeEntry* node, SimEnergySubsystem subsystem, uint64_t chargeNanoCoulomb)
+{
+    node->energy.chargeNanoCoulomb[(u32)subsystem] += chargeNanoCoulomb;
+    node->nanoAmperePerMsTotal += chargeNanoCoulomb;
+}
+
+void CherrySim::AddPacketEnergyUsage(NodeEntry* sender, NodeEntry* receiver, u32 payloadLength)
+{
+    sender->energy.txPackets++;
+    sender->energy.txBytes += payloadLength;
+    AddEnergyUsage(sender, SimEnergySubsystem::RADIO_TX, energyModel.GetPacketCharge(payloadLength, true, sender->state.txPower));
+
+    receiver->energy.rxPackets++;
+    receiver->energy.rxBytes += payloadLength;
+    AddEnergyUsage(receiver, SimEnergySubsystem::RADIO_RX, energyModel.GetPacketCharge(payloadLength, false, receiver->state.txPower));
+}
+
+//################################## Fault Injection ######################################
+// Executes the faults of the SimFaultInjector that are not checked inside other simulation parts
+//#########################################################################################
+
+void CherrySim::SimulateFaults()
+{
+    std::vector<const SimFault*> dueDisconnects;
+    faultInjector.Update(simState.simTimeMs, dueDisconnects);
+
+    for (const SimFault* fault : dueDisconnects)
+    {
+        for (u32 i = 0; i < GetTotalNodes(); i++)
+        {
+            for (u32 k = 0; k < nodes[i].state.configuredTotalConnectionCount; k++)
+            {
+                SoftdeviceConnection* connection = &nodes[i].state.connections[k];
+                if (connection->connectionActive && fault->MatchesLink(nodes[i].id, connection->partner->id))
+                {
+                    printf("Injected disconnect of node %d from partner %d" EOL, nodes[i].id, connection->partner->id);
+                    DisconnectSimulatorConnection(connection, BLE_HCI_CONNECTION_TIMEOUT, BLE_HCI_CONNECTION_TIMEOUT);
+                }
+            }
+        }
+    }
 }
 
 //################################## Other Simulation #####################################
@@ -2736,8 +3053,28 @@ void CherrySim::SimulateTimer() {
     //Advance time of this node
     currentNode->state.timeMs += simConfig.simTickDurationMs;
 
-    if (ShouldSimIvTrigger(100L * MAIN_TIMER_TICK * 10 / ticksPerSecond)) {
-        app_timer_handler(nullptr);
+    const u32 timerIntervalMs = 100L * MAIN_TIMER_TICK * 10 / ticksPerSecond;
+    if (ShouldSimIvTrigger(timerIntervalMs)) {
+        //A drifting clock calls the timer handler once more or once less as soon as the drift adds up to a whole interval
+        u32 timerHandlerCalls = 1;
+        const i32 driftPpm = faultInjector.GetClockDriftPpm(currentNode->id);
+        if (driftPpm != 0) {
+            currentNode->clockDriftUs += (int64_t)timerIntervalMs * driftPpm / 1000;
+            const int64_t timerIntervalUs = timerIntervalMs * 1000LL;
+            if (currentNode->clockDriftUs >= timerIntervalUs) {
+                currentNode->clockDriftUs -= timerIntervalUs;
+                timerHandlerCalls = 2;
+            }
+            else if (currentNode->clockDriftUs <= -timerIntervalUs) {
+                currentNode->clockDriftUs += timerIntervalUs;
+                timerHandlerCalls = 0;
+            }
+        }
+        for (u32 i = 0; i < timerHandlerCalls; i++) {
+            currentNode->energy.cpuEvents++;
+            AddEnergyUsage(currentNode, SimEnergySubsystem::CPU, energyModel.GetCpuCharge(1));
+            app_timer_handler(nullptr);
+        }
     }
 }
 
@@ -2767,27 +3104,41 @@ struct InterruptGuard
     }
 };
 
+//Each call of START_OF_FUNCTION used to simulate a queued interrupt with the probability interruptProbability.
+//The number of calls until this happens is geometrically distributed, so it is drawn once instead.
+u32 CherrySim::DrawCallsUntilInterrupt()
+{
+    const u32 probability = simConfig.interruptProbability;
+    if (probability == 0) return 0;
+    if (probability == UINT32_MAX) return 1;
+
+    const double uniform = (NODE_RANDOM(SCHEDULING).NextU32() + 0.5) / 4294967296.0;
+    const double calls = std::floor(std::log(uniform) / std::log1p(-(double)probability / UINT32_MAX)) + 1;
+    return calls < UINT32_MAX ? (u32)calls : UINT32_MAX;
+}
+
 void CherrySim::SimulateInterrupts()
 {
     if (currentNode->interruptQueue.size() > 0 && InterruptGuard::currentlyInAnInterrupt == false)
     {
-        if (PSRNG(simConfig.interruptProbability))
-        {
-            InterruptGuard guard;
+        InterruptGuard guard;
 
-            u32 pin = currentNode->interruptQueue.front();
-            currentNode->interruptQueue.pop();
+        u32 pin = currentNode->interruptQueue.front();
+        currentNode->interruptQueue.pop();
 
-            if (cherrySimInstance->currentNode->gpioInitializedPins.find(pin) != cherrySimInstance->currentNode->gpioInitializedPins.end()) {
-                InterruptSettings &settings = currentNode->gpioInitializedPins[pin];
-                if (settings.isEnabled)
-                {
-                    //TODO The polarity is currently unused by every interrupt handler, thus we just pass 0 here.
-                    settings.handler(pin, 0);
-                }
+        auto entry = currentNode->gpioInitializedPins.find(pin);
+        if (entry != currentNode->gpioInitializedPins.end()) {
+            InterruptSettings &settings = entry->second;
+            if (settings.isEnabled)
+            {
+                //TODO The polarity is currently unused by every interrupt handler, thus we just pass 0 here.
+                settings.handler(pin, 0);
             }
         }
     }
+
+    //Also reached within an interrupt, in which case the queued interrupt is simply scheduled again
+    currentNode->callsUntilInterrupt = currentNode->interruptQueue.size() > 0 ? DrawCallsUntilInterrupt() : 0;
 }
 
 //################################## Validity Checks ######################################
@@ -2936,9 +3287,9 @@ void CherrySim::CheckMeshingConsistency()
     {
         NodeEntry* node = &nodes[i];
 
-        for (u32 k = 0; k < node->eventQueue.size(); k++)
+        for (u32 k = 0; k < node->eventQueue.Size(); k++)
         {
-            simBleEvent bleEvent = node->eventQueue[k];
+            const simBleEvent& bleEvent = node->eventQueue[k];
             if (bleEvent.bleEvent.header.evt_id == BLE_GATTS_EVT_WRITE) {
                 ble_gatts_evt_t* gattsEvt = (ble_gatts_evt_t*)&bleEvent.bleEvent.evt;
 
@@ -3279,7 +3630,8 @@ float CherrySim::GetReceptionRssi(const NodeEntry* sender, const NodeEntry* rece
     {
         return rssi;
     }
-    const float randomNoise = (float)cherrySimInstance->simState.rnd.NextU32(0, 7) - 3.f;
+    //The noise only depends on the link and the time so that it does not change with the number of nodes
+    const float randomNoise = (float)GetLinkRandom(sender, receiver, SimLinkRandom::RSSI_NOISE).NextU32(0, 7) - 3.f;
     return rssi + randomNoise;
 }
 
@@ -3314,6 +3666,12 @@ uint32_t CherrySim::CalculateReceptionProbability(const NodeEntry* sendingNode,
     else return 0;
 }
 
+SimRandom CherrySim::GetLinkRandom(const NodeEntry* sender, const NodeEntry* receiver, SimLinkRandom purpose) const
+{
+    //A node sends at most one packet per simulation step, so the time identifies the event on the link
+    return SimRandom::ForLink(simConfig.seed, sender->id, receiver->id, purpose, simState.simTimeMs);
+}
+
 SoftdeviceConnection* CherrySim::FindConnectionByHandle(NodeEntry* node, int connectionHandle) {
     for (u32 i = 0; i < node->state.configuredTotalConnectionCount; i++) {
         if (node->state.connections[i].connectionActive && node->state.connections[i].connectionHandle == connectionHandle) {
@@ -3324,12 +3682,9 @@ SoftdeviceConnection* CherrySim::FindConnectionByHandle(NodeEntry* node, int con
 }
 
 NodeEntry* CherrySim::FindNodeById(int id) {
-    for (u32 i = 0; i < GetTotalNodes(); i++) {
-        if (nodes[i].id == id) {
-            return &nodes[i];
-        }
-    }
-    return nullptr;
+    const u32 nodeIndex = nodeIndexById.Find(id);
+    if (nodeIndex == UINT32_MAX) return nullptr;
+    return &nodes[nodeIndex];
 }
 
 u8 CherrySim::GetNumSimConnections(const NodeEntry* node) {
@@ -44,8 +44,14 @@ into all files in order to rewrite macros and other calls.
 #include <Terminal.h>
 #include <LedWrapper.h>
 #include <CherrySimTypes.h>
+#include <ReplayFile.h>
+#include <SimPcapWriter.h>
+#include <NodeLookupIndex.h>
+#include <SimFlashStore.h>
+#include <SimFaultInjector.h>
 #include <map>
 #include <chrono>
+#include <memory>
 #include <string>
 
 struct ReplayRecordEntry
@@ -86,6 +92,7 @@ public:
     bool shouldRestartSim = false;
     bool blockConnections = false; //Can be set to true to stop packets from being sent
     volatile bool receivedDataFromMeshGw = false;
+    bool externalTerminalInput = false; //Set if stdin is read by someone else (e.g. the terminal multiplexer of the runner) instead of the terminal of the nodes
     SimConfiguration simConfig; //The current configuration for the simulator
     SimulatorState simState; //The current state of the simulator
     NodeEntry* currentNode = nullptr; //A pointer to the current node under simulation
@@ -96,14 +103,48 @@ public:
 
     int flashToFileWriteCycle = 0;
     static constexpr int flashToFileWriteInterval = 128; // Will write flash to file every flashToFileWriteInterval's simulation step.
+    SimFlashStore flashStore; //Persists the flash of all nodes, the simulated flash operations mark the pages that they modify as dirty
 
-    void ErasePage(u32 pageAddress);
+    void ErasePage(uintptr_t pageAddress);
 
     std::map<std::string, FeaturesetPointers> featuresetPointers;
 
     std::queue<ReplayRecordEntry> replayRecordEntries;
+    std::unique_ptr<ReplayFileReader> replayFileReader; //Set if a binary replay is played back
+    std::unique_ptr<ReplayFileWriter> replayFileWriter; //Set if the simulation is recorded as a binary replay
+    u32 nextReplayCheckpointTimeMs = 0;
+
+    std::vector<SimStatSnapshot> statisticSnapshots; //Time series of the global statistic values, taken every simConfig.statisticSnapshotIntervalMs
+    u32 nextStatisticSnapshotTimeMs = 0;
+    u32 nextMemorySampleTimeMs = 0;
+
+    std::unique_ptr<SimPcapWriter> pcapWriter; //Set if the radio traffic is captured to a pcapng file
+
+    SimFaultInjector faultInjector; //Faults of simConfig.faultScenarioPath and those added at runtime
+    void SimulateFaults();
+
+    void RecordReplayCommand(const std::string& command);
+    u32 CalculateReplayStateHash() const;
+    bool IsFastForwardingReplay() const;
+
+    //Kept up to date when nodes are initialized, booted or change their serial number
+    NodeLookupIndex<int> nodeIndexById;
+    NodeLookupIndex<u32> nodeIndexBySerialNumber;
 
     NodeEntry* GetNodeEntryBySerialNumber(u32 serialNumber);
+    void UpdateNodeLookupIndices(u32 nodeIndex);
+    bool AreNodeLookupIndicesConsistent() const;
+
+    //Memory sizes that a node needs during boot. They only depend on the featureset, so they are
+    //measured once by the first node that boots with it and then reused.
+    struct NodeBootTemplate
+    {
+        u32 halMemorySize = 0;
+        u32 moduleMemoryBlockSize = 0;
+    };
+    std::map<std::string, NodeBootTemplate> nodeBootTemplates; //Keyed by the featureset name
+    const NodeBootTemplate& GetNodeBootTemplate();
+    u32 amountOfNodeMemoryAllocations = 0; //Counts how often HAL or module memory had to be (re)allocated during boot
 
     static std::string LoadFileContents(const char* path);
     static std::string ExtractReplayToken(const std::string &fileContents, const std::string &startToken, const std::string &endToken);
@@ -111,6 +152,7 @@ public:
     static std::string ExtractAndCleanReplayToken(const std::string& fileContents, const std::string& startToken, const std::string& endToken);
     static SimConfiguration ExtractSimConfigurationFromReplayRecord(const std::string &fileContents);
     static void CheckVersionFromReplayRecord(const std::string &fileContents);
+    static void ConvertTextReplayToBinary(const std::string& textLogPath, const std::string& binaryReplayPath);
 
 private:
 
@@ -179,7 +221,7 @@ public:
     void FlashNode(u32 i); // Flashes a node with uicr and settings
     void BootCurrentNode(); // Starts the node. ShutdownCurrentNode() must be called to clean up
     void ResetCurrentNode(RebootReason rebootReason, bool throwException = true); //Resets a node and boots it again (Only call this after node was bootet)
-    void ShutdownCurrentNode(); //Deletes the memory allocated by the node during runtime
+    void ShutdownCurrentNode(); //Deletes the memory allocated by the node during runtime, with fastNodeBoot a reset keeps it for the next boot instead
     static void SendUartCommand(NodeId nodeId, const u8* message, u32 messageLength);
 
     static int ChipsetToPageSize(Chipset chipset);
@@ -227,10 +269,15 @@ public:
     void SetSimLed(bool state);
 
     //Movement Simulation
+    MoveAnimationEngine moveAnimationEngine;
+    void EvaluateMoveAnimations();
     void SimulateMovement();
 
     //Battery usage simulation
+    SimEnergyModel energyModel; //Can be modified before or during a simulation, e.g. to compare boards
     void SimulateBatteryUsage();
+    void AddEnergyUsage(NodeEntry* node, SimEnergySubsystem subsystem, uint64_t chargeNanoCoulomb);
+    void AddPacketEnergyUsage(NodeEntry* sender, NodeEntry* receiver, u32 payloadLength);
 
     //Service Discovery Simulation
     void StartServiceDiscovery(u16 connHandle, const ble_uuid_t &p_uuid, int discoveryTimeMs);
@@ -246,6 +293,16 @@ public:
     void SimulateWatchDog();
 
     void SimulateInterrupts();
+    //Called at the start of every instrumented function (see START_OF_FUNCTION). Instead of drawing a random
+    //number on each call, the call at which the next queued interrupt happens is drawn once in advance.
+    void SimulateScheduledInterrupts()
+    {
+        if (currentNode != nullptr && currentNode->callsUntilInterrupt != 0 && --currentNode->callsUntilInterrupt == 0)
+        {
+            SimulateInterrupts();
+        }
+    }
+    u32 DrawCallsUntilInterrupt();
 
     //Validity Checking
     void CheckMeshingConsistency();
@@ -273,6 +330,7 @@ public:
     float GetReceptionRssiNoNoise(const NodeEntry* sender, const NodeEntry* receiver);
     float GetReceptionRssiNoNoise(const NodeEntry* sender, const NodeEntry* receiver, int8_t senderDbmTx, int8_t senderCalibratedTx);
     uint32_t CalculateReceptionProbability(const NodeEntry* sendingNode, const NodeEntry* receivingNode);
+    SimRandom GetLinkRandom(const NodeEntry* sender, const NodeEntry* receiver, SimLinkRandom purpose) const;
 
     SoftdeviceConnection* FindConnectionByHandle(NodeEntry* node, int connectionHandle);
     NodeEntry* FindNodeById(int id);
@@ -30,11 +30,13 @@
 #include "CherrySimRunner.h"
 #include "CherrySim.h"
 #include "CherrySimUtils.h"
+#include "SimSweep.h"
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <chrono>
 #include <cmath>
+#include <cstring>
 #include <regex>
 #include "json.hpp"
 #ifdef _MSC_VER
@@ -61,6 +63,9 @@ int main(int argc, char** argv) {
 
     CherrySimRunnerConfig runnerConfig = CherrySimRunner::CreateDefaultTesterConfiguration();
     SimConfiguration simConfig = CherrySimRunner::CreateDefaultRunConfiguration();
+    std::string sweepDescriptionPath = "";
+    bool isSweepRun = false;
+    u32 sweepRunIndex = 0;
 
     for (int i = 0; i < argc; i++)
     {
@@ -78,10 +83,25 @@ int main(int argc, char** argv) {
             simConfig = configJson;
             printf("Launching with MeshGwCommunication!" EOL);
         }
+        else if (s == "TerminalMux")
+        {
+            //All nodes print into the multiplexer, which shows only the selected part
+            runnerConfig.terminalMux = true;
+            simConfig.terminalId = 0;
+        }
         else if (s == "shortLived")
         {
             shortLived = true;
         }
+        else if (s.rfind("Sweep=", 0) == 0)
+        {
+            sweepDescriptionPath = s.substr(strlen("Sweep="));
+        }
+        else if (s.rfind("SweepRun=", 0) == 0)
+        {
+            isSweepRun = true;
+            sweepRunIndex = (u32)std::stoul(s.substr(strlen("SweepRun=")));
+        }
         else
         {
             if (i != 0) std::cerr << "WARNING: unknown parameter " << s << "\n";
@@ -103,10 +123,33 @@ int main(int argc, char** argv) {
     //probably too harsh and will lead to more issues than it solves in the future.
     Exceptions::ExceptionDisabler<ErrorLoggedException> ele;
 
+    //Parameter sweeps: the coordinator starts this executable again for every single run, see SimSweep.h
+    if (sweepDescriptionPath != "")
+    {
+        SimConfiguration sweepConfig = simConfig;
+        sweepConfig.terminalId = -1;
+        sweepConfig.playDelay = 0;
+        sweepConfig.logReplayCommands = false;
+        sweepConfig.verboseCommands = false;
+        sweepConfig.enableSimStatistics = false;
+        SimSweep sweep(SimSweep::LoadDescription(sweepDescriptionPath), sweepConfig);
+
+        if (isSweepRun)
+        {
+            Exceptions::DisableDebugBreakOnException disabler;
+            return sweep.ExecuteRunAndStoreResult(sweepRunIndex) ? 0 : 1;
+        }
+        sweep.Run(argv[0], sweepDescriptionPath);
+        return 0;
+    }
+
     //@ReplayFeature@ <- Don't change this, it's a label used in the documentation.
     //You may use the following line to enable the replay feature. As this change
     //should not get commited anyway, you may use absolut paths.
     //simConfig.replayPath = "C:/Path/to/some/log/file/MyLog.log";
+    //Binary replays (see simConfig.replayRecordPath) are detected automatically and
+    //allow to fast forward to a given time without any output:
+    //simConfig.replaySeekTimeMs = 60 * 60 * 1000;
 
     CherrySimRunner* runner = new CherrySimRunner(runnerConfig, simConfig, meshGwCommunication);
     printf("Launching Runner..." EOL);
@@ -162,11 +205,65 @@ void CherrySimRunner::TerminalReaderMain() {
     }
 }
 
+void CherrySimRunner::TerminalMuxReaderMain()
+{
+    std::string input;
+    while (std::getline(std::cin, input))
+    {
+        //Lines are only queued here, the simulation thread hands them to the mux between two steps
+        std::lock_guard<std::mutex> guard(terminalMuxInputMutex);
+        terminalMuxInput.push(input);
+    }
+}
+
+void CherrySimRunner::ProcessTerminalMux()
+{
+    {
+        std::lock_guard<std::mutex> guard(terminalMuxInputMutex);
+        while (!terminalMuxInput.empty())
+        {
+            terminalMux->HandleInput(terminalMuxInput.front());
+            terminalMuxInput.pop();
+        }
+    }
+
+    const std::string output = terminalMux->TakeOutput();
+    if (!output.empty() && runnerConfig.verbose)
+    {
+        fwrite(output.data(), 1, output.size(), stdout);
+        fflush(stdout);
+    }
+}
+
+std::vector<NodeId> CherrySimRunner::GetNodeIds() const
+{
+    std::vector<NodeId> nodeIds;
+    for (u32 i = 0; i < sim->GetTotalNodes(); i++)
+    {
+        nodeIds.push_back(sim->nodes[i].id);
+    }
+    return nodeIds;
+}
+
+std::vector<NodeId> CherrySimRunner::GetClusterNodeIds(NodeId nodeId) const
+{
+    std::vector<NodeId> nodeIds;
+    NodeEntry* node = sim->FindNodeById(nodeId);
+    if (node == nullptr) return nodeIds;
+    const ClusterId clusterId = node->gs.node.clusterId;
+    for (u32 i = 0; i < sim->GetTotalNodes(); i++)
+    {
+        if (sim->nodes[i].gs.node.clusterId == clusterId) nodeIds.push_back(sim->nodes[i].id);
+    }
+    return nodeIds;
+}
+
 CherrySimRunnerConfig CherrySimRunner::CreateDefaultTesterConfiguration()
 {
     CherrySimRunnerConfig config;
     config.enableClusteringTest = false; //If enabled, the simulator be reset after all nodes have clustered
     config.verbose = true;
+    config.terminalMux = false;
 
     return config;
 }
@@ -235,6 +332,7 @@ void CherrySimRunner::Start()
         sim = new CherrySim(simConfig);
         sim->SetCherrySimEventListener(this);
         sim->RegisterTerminalPrintListener(this);
+        sim->externalTerminalInput = runnerConfig.terminalMux;
         sim->Init();
 
         //We can now modify the nodes to use a different configuration
@@ -261,6 +359,20 @@ void CherrySimRunner::Start()
             terminalReaderLaunched = true;
             terminalReader = std::thread(&CherrySimRunner::TerminalReaderMain, this);
         }
+        if (runnerConfig.terminalMux && terminalMux == nullptr)
+        {
+            terminalMux.reset(new SimTerminalMux(
+                [this](NodeId nodeId, const std::string& command) {
+                    NodeEntry* node = sim->FindNodeById(nodeId);
+                    std::string nodeCommand = command;
+                    if (node != nullptr) node->gs.terminal.PutIntoTerminalCommandQueue(nodeCommand, false);
+                },
+                [this]() { return GetNodeIds(); },
+                [this](NodeId nodeId) { return GetClusterNodeIds(nodeId); }));
+            terminalMuxReader = std::thread(&CherrySimRunner::TerminalMuxReaderMain, this);
+            terminalMuxReader.detach();
+            printf("Terminal multiplexer enabled, enter :help for a list of commands" EOL);
+        }
 
         if (Simulate()) {
             break;
@@ -277,7 +389,7 @@ bool CherrySimRunner::Simulate()
 {
     //Simulate all nodes
     while (running) {
-        if (sim->simConfig.playDelay > 0) {
+        if (sim->simConfig.playDelay > 0 && !sim->IsFastForwardingReplay()) {
             std::this_thread::sleep_for(std::chrono::milliseconds(sim->simConfig.playDelay));
         }
 
@@ -311,6 +423,7 @@ bool CherrySimRunner::Simulate()
 
         try {
             sim->SimulateStepForAllNodes();
+            if (terminalMux != nullptr) ProcessTerminalMux();
             if (shortLived)
             {
                 std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
@@ -336,7 +449,11 @@ bool CherrySimRunner::Simulate()
 
 void CherrySimRunner::TerminalPrintHandler(NodeEntry* currentNode, const char* message)
 {
-    if (runnerConfig.verbose) {
+    if (terminalMux != nullptr) {
+        //Printed once per step by ProcessTerminalMux
+        terminalMux->Append(currentNode != nullptr ? currentNode->id : SimTerminalMux::SIMULATOR_NODE_ID, message);
+    }
+    else if (runnerConfig.verbose) {
         //Send to console
         printf("%s", message);
     }
@@ -30,6 +30,10 @@
 #pragma once
 
 #include <CherrySim.h>
+#include <SimTerminalMux.h>
+#include <memory>
+#include <mutex>
+#include <queue>
 #include <thread>
 #include <string>
 #include <vector>
@@ -38,6 +42,7 @@ struct CherrySimRunnerConfig
 {
     bool enableClusteringTest;
     bool verbose;
+    bool terminalMux; //Routes the terminal through a SimTerminalMux, see CherrySim.adoc
 };
 
 class CherrySimRunner : public TerminalPrintListener, public CherrySimEventListener
@@ -45,6 +50,16 @@ class CherrySimRunner : public TerminalPrintListener, public CherrySimEventListe
 private:
     volatile bool terminalReaderLaunched = false;
     std::thread terminalReader;
+
+    std::unique_ptr<SimTerminalMux> terminalMux;
+    std::thread terminalMuxReader;
+    std::mutex terminalMuxInputMutex;
+    std::queue<std::string> terminalMuxInput;
+
+    void TerminalMuxReaderMain();
+    void ProcessTerminalMux();
+    std::vector<NodeId> GetNodeIds() const;
+    std::vector<NodeId> GetClusterNodeIds(NodeId nodeId) const;
 public:
     CherrySim* sim;
     static CherrySimRunnerConfig CreateDefaultTesterConfiguration();
@@ -80,6 +80,13 @@ int main(int argc, char **argv) {
     //A workaround to find out if the Visual Studio Test Explorer is executing us (either on first run through list_tests or the second real run for testing)
     bool runByVisualStudioTestExplorer = argc >= 2 && (std::string(argv[1]).find("gtest_output=xml:") != std::string::npos || (std::string(argv[1]).find("gtest_list_tests") != std::string::npos));
 
+    //An explicitly given filter always wins, e.g. if single tests are executed by util/cherrysim/runTestsParallel.py
+    bool filterGivenOnCommandLine = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]).rfind("--gtest_filter=", 0) == 0) filterGivenOnCommandLine = true;
+    }
+
     //Initialize google tests
     //WARNING: Will modify the arc and argv and will remove all the GTEST command line parameters
     ::testing::InitGoogleTest(&argc, argv);
@@ -92,7 +99,7 @@ int main(int argc, char **argv) {
         ::testing::GTEST_FLAG(break_on_failure) = true;
 
         //If we only want to execute specific tests, we can specify them here, default: *:-*_scheduled*:*_long*
-        ::testing::GTEST_FLAG(filter) = "*:-*_scheduled*:*_long*";
+        if (!filterGivenOnCommandLine) ::testing::GTEST_FLAG(filter) = "*:-*_scheduled*:*_long*";
 
         //Do not catch exceptions is useful for debugging (Automatically set to 1 if running on Gitlab)
         ::testing::GTEST_FLAG(catch_exceptions) = 0;
@@ -126,7 +133,7 @@ int main(int argc, char **argv) {
         {
             GitLab = true;
             ::testing::GTEST_FLAG(catch_exceptions) = 1;
-            ::testing::GTEST_FLAG(filter) = "*";
+            if (!filterGivenOnCommandLine) ::testing::GTEST_FLAG(filter) = "*";
             ::testing::GTEST_FLAG(break_on_failure) = false;
         }
         else if (s == "Scheduled")
@@ -152,7 +159,7 @@ int main(int argc, char **argv) {
         SIMEXCEPTION(IllegalParameterException);
     }
 
-    if (GitLab) {
+    if (GitLab && !filterGivenOnCommandLine) {
         if (Scheduled){
             printf("I am scheduled!" SEP);
             ::testing::GTEST_FLAG(filter) += "*_scheduled*:-*_long";
@@ -369,7 +376,7 @@ void CherrySimTester::SimulateBroadcastMessage(double x, double y, ble_gap_evt_a
                 s.bleEvent.evt.gap_evt.params.adv_report.rssi = (i8) sim->GetReceptionRssi(sim->currentNode, &(sim->nodes[i]));
                 s.bleEvent.evt.gap_evt.params.adv_report.scan_rsp = 0;
                 s.bleEvent.evt.gap_evt.params.adv_report.type = (u8)sim->currentNode->state.advertisingType;
-                sim->nodes[i].eventQueue.push_back(s);
+                sim->nodes[i].eventQueue.PushBack(s);
             }
         }
     }
@@ -31,6 +31,103 @@
 #include "CherrySimTypes.h"
 #include <cstdio>
 
+SimBleEventQueue::SimBleEventQueue(u32 capacity)
+    : events(capacity > 0 ? capacity : 1)
+{
+}
+
+void SimBleEventQueue::Grow()
+{
+    std::vector<simBleEvent> grown(events.size() * 2);
+    for (u32 i = 0; i < size; i++)
+    {
+        grown[i] = events[GetStorageIndex(i)];
+    }
+    events.swap(grown);
+    readIndex = 0;
+}
+
+u32 SimBleEventQueue::GetStorageIndex(u32 index) const
+{
+    const u32 storageIndex = readIndex + index;
+    return storageIndex < events.size() ? storageIndex : storageIndex - (u32)events.size();
+}
+
+simBleEvent& SimBleEventQueue::EmplaceBack()
+{
+    if (size == events.size())
+    {
+        numOverflows++;
+        Grow();
+    }
+    simBleEvent& event = events[GetStorageIndex(size)];
+    CheckedMemset(&event, 0, sizeof(event));
+    size++;
+    if (size > maxSize) maxSize = size;
+    return event;
+}
+
+void SimBleEventQueue::PushBack(const simBleEvent& event)
+{
+    CheckedMemcpy(&EmplaceBack(), &event, sizeof(event));
+}
+
+simBleEvent& SimBleEventQueue::Front()
+{
+    if (size == 0) SIMEXCEPTIONFORCE(IllegalStateException);
+    return events[readIndex];
+}
+
+void SimBleEventQueue::PopFront()
+{
+    if (size == 0) SIMEXCEPTIONFORCE(IllegalStateException);
+    readIndex = GetStorageIndex(1);
+    size--;
+}
+
+void SimBleEventQueue::Clear()
+{
+    readIndex = 0;
+    size = 0;
+}
+
+simBleEvent& SimBleEventQueue::operator[](u32 index)
+{
+    if (index >= size) SIMEXCEPTIONFORCE(IndexOutOfBoundsException);
+    return events[GetStorageIndex(index)];
+}
+
+const simBleEvent& SimBleEventQueue::operator[](u32 index) const
+{
+    if (index >= size) SIMEXCEPTIONFORCE(IndexOutOfBoundsException);
+    return events[GetStorageIndex(index)];
+}
+
+u32 SimBleEventQueue::Size() const
+{
+    return size;
+}
+
+bool SimBleEventQueue::Empty() const
+{
+    return size == 0;
+}
+
+u32 SimBleEventQueue::GetCapacity() const
+{
+    return (u32)events.size();
+}
+
+u32 SimBleEventQueue::GetMaxSize() const
+{
+    return maxSize;
+}
+
+u32 SimBleEventQueue::GetNumOverflows() const
+{
+    return numOverflows;
+}
+
 void to_json(nlohmann::json& j, const SimConfiguration & config)
 {
     j = nlohmann::json{
@@ -55,6 +152,18 @@ void to_json(nlohmann::json& j, const SimConfiguration & config)
         { "devicesJsonPath"                   , config.devicesJsonPath                   },
         { "replayPath"                        , config.replayPath                        },
         { "logReplayCommands"                 , config.logReplayCommands                 },
+        { "replayRecordPath"                  , config.replayRecordPath                  },
+        { "replayCheckpointIntervalMs"        , config.replayCheckpointIntervalMs        },
+        { "replaySeekTimeMs"                  , config.replaySeekTimeMs                  },
+        { "replayVerifyCheckpoints"           , config.replayVerifyCheckpoints           },
+        { "pcapCapturePath"                   , config.pcapCapturePath                   },
+        { "pcapCaptureBufferSize"             , config.pcapCaptureBufferSize             },
+        { "nodeDensity"                       , config.nodeDensity                       },
+        { "attachUnconnectedNodes"            , config.attachUnconnectedNodes            },
+        { "fastNodeBoot"                      , config.fastNodeBoot                      },
+        { "statisticSnapshotIntervalMs"       , config.statisticSnapshotIntervalMs       },
+        { "memorySampleIntervalMs"            , config.memorySampleIntervalMs            },
+        { "faultScenarioPath"                 , config.faultScenarioPath                 },
         { "useLogAccumulator"                 , config.useLogAccumulator                 },
         { "defaultNetworkId"                  , config.defaultNetworkId                  },
         { "preDefinedPositions"               , config.preDefinedPositions               },
@@ -100,6 +209,18 @@ void from_json(const nlohmann::json & j, SimConfiguration & config)
         else if(it.key() == "devicesJsonPath"                   ) config.devicesJsonPath                   = *it;
         else if(it.key() == "replayPath"                        ) config.replayPath                        = *it;
         else if(it.key() == "logReplayCommands"                 ) config.logReplayCommands                 = *it;
+        else if(it.key() == "replayRecordPath"                  ) config.replayRecordPath                  = *it;
+        else if(it.key() == "replayCheckpointIntervalMs"        ) config.replayCheckpointIntervalMs        = *it;
+        else if(it.key() == "replaySeekTimeMs"                  ) config.replaySeekTimeMs                  = *it;
+        else if(it.key() == "replayVerifyCheckpoints"           ) config.replayVerifyCheckpoints           = *it;
+        else if(it.key() == "pcapCapturePath"                   ) config.pcapCapturePath                   = *it;
+        else if(it.key() == "pcapCaptureBufferSize"             ) config.pcapCaptureBufferSize             = *it;
+        else if(it.key() == "nodeDensity"                       ) config.nodeDensity                       = *it;
+        else if(it.key() == "attachUnconnectedNodes"            ) config.attachUnconnectedNodes            = *it;
+        else if(it.key() == "fastNodeBoot"                      ) config.fastNodeBoot                      = *it;
+        else if(it.key() == "statisticSnapshotIntervalMs"       ) config.statisticSnapshotIntervalMs       = *it;
+        else if(it.key() == "memorySampleIntervalMs"            ) config.memorySampleIntervalMs            = *it;
+        else if(it.key() == "faultScenarioPath"                 ) config.faultScenarioPath                 = *it;
         else if(it.key() == "useLogAccumulator"                 ) config.useLogAccumulator                 = *it;
         else if(it.key() == "defaultNetworkId"                  ) config.defaultNetworkId                  = *it;
         else if(it.key() == "preDefinedPositions"               ) j.at("preDefinedPositions").get_to(config.preDefinedPositions);
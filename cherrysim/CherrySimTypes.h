@@ -34,9 +34,14 @@
 #include <map>
 #include <array>
 #include <string>
+#include <vector>
 #include "MersenneTwister.h"
+#include "SimRandom.h"
 #include "json.hpp"
 #include "MoveAnimation.h"
+#include "SimStatistics.h"
+#include "SimEnergy.h"
+#include "SimMemory.h"
 #ifndef GITHUB_RELEASE
 #include "ClcMock.h"
 #endif //GITHUB_RELEASE
@@ -51,7 +56,7 @@ extern "C" {
 class CherrySim;
 extern CherrySim* cherrySimInstance;
 
-constexpr int SIM_EVT_QUEUE_SIZE = 50;
+constexpr int SIM_EVT_QUEUE_SIZE = 64; //Number of events that are preallocated in each node's event queue
 constexpr int SIM_MAX_CONNECTION_NUM = 10; //Maximum total num of connections supported by the simulator
 
 constexpr int SIM_NUM_RELIABLE_BUFFERS   = 1;
@@ -64,6 +69,10 @@ constexpr int PACKET_STAT_SIZE = 10*1024;
 
 #define PSRNG(prob) (cherrySimInstance->simState.rnd.NextPsrng((prob)))
 #define PSRNGINT(min, max) ((u32)cherrySimInstance->simState.rnd.NextU32(min, max)) //Generates random int from min (inclusive) up to max (inclusive)
+//Same as above, but draws from a stream of the current node, which is independent of all other nodes and streams
+#define NODE_RANDOM(stream) (cherrySimInstance->currentNode->random[(u32)SimRandomStream::stream])
+#define NODE_PSRNG(stream, prob) (NODE_RANDOM(stream).NextPsrng((prob)))
+#define NODE_PSRNGINT(stream, min, max) ((u32)NODE_RANDOM(stream).NextU32(min, max))
 
 //A BLE Event that is sent by the Simulator is wrapped
 struct simBleEvent {
@@ -74,6 +83,44 @@ struct simBleEvent {
     u32 additionalInfo; //Can be used to store a pointer or other information
 };
 
+//The queue of BLE events that a node has not yet fetched with sd_ble_evt_get.
+//Events are stored in a ring that is allocated once so that producers can construct them in place
+//without any heap allocations. If the ring is full, its capacity is doubled to keep the simulation
+//deterministic and the overflow is counted so that it can be reported.
+class SimBleEventQueue
+{
+private:
+    std::vector<simBleEvent> events;
+    u32 readIndex = 0;
+    u32 size = 0;
+    u32 maxSize = 0;
+    u32 numOverflows = 0;
+
+    void Grow();
+    u32 GetStorageIndex(u32 index) const;
+
+public:
+    explicit SimBleEventQueue(u32 capacity = SIM_EVT_QUEUE_SIZE);
+
+    //Returns a zeroed event at the end of the queue which can then be filled in place
+    simBleEvent& EmplaceBack();
+    void PushBack(const simBleEvent& event);
+    simBleEvent& Front();
+    void PopFront();
+    void Clear();
+
+    simBleEvent& operator[](u32 index);
+    const simBleEvent& operator[](u32 index) const;
+
+    u32 Size() const;
+    bool Empty() const;
+    u32 GetCapacity() const;
+    //The maximum number of events that were queued at the same time
+    u32 GetMaxSize() const;
+    //How often an event was queued while the ring was full
+    u32 GetNumOverflows() const;
+};
+
 
 //A packet that is buffered in the SoftDevice for sending
 struct NodeEntry;
@@ -237,11 +284,16 @@ struct NodeEntry {
     NRF_GPIO_Type gpio;
     u8 flash[SIM_MAX_FLASH_SIZE];
     SoftdeviceState state;
-    std::deque<simBleEvent> eventQueue;
+    SimBleEventQueue eventQueue;
     simBleEvent currentEvent; //The event currently being processed, as a simBleEvent, this can have some additional data attached to it useful for debugging
     bool ledOn;
-    u32 nanoAmperePerMsTotal;
+    uint64_t nanoAmperePerMsTotal; //Charge in nC drawn since the node was created, the sum of energy.chargeNanoCoulomb
+    SimEnergyUsage energy;
+    SimMemoryUsage memory; //Occupancy of the allocators and connection queues, sampled every simConfig.memorySampleIntervalMs
     u8 *moduleMemoryBlock = nullptr;
+    u32 moduleMemoryBlockSize = 0;
+    u8 *halMemory = nullptr; //Owned by the node entry so that it can be reused when the node reboots, GS->halMemory points to it
+    u32 halMemorySize = 0;
 
     uint32_t restartCounter = 0; //Counts how many times the node was restarted
     int64_t simulatedFrames = 0;
@@ -250,9 +302,12 @@ struct NodeEntry {
     RebootReason rebootReason = RebootReason::UNKNOWN;
 
     std::vector<int> impossibleConnection; //The rssi to these nodes is artificially increased to an unconnectable level.
+    std::vector<SimStatValue> statistics; //Values of SIMSTATCOUNT and SIMSTATAVG collected while this node was simulated, indexed by handle
 
     std::map<u32, InterruptSettings> gpioInitializedPins; // Map from pin to settings
     std::queue<u32> interruptQueue;
+    int64_t clockDriftUs = 0; //Deviation of the application timer from the simulation time that was not yet compensated, see SimFaultType::CLOCK_DRIFT
+    u32 callsUntilInterrupt = 0; //Number of START_OF_FUNCTION calls until the next queued interrupt is simulated, 0 if none is scheduled
 
     bool bmgWasInit          = false;
     bool twiWasInit          = false;
@@ -278,12 +333,14 @@ struct NodeEntry {
     PacketStat routedPackets[PACKET_STAT_SIZE];
 
     MoveAnimation animation;
+
+    SimRandom random[(u32)SimRandomStream::AMOUNT]; //Seeded once in InitNode and kept over reboots
 };
 
 
 struct SimulatorState {
     u32 simTimeMs = 0;
-    MersenneTwister rnd;
+    MersenneTwister rnd; //For simulator wide decisions only, nodes use their own SimRandom streams
     u16 globalConnHandleCounter = 0;
     u32 globalEventIdCounter = 0;
     u32 globalPacketIdCounter = 0;
@@ -320,6 +377,18 @@ struct SimConfiguration {
     std::string devicesJsonPath                    = "";
     std::string replayPath                         = ""; //If set, a replay is loaded from this path.
     bool        logReplayCommands                  = false; //If set, lines are logged out that can be used as input for the replay feature.
+    std::string replayRecordPath                   = ""; //If set, the simulation is recorded to this path as a binary replay file (see ReplayFile.h).
+    u32         replayCheckpointIntervalMs         = 10 * 1000; //Simulated time between two state checkpoints in a binary replay recording. 0 to disable.
+    u32         replaySeekTimeMs                   = 0; //When replaying, the simulation is fast forwarded without terminal output, play delay or real time until this time is reached.
+    bool        replayVerifyCheckpoints            = true; //When replaying a binary replay, the simulator state is compared against the recorded checkpoints.
+    std::string pcapCapturePath                    = ""; //If set, all advertising packets, writes and notifications are captured to this pcapng file (see SimPcapWriter.h).
+    u32         pcapCaptureBufferSize              = 4096; //Number of packets that can be buffered for the pcap writer thread before packets are dropped.
+    double      nodeDensity                        = 0; //If set, the map width and height are calculated so that there are this many non asset nodes per 100 square meters. Only used when positioning randomly.
+    bool        attachUnconnectedNodes             = false; //If set, randomly placed nodes that can not connect are put within range of a connected node instead of trying other random positions (see SimPlacement.h).
+    bool        fastNodeBoot                       = true; //If set, a rebooting node reuses its HAL and module memory and the module sizes measured for its featureset instead of allocating and measuring them again.
+    u32         statisticSnapshotIntervalMs        = 0; //Simulated time between two snapshots of the SIMSTATCOUNT and SIMSTATAVG values (see CherrySim::statisticSnapshots). 0 to disable.
+    u32         memorySampleIntervalMs             = 0; //Simulated time between two samples of the allocator and queue occupancy of all nodes (see SimMemory.h). 0 to disable.
+    std::string faultScenarioPath                  = ""; //If set, the faults of this json file are injected into the simulation (see SimFaultInjector.h).
     bool        useLogAccumulator                  = false; //If set, all logs are written to CherrySim::logAccumulator
     u32         defaultNetworkId                   = 0;
     std::vector<std::pair<double, double>> preDefinedPositions;
@@ -77,6 +77,7 @@ CREATEEXCEPTIONINHERITING(FileException                            , IllegalStat
 CREATEEXCEPTIONINHERITING(SigProvisioningFailedException           , IllegalStateException);
 CREATEEXCEPTIONINHERITING(SigCreateElementFailedException          , IllegalStateException);
 CREATEEXCEPTIONINHERITING(IncorrectHopsToSinkException             , IllegalStateException);
+CREATEEXCEPTIONINHERITING(ReplayDivergedException                  , IllegalStateException);
 
 CREATEEXCEPTION(BufferException);
 CREATEEXCEPTIONINHERITING(TriedToReadEmptyBufferException         , BufferException);
@@ -123,15 +123,18 @@ int FruitySimServer::StartServer()
 
     char const SrvAddress[] = "0.0.0.0";
     std::uint16_t SrvPort = 5555;
-    server = new std::unique_ptr<evhttp, decltype(&evhttp_free)>(evhttp_start(SrvAddress, SrvPort), &evhttp_free);
-    if (!server)
+    evhttp* httpServer = evhttp_start(SrvAddress, SrvPort);
+    if (!httpServer)
     {
-        std::cerr << "Failed to init http server." << std::endl;
+        //Happens e.g. if several simulators run in parallel processes, only the first one can be visualized
+        std::cerr << "Failed to init http server, port " << SrvPort << " is probably in use." << std::endl;
         return -1;
     }
+    server = new std::unique_ptr<evhttp, decltype(&evhttp_free)>(httpServer, &evhttp_free);
 
-    void(*OnReq)(evhttp_request *req, void *) = [](evhttp_request *req, void *)
+    void(*OnReq)(evhttp_request *req, void *) = [](evhttp_request *req, void *arg)
     {
+        FruitySimServer* fruitySimServer = (FruitySimServer*)arg;
         FILE* file = nullptr;
     
         auto *OutBuf = evhttp_request_get_output_buffer(req);
@@ -140,7 +143,11 @@ int FruitySimServer::StartServer()
 
         if (strstr(req->uri, "/devices") != nullptr)
         {
-            std::string devices = GenerateDevicesJson();
+            //Clients can pass the revision of their last response to only receive the changes, e.g. /devices?since=123
+            u32 sinceRevision = 0;
+            const char* sinceParam = strstr(req->uri, "since=");
+            if (sinceParam != nullptr) sinceRevision = (u32)strtoul(sinceParam + strlen("since="), nullptr, 10);
+            std::string devices = fruitySimServer->GenerateDevicesJson(sinceRevision);
     
             evbuffer_add_printf(OutBuf, "%s", devices.c_str());
             evhttp_add_header(evhttp_request_get_output_headers(req), "Content-Type", "application/json");
@@ -195,7 +202,7 @@ int FruitySimServer::StartServer()
         evhttp_send_reply(req, HTTP_OK, "OK", OutBuf);
     };
     
-    evhttp_set_gencb(server->get(), OnReq, nullptr);
+    evhttp_set_gencb(server->get(), OnReq, this);
 #endif // SIM_SERVER_PRESENT
     return 0;
 }
@@ -234,113 +241,322 @@ std::string FruitySimServer::GenerateSiteJson()
 }
 #endif // SIM_SERVER_PRESENT
 
+u32 FruitySimServer::devicesRevision = 0;
+
+u32 FruitySimServer::GetDevicesRevision() const
+{
+    return devicesRevision;
+}
+
 #if defined(SIM_SERVER_PRESENT)
-std::string FruitySimServer::GenerateDevicesJson()
+std::string FruitySimServer::GenerateDevicesJson(u32 sinceRevision)
 {
     MersenneTwisterDisabler disabler;
+    UpdateTrackedDevices();
+
+    //A revision that we don't know belongs to a previous simulation, so the client has to start over
+    const bool full = sinceRevision < firstDevicesRevision || sinceRevision > devicesRevision;
+
     json devices;
     devices["status"] = "success";
-    for (unsigned int i = 0; i < cherrySimInstance->GetTotalNodes(); i++) {
-        NodeIndexSetter nodeIndexSetter(i);
-        NodeEntry* node = &cherrySimInstance->nodes[i];
-        json device;
-
-        //Get the only handshaked inConnection
-        //TODO: The inConnection is only used to draw the direction arrow in the fruitymap, but currently
-        //the json only supports communicating 1 inConnection, this should be changed at some point so that
-        //Each connection can report its direction and masterBit
-        auto inConnections = node->gs.cm.GetMeshConnections(ConnectionDirection::DIRECTION_IN);
-        MeshConnection* inConnection = nullptr;
-        for (int k = 0; k < inConnections.count; k++) {
-            if (inConnections.handles[k] && inConnections.handles[k].IsHandshakeDone()) {
-                inConnection = inConnections.handles[k].GetConnection();
-            }
+    devices["revision"] = devicesRevision;
+    devices["full"] = full;
+    devices["result"] = json::array();
+    for (const TrackedDevice& tracked : trackedDevices)
+    {
+        if (full)
+        {
+            devices["result"].push_back(tracked.device);
         }
-
-        //UUID is generated based on the node index
-        char uuid[50];
-        sprintf(uuid, "00000000-1111-2222-3333-00000000%04u", node->index);
-
-        device["uuid"] = uuid;
-        device["deviceId"] = node->gs.config.GetSerialNumber();
-        device["platform"] = "BLENODE";
-        device["ledOn"] = node->ledOn;
-        device["inConnectionHasMasterBit"] = false;
-        device["inConnectionPartnerHasMasterBit"] = false;
-
-        //Find out who has the master bit of the inConnection
-        if(inConnection != nullptr) device["inConnectionHasMasterBit"] = inConnection->connectionMasterBit == 1;
-
-        bool partnerHasMB = false;
-
-        if (inConnection != nullptr) {
-            SoftdeviceConnection* foundSoftdeviceConnection = cherrySimInstance->FindConnectionByHandle(node, inConnection->connectionHandle);
-            //We must check if the simulator connection still exists as it might have been cleaned up already
-            if (foundSoftdeviceConnection != nullptr) {
-                NodeEntry* partnerNode = foundSoftdeviceConnection->partner;
-                MeshConnections conn = partnerNode->gs.cm.GetMeshConnections(ConnectionDirection::DIRECTION_OUT);
-                for (int k = 0; k < conn.count; k++) {
-                    if (conn.handles[k] && conn.handles[k].GetConnectionHandle() == inConnection->connectionHandle) {
-                        partnerHasMB = conn.handles[k].GetConnection()->connectionMasterBit;
+        else if (tracked.revision > sinceRevision)
+        {
+            json delta;
+            delta["uuid"] = tracked.device["uuid"];
+            for (auto it = tracked.fieldRevisions.begin(); it != tracked.fieldRevisions.end(); it++)
+            {
+                if (it->second <= sinceRevision) continue;
+
+                //Fields that no longer exist are sent as null
+                const size_t separator = it->first.find('/');
+                if (separator == std::string::npos)
+                {
+                    auto field = tracked.device.find(it->first);
+                    delta[it->first] = field != tracked.device.end() ? *field : json(nullptr);
+                }
+                else
+                {
+                    const std::string parentKey = it->first.substr(0, separator);
+                    const std::string childKey = it->first.substr(separator + 1);
+                    auto parent = tracked.device.find(parentKey);
+                    json value = nullptr;
+                    if (parent != tracked.device.end())
+                    {
+                        auto child = parent->find(childKey);
+                        if (child != parent->end()) value = *child;
                     }
+                    delta[parentKey][childKey] = value;
                 }
             }
+            devices["result"].push_back(delta);
         }
+    }
 
-        device["inConnectionPartnerHasMasterBit"] = partnerHasMB;
+    //The fruitymap parses the json anyway, so there is no need for pretty printing
+    return devices.dump();
+}
 
-        device["connectionLossCounter"] = node->gs.node.connectionLossCounter;
-        device["inConnectionPartner"] = inConnection == nullptr ? 0 : inConnection->partnerId;
+void FruitySimServer::UpdateTrackedDevices()
+{
+    const u32 totalNodes = cherrySimInstance->GetTotalNodes();
+    const u32 newRevision = devicesRevision + 1;
+    if (trackedDevices.size() != totalNodes)
+    {
+        trackedDevices.clear();
+        trackedDevices.resize(totalNodes);
+        firstDevicesRevision = newRevision;
+    }
 
+    bool changed = false;
+    for (u32 i = 0; i < totalNodes; i++) {
+        NodeIndexSetter nodeIndexSetter(i);
+        NodeEntry* node = &cherrySimInstance->nodes[i];
+        TrackedDevice& tracked = trackedDevices[i];
+
+        //Generating the json (especially the rssi) is much more expensive than collecting the values it is based on
+        GenerateDeviceStateSnapshot(node, stateSnapshotScratch);
+        if (tracked.revision != 0 && stateSnapshotScratch == tracked.stateSnapshot) continue;
+        tracked.stateSnapshot.swap(stateSnapshotScratch);
+
+        const json device = GenerateDeviceJson(node);
+        UpdateFieldRevisions(tracked, device, newRevision);
+        tracked.device = device;
+        tracked.revision = newRevision;
+        changed = true;
+    }
 
-        //FIXME: This mixes fruitymesh and simulator connections, but should only use simulator data
-        if (inConnection != nullptr) {
-            SoftdeviceConnection* sdInConn = cherrySimInstance->FindConnectionByHandle(node, inConnection->connectionHandle);
-            if (sdInConn != nullptr) device["inConnectionRssi"] = (int)cherrySimInstance->GetReceptionRssiNoNoise(node, sdInConn->partner);
-        }
-        else {
-            device["inConnectionRssi"] = 0;
+    if (changed) devicesRevision = newRevision;
+}
+
+void FruitySimServer::UpdateFieldRevisions(TrackedDevice& tracked, const json& device, u32 revision)
+{
+    //Only details and properties are split up into their fields, everything else is compared as a whole
+    auto isSplitField = [](const std::string& key) { return key == "details" || key == "properties"; };
+    auto compareField = [&](const std::string& fieldName, const json* oldValue, const json* newValue) {
+        if (oldValue == nullptr || newValue == nullptr || *oldValue != *newValue)
+        {
+            tracked.fieldRevisions[fieldName] = revision;
         }
+    };
+    auto findField = [](const json& object, const std::string& key) -> const json* {
+        if (!object.is_object()) return nullptr;
+        auto it = object.find(key);
+        return it != object.end() ? &(*it) : nullptr;
+    };
 
+    //Fields that are part of the new device json
+    for (auto it = device.begin(); it != device.end(); it++)
+    {
+        const json* oldValue = findField(tracked.device, it.key());
+        if (isSplitField(it.key()) && it->is_object())
+        {
+            for (auto child = it->begin(); child != it->end(); child++)
+            {
+                compareField(it.key() + "/" + child.key(), oldValue != nullptr ? findField(*oldValue, child.key()) : nullptr, &(*child));
+            }
+            if (oldValue != nullptr && oldValue->is_object())
+            {
+                for (auto child = oldValue->begin(); child != oldValue->end(); child++)
+                {
+                    if (it->find(child.key()) == it->end()) tracked.fieldRevisions[it.key() + "/" + child.key()] = revision;
+                }
+            }
+        }
+        else
+        {
+            compareField(it.key(), oldValue, &(*it));
+        }
+    }
 
-        char advData[200];
-        if (node->state.advertisingActive) {
-            Logger::ConvertBufferToHexString(node->state.advertisingData, node->state.advertisingDataLength, advData, sizeof(advData));
+    //Fields that were removed
+    if (tracked.device.is_object())
+    {
+        for (auto it = tracked.device.begin(); it != tracked.device.end(); it++)
+        {
+            if (device.find(it.key()) == device.end()) tracked.fieldRevisions[it.key()] = revision;
         }
-        else {
-            sprintf(advData, "Not advertising");
+    }
+}
+
+MeshConnection* FruitySimServer::FindHandshakedInConnection(NodeEntry* node)
+{
+    //Get the only handshaked inConnection
+    //TODO: The inConnection is only used to draw the direction arrow in the fruitymap, but currently
+    //the json only supports communicating 1 inConnection, this should be changed at some point so that
+    //Each connection can report its direction and masterBit
+    auto inConnections = node->gs.cm.GetMeshConnections(ConnectionDirection::DIRECTION_IN);
+    MeshConnection* inConnection = nullptr;
+    for (int k = 0; k < inConnections.count; k++) {
+        if (inConnections.handles[k] && inConnections.handles[k].IsHandshakeDone()) {
+            inConnection = inConnections.handles[k].GetConnection();
         }
+    }
+    return inConnection;
+}
 
-        device["details"] = {
-            {"platform", "BLENODE"},
-            {"clusterId", node->gs.node.clusterId},
-            {"clusterSize", node->gs.node.GetClusterSize()},
-            {"nodeId", node->gs.node.configuration.nodeId},
-            {"serialNumber", node->gs.config.GetSerialNumber()},
-            {"connections", json::array()},
-            {"nonConnections", json::array()},
-            {"lastSentAdvertisingMessage", advData},
-            {"freeIn", node->gs.cm.freeMeshInConnections},
-            {"freeOut", node->gs.cm.freeMeshOutConnections}
-        };
-        for (int j = 0; j < node->state.configuredTotalConnectionCount; j++) {
-            if (node->state.connections[j].connectionActive) {
-                json connection;
-                connection["handle"] = node->state.connections[j].connectionHandle;
-                connection["rssi"] = 7;
-                connection["target"] = node->state.connections[j].partner->gs.node.configuration.nodeId;
-
-                device["details"]["connections"].push_back(connection);
+bool FruitySimServer::PartnerHasMasterBit(NodeEntry* node, MeshConnection* inConnection)
+{
+    bool partnerHasMB = false;
+
+    if (inConnection != nullptr) {
+        SoftdeviceConnection* foundSoftdeviceConnection = cherrySimInstance->FindConnectionByHandle(node, inConnection->connectionHandle);
+        //We must check if the simulator connection still exists as it might have been cleaned up already
+        if (foundSoftdeviceConnection != nullptr) {
+            NodeEntry* partnerNode = foundSoftdeviceConnection->partner;
+            MeshConnections conn = partnerNode->gs.cm.GetMeshConnections(ConnectionDirection::DIRECTION_OUT);
+            for (int k = 0; k < conn.count; k++) {
+                if (conn.handles[k] && conn.handles[k].GetConnectionHandle() == inConnection->connectionHandle) {
+                    partnerHasMB = conn.handles[k].GetConnection()->connectionMasterBit;
+                }
             }
         }
-        device["properties"] = {
-            {"onMap", "true"},
-            {"x", node->x},
-            {"y", node->y}
-        };
-        devices["result"].push_back(device);
     }
+    return partnerHasMB;
+}
+
+void FruitySimServer::GenerateDeviceStateSnapshot(NodeEntry* node, std::vector<u8>& snapshot)
+{
+    snapshot.clear();
+    auto append = [&snapshot](const void* data, size_t length) {
+        snapshot.insert(snapshot.end(), (const u8*)data, (const u8*)data + length);
+    };
+#define APPEND_VALUE(value) { const auto v = (value); append(&v, sizeof(v)); }
+
+    const char* serialNumber = node->gs.config.GetSerialNumber();
+    append(serialNumber, strlen(serialNumber) + 1);
+    APPEND_VALUE(node->ledOn);
+    APPEND_VALUE(node->gs.node.connectionLossCounter);
+    APPEND_VALUE(node->gs.node.clusterId);
+    APPEND_VALUE(node->gs.node.GetClusterSize());
+    APPEND_VALUE(node->gs.node.configuration.nodeId);
+    APPEND_VALUE(node->gs.cm.freeMeshInConnections);
+    APPEND_VALUE(node->gs.cm.freeMeshOutConnections);
+    APPEND_VALUE(node->x);
+    APPEND_VALUE(node->y);
+
+    APPEND_VALUE(node->state.advertisingActive);
+    if (node->state.advertisingActive)
+    {
+        APPEND_VALUE(node->state.advertisingDataLength);
+        append(node->state.advertisingData, node->state.advertisingDataLength);
+    }
+
+    MeshConnection* inConnection = FindHandshakedInConnection(node);
+    APPEND_VALUE(inConnection != nullptr);
+    if (inConnection != nullptr)
+    {
+        APPEND_VALUE(inConnection->partnerId);
+        APPEND_VALUE(inConnection->connectionMasterBit);
+        APPEND_VALUE(PartnerHasMasterBit(node, inConnection));
+
+        //The rssi depends on the positions of both nodes, the calibration of the sender and the impossible connections of both nodes
+        SoftdeviceConnection* sdInConn = cherrySimInstance->FindConnectionByHandle(node, inConnection->connectionHandle);
+        APPEND_VALUE(sdInConn != nullptr);
+        if (sdInConn != nullptr)
+        {
+            APPEND_VALUE(sdInConn->partner->index);
+            APPEND_VALUE(sdInConn->partner->x);
+            APPEND_VALUE(sdInConn->partner->y);
+            APPEND_VALUE(sdInConn->partner->z);
+            APPEND_VALUE(node->z);
+            APPEND_VALUE(node->gs.boardconf.configuration.calibratedTX);
+            APPEND_VALUE(node->impossibleConnection.size());
+            append(node->impossibleConnection.data(), node->impossibleConnection.size() * sizeof(int));
+            APPEND_VALUE(sdInConn->partner->impossibleConnection.size());
+            append(sdInConn->partner->impossibleConnection.data(), sdInConn->partner->impossibleConnection.size() * sizeof(int));
+        }
+    }
+
+    for (int j = 0; j < node->state.configuredTotalConnectionCount; j++) {
+        if (node->state.connections[j].connectionActive) {
+            APPEND_VALUE(node->state.connections[j].connectionHandle);
+            APPEND_VALUE(node->state.connections[j].partner->gs.node.configuration.nodeId);
+        }
+    }
+#undef APPEND_VALUE
+}
+
+json FruitySimServer::GenerateDeviceJson(NodeEntry* node)
+{
+    json device;
+
+    MeshConnection* inConnection = FindHandshakedInConnection(node);
+
+    //UUID is generated based on the node index
+    char uuid[50];
+    sprintf(uuid, "00000000-1111-2222-3333-00000000%04u", node->index);
+
+    device["uuid"] = uuid;
+    device["deviceId"] = node->gs.config.GetSerialNumber();
+    device["platform"] = "BLENODE";
+    device["ledOn"] = node->ledOn;
+    device["inConnectionHasMasterBit"] = false;
+    device["inConnectionPartnerHasMasterBit"] = false;
+
+    //Find out who has the master bit of the inConnection
+    if(inConnection != nullptr) device["inConnectionHasMasterBit"] = inConnection->connectionMasterBit == 1;
+
+    device["inConnectionPartnerHasMasterBit"] = PartnerHasMasterBit(node, inConnection);
+
+    device["connectionLossCounter"] = node->gs.node.connectionLossCounter;
+    device["inConnectionPartner"] = inConnection == nullptr ? 0 : inConnection->partnerId;
+
+
+    //FIXME: This mixes fruitymesh and simulator connections, but should only use simulator data
+    if (inConnection != nullptr) {
+        SoftdeviceConnection* sdInConn = cherrySimInstance->FindConnectionByHandle(node, inConnection->connectionHandle);
+        if (sdInConn != nullptr) device["inConnectionRssi"] = (int)cherrySimInstance->GetReceptionRssiNoNoise(node, sdInConn->partner);
+    }
+    else {
+        device["inConnectionRssi"] = 0;
+    }
+
+
+    char advData[200];
+    if (node->state.advertisingActive) {
+        Logger::ConvertBufferToHexString(node->state.advertisingData, node->state.advertisingDataLength, advData, sizeof(advData));
+    }
+    else {
+        sprintf(advData, "Not advertising");
+    }
+
+    device["details"] = {
+        {"platform", "BLENODE"},
+        {"clusterId", node->gs.node.clusterId},
+        {"clusterSize", node->gs.node.GetClusterSize()},
+        {"nodeId", node->gs.node.configuration.nodeId},
+        {"serialNumber", node->gs.config.GetSerialNumber()},
+        {"connections", json::array()},
+        {"nonConnections", json::array()},
+        {"lastSentAdvertisingMessage", advData},
+        {"freeIn", node->gs.cm.freeMeshInConnections},
+        {"freeOut", node->gs.cm.freeMeshOutConnections}
+    };
+    for (int j = 0; j < node->state.configuredTotalConnectionCount; j++) {
+        if (node->state.connections[j].connectionActive) {
+            json connection;
+            connection["handle"] = node->state.connections[j].connectionHandle;
+            connection["rssi"] = 7;
+            connection["target"] = node->state.connections[j].partner->gs.node.configuration.nodeId;
+
+            device["details"]["connections"].push_back(connection);
+        }
+    }
+    device["properties"] = {
+        {"onMap", "true"},
+        {"x", node->x},
+        {"y", node->y}
+    };
 
-    return devices.dump(4);
+    return device;
 }
 #endif // SIM_SERVER_PRESENT
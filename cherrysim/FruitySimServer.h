@@ -29,7 +29,14 @@
 ////////////////////////////////////////////////////////////////////////////////
 #pragma once
 
+#include <FmTypes.h>
 #include <string>
+#include <vector>
+#include <map>
+#include "json.hpp"
+
+struct NodeEntry;
+class MeshConnection;
 
 class FruitySimServer
 {
@@ -40,10 +47,34 @@ public:
     //Call periodically so that the server can process requests
     void ProcessServerRequests();
 
+    //Generates the response for /devices. If sinceRevision is 0 or unknown to this server, all devices are returned
+    //with "full": true. Otherwise only the devices and fields that changed after sinceRevision are returned. Fields
+    //of "details" and "properties" are reported individually, removed fields are set to null (JSON merge patch).
+    std::string GenerateDevicesJson(u32 sinceRevision = 0);
+    u32 GetDevicesRevision() const;
+
 private:
     int StartServer();
 
-    static std::string GenerateDevicesJson();
+    struct TrackedDevice
+    {
+        std::vector<u8> stateSnapshot; //The raw values the device json is generated from, used to detect changes cheaply
+        nlohmann::json device;
+        std::map<std::string, u32> fieldRevisions; //Revision of the last change of each field, e.g. "ledOn" or "details/clusterId"
+        u32 revision = 0; //Revision of the last change of any field
+    };
+    std::vector<TrackedDevice> trackedDevices;
+    std::vector<u8> stateSnapshotScratch;
+    u32 firstDevicesRevision = 0; //Revisions before this one belong to a previous server or node setup
+
+    //Revisions are unique across all servers so that a client of a previous simulation is detected
+    static u32 devicesRevision;
+
+    void UpdateTrackedDevices();
+    static void UpdateFieldRevisions(TrackedDevice& tracked, const nlohmann::json& device, u32 revision);
+    static MeshConnection* FindHandshakedInConnection(NodeEntry* node);
+    static bool PartnerHasMasterBit(NodeEntry* node, MeshConnection* inConnection);
+    static void GenerateDeviceStateSnapshot(NodeEntry* node, std::vector<u8>& snapshot);
+    static nlohmann::json GenerateDeviceJson(NodeEntry* node);
     static std::string GenerateSiteJson();
 };
-
@@ -24,6 +24,7 @@
 #include <cmath>
 #include <iostream>
 #include "Exceptions.h"
+#include "Utility.h"
 
 void MersenneTwister::TwistIteration(uint32_t i)
 {
@@ -765,3 +766,10 @@ MersenneTwisterDisabler::~MersenneTwisterDisabler()
 {
     disableLevel--;
 }
+
+uint32_t MersenneTwister::GetStateChecksum() const
+{
+    uint32_t crc = Utility::CalculateCrc32((const u8*)m_mt, sizeof(m_mt));
+    crc = Utility::CalculateCrc32((const u8*)&m_index, sizeof(m_index), crc);
+    return Utility::CalculateCrc32((const u8*)&m_seed, sizeof(m_seed), crc);
+}
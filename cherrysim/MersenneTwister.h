@@ -74,6 +74,9 @@ public:
     uint32_t NextU32(uint32_t min, uint32_t max);
 
     bool NextPsrng(uint32_t probability);
+
+    //A checksum over the complete internal state, used to check that two simulations did not diverge.
+    uint32_t GetStateChecksum() const;
 };
 
 
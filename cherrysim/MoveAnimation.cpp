@@ -30,22 +30,22 @@
 #include "MoveAnimation.h"
 #include "Exceptions.h"
 #include "CherrySim.h"
+#include <algorithm>
 
 ThreeDimStruct<float> MoveAnimationKeyPoint::InterpolateLerp(const ThreeDimStruct<float>& previousPosition, float percentage) const
 {
     ThreeDimStruct<float> retVal = {};
 
-    retVal.x = previousPosition.x * (1 - percentage) + this->x * percentage;
-    retVal.y = previousPosition.y * (1 - percentage) + this->y * percentage;
-    retVal.z = previousPosition.z * (1 - percentage) + this->z * percentage;
+    retVal.x = Lerp(previousPosition.x, this->x, percentage);
+    retVal.y = Lerp(previousPosition.y, this->y, percentage);
+    retVal.z = Lerp(previousPosition.z, this->z, percentage);
 
     return retVal;
 }
 
 ThreeDimStruct<float> MoveAnimationKeyPoint::InterpolateCosine(const ThreeDimStruct<float>& previousPosition, float percentage) const
 {
-    const float percentage2 = static_cast<float>((1 - std::cos(percentage * 3.14)) / 2);
-    return InterpolateLerp(previousPosition, percentage2);
+    return InterpolateLerp(previousPosition, CosinePercentage(percentage));
 }
 
 ThreeDimStruct<float> MoveAnimationKeyPoint::InterpolateBoolean(const ThreeDimStruct<float>& previousPosition, float percentage) const
@@ -97,6 +97,16 @@ ThreeDimStruct<float> MoveAnimationKeyPoint::GetEndPosition() const
     return retVal;
 }
 
+float MoveAnimationKeyPoint::Lerp(float from, float to, float percentage)
+{
+    return from * (1 - percentage) + to * percentage;
+}
+
+float MoveAnimationKeyPoint::CosinePercentage(float percentage)
+{
+    return static_cast<float>((1 - std::cos(percentage * 3.14)) / 2);
+}
+
 ThreeDimStruct<float> MoveAnimationKeyPoint::Evaluate(const ThreeDimStruct<float> &previousPosition, const float time) const
 {
     if (time < 0 || time > this->duration)
@@ -171,7 +181,12 @@ void MoveAnimation::Start(const u32 startTimeMs, const ThreeDimStruct<float> &st
         //Can't start animation without keypoints!
         SIMEXCEPTION(IllegalStateException);
     }
+    static u32 startIdCounter = 0;
+    startIdCounter++;
+    if (startIdCounter == 0) startIdCounter++;
+
     this->isStarted = true;
+    this->startId = startIdCounter;
     this->animationStartTimeMs = startTimeMs;
 
     float totalDuration = 0;
@@ -248,3 +263,208 @@ size_t MoveAnimation::GetAmounOfKeyPoints() const
 {
     return keyPoints.size();
 }
+
+u32 MoveAnimation::GetStartId() const
+{
+    return startId;
+}
+
+void MoveAnimationEngine::BeginSync()
+{
+    syncedAnimations.clear();
+    syncDirty = false;
+}
+
+void MoveAnimationEngine::Sync(u32 nodeIndex, const MoveAnimation & animation)
+{
+    const size_t slot = syncedAnimations.size();
+    syncedAnimations.push_back({ nodeIndex, &animation });
+    if (slot >= nodeIndices.size() || nodeIndices[slot] != nodeIndex || startIds[slot] != animation.startId)
+    {
+        syncDirty = true;
+    }
+}
+
+void MoveAnimationEngine::Rebuild()
+{
+    const size_t amountOfSlots = syncedAnimations.size();
+    size_t amountOfKeyPoints = 0;
+    for (const auto& entry : syncedAnimations) amountOfKeyPoints += entry.second->keyPoints.size();
+
+    nodeIndices.resize(amountOfSlots);
+    startIds.resize(amountOfSlots);
+    animationStartTimesMs.resize(amountOfSlots);
+    totalAnimationTimesMs.resize(amountOfSlots);
+    loopedFlags.resize(amountOfSlots);
+    startX.resize(amountOfSlots);
+    startY.resize(amountOfSlots);
+    startZ.resize(amountOfSlots);
+    firstSegments.resize(amountOfSlots);
+    amountOfSegments.resize(amountOfSlots);
+    currentSegments.assign(amountOfSlots, 0);
+    resultX.resize(amountOfSlots);
+    resultY.resize(amountOfSlots);
+    resultZ.resize(amountOfSlots);
+    resultValid.assign(amountOfSlots, 0);
+    resultFinished.assign(amountOfSlots, 0);
+
+    segmentStartMs.resize(amountOfKeyPoints);
+    segmentEndMs.resize(amountOfKeyPoints);
+    segmentDurations.resize(amountOfKeyPoints);
+    segmentTypes.resize(amountOfKeyPoints);
+    endX.resize(amountOfKeyPoints);
+    endY.resize(amountOfKeyPoints);
+    endZ.resize(amountOfKeyPoints);
+
+    u32 segment = 0;
+    for (size_t slot = 0; slot < amountOfSlots; slot++)
+    {
+        const MoveAnimation& animation = *syncedAnimations[slot].second;
+        nodeIndices[slot] = syncedAnimations[slot].first;
+        startIds[slot] = animation.startId;
+        animationStartTimesMs[slot] = animation.animationStartTimeMs;
+        totalAnimationTimesMs[slot] = animation.totalAnimationTimeMs;
+        loopedFlags[slot] = animation.looped ? 1 : 0;
+        startX[slot] = animation.startPosition.x;
+        startY[slot] = animation.startPosition.y;
+        startZ[slot] = animation.startPosition.z;
+        firstSegments[slot] = segment;
+        amountOfSegments[slot] = static_cast<u32>(animation.keyPoints.size());
+
+        //Same float accumulation as in MoveAnimation::Evaluate, otherwise the boundaries could differ by a millisecond
+        float sumOfAnimationTimes = 0;
+        for (const MoveAnimationKeyPoint& keyPoint : animation.keyPoints)
+        {
+            segmentStartMs[segment] = static_cast<u32>(sumOfAnimationTimes * 1000.0f);
+            sumOfAnimationTimes += keyPoint.GetDuration();
+            segmentEndMs[segment] = static_cast<u32>(sumOfAnimationTimes * 1000.0f);
+            segmentDurations[segment] = keyPoint.duration;
+            segmentTypes[segment] = keyPoint.type;
+            endX[segment] = keyPoint.x;
+            endY[segment] = keyPoint.y;
+            endZ[segment] = keyPoint.z;
+            segment++;
+        }
+    }
+}
+
+void MoveAnimationEngine::Evaluate(u32 currentTimeMs)
+{
+    if (syncDirty || syncedAnimations.size() != nodeIndices.size())
+    {
+        Rebuild();
+        syncDirty = false;
+    }
+    syncedAnimations.clear();
+    evaluatedTimeMs = currentTimeMs;
+
+    const size_t amountOfSlots = nodeIndices.size();
+    for (size_t slot = 0; slot < amountOfSlots; slot++)
+    {
+        const u32 totalTimeMs = totalAnimationTimesMs[slot];
+        const bool looped = loopedFlags[slot] != 0;
+        u32 localTimeMs = currentTimeMs - animationStartTimesMs[slot];
+        bool hasLooped = false;
+        bool finished = false;
+        if (localTimeMs >= totalTimeMs)
+        {
+            hasLooped = true;
+            if (looped)
+            {
+                if (totalTimeMs == 0)
+                {
+                    //Left to the reference implementation
+                    resultValid[slot] = 0;
+                    continue;
+                }
+                localTimeMs %= totalTimeMs;
+            }
+            else
+            {
+                localTimeMs = totalTimeMs;
+                finished = true;
+            }
+        }
+
+        //Find the first segment that ends at or after the local time, starting from the cached one
+        const u32 first = firstSegments[slot];
+        const u32 last = first + amountOfSegments[slot] - 1;
+        u32 segment = first + currentSegments[slot];
+        while (segment > first && localTimeMs <= segmentEndMs[segment - 1]) segment--;
+        while (segment < last && localTimeMs > segmentEndMs[segment]) segment++;
+        currentSegments[slot] = segment - first;
+
+        float fromX, fromY, fromZ;
+        if (segment != first)
+        {
+            fromX = endX[segment - 1];
+            fromY = endY[segment - 1];
+            fromZ = endZ[segment - 1];
+        }
+        else if (looped && hasLooped)
+        {
+            fromX = endX[last];
+            fromY = endY[last];
+            fromZ = endZ[last];
+        }
+        else
+        {
+            fromX = startX[slot];
+            fromY = startY[slot];
+            fromZ = startZ[slot];
+        }
+
+        const float time = (localTimeMs - segmentStartMs[segment]) / 1000.f;
+        const float duration = segmentDurations[segment];
+        if (time < 0 || time > duration)
+        {
+            //Left to the reference implementation, which reports the error
+            resultValid[slot] = 0;
+            continue;
+        }
+        float percentage = time / duration;
+
+        switch (segmentTypes[segment])
+        {
+        case MoveAnimationType::COSINE:
+            percentage = MoveAnimationKeyPoint::CosinePercentage(percentage);
+            //Fallthrough
+        case MoveAnimationType::LERP:
+            resultX[slot] = MoveAnimationKeyPoint::Lerp(fromX, endX[segment], percentage);
+            resultY[slot] = MoveAnimationKeyPoint::Lerp(fromY, endY[segment], percentage);
+            resultZ[slot] = MoveAnimationKeyPoint::Lerp(fromZ, endZ[segment], percentage);
+            break;
+        case MoveAnimationType::BOOLEAN:
+            resultX[slot] = percentage < 0.5 ? fromX : endX[segment];
+            resultY[slot] = percentage < 0.5 ? fromY : endY[segment];
+            resultZ[slot] = percentage < 0.5 ? fromZ : endZ[segment];
+            break;
+        default:
+            resultValid[slot] = 0;
+            continue;
+        }
+        resultValid[slot] = 1;
+        resultFinished[slot] = finished ? 1 : 0;
+    }
+}
+
+bool MoveAnimationEngine::GetPosition(u32 nodeIndex, const MoveAnimation & animation, u32 currentTimeMs, ThreeDimStruct<float>& outPosition, bool & outFinished) const
+{
+    if (currentTimeMs != evaluatedTimeMs) return false;
+
+    const auto it = std::lower_bound(nodeIndices.begin(), nodeIndices.end(), nodeIndex);
+    if (it == nodeIndices.end() || *it != nodeIndex) return false;
+    const size_t slot = it - nodeIndices.begin();
+    if (startIds[slot] != animation.startId || !resultValid[slot]) return false;
+
+    outPosition.x = resultX[slot];
+    outPosition.y = resultY[slot];
+    outPosition.z = resultZ[slot];
+    outFinished = resultFinished[slot] != 0;
+    return true;
+}
+
+size_t MoveAnimationEngine::GetAmountOfMovingNodes() const
+{
+    return nodeIndices.size();
+}
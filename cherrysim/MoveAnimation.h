@@ -33,6 +33,7 @@
 #include <cmath>
 #include <initializer_list>
 #include <string>
+#include <utility>
 
 #include "FmTypes.h"
 #include "PrimitiveTypes.h"
@@ -73,10 +74,16 @@ public:
     ThreeDimStruct<float> GetEndPosition() const;
 
     ThreeDimStruct<float> Evaluate(const ThreeDimStruct<float> &previousPosition, float time) const;
+
+    //Shared with the MoveAnimationEngine so that both produce bit identical positions
+    static float Lerp(float from, float to, float percentage);
+    static float CosinePercentage(float percentage);
 };
 
 class MoveAnimation
 {
+    friend class MoveAnimationEngine;
+
 TESTER_PUBLIC:
     std::string name = "NULL";
     bool isStarted = false;
@@ -84,6 +91,7 @@ TESTER_PUBLIC:
     u32 totalAnimationTimeMs = 0;
     ThreeDimStruct<float> startPosition = {};
     bool looped = false;
+    u32 startId = 0; //Unique for every call to Start, 0 if never started
     std::vector<MoveAnimationKeyPoint> keyPoints = {};
 
     MoveAnimationType defaultAnimationType = MoveAnimationType::LERP;
@@ -114,4 +122,56 @@ public:
     ThreeDimStruct<float> Evaluate(u32 currentTimeMs);
 
     size_t GetAmounOfKeyPoints() const;
+    u32 GetStartId() const;
+};
+
+//Evaluates the animations of all moving nodes in one loop over flat arrays instead of
+//walking the keypoints of every animation separately. The keypoint boundaries of each
+//started animation are precomputed once and the current segment is cached per node, so
+//that a step only has to check whether the segment is still active. The results are bit
+//identical to MoveAnimation::Evaluate, which is still used as the reference and as a
+//fallback for anything the engine did not precompute (e.g. animations started mid step).
+class MoveAnimationEngine
+{
+TESTER_PUBLIC:
+    //Per moving node, indexed by slot
+    std::vector<u32> nodeIndices;
+    std::vector<u32> startIds;
+    std::vector<u32> animationStartTimesMs;
+    std::vector<u32> totalAnimationTimesMs;
+    std::vector<u8> loopedFlags;
+    std::vector<float> startX, startY, startZ;
+    std::vector<u32> firstSegments;
+    std::vector<u32> amountOfSegments;
+    std::vector<u32> currentSegments;
+
+    //Per keypoint of all moving nodes, indexed by firstSegments[slot] + keyPointIndex
+    std::vector<u32> segmentStartMs;
+    std::vector<u32> segmentEndMs;
+    std::vector<float> segmentDurations;
+    std::vector<MoveAnimationType> segmentTypes;
+    std::vector<float> endX, endY, endZ;
+
+    //Results of the last call to Evaluate, indexed by slot
+    std::vector<float> resultX, resultY, resultZ;
+    std::vector<u8> resultValid;
+    std::vector<u8> resultFinished;
+    u32 evaluatedTimeMs = 0;
+
+    std::vector<std::pair<u32, const MoveAnimation*>> syncedAnimations;
+    bool syncDirty = true;
+
+    void Rebuild();
+
+public:
+    //Must be called once per step, followed by Sync for every started animation in ascending node order
+    void BeginSync();
+    void Sync(u32 nodeIndex, const MoveAnimation& animation);
+    void Evaluate(u32 currentTimeMs);
+
+    //Returns false if no precomputed position exists for this animation and time, in which case
+    //MoveAnimation::Evaluate must be used. If finished is set, the caller has to reset the animation.
+    bool GetPosition(u32 nodeIndex, const MoveAnimation& animation, u32 currentTimeMs, ThreeDimStruct<float>& outPosition, bool& outFinished) const;
+
+    size_t GetAmountOfMovingNodes() const;
 };
@@ -0,0 +1,101 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include "FmTypes.h"
+
+//Maps a key such as the serial number of a node to the index of that node. A key may be shared by
+//multiple nodes (e.g. before they booted), in which case the node with the smallest index is found,
+//the same result that a linear search over all nodes gives. The owner must call Set whenever the key
+//of a node may have changed.
+template<typename Key>
+class NodeLookupIndex
+{
+private:
+    std::unordered_map<Key, std::vector<u32>> nodeIndicesByKey;
+    std::vector<Key> keyOfNode;
+    std::vector<bool> nodeHasKey;
+
+    void Remove(u32 nodeIndex)
+    {
+        if (!nodeHasKey[nodeIndex]) return;
+        nodeHasKey[nodeIndex] = false;
+
+        const auto it = nodeIndicesByKey.find(keyOfNode[nodeIndex]);
+        std::vector<u32>& nodeIndices = it->second;
+        nodeIndices.erase(std::find(nodeIndices.begin(), nodeIndices.end(), nodeIndex));
+        if (nodeIndices.empty()) nodeIndicesByKey.erase(it);
+    }
+
+public:
+    void Reset(u32 amountOfNodes)
+    {
+        nodeIndicesByKey.clear();
+        nodeIndicesByKey.reserve(amountOfNodes);
+        keyOfNode.assign(amountOfNodes, Key());
+        nodeHasKey.assign(amountOfNodes, false);
+    }
+
+    void Set(u32 nodeIndex, Key key)
+    {
+        if (nodeHasKey[nodeIndex] && keyOfNode[nodeIndex] == key) return;
+        Remove(nodeIndex);
+
+        std::vector<u32>& nodeIndices = nodeIndicesByKey[key];
+        nodeIndices.insert(std::lower_bound(nodeIndices.begin(), nodeIndices.end(), nodeIndex), nodeIndex);
+        keyOfNode[nodeIndex] = key;
+        nodeHasKey[nodeIndex] = true;
+    }
+
+    //Returns UINT32_MAX if no node has the key.
+    u32 Find(Key key) const
+    {
+        const auto it = nodeIndicesByKey.find(key);
+        if (it == nodeIndicesByKey.end()) return UINT32_MAX;
+        return it->second.front();
+    }
+
+    //Compares the index with the actual key of every node, returns false if an update was missed.
+    template<typename GetKey>
+    bool IsConsistent(GetKey getKey) const
+    {
+        for (u32 nodeIndex = 0; nodeIndex < keyOfNode.size(); nodeIndex++)
+        {
+            const Key key = getKey(nodeIndex);
+            if (!nodeHasKey[nodeIndex] || keyOfNode[nodeIndex] != key) return false;
+            const auto it = nodeIndicesByKey.find(key);
+            if (it == nodeIndicesByKey.end() || std::find(it->second.begin(), it->second.end(), nodeIndex) == it->second.end()) return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,392 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include <ReplayFile.h>
+#include <Config.h>
+#include <Exceptions.h>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr char FILE_MAGIC[8]   = { 'F', 'M', 'R', 'E', 'P', 'L', 'A', 'Y' };
+    constexpr char FOOTER_MAGIC[8] = { 'F', 'M', 'R', 'P', 'I', 'D', 'X', '1' };
+    constexpr u32 FORMAT_VERSION = 1;
+
+    constexpr u32 FILE_HEADER_SIZE   = sizeof(FILE_MAGIC) + 4 + 4;           //magic, formatVersion, fmVersion
+    constexpr u32 RECORD_HEADER_SIZE = 1 + 4 + 4;                            //type, time, payloadLength
+    constexpr u32 INDEX_ENTRY_SIZE   = 4 + 8;                                //time, offset
+    constexpr u32 FILE_FOOTER_SIZE   = 8 + 4 + 4 + 4 + 4 + sizeof(FOOTER_MAGIC); //indexOffset, indexEntryCount, numCommands, numCheckpoints, endTimeMs, magic
+
+    void PutU32(u8* buffer, u32 value)
+    {
+        for (u32 i = 0; i < 4; i++) buffer[i] = (u8)(value >> (8 * i));
+    }
+
+    void PutU64(u8* buffer, uint64_t value)
+    {
+        for (u32 i = 0; i < 8; i++) buffer[i] = (u8)(value >> (8 * i));
+    }
+
+    u32 GetU32(const u8* buffer)
+    {
+        return (u32)buffer[0] | ((u32)buffer[1] << 8) | ((u32)buffer[2] << 16) | ((u32)buffer[3] << 24);
+    }
+
+    uint64_t GetU64(const u8* buffer)
+    {
+        return (uint64_t)GetU32(buffer) | ((uint64_t)GetU32(buffer + 4) << 32);
+    }
+
+    bool IsTimedRecord(ReplayRecordType type)
+    {
+        return type == ReplayRecordType::COMMAND || type == ReplayRecordType::CHECKPOINT;
+    }
+}
+
+ReplayFileWriter::ReplayFileWriter(const std::string& path, u32 indexIntervalMs)
+    : file(path, std::ios::binary | std::ios::out | std::ios::trunc),
+      indexIntervalMs(indexIntervalMs)
+{
+    if (!file)
+    {
+        SIMEXCEPTIONFORCE(FileException);
+    }
+
+    u8 header[FILE_HEADER_SIZE];
+    memcpy(header, FILE_MAGIC, sizeof(FILE_MAGIC));
+    PutU32(header + 8, FORMAT_VERSION);
+    PutU32(header + 12, FM_VERSION);
+    file.write((const char*)header, sizeof(header));
+}
+
+ReplayFileWriter::~ReplayFileWriter()
+{
+    Finish();
+}
+
+void ReplayFileWriter::WriteConfiguration(const std::string& configurationJson)
+{
+    WriteRecord(ReplayRecordType::CONFIGURATION, 0, (const u8*)configurationJson.data(), configurationJson.size());
+}
+
+void ReplayFileWriter::WriteSite(const std::string& siteJson)
+{
+    WriteRecord(ReplayRecordType::SITE, 0, (const u8*)siteJson.data(), siteJson.size());
+}
+
+void ReplayFileWriter::WriteDevices(const std::string& devicesJson)
+{
+    WriteRecord(ReplayRecordType::DEVICES, 0, (const u8*)devicesJson.data(), devicesJson.size());
+}
+
+void ReplayFileWriter::WriteCommand(u32 time, u32 index, const std::string& command)
+{
+    WriteTimedRecordIndex(time);
+    numCommands++;
+    u8 nodeIndex[4];
+    PutU32(nodeIndex, index);
+    WriteRecord(ReplayRecordType::COMMAND, time, nodeIndex, sizeof(nodeIndex), (const u8*)command.data(), command.size());
+}
+
+void ReplayFileWriter::WriteCheckpoint(u32 time, u32 stateHash)
+{
+    WriteTimedRecordIndex(time);
+    numCheckpoints++;
+    u8 hash[4];
+    PutU32(hash, stateHash);
+    WriteRecord(ReplayRecordType::CHECKPOINT, time, hash, sizeof(hash));
+}
+
+void ReplayFileWriter::WriteTimedRecordIndex(u32 time)
+{
+    if (finished || (!index.empty() && time < lastTime))
+    {
+        //Records must be written in chronological order, otherwise the index would be invalid.
+        SIMEXCEPTION(IllegalArgumentException);
+    }
+    lastTime = time;
+
+    if (index.empty() || time >= index.back().time + indexIntervalMs)
+    {
+        ReplayIndexEntry entry;
+        entry.time = time;
+        entry.offset = (uint64_t)file.tellp();
+        index.push_back(entry);
+    }
+}
+
+void ReplayFileWriter::WriteRecord(ReplayRecordType type, u32 time, const u8* payload, u32 payloadLength, const u8* payload2, u32 payload2Length)
+{
+    if (finished)
+    {
+        SIMEXCEPTION(IllegalStateException);
+        return;
+    }
+
+    u8 header[RECORD_HEADER_SIZE];
+    header[0] = (u8)type;
+    PutU32(header + 1, time);
+    PutU32(header + 5, payloadLength + payload2Length);
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)payload, payloadLength);
+    if (payload2Length > 0) file.write((const char*)payload2, payload2Length);
+}
+
+void ReplayFileWriter::Finish()
+{
+    if (finished) return;
+    finished = true;
+
+    const uint64_t indexOffset = (uint64_t)file.tellp();
+
+    for (const ReplayIndexEntry& entry : index)
+    {
+        u8 buffer[INDEX_ENTRY_SIZE];
+        PutU32(buffer, entry.time);
+        PutU64(buffer + 4, entry.offset);
+        file.write((const char*)buffer, sizeof(buffer));
+    }
+
+    u8 footer[FILE_FOOTER_SIZE];
+    PutU64(footer, indexOffset);
+    PutU32(footer + 8, index.size());
+    PutU32(footer + 12, numCommands);
+    PutU32(footer + 16, numCheckpoints);
+    PutU32(footer + 20, lastTime);
+    memcpy(footer + 24, FOOTER_MAGIC, sizeof(FOOTER_MAGIC));
+    file.write((const char*)footer, sizeof(footer));
+    file.close();
+}
+
+ReplayFileReader::ReplayFileReader(const std::string& path)
+    : file(path, std::ios::binary | std::ios::in)
+{
+    if (!file)
+    {
+        SIMEXCEPTIONFORCE(FileException);
+    }
+
+    file.seekg(0, std::ios::end);
+    const uint64_t fileSize = (uint64_t)file.tellg();
+    file.seekg(0);
+
+    u8 header[FILE_HEADER_SIZE];
+    if (fileSize < FILE_HEADER_SIZE
+        || !file.read((char*)header, sizeof(header))
+        || memcmp(header, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0
+        || GetU32(header + 8) != FORMAT_VERSION)
+    {
+        //Not a replay file or written with an incompatible format version.
+        SIMEXCEPTIONFORCE(IllegalArgumentException);
+    }
+    fmVersion = GetU32(header + 12);
+    recordsEndOffset = fileSize;
+
+    //Load the index if the recording was finished properly.
+    if (fileSize >= FILE_HEADER_SIZE + FILE_FOOTER_SIZE)
+    {
+        u8 footer[FILE_FOOTER_SIZE];
+        file.seekg(fileSize - FILE_FOOTER_SIZE);
+        file.read((char*)footer, sizeof(footer));
+        const uint64_t indexOffset = GetU64(footer);
+        const u32 indexEntryCount = GetU32(footer + 8);
+        if (file
+            && memcmp(footer + 24, FOOTER_MAGIC, sizeof(FOOTER_MAGIC)) == 0
+            && indexOffset >= FILE_HEADER_SIZE
+            && indexOffset + (uint64_t)indexEntryCount * INDEX_ENTRY_SIZE + FILE_FOOTER_SIZE == fileSize)
+        {
+            std::vector<u8> indexBuffer((size_t)indexEntryCount * INDEX_ENTRY_SIZE);
+            file.seekg(indexOffset);
+            file.read((char*)indexBuffer.data(), indexBuffer.size());
+            index.resize(indexEntryCount);
+            for (u32 i = 0; i < indexEntryCount; i++)
+            {
+                index[i].time   = GetU32(indexBuffer.data() + i * INDEX_ENTRY_SIZE);
+                index[i].offset = GetU64(indexBuffer.data() + i * INDEX_ENTRY_SIZE + 4);
+            }
+            recordsEndOffset = indexOffset;
+            numCommands    = GetU32(footer + 12);
+            numCheckpoints = GetU32(footer + 16);
+            endTimeMs      = GetU32(footer + 20);
+        }
+        file.clear();
+    }
+
+    //The untimed records (configuration, site, devices) are always stored before the first command.
+    readOffset = FILE_HEADER_SIZE;
+    ReplayRecordType type;
+    u32 time;
+    std::string payload;
+    uint64_t recordOffset = readOffset;
+    while (ReadRecord(type, time, payload) && !IsTimedRecord(type))
+    {
+             if (type == ReplayRecordType::CONFIGURATION) configuration = std::move(payload);
+        else if (type == ReplayRecordType::SITE         ) site          = std::move(payload);
+        else if (type == ReplayRecordType::DEVICES      ) devices       = std::move(payload);
+        recordOffset = readOffset;
+    }
+    firstTimedRecordOffset = recordOffset;
+
+    SeekToTime(0);
+}
+
+bool ReplayFileReader::IsReplayFile(const std::string& path)
+{
+    std::ifstream input(path, std::ios::binary | std::ios::in);
+    char magic[sizeof(FILE_MAGIC)];
+    if (!input.read(magic, sizeof(magic))) return false;
+    return memcmp(magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0;
+}
+
+u32 ReplayFileReader::GetFmVersion() const
+{
+    return fmVersion;
+}
+
+const std::string& ReplayFileReader::GetConfiguration() const
+{
+    return configuration;
+}
+
+const std::string& ReplayFileReader::GetSite() const
+{
+    return site;
+}
+
+const std::string& ReplayFileReader::GetDevices() const
+{
+    return devices;
+}
+
+bool ReplayFileReader::HasIndex() const
+{
+    return !index.empty();
+}
+
+u32 ReplayFileReader::GetNumCommands() const
+{
+    return numCommands;
+}
+
+u32 ReplayFileReader::GetNumCheckpoints() const
+{
+    return numCheckpoints;
+}
+
+u32 ReplayFileReader::GetEndTimeMs() const
+{
+    return endTimeMs;
+}
+
+void ReplayFileReader::SeekToTime(u32 timeMs)
+{
+    //Jump to the last index entry before the requested time, the remaining
+    //records are then skipped one by one.
+    readOffset = firstTimedRecordOffset;
+    auto it = std::lower_bound(index.begin(), index.end(), timeMs,
+        [](const ReplayIndexEntry& entry, u32 time) { return entry.time < time; });
+    if (it != index.begin())
+    {
+        readOffset = (it - 1)->offset;
+    }
+
+    ReadNextTimedRecord();
+    while (hasCurrent && current.time < timeMs)
+    {
+        ReadNextTimedRecord();
+    }
+}
+
+const ReplayFileRecord* ReplayFileReader::Peek() const
+{
+    return hasCurrent ? &current : nullptr;
+}
+
+void ReplayFileReader::Pop()
+{
+    ReadNextTimedRecord();
+}
+
+bool ReplayFileReader::ReadRecord(ReplayRecordType& type, u32& time, std::string& payload)
+{
+    if (readOffset + RECORD_HEADER_SIZE > recordsEndOffset) return false;
+
+    u8 header[RECORD_HEADER_SIZE];
+    file.clear();
+    file.seekg(readOffset);
+    if (!file.read((char*)header, sizeof(header))) return false;
+    const u32 payloadLength = GetU32(header + 5);
+    if (readOffset + RECORD_HEADER_SIZE + payloadLength > recordsEndOffset)
+    {
+        //The last record was only written partially, e.g. because the recording crashed.
+        return false;
+    }
+
+    type = (ReplayRecordType)header[0];
+    time = GetU32(header + 1);
+    payload.resize(payloadLength);
+    if (payloadLength > 0 && !file.read(&payload[0], payloadLength)) return false;
+
+    readOffset += RECORD_HEADER_SIZE + payloadLength;
+    return true;
+}
+
+void ReplayFileReader::ReadNextTimedRecord()
+{
+    hasCurrent = false;
+
+    ReplayRecordType type;
+    u32 time;
+    std::string payload;
+    while (ReadRecord(type, time, payload))
+    {
+        if (type == ReplayRecordType::COMMAND && payload.size() >= 4)
+        {
+            current.type = type;
+            current.time = time;
+            current.index = GetU32((const u8*)payload.data());
+            current.command = payload.substr(4);
+            current.stateHash = 0;
+            hasCurrent = true;
+            return;
+        }
+        else if (type == ReplayRecordType::CHECKPOINT && payload.size() >= 4)
+        {
+            current.type = type;
+            current.time = time;
+            current.index = 0;
+            current.command.clear();
+            current.stateHash = GetU32((const u8*)payload.data());
+            hasCurrent = true;
+            return;
+        }
+        //Unknown records are skipped so that newer files stay readable.
+    }
+}
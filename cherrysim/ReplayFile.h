@@ -0,0 +1,158 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <FmTypes.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * Binary replay container, an alternative to parsing replays out of text logs.
+ * It holds the SimConfiguration, the site and devices json (if the simulation was
+ * imported from json), a time ordered stream of terminal commands and periodic
+ * checkpoints that store a hash of the simulator state at that time. During
+ * playback, the checkpoints are compared against the replayed simulation to
+ * detect if it diverged from the original run.
+ *
+ * Layout (all integers are little endian):
+ *   ReplayFileHeader
+ *   Records, each consisting of a record header (type, time, payload length) and the payload
+ *   Index: ReplayIndexEntry[indexEntryCount], maps a time to the file offset of the first record at or after that time
+ *   ReplayFileFooter
+ *
+ * The index and the footer are only written once the recording is finished. If the
+ * recording was interrupted (e.g. by a crash), the file can still be read but seeking
+ * has to scan all records.
+ */
+
+enum class ReplayRecordType : u8
+{
+    CONFIGURATION = 1,
+    SITE          = 2,
+    DEVICES       = 3,
+    COMMAND       = 4,
+    CHECKPOINT    = 5,
+};
+
+struct ReplayFileRecord
+{
+    ReplayRecordType type = ReplayRecordType::COMMAND;
+    u32 time = 0;
+    u32 index = 0;          //Only for COMMAND: Index of the node that executed the command
+    std::string command;    //Only for COMMAND
+    u32 stateHash = 0;      //Only for CHECKPOINT
+};
+
+struct ReplayIndexEntry
+{
+    u32 time = 0;
+    uint64_t offset = 0;
+};
+
+class ReplayFileWriter
+{
+public:
+    static constexpr u32 DEFAULT_INDEX_INTERVAL_MS = 1000;
+
+    explicit ReplayFileWriter(const std::string& path, u32 indexIntervalMs = DEFAULT_INDEX_INTERVAL_MS);
+    ~ReplayFileWriter();
+    ReplayFileWriter(const ReplayFileWriter&) = delete;
+    ReplayFileWriter& operator=(const ReplayFileWriter&) = delete;
+
+    void WriteConfiguration(const std::string& configurationJson);
+    void WriteSite(const std::string& siteJson);
+    void WriteDevices(const std::string& devicesJson);
+    void WriteCommand(u32 time, u32 index, const std::string& command);
+    void WriteCheckpoint(u32 time, u32 stateHash);
+
+    //Writes the index and the footer. No further records can be written afterwards.
+    void Finish();
+
+private:
+    std::ofstream file;
+    const u32 indexIntervalMs;
+    std::vector<ReplayIndexEntry> index;
+    u32 lastTime = 0;
+    u32 numCommands = 0;
+    u32 numCheckpoints = 0;
+    bool finished = false;
+
+    void WriteRecord(ReplayRecordType type, u32 time, const u8* payload, u32 payloadLength, const u8* payload2 = nullptr, u32 payload2Length = 0);
+    void WriteTimedRecordIndex(u32 time);
+};
+
+class ReplayFileReader
+{
+public:
+    explicit ReplayFileReader(const std::string& path);
+    ReplayFileReader(const ReplayFileReader&) = delete;
+    ReplayFileReader& operator=(const ReplayFileReader&) = delete;
+
+    //Checks the magic number at the beginning of the file, used to tell binary replays apart from text logs.
+    static bool IsReplayFile(const std::string& path);
+
+    u32 GetFmVersion() const;
+    const std::string& GetConfiguration() const;
+    const std::string& GetSite() const;
+    const std::string& GetDevices() const;
+    bool HasIndex() const;
+    u32 GetNumCommands() const;    //Only available if the file has an index, 0 otherwise
+    u32 GetNumCheckpoints() const; //Only available if the file has an index, 0 otherwise
+    u32 GetEndTimeMs() const;      //Only available if the file has an index, 0 otherwise
+
+    //Positions the reader on the first command or checkpoint with a time equal to or after the given time.
+    void SeekToTime(u32 timeMs);
+
+    //Returns the next command or checkpoint or nullptr if the end of the file was reached.
+    const ReplayFileRecord* Peek() const;
+    void Pop();
+
+private:
+    std::ifstream file;
+    u32 fmVersion = 0;
+    std::string configuration;
+    std::string site;
+    std::string devices;
+    std::vector<ReplayIndexEntry> index;
+    uint64_t firstTimedRecordOffset = 0;
+    uint64_t recordsEndOffset = 0;
+    u32 numCommands = 0;
+    u32 numCheckpoints = 0;
+    u32 endTimeMs = 0;
+
+    uint64_t readOffset = 0;
+    ReplayFileRecord current;
+    bool hasCurrent = false;
+
+    //Reads the record at readOffset. Returns false if the end of the records was reached.
+    bool ReadRecord(ReplayRecordType& type, u32& time, std::string& payload);
+    void ReadNextTimedRecord();
+};
@@ -0,0 +1,168 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include <SimAes.h>
+#include <cstring>
+
+extern "C" {
+#include <aes.h>
+}
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define SIM_AES_NI_PRESENT 1
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SIM_AES_NI_TARGET
+#else
+#include <cpuid.h>
+#define SIM_AES_NI_TARGET __attribute__((target("aes,sse2")))
+#endif
+#else
+#define SIM_AES_NI_PRESENT 0
+#endif
+
+bool SimAes::aesNiEnabled = true;
+
+#if SIM_AES_NI_PRESENT
+namespace
+{
+    constexpr u32 KEY_SCHEDULE_CACHE_SIZE = 16;
+
+    struct KeySchedule
+    {
+        __m128i roundKeys[11];
+        u8 key[16];
+        bool valid;
+    };
+
+    //The simulator may run nodes on different threads (e.g. the sim server), so every thread has its own cache
+    thread_local KeySchedule keyScheduleCache[KEY_SCHEDULE_CACHE_SIZE];
+
+    SIM_AES_NI_TARGET inline __m128i KeyExpansionStep(__m128i key, __m128i keygened)
+    {
+        keygened = _mm_shuffle_epi32(keygened, _MM_SHUFFLE(3, 3, 3, 3));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        return _mm_xor_si128(key, keygened);
+    }
+
+    //The round constant of aeskeygenassist must be an immediate, so the expansion is unrolled
+#define SIM_AES_EXPAND_KEY(index, rcon) roundKeys[index] = KeyExpansionStep(roundKeys[index - 1], _mm_aeskeygenassist_si128(roundKeys[index - 1], rcon))
+
+    SIM_AES_NI_TARGET void ExpandKey(const u8* key, __m128i* roundKeys)
+    {
+        roundKeys[0] = _mm_loadu_si128((const __m128i*)key);
+        SIM_AES_EXPAND_KEY(1, 0x01);
+        SIM_AES_EXPAND_KEY(2, 0x02);
+        SIM_AES_EXPAND_KEY(3, 0x04);
+        SIM_AES_EXPAND_KEY(4, 0x08);
+        SIM_AES_EXPAND_KEY(5, 0x10);
+        SIM_AES_EXPAND_KEY(6, 0x20);
+        SIM_AES_EXPAND_KEY(7, 0x40);
+        SIM_AES_EXPAND_KEY(8, 0x80);
+        SIM_AES_EXPAND_KEY(9, 0x1B);
+        SIM_AES_EXPAND_KEY(10, 0x36);
+    }
+#undef SIM_AES_EXPAND_KEY
+
+    SIM_AES_NI_TARGET void EncryptBlockAesNi(const __m128i* roundKeys, const u8* cleartext, u8* ciphertext)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*)cleartext);
+        block = _mm_xor_si128(block, roundKeys[0]);
+        for (u32 i = 1; i < 10; i++)
+        {
+            block = _mm_aesenc_si128(block, roundKeys[i]);
+        }
+        block = _mm_aesenclast_si128(block, roundKeys[10]);
+        _mm_storeu_si128((__m128i*)ciphertext, block);
+    }
+
+    const KeySchedule& GetKeySchedule(const u8* key)
+    {
+        u32 words[4];
+        memcpy(words, key, sizeof(words));
+        const u32 hash = (words[0] ^ words[1] ^ words[2] ^ words[3]) * 2654435761UL;
+        KeySchedule& entry = keyScheduleCache[(hash >> 16) % KEY_SCHEDULE_CACHE_SIZE];
+
+        if (!entry.valid || memcmp(entry.key, key, sizeof(entry.key)) != 0)
+        {
+            ExpandKey(key, entry.roundKeys);
+            memcpy(entry.key, key, sizeof(entry.key));
+            entry.valid = true;
+        }
+        return entry;
+    }
+
+    bool DetectAesNi()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        const u32 ecx = (u32)info[2];
+        const u32 edx = (u32)info[3];
+#else
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+#endif
+        const bool hasSse2 = (edx & (1UL << 26)) != 0;
+        const bool hasAes = (ecx & (1UL << 25)) != 0;
+        return hasSse2 && hasAes;
+    }
+}
+#endif
+
+bool SimAes::IsAesNiSupported()
+{
+#if SIM_AES_NI_PRESENT
+    static const bool supported = DetectAesNi();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void SimAes::SetAesNiEnabled(bool enabled)
+{
+    aesNiEnabled = enabled;
+}
+
+void SimAes::EcbEncryptBlock(const u8* key, const u8* cleartext, u8* ciphertext)
+{
+#if SIM_AES_NI_PRESENT
+    if (aesNiEnabled && IsAesNiSupported())
+    {
+        EncryptBlockAesNi(GetKeySchedule(key).roundKeys, cleartext, ciphertext);
+        return;
+    }
+#endif
+    AES_ECB_encrypt(cleartext, key, ciphertext, 16);
+}
@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <FmTypes.h>
+
+/*
+ * AES-128 ECB encryption used by the simulated ECB peripheral (sd_ecb_block_encrypt).
+ * If the host CPU supports AES-NI, the hardware instructions are used together with a
+ * small cache of expanded key schedules, as the same session keys are used for many blocks.
+ * Otherwise, the portable implementation from aes.c is used. Both produce identical results.
+ */
+class SimAes
+{
+public:
+    static void EcbEncryptBlock(const u8* key, const u8* cleartext, u8* ciphertext);
+
+    //Returns true if the host CPU supports AES-NI and the backend was compiled in
+    static bool IsAesNiSupported();
+
+    //Allows to disable AES-NI, e.g. to compare both implementations in tests
+    static void SetAesNiEnabled(bool enabled);
+
+private:
+    static bool aesNiEnabled;
+};
@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include <SimEnergy.h>
+#include <CherrySimTypes.h>
+#include <algorithm>
+#include <fstream>
+
+u32 SimEnergyModel::GetTxCurrentMicroAmpere(i8 txPower) const
+{
+    if (txPower >= 4) return 7500;
+    if (txPower >= 0) return 5300;
+    if (txPower >= -4) return 4200;
+    if (txPower >= -8) return 3800;
+    if (txPower >= -12) return 3300;
+    if (txPower >= -16) return 3000;
+    if (txPower >= -20) return 2700;
+    return 2300;
+}
+
+uint64_t SimEnergyModel::GetAdvertisingEventCharge(u8 advertisingDataLength, i8 txPower, bool listensForRequests) const
+{
+    const uint64_t packetMicroSeconds = (uint64_t)(advertisingDataLength + advertisingPacketOverheadBytes) * microSecondsPerByte;
+    uint64_t chargePerChannel = GetCharge(GetTxCurrentMicroAmpere(txPower), packetMicroSeconds);
+    if (listensForRequests) chargePerChannel += GetCharge(rxCurrentMicroAmpere, advertisingListenMicroSeconds);
+
+    return radioEventOverheadNanoCoulomb + 3 * chargePerChannel;
+}
+
+uint64_t SimEnergyModel::GetConnectionEventCharge(i8 txPower) const
+{
+    const uint64_t packetMicroSeconds = (uint64_t)emptyPacketBytes * microSecondsPerByte;
+    return radioEventOverheadNanoCoulomb
+        + GetCharge(GetTxCurrentMicroAmpere(txPower), packetMicroSeconds)
+        + GetCharge(rxCurrentMicroAmpere, packetMicroSeconds);
+}
+
+uint64_t SimEnergyModel::GetPacketCharge(u32 payloadLength, bool transmit, i8 txPower) const
+{
+    const uint64_t packetMicroSeconds = (uint64_t)(payloadLength + dataPacketOverheadBytes) * microSecondsPerByte;
+    return GetCharge(transmit ? GetTxCurrentMicroAmpere(txPower) : rxCurrentMicroAmpere, packetMicroSeconds);
+}
+
+uint64_t SimEnergyModel::GetScanningCharge(u32 windowMs, u32 intervalMs, u32 durationMs) const
+{
+    if (intervalMs == 0) return 0;
+    const uint64_t scanMicroSeconds = (uint64_t)durationMs * 1000 * std::min(windowMs, intervalMs) / intervalMs;
+    return GetCharge(rxCurrentMicroAmpere, scanMicroSeconds);
+}
+
+uint64_t SimEnergyModel::GetFlashWriteCharge(u32 words) const
+{
+    return GetCharge(flashCurrentMicroAmpere, (uint64_t)words * flashWriteMicroSecondsPerWord);
+}
+
+uint64_t SimEnergyModel::GetFlashPageEraseCharge() const
+{
+    return GetCharge(flashCurrentMicroAmpere, flashPageEraseMicroSeconds);
+}
+
+uint64_t SimEnergyModel::GetCpuCharge(u32 events) const
+{
+    return GetCharge(cpuCurrentMicroAmpere, (uint64_t)events * cpuMicroSecondsPerEvent);
+}
+
+u32 SimEnergyModel::EstimateBatteryLifeDays(uint64_t averageCurrentMicroAmpere) const
+{
+    if (averageCurrentMicroAmpere == 0) return UINT32_MAX;
+    return (u32)((uint64_t)batteryCapacityMah * 1000 / averageCurrentMicroAmpere / 24);
+}
+
+uint64_t SimEnergyUsage::GetTotalCharge() const
+{
+    uint64_t total = 0;
+    for (const uint64_t charge : chargeNanoCoulomb) total += charge;
+    return total;
+}
+
+uint64_t SimEnergyUsage::GetAverageCurrentMicroAmpere(u32 simTimeMs) const
+{
+    return simTimeMs > 0 ? GetTotalCharge() / simTimeMs : 0;
+}
+
+uint64_t SimEnergyUsage::GetAverageCurrentMicroAmpere(SimEnergySubsystem subsystem, u32 simTimeMs) const
+{
+    return simTimeMs > 0 ? chargeNanoCoulomb[(u32)subsystem] / simTimeMs : 0;
+}
+
+const char* SimEnergy::GetSubsystemName(SimEnergySubsystem subsystem)
+{
+    switch (subsystem)
+    {
+    case SimEnergySubsystem::IDLE:              return "idle";
+    case SimEnergySubsystem::LED:               return "led";
+    case SimEnergySubsystem::ADVERTISING:       return "advertising";
+    case SimEnergySubsystem::SCANNING:          return "scanning";
+    case SimEnergySubsystem::CONNECTION_EVENTS: return "connectionEvents";
+    case SimEnergySubsystem::RADIO_TX:          return "radioTx";
+    case SimEnergySubsystem::RADIO_RX:          return "radioRx";
+    case SimEnergySubsystem::FLASH:             return "flash";
+    case SimEnergySubsystem::CPU:               return "cpu";
+    default:                                    return "unknown";
+    }
+}
+
+void SimEnergy::PrintNode(const NodeEntry& node, u32 simTimeMs, const SimEnergyModel& model)
+{
+    const SimEnergyUsage& energy = node.energy;
+    const uint64_t totalCharge = energy.GetTotalCharge();
+    printf("Energy usage of node %d in %u ms:" EOL, node.id, simTimeMs);
+    for (u32 i = 0; i < (u32)SimEnergySubsystem::AMOUNT; i++)
+    {
+        const SimEnergySubsystem subsystem = (SimEnergySubsystem)i;
+        printf("  %-17s %7u uA %5.1f %%" EOL,
+            GetSubsystemName(subsystem),
+            (u32)energy.GetAverageCurrentMicroAmpere(subsystem, simTimeMs),
+            totalCharge > 0 ? 100.0 * energy.chargeNanoCoulomb[i] / totalCharge : 0.0);
+    }
+    const uint64_t averageCurrent = energy.GetAverageCurrentMicroAmpere(simTimeMs);
+    printf("  total %u uA, battery life %u days" EOL, (u32)averageCurrent, model.EstimateBatteryLifeDays(averageCurrent));
+    printf("  packets tx %u (%u bytes), rx %u (%u bytes), flash words written %u, pages erased %u, cpu events %u" EOL,
+        energy.txPackets, (u32)energy.txBytes, energy.rxPackets, (u32)energy.rxBytes,
+        energy.flashWrittenWords, energy.flashErasedPages, (u32)energy.cpuEvents);
+}
+
+void SimEnergy::PrintSummary(const NodeEntry* nodes, u32 amountOfNodes, u32 simTimeMs, const SimEnergyModel& model)
+{
+    const NodeEntry* worstNode = nullptr;
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        const uint64_t averageCurrent = nodes[i].energy.GetAverageCurrentMicroAmpere(simTimeMs);
+        printf("Node %d: %u uA, battery life %u days" EOL, nodes[i].id, (u32)averageCurrent, model.EstimateBatteryLifeDays(averageCurrent));
+        if (worstNode == nullptr || averageCurrent > worstNode->energy.GetAverageCurrentMicroAmpere(simTimeMs)) worstNode = &nodes[i];
+    }
+    if (worstNode != nullptr)
+    {
+        printf("Node %d has the highest current, enter 'sim energy %d' for details" EOL, worstNode->id, worstNode->id);
+    }
+}
+
+bool SimEnergy::WriteCsv(const std::string& path, const NodeEntry* nodes, u32 amountOfNodes, u32 simTimeMs, const SimEnergyModel& model)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) return false;
+
+    file << "nodeId,simTimeMs,totalMicroAmpere,batteryLifeDays";
+    for (u32 i = 0; i < (u32)SimEnergySubsystem::AMOUNT; i++)
+    {
+        file << "," << GetSubsystemName((SimEnergySubsystem)i) << "MicroAmpere";
+    }
+    file << ",txPackets,txBytes,rxPackets,rxBytes,flashWrittenWords,flashErasedPages,cpuEvents\n";
+
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        const SimEnergyUsage& energy = nodes[i].energy;
+        const uint64_t averageCurrent = energy.GetAverageCurrentMicroAmpere(simTimeMs);
+        file << nodes[i].id << "," << simTimeMs << "," << averageCurrent << "," << model.EstimateBatteryLifeDays(averageCurrent);
+        for (u32 k = 0; k < (u32)SimEnergySubsystem::AMOUNT; k++)
+        {
+            file << "," << energy.GetAverageCurrentMicroAmpere((SimEnergySubsystem)k, simTimeMs);
+        }
+        file << "," << energy.txPackets << "," << energy.txBytes << "," << energy.rxPackets << "," << energy.rxBytes
+            << "," << energy.flashWrittenWords << "," << energy.flashErasedPages << "," << energy.cpuEvents << "\n";
+    }
+    return (bool)file;
+}
@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <FmTypes.h>
+#include <array>
+#include <string>
+
+struct NodeEntry;
+
+//The parts of a node that draw current, used to break down its energy usage
+enum class SimEnergySubsystem : u8
+{
+    IDLE              = 0, //System ON with RTC, RAM retention and the quiescent current of the board
+    LED               = 1,
+    ADVERTISING       = 2, //Advertising events including the listening for scan and connect requests
+    SCANNING          = 3, //Scanning and connecting (initiator), proportional to the duty cycle
+    CONNECTION_EVENTS = 4, //The empty packets that keep a connection alive
+    RADIO_TX          = 5, //Data packets sent in connection events
+    RADIO_RX          = 6, //Data packets received in connection events
+    FLASH             = 7, //Flash writes and page erases
+    CPU               = 8, //Processing of SoftDevice and timer events by the application
+    AMOUNT            = 9,
+};
+
+/*
+ * Parameters of the energy model of the simulator. Each activity of a node is converted into
+ * the charge it draws from the battery in nC (uA * ms), which the simulator adds up per node and
+ * subsystem (see SimEnergyUsage). Dividing the charge by the simulated time gives the average
+ * current in uA.
+ *
+ * The default values are taken from the nRF52832 product specification (DC/DC regulator
+ * enabled, 1 Mbit/s) and the Nordic online power profiler. They are meant to compare firmware
+ * changes with each other, not to predict the battery life of a specific board exactly.
+ */
+struct SimEnergyModel
+{
+    u32 idleCurrentMicroAmpere = 10;
+    u32 ledCurrentMicroAmpere = 10 * 1000;
+    u32 rxCurrentMicroAmpere = 5400;
+    u32 cpuCurrentMicroAmpere = 3300; //Running from flash at 64 MHz with cache enabled
+
+    u32 radioEventOverheadNanoCoulomb = 1500; //Start of the HFXO, radio ramp up and SoftDevice processing of each advertising or connection event
+    u32 microSecondsPerByte = 8; //On air time at 1 Mbit/s
+    u32 advertisingPacketOverheadBytes = 16; //Preamble, access address, header, advertiser address and CRC
+    u32 dataPacketOverheadBytes = 17; //Preamble, access address, header, CRC, L2CAP and ATT header
+    u32 emptyPacketBytes = 10;
+    u32 advertisingListenMicroSeconds = 200; //Listening for scan and connect requests after each packet of scannable or connectable advertising
+
+    u32 flashCurrentMicroAmpere = 7400;
+    u32 flashWriteMicroSecondsPerWord = 41;
+    u32 flashPageEraseMicroSeconds = 85 * 1000;
+
+    u32 cpuMicroSecondsPerEvent = 100;
+
+    u32 batteryCapacityMah = 220; //CR2032
+
+    //Returns the current of the radio while sending with the given tx power in dBm
+    u32 GetTxCurrentMicroAmpere(i8 txPower) const;
+
+    //One advertising event sends the advertising data on all three advertising channels
+    uint64_t GetAdvertisingEventCharge(u8 advertisingDataLength, i8 txPower, bool listensForRequests) const;
+    //An empty packet exchange of a connection event, data packets are added with GetPacketCharge
+    uint64_t GetConnectionEventCharge(i8 txPower) const;
+    uint64_t GetPacketCharge(u32 payloadLength, bool transmit, i8 txPower) const;
+    //Scanning with the given duty cycle for the given time
+    uint64_t GetScanningCharge(u32 windowMs, u32 intervalMs, u32 durationMs) const;
+    uint64_t GetFlashWriteCharge(u32 words) const;
+    uint64_t GetFlashPageEraseCharge() const;
+    uint64_t GetCpuCharge(u32 events) const;
+
+    //Returns the days until the battery is empty at the given average current
+    u32 EstimateBatteryLifeDays(uint64_t averageCurrentMicroAmpere) const;
+
+    //uA * us = pC
+    static uint64_t GetCharge(u32 currentMicroAmpere, uint64_t durationMicroSeconds)
+    {
+        return (uint64_t)currentMicroAmpere * durationMicroSeconds / 1000;
+    }
+};
+
+//The energy usage of a node since it was created, kept in NodeEntry::energy
+struct SimEnergyUsage
+{
+    std::array<uint64_t, (u32)SimEnergySubsystem::AMOUNT> chargeNanoCoulomb = {};
+
+    u32 txPackets = 0;
+    u32 rxPackets = 0;
+    uint64_t txBytes = 0;
+    uint64_t rxBytes = 0;
+    u32 flashWrittenWords = 0;
+    u32 flashErasedPages = 0;
+    uint64_t cpuEvents = 0;
+
+    uint64_t GetTotalCharge() const;
+    //Charge in nC divided by the time in ms gives the average current in uA
+    uint64_t GetAverageCurrentMicroAmpere(u32 simTimeMs) const;
+    uint64_t GetAverageCurrentMicroAmpere(SimEnergySubsystem subsystem, u32 simTimeMs) const;
+};
+
+namespace SimEnergy
+{
+    const char* GetSubsystemName(SimEnergySubsystem subsystem);
+
+    //Prints the average current of each subsystem and the estimated battery life of a node
+    void PrintNode(const NodeEntry& node, u32 simTimeMs, const SimEnergyModel& model);
+    //Prints one line per node and the node with the shortest battery life
+    void PrintSummary(const NodeEntry* nodes, u32 amountOfNodes, u32 simTimeMs, const SimEnergyModel& model);
+    //Writes one row per node with the average current of each subsystem and the counters
+    bool WriteCsv(const std::string& path, const NodeEntry* nodes, u32 amountOfNodes, u32 simTimeMs, const SimEnergyModel& model);
+}
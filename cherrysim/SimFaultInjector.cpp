@@ -0,0 +1,344 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include <SimFaultInjector.h>
+#include <Exceptions.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace
+{
+    //The random streams of the faults are keyed with an owner that can not be a node id
+    constexpr u32 FAULT_STREAM_OWNER_OFFSET = 0x10000;
+
+    const char* const typeNames[] = { "packetLoss", "latency", "txStall", "clockDrift", "flashFailure", "disconnect" };
+    static_assert(sizeof(typeNames) / sizeof(*typeNames) == (u32)SimFaultType::AMOUNT, "Every fault type needs a name");
+
+    //Exponentially distributed duration with the given mean, at least 1 ms
+    u32 DrawDurationMs(SimRandom& random, u32 meanMs)
+    {
+        const double uniform = (random.NextU32() + 0.5) / 4294967296.0;
+        return (u32)std::min(-std::log(uniform) * meanMs, (double)UINT32_MAX / 2) + 1;
+    }
+
+    u32 ProbabilityFromJson(double probability)
+    {
+        if (probability < 0 || probability > 1)
+        {
+            printf("Fault probability %f must be between 0 and 1" EOL, probability);
+            SIMEXCEPTIONFORCE(IllegalArgumentException);
+        }
+        return (u32)(probability * UINT32_MAX);
+    }
+}
+
+bool SimFault::IsActive(u32 simTimeMs) const
+{
+    if (simTimeMs < startMs) return false;
+    if (durationMs != 0 && simTimeMs - startMs >= durationMs) return false;
+    return burstMs == 0 || inBurst;
+}
+
+bool SimFault::MatchesNode(NodeId nodeId) const
+{
+    return node == 0 || node == nodeId;
+}
+
+bool SimFault::MatchesLink(NodeId sender, NodeId receiver) const
+{
+    if ((node == 0 || node == sender) && (partner == 0 || partner == receiver)) return true;
+    return bidirectional && (node == 0 || node == receiver) && (partner == 0 || partner == sender);
+}
+
+void to_json(nlohmann::json& j, const SimFault& fault)
+{
+    j = nlohmann::json{
+        { "type"         , SimFaultInjector::GetTypeName(fault.type)     },
+        { "node"         , fault.node                                    },
+        { "partner"      , fault.partner                                 },
+        { "bidirectional", fault.bidirectional                           },
+        { "startMs"      , fault.startMs                                 },
+        { "durationMs"   , fault.durationMs                              },
+        { "probability"  , (double)fault.probability / UINT32_MAX        },
+        { "burstMs"      , fault.burstMs                                 },
+        { "gapMs"        , fault.gapMs                                   },
+        { "latencyMs"    , fault.latencyMs                               },
+        { "driftPpm"     , fault.driftPpm                                },
+        { "triggerCount" , fault.triggerCount                            },
+    };
+}
+
+void from_json(const nlohmann::json& j, SimFault& fault)
+{
+    fault = SimFault();
+    for (nlohmann::json::const_iterator it = j.begin(); it != j.end(); ++it)
+    {
+        if (it.key() == "type")
+        {
+            const std::string typeName = it->get<std::string>();
+            const auto type = std::find_if(std::begin(typeNames), std::end(typeNames), [&](const char* name) { return typeName == name; });
+            if (type == std::end(typeNames))
+            {
+                printf("Unknown fault type %s" EOL, typeName.c_str());
+                SIMEXCEPTIONFORCE(IllegalArgumentException);
+            }
+            fault.type = (SimFaultType)(type - std::begin(typeNames));
+        }
+        else if (it.key() == "node"         ) fault.node          = *it;
+        else if (it.key() == "partner"      ) fault.partner       = *it;
+        else if (it.key() == "bidirectional") fault.bidirectional = *it;
+        else if (it.key() == "startMs"      ) fault.startMs       = *it;
+        else if (it.key() == "durationMs"   ) fault.durationMs    = *it;
+        else if (it.key() == "probability"  ) fault.probability   = ProbabilityFromJson(*it);
+        else if (it.key() == "burstMs"      ) fault.burstMs       = *it;
+        else if (it.key() == "gapMs"        ) fault.gapMs         = *it;
+        else if (it.key() == "latencyMs"    ) fault.latencyMs     = *it;
+        else if (it.key() == "driftPpm"     ) fault.driftPpm      = *it;
+        else if (it.key() == "triggerCount" ) continue; //Only informational, written by to_json
+        else SIMEXCEPTIONFORCE(UnknownJsonEntryException);
+    }
+    if (!j.contains("type"))
+    {
+        printf("Every fault needs a type" EOL);
+        SIMEXCEPTIONFORCE(IllegalArgumentException);
+    }
+}
+
+void SimFaultInjector::SeedFault(SimFault& fault, u32 faultIndex)
+{
+    fault.random.SetSeed(seed, FAULT_STREAM_OWNER_OFFSET + faultIndex, SimRandomStream::RADIO);
+    fault.inBurst = false;
+    fault.executed = false;
+    if (fault.burstMs != 0)
+    {
+        fault.nextEventMs = fault.startMs + DrawDurationMs(fault.random, fault.gapMs);
+    }
+    else if (fault.type == SimFaultType::DISCONNECT)
+    {
+        fault.nextEventMs = fault.startMs;
+    }
+}
+
+void SimFaultInjector::SetSeed(u32 seed)
+{
+    this->seed = seed;
+    for (u32 i = 0; i < faults.size(); i++)
+    {
+        SeedFault(faults[i], i);
+    }
+}
+
+void SimFaultInjector::AddFault(const SimFault& fault)
+{
+    if (fault.burstMs != 0 && (fault.gapMs == 0 || fault.type == SimFaultType::DISCONNECT))
+    {
+        printf("Bursts need a gapMs and are not supported for disconnects" EOL);
+        SIMEXCEPTIONFORCE(IllegalArgumentException);
+    }
+    faults.push_back(fault);
+    SeedFault(faults.back(), (u32)faults.size() - 1);
+    typeMask |= 1UL << (u32)fault.type;
+}
+
+bool SimFaultInjector::IsValidFault(const nlohmann::json& j)
+{
+    if (!j.is_object()) return false;
+
+    auto isUnsigned = [](const nlohmann::json& value, uint64_t maxValue) {
+        return value.is_number_unsigned() && value.get<uint64_t>() <= maxValue;
+    };
+    for (nlohmann::json::const_iterator it = j.begin(); it != j.end(); ++it)
+    {
+        bool valid = false;
+        if (it.key() == "type")
+        {
+            valid = it->is_string() && std::find(std::begin(typeNames), std::end(typeNames), it->get<std::string>()) != std::end(typeNames);
+        }
+        else if (it.key() == "node" || it.key() == "partner") valid = isUnsigned(*it, UINT16_MAX);
+        else if (it.key() == "bidirectional") valid = it->is_boolean();
+        else if (it.key() == "startMs" || it.key() == "durationMs" || it.key() == "burstMs" || it.key() == "gapMs"
+              || it.key() == "latencyMs" || it.key() == "triggerCount") valid = isUnsigned(*it, UINT32_MAX);
+        else if (it.key() == "probability") valid = it->is_number() && it->get<double>() >= 0 && it->get<double>() <= 1;
+        else if (it.key() == "driftPpm") valid = it->is_number_integer() && it->get<int64_t>() >= INT32_MIN && it->get<int64_t>() <= INT32_MAX;
+
+        if (!valid)
+        {
+            printf("Invalid fault entry %s" EOL, it.key().c_str());
+            return false;
+        }
+    }
+    if (!j.contains("type"))
+    {
+        printf("Every fault needs a type" EOL);
+        return false;
+    }
+
+    //Same restriction as in AddFault
+    const u32 burstMs = j.value("burstMs", 0u);
+    if (burstMs != 0 && (j.value("gapMs", 0u) == 0 || j["type"] == GetTypeName(SimFaultType::DISCONNECT)))
+    {
+        printf("Bursts need a gapMs and are not supported for disconnects" EOL);
+        return false;
+    }
+    return true;
+}
+
+void SimFaultInjector::AddScenario(const nlohmann::json& scenario)
+{
+    for (nlohmann::json::const_iterator it = scenario.begin(); it != scenario.end(); ++it)
+    {
+        if (it.key() == "faults")
+        {
+            for (const nlohmann::json& fault : *it)
+            {
+                AddFault(fault.get<SimFault>());
+            }
+        }
+        else SIMEXCEPTIONFORCE(UnknownJsonEntryException);
+    }
+}
+
+nlohmann::json SimFaultInjector::LoadScenario(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        SIMEXCEPTIONFORCE(FileException);
+    }
+    nlohmann::json scenario;
+    file >> scenario;
+    return scenario;
+}
+
+void SimFaultInjector::Clear()
+{
+    faults.clear();
+    typeMask = 0;
+}
+
+const std::vector<SimFault>& SimFaultInjector::GetFaults() const
+{
+    return faults;
+}
+
+void SimFaultInjector::Update(u32 simTimeMs, std::vector<const SimFault*>& dueDisconnects)
+{
+    this->simTimeMs = simTimeMs;
+    for (SimFault& fault : faults)
+    {
+        //Alternate between bursts and gaps
+        while (fault.burstMs != 0 && simTimeMs >= fault.nextEventMs)
+        {
+            fault.inBurst = !fault.inBurst;
+            fault.nextEventMs += DrawDurationMs(fault.random, fault.inBurst ? fault.burstMs : fault.gapMs);
+        }
+
+        if (fault.type != SimFaultType::DISCONNECT || !fault.IsActive(simTimeMs)) continue;
+        if (fault.durationMs == 0)
+        {
+            //A single disconnect at the start time
+            if (!fault.executed)
+            {
+                fault.executed = true;
+                fault.triggerCount++;
+                dueDisconnects.push_back(&fault);
+            }
+        }
+        else if (simTimeMs >= fault.nextEventMs)
+        {
+            fault.nextEventMs += 1000;
+            if (fault.random.NextPsrng(fault.probability))
+            {
+                fault.triggerCount++;
+                dueDisconnects.push_back(&fault);
+            }
+        }
+    }
+}
+
+bool SimFaultInjector::DrawLinkFault(SimFaultType type, NodeId sender, NodeId receiver)
+{
+    for (SimFault& fault : faults)
+    {
+        if (fault.type == type && fault.IsActive(simTimeMs) && fault.MatchesLink(sender, receiver) && fault.random.NextPsrng(fault.probability))
+        {
+            fault.triggerCount++;
+            return true;
+        }
+    }
+    return false;
+}
+
+u32 SimFaultInjector::GetLatencyMs(NodeId sender, NodeId receiver) const
+{
+    u32 latencyMs = 0;
+    if (!HasFaults(SimFaultType::LATENCY)) return latencyMs;
+    for (const SimFault& fault : faults)
+    {
+        if (fault.type == SimFaultType::LATENCY && fault.IsActive(simTimeMs) && fault.MatchesLink(sender, receiver))
+        {
+            latencyMs = std::max(latencyMs, fault.latencyMs);
+        }
+    }
+    return latencyMs;
+}
+
+i32 SimFaultInjector::GetClockDriftPpm(NodeId nodeId) const
+{
+    i32 driftPpm = 0;
+    if (!HasFaults(SimFaultType::CLOCK_DRIFT)) return driftPpm;
+    for (const SimFault& fault : faults)
+    {
+        if (fault.type == SimFaultType::CLOCK_DRIFT && fault.IsActive(simTimeMs) && fault.MatchesNode(nodeId))
+        {
+            driftPpm += fault.driftPpm;
+        }
+    }
+    return driftPpm;
+}
+
+bool SimFaultInjector::ShouldFailFlashOperation(NodeId nodeId)
+{
+    if (!HasFaults(SimFaultType::FLASH_FAILURE)) return false;
+    for (SimFault& fault : faults)
+    {
+        if (fault.type == SimFaultType::FLASH_FAILURE && fault.IsActive(simTimeMs) && fault.MatchesNode(nodeId) && fault.random.NextPsrng(fault.probability))
+        {
+            fault.triggerCount++;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* SimFaultInjector::GetTypeName(SimFaultType type)
+{
+    return (u32)type < (u32)SimFaultType::AMOUNT ? typeNames[(u32)type] : "unknown";
+}
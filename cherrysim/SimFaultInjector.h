@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <FmTypes.h>
+#include <string>
+#include <vector>
+#include "SimRandom.h"
+#include "json.hpp"
+
+enum class SimFaultType : u8
+{
+    PACKET_LOSS   = 0, //Advertising packets and connection events between the nodes are lost with the given probability
+    LATENCY       = 1, //Data packets are sent at the earliest latencyMs after they were queued
+    TX_STALL      = 2, //The connection is kept alive, but no data packets are sent
+    CLOCK_DRIFT   = 3, //The application timer of the node runs faster (positive) or slower (negative) by driftPpm
+    FLASH_FAILURE = 4, //Flash operations of the node report an error with the given probability
+    DISCONNECT    = 5, //Connections are disconnected at startMs or, if a duration is given, with the given probability each second
+    AMOUNT        = 6,
+};
+
+struct SimFault
+{
+    SimFaultType type = SimFaultType::PACKET_LOSS;
+    NodeId node = 0; //The sending or affected node, 0 for all nodes
+    NodeId partner = 0; //The receiving node of link faults, 0 for all partners
+    bool bidirectional = false; //If set, link faults also affect the packets that the node receives from the partner
+    u32 startMs = 0;
+    u32 durationMs = 0; //0 if the fault lasts until the end of the simulation
+    u32 probability = UINT32_MAX; //Per packet, connection event, flash operation or second, UINT32_MAX for always
+    u32 burstMs = 0; //If set, the fault is only active in bursts of this average length...
+    u32 gapMs = 0; //...with pauses of this average length in between, both exponentially distributed
+    u32 latencyMs = 0;
+    i32 driftPpm = 0;
+
+    //State during the simulation
+    SimRandom random;
+    bool inBurst = false;
+    u32 nextEventMs = 0; //Next change of the burst state or next check for a stochastic disconnect
+    bool executed = false; //Set once a disconnect at a specific time was executed
+    u32 triggerCount = 0; //How often the fault changed the simulation, e.g. the number of lost packets
+
+    bool IsActive(u32 simTimeMs) const;
+    bool MatchesNode(NodeId nodeId) const;
+    bool MatchesLink(NodeId sender, NodeId receiver) const;
+};
+
+void to_json(nlohmann::json& j, const SimFault& fault);
+void from_json(const nlohmann::json& j, SimFault& fault);
+
+/*
+ * Injects scheduled and stochastic faults into the simulation, e.g. bursty interference, an
+ * asymmetric link, a single flaky node or a connection that stops sending data. Faults are
+ * described declaratively, either in a scenario file (simConfig.faultScenarioPath) with the format
+ *
+ * {
+ *   "faults": [
+ *     { "type": "packetLoss", "node": 3, "bidirectional": true, "probability": 0.9, "startMs": 60000, "durationMs": 30000, "burstMs": 500, "gapMs": 2000 },
+ *     { "type": "latency", "node": 2, "partner": 4, "latencyMs": 300 },
+ *     { "type": "txStall", "node": 2, "partner": 4, "startMs": 90000, "durationMs": 10000 },
+ *     { "type": "clockDrift", "node": 5, "driftPpm": 5000 },
+ *     { "type": "flashFailure", "node": 5, "probability": 0.5 },
+ *     { "type": "disconnect", "node": 2, "startMs": 120000 }
+ *   ]
+ * }
+ *
+ * or at runtime with "sim fault add {json}". All random decisions of a fault are drawn from its
+ * own random stream, so adding a fault does not change the random numbers of the nodes.
+ */
+class SimFaultInjector
+{
+private:
+    std::vector<SimFault> faults;
+    u32 seed = 0;
+    u32 simTimeMs = 0;
+    u32 typeMask = 0; //Bit per SimFaultType that has at least one fault, keeps the checks in hot paths cheap
+
+    void SeedFault(SimFault& fault, u32 faultIndex);
+    bool HasFaults(SimFaultType type) const
+    {
+        return (typeMask & (1UL << (u32)type)) != 0;
+    }
+    bool DrawLinkFault(SimFaultType type, NodeId sender, NodeId receiver);
+
+public:
+    void SetSeed(u32 seed);
+    void AddFault(const SimFault& fault);
+    //Checks a fault given as json without throwing, e.g. for faults that are added at runtime
+    static bool IsValidFault(const nlohmann::json& j);
+    //Adds all faults of a scenario, see the class description for the format
+    void AddScenario(const nlohmann::json& scenario);
+    static nlohmann::json LoadScenario(const std::string& path);
+    void Clear();
+    const std::vector<SimFault>& GetFaults() const;
+    bool IsEmpty() const
+    {
+        return typeMask == 0;
+    }
+
+    //Called once per simulation step, returns the disconnects that have to be executed in this step
+    void Update(u32 simTimeMs, std::vector<const SimFault*>& dueDisconnects);
+
+    bool ShouldDropPacket(NodeId sender, NodeId receiver)
+    {
+        return HasFaults(SimFaultType::PACKET_LOSS) && DrawLinkFault(SimFaultType::PACKET_LOSS, sender, receiver);
+    }
+    bool IsTxStalled(NodeId sender, NodeId receiver)
+    {
+        return HasFaults(SimFaultType::TX_STALL) && DrawLinkFault(SimFaultType::TX_STALL, sender, receiver);
+    }
+    u32 GetLatencyMs(NodeId sender, NodeId receiver) const;
+    i32 GetClockDriftPpm(NodeId nodeId) const;
+    bool ShouldFailFlashOperation(NodeId nodeId);
+
+    static const char* GetTypeName(SimFaultType type);
+};
@@ -0,0 +1,342 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include <SimFlashStore.h>
+#include <Exceptions.h>
+#include <Utility.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+    constexpr u32 JOURNAL_MAGIC = 0x4C4E524A; //"JRNL"
+    constexpr u32 JOURNAL_COMMIT_MAGIC = 0x54494D43; //"CMIT"
+
+    struct FlashJournalHeader
+    {
+        u32 magic;
+        u32 flashSize;
+        u32 pageSize;
+        u32 amountOfEntries;
+    };
+
+    struct FlashJournalEntryHeader
+    {
+        u32 nodeIndex;
+        u32 pageIndex;
+    };
+
+    struct FlashJournalTrailer
+    {
+        u32 magic;
+        u32 crc;
+    };
+}
+
+FlashFileHeader SimFlashStore::CreateHeader() const
+{
+    FlashFileHeader ffh;
+    CheckedMemset(&ffh, 0, sizeof(ffh));
+
+    ffh.version = version;
+    ffh.sizeOfHeader = sizeof(ffh);
+    ffh.flashSize = flashSize;
+    ffh.amountOfNodes = amountOfNodes;
+
+    return ffh;
+}
+
+void SimFlashStore::Reset(const std::string& path, u32 flashSize, u32 amountOfNodes, u32 version)
+{
+    if (flashSize % PAGE_SIZE != 0)
+    {
+        SIMEXCEPTION(IllegalArgumentException);
+    }
+
+    this->path = path;
+    this->flashSize = flashSize;
+    this->pagesPerNode = flashSize / PAGE_SIZE;
+    this->amountOfNodes = amountOfNodes;
+    this->version = version;
+    fileMatchesHeader = false;
+
+    //Without a file, nothing has to be tracked
+    dirtyPages.clear();
+    amountOfDirtyPages = 0;
+    if (path == "") return;
+
+    dirtyPages.resize(((uint64_t)pagesPerNode * amountOfNodes + 63) / 64, 0);
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        MarkNodeDirty(i);
+    }
+}
+
+void SimFlashStore::ClearDirtyPages()
+{
+    std::fill(dirtyPages.begin(), dirtyPages.end(), 0);
+    amountOfDirtyPages = 0;
+}
+
+void SimFlashStore::MarkDirty(u32 nodeIndex, u32 offset, u32 length)
+{
+    if (dirtyPages.empty() || nodeIndex >= amountOfNodes || length == 0 || offset >= flashSize) return;
+    if (length > flashSize - offset) length = flashSize - offset;
+
+    const u32 firstPage = offset / PAGE_SIZE;
+    const u32 lastPage = (offset + length - 1) / PAGE_SIZE;
+    for (u32 page = firstPage; page <= lastPage; page++)
+    {
+        const uint64_t bit = (uint64_t)nodeIndex * pagesPerNode + page;
+        const uint64_t mask = 1ULL << (bit % 64);
+        if ((dirtyPages[bit / 64] & mask) == 0)
+        {
+            dirtyPages[bit / 64] |= mask;
+            amountOfDirtyPages++;
+        }
+    }
+}
+
+void SimFlashStore::MarkNodeDirty(u32 nodeIndex)
+{
+    MarkDirty(nodeIndex, 0, flashSize);
+}
+
+bool SimFlashStore::IsPageDirty(u32 nodeIndex, u32 pageIndex) const
+{
+    if (dirtyPages.empty() || nodeIndex >= amountOfNodes || pageIndex >= pagesPerNode) return false;
+    const uint64_t bit = (uint64_t)nodeIndex * pagesPerNode + pageIndex;
+    return (dirtyPages[bit / 64] & (1ULL << (bit % 64))) != 0;
+}
+
+u32 SimFlashStore::GetAmountOfDirtyPages() const
+{
+    return amountOfDirtyPages;
+}
+
+std::string SimFlashStore::GetJournalPath() const
+{
+    return path + ".journal";
+}
+
+bool SimFlashStore::WriteCompleteFile(const FlashGetter& getFlash)
+{
+    //Written to a temporary file first so that the previous file stays intact until the new one is complete
+    const std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        const FlashFileHeader ffh = CreateHeader();
+        file.write((const char*)&ffh, sizeof(ffh));
+        for (u32 i = 0; i < amountOfNodes; i++)
+        {
+            file.write((const char*)getFlash(i), flashSize);
+        }
+        file.flush();
+        if (!file.good()) return false;
+    }
+
+    //A journal that is left behind belongs to the previous file
+    std::remove(GetJournalPath().c_str());
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        //Renaming onto an existing file is not possible on every platform
+        std::remove(path.c_str());
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) return false;
+    }
+    return true;
+}
+
+bool SimFlashStore::WriteJournal(const FlashGetter& getFlash)
+{
+    std::ofstream journal(GetJournalPath(), std::ios::binary | std::ios::trunc);
+
+    FlashJournalHeader header;
+    CheckedMemset(&header, 0, sizeof(header));
+    header.magic = JOURNAL_MAGIC;
+    header.flashSize = flashSize;
+    header.pageSize = PAGE_SIZE;
+    header.amountOfEntries = amountOfDirtyPages;
+    journal.write((const char*)&header, sizeof(header));
+
+    u32 crc = 0;
+    for (u32 nodeIndex = 0; nodeIndex < amountOfNodes; nodeIndex++)
+    {
+        const u8* flash = nullptr;
+        for (u32 pageIndex = 0; pageIndex < pagesPerNode; pageIndex++)
+        {
+            if (!IsPageDirty(nodeIndex, pageIndex)) continue;
+            if (flash == nullptr) flash = getFlash(nodeIndex);
+
+            FlashJournalEntryHeader entry;
+            entry.nodeIndex = nodeIndex;
+            entry.pageIndex = pageIndex;
+            crc = Utility::CalculateCrc32((const u8*)&entry, sizeof(entry), crc);
+            crc = Utility::CalculateCrc32(flash + pageIndex * PAGE_SIZE, PAGE_SIZE, crc);
+            journal.write((const char*)&entry, sizeof(entry));
+            journal.write((const char*)flash + pageIndex * PAGE_SIZE, PAGE_SIZE);
+        }
+    }
+
+    //The journal only counts as complete once the trailer is written
+    FlashJournalTrailer trailer;
+    trailer.magic = JOURNAL_COMMIT_MAGIC;
+    trailer.crc = crc;
+    journal.write((const char*)&trailer, sizeof(trailer));
+    journal.flush();
+
+    return journal.good();
+}
+
+bool SimFlashStore::ApplyJournal()
+{
+    std::vector<u8> entries;
+    bool journalComplete = false;
+    {
+        std::ifstream journal(GetJournalPath(), std::ios::binary);
+        if (!journal.good()) return false;
+
+        FlashJournalHeader header;
+        FlashJournalTrailer trailer;
+        journal.read((char*)&header, sizeof(header));
+        if (journal.good()
+            && header.magic == JOURNAL_MAGIC
+            && header.flashSize == flashSize
+            && header.pageSize == PAGE_SIZE)
+        {
+            entries.resize((size_t)header.amountOfEntries * (sizeof(FlashJournalEntryHeader) + PAGE_SIZE));
+            journal.read((char*)entries.data(), entries.size());
+            journal.read((char*)&trailer, sizeof(trailer));
+            journalComplete = journal.good()
+                && trailer.magic == JOURNAL_COMMIT_MAGIC
+                && trailer.crc == Utility::CalculateCrc32(entries.data(), entries.size());
+        }
+    }
+
+    bool success = false;
+    if (journalComplete)
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        success = file.good();
+        for (size_t offset = 0; success && offset < entries.size(); offset += sizeof(FlashJournalEntryHeader) + PAGE_SIZE)
+        {
+            FlashJournalEntryHeader entry;
+            CheckedMemcpy(&entry, entries.data() + offset, sizeof(entry));
+            if (entry.nodeIndex >= amountOfNodes || entry.pageIndex >= pagesPerNode)
+            {
+                success = false;
+                break;
+            }
+            file.seekp(sizeof(FlashFileHeader) + (uint64_t)entry.nodeIndex * flashSize + (uint64_t)entry.pageIndex * PAGE_SIZE);
+            file.write((const char*)entries.data() + offset + sizeof(entry), PAGE_SIZE);
+        }
+        file.flush();
+        success = success && file.good();
+    }
+
+    //An incomplete journal is the remainder of an interrupted store, the file still holds the state of the store before
+    if (success || !journalComplete) std::remove(GetJournalPath().c_str());
+    return success;
+}
+
+u32 SimFlashStore::Store(const FlashGetter& getFlash)
+{
+    if (path == "") return 0;
+
+    if (!fileMatchesHeader)
+    {
+        if (!WriteCompleteFile(getFlash))
+        {
+            SIMEXCEPTION(FileException);
+            return 0;
+        }
+        fileMatchesHeader = true;
+        ClearDirtyPages();
+        return pagesPerNode * amountOfNodes;
+    }
+
+    if (amountOfDirtyPages == 0) return 0;
+
+    const u32 amountOfWrittenPages = amountOfDirtyPages;
+    if (!WriteJournal(getFlash) || !ApplyJournal())
+    {
+        SIMEXCEPTION(FileException);
+        return 0;
+    }
+    ClearDirtyPages();
+    return amountOfWrittenPages;
+}
+
+bool SimFlashStore::Load(const FlashGetter& getFlash)
+{
+    fileMatchesHeader = false;
+    if (path == "") return false;
+
+    //Finish a store that was interrupted after its journal was complete
+    ApplyJournal();
+
+    std::ifstream infile(path, std::ios::binary);
+
+    //If file does not exist we just return
+    if (!infile.good()) return false;
+
+    infile.seekg(0, std::ios::end);
+    const uint64_t length = (uint64_t)infile.tellg();
+    infile.seekg(0, std::ios::beg);
+
+    FlashFileHeader ffh;
+    CheckedMemset(&ffh, 0, sizeof(ffh));
+    infile.read((char*)&ffh, sizeof(ffh));
+
+    if (
+        //=> We are not checking against the version as this is set to the FruityMesh version which is allowed to change
+           !infile.good()
+        || ffh.sizeOfHeader  != sizeof(ffh)
+        || ffh.flashSize     != flashSize
+        || ffh.amountOfNodes != amountOfNodes
+        || length            != sizeof(ffh) + (uint64_t)flashSize * amountOfNodes
+        )
+    {
+        //Probably the correct action if this happens is to just remove the flash safe file (see simConfig.storeFlashToFile)
+        //This is NOT automatically performed here as it would be rather rude to just remove it in case the user accidentally
+        //launched a different version of CherrySim or another config.
+        SIMEXCEPTION(CorruptOrOutdatedSavefile);
+        return false;
+    }
+
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        infile.read((char*)getFlash(i), flashSize);
+    }
+
+    //The version of the file is updated with the next store, all pages match the file until then
+    fileMatchesHeader = ffh.version == version;
+    ClearDirtyPages();
+    return true;
+}
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <FmTypes.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct FlashFileHeader
+{
+    u32 version;
+    u32 sizeOfHeader;
+    u32 flashSize;
+    u32 amountOfNodes;
+};
+
+/*
+ * Keeps the flash of all simulated nodes persisted in a file (see simConfig.storeFlashToFile).
+ *
+ * The file holds a FlashFileHeader followed by the flash image of every node. Instead of
+ * rewriting the whole file, only the pages that were marked dirty since the last store are
+ * written. The first store after the simulation was started writes the complete file.
+ *
+ * Stores are crash consistent: The dirty pages are first written to a journal next to the
+ * file (path + ".journal") that is terminated by a commit marker and a checksum. Only after
+ * the journal is complete, the pages are written to the file and the journal is removed.
+ * Loading applies a complete journal that was left behind and discards an incomplete one,
+ * so the file always contains the state of one of the stores.
+ */
+class SimFlashStore
+{
+public:
+    //Granularity of the dirty tracking, which is the smallest code page size of all supported chipsets
+    static constexpr u32 PAGE_SIZE = 1024;
+
+    using FlashGetter = std::function<u8*(u32 nodeIndex)>;
+
+private:
+    std::string path;
+    u32 flashSize = 0;
+    u32 pagesPerNode = 0;
+    u32 amountOfNodes = 0;
+    u32 version = 0;
+    std::vector<uint64_t> dirtyPages; //One bit per page of all nodes
+    u32 amountOfDirtyPages = 0;
+    bool fileMatchesHeader = false; //False until the file is known to hold a complete image of the current nodes
+
+    FlashFileHeader CreateHeader() const;
+    bool WriteCompleteFile(const FlashGetter& getFlash);
+    void ClearDirtyPages();
+
+public:
+    //Prepares the store for the given amount of nodes, all pages are dirty afterwards
+    void Reset(const std::string& path, u32 flashSize, u32 amountOfNodes, u32 version);
+
+    void MarkDirty(u32 nodeIndex, u32 offset, u32 length);
+    void MarkNodeDirty(u32 nodeIndex);
+    bool IsPageDirty(u32 nodeIndex, u32 pageIndex) const;
+    u32 GetAmountOfDirtyPages() const;
+    std::string GetJournalPath() const;
+
+    //Writes all dirty pages and returns the amount of pages written
+    u32 Store(const FlashGetter& getFlash);
+    //Loads the flash of all nodes from the file. Returns false if there is no file, throws if it does not match the current nodes
+    bool Load(const FlashGetter& getFlash);
+
+    //The two steps of an incremental store, exposed separately so that an interrupted store can be tested
+    bool WriteJournal(const FlashGetter& getFlash);
+    bool ApplyJournal();
+};
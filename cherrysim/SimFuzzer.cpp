@@ -0,0 +1,1010 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include <SimFuzzer.h>
+#include <CherrySimTester.h>
+#include <Exceptions.h>
+#include <GlobalState.h>
+#include <StackWatcher.h>
+#include <Utility.h>
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <typeinfo>
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#ifdef SIM_FUZZING_COVERAGE
+static u8 coverageCounters[SimFuzzer::COVERAGE_MAP_SIZE];
+static u32 previousLocation = 0;
+
+//Called for every edge of the firmware, which is compiled with -fsanitize-coverage=trace-pc if
+//SIMULATOR_FUZZING_COVERAGE is set. The simulator itself is not instrumented, so it doesn't call itself.
+extern "C" void __sanitizer_cov_trace_pc()
+{
+    const u32 location = ((u32)(uintptr_t)__builtin_return_address(0) * 2654435761u) >> 16;
+    u8& counter = coverageCounters[(location ^ previousLocation) % SimFuzzer::COVERAGE_MAP_SIZE];
+    if (counter != 0xFF) counter++;
+    previousLocation = location >> 1;
+}
+#endif //SIM_FUZZING_COVERAGE
+
+static SimFuzzer* activeFuzzer = nullptr;
+
+static const MessageType interestingMessageTypes[] = {
+    MessageType::SPLIT_WRITE_CMD, MessageType::SPLIT_WRITE_CMD_END,
+    MessageType::CLUSTER_WELCOME, MessageType::CLUSTER_ACK_1, MessageType::CLUSTER_ACK_2, MessageType::CLUSTER_INFO_UPDATE, MessageType::RECONNECT,
+    MessageType::ENCRYPT_CUSTOM_START, MessageType::ENCRYPT_CUSTOM_ANONCE, MessageType::ENCRYPT_CUSTOM_SNONCE, MessageType::ENCRYPT_CUSTOM_DONE,
+    MessageType::UPDATE_TIMESTAMP, MessageType::UPDATE_CONNECTION_INTERVAL, MessageType::ASSET_LEGACY, MessageType::CAPABILITY, MessageType::ASSET_GENERIC, MessageType::SIG_MESH_SIMPLE,
+    MessageType::MODULE_CONFIG, MessageType::MODULE_TRIGGER_ACTION, MessageType::MODULE_ACTION_RESPONSE, MessageType::MODULE_GENERAL,
+    MessageType::MODULE_RAW_DATA, MessageType::MODULE_RAW_DATA_LIGHT, MessageType::COMPONENT_ACT, MessageType::COMPONENT_SENSE,
+    MessageType::TIME_SYNC, MessageType::DEAD_DATA, MessageType::DATA_1, MessageType::DATA_1_VITAL, MessageType::CLC_DATA,
+};
+
+static const ModuleId interestingModuleIds[] = {
+    ModuleId::NODE, ModuleId::BEACONING_MODULE, ModuleId::SCANNING_MODULE, ModuleId::STATUS_REPORTER_MODULE, ModuleId::DFU_MODULE,
+    ModuleId::ENROLLMENT_MODULE, ModuleId::IO_MODULE, ModuleId::DEBUG_MODULE, ModuleId::CONFIG, ModuleId::MESH_ACCESS_MODULE,
+    ModuleId::TESTING_MODULE, ModuleId::BULK_MODULE, ModuleId::ASSET_MODULE, ModuleId::VENDOR_MODULE_ID_PREFIX,
+};
+
+static const u8 interestingBytes[] = { 0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF };
+
+bool SimFuzzer::Step::operator==(const Step& other) const
+{
+    return type == other.type
+        && target == other.target
+        && sleepSteps == other.sleepSteps
+        && templateIndex == other.templateIndex
+        && choices == other.choices
+        && packet == other.packet;
+}
+
+std::vector<std::type_index> SimFuzzer::GetDefaultIgnoredExceptions()
+{
+    return {
+        //Same as for the TestMonkey, these happen for valid commands with unlucky parameters
+        std::type_index(typeid(ErrorCodeUnknownException)),
+        std::type_index(typeid(RecordStorageIsLockedDownException)),
+        std::type_index(typeid(WrongCommandParameterException)),
+        std::type_index(typeid(InternalTerminalCommandErrorException)),
+        //Injected packets are checked by the firmware before they are dispatched
+        std::type_index(typeid(IllegalFruityMeshPacketException)),
+    };
+}
+
+SimFuzzer::SimFuzzer(const Config& config)
+    : config(config), random(config.seed)
+{
+    for (const std::string& commandTemplate : config.templates)
+    {
+        parsedTemplates.push_back(ParseTemplate(commandTemplate));
+    }
+    if (this->config.amountOfNodes == 0)
+    {
+        SIMEXCEPTIONFORCE(IllegalArgumentException);
+    }
+}
+
+SimFuzzer::~SimFuzzer()
+{
+    if (watchdog.joinable())
+    {
+        stopWatchdog = true;
+        watchdog.join();
+    }
+}
+
+std::vector<SimFuzzer::TemplateSegment> SimFuzzer::ParseTemplate(const std::string& commandTemplate)
+{
+    static const std::string serialPlaceholder = "%%%SERIAL%%%";
+    std::vector<TemplateSegment> segments;
+    size_t position = 0;
+    while (true)
+    {
+        const size_t rangeStart = commandTemplate.find("[[[", position);
+        const size_t optionStart = commandTemplate.find("{{{", position);
+        const size_t serialStart = commandTemplate.find(serialPlaceholder, position);
+        const size_t start = std::min({ rangeStart, optionStart, serialStart });
+
+        TemplateSegment segment;
+        if (start == std::string::npos)
+        {
+            segment.text = commandTemplate.substr(position);
+            segments.push_back(segment);
+            return segments;
+        }
+        segment.text = commandTemplate.substr(position, start - position);
+
+        if (start == serialStart)
+        {
+            segment.placeholder.type = PlaceholderType::SERIAL;
+            position = start + serialPlaceholder.size();
+        }
+        else
+        {
+            const bool isRange = start == rangeStart;
+            const size_t end = commandTemplate.find(isRange ? "]]]" : "}}}", start);
+            if (end == std::string::npos)
+            {
+                printf("Placeholder is not closed in template \"%s\"" EOL, commandTemplate.c_str());
+                SIMEXCEPTIONFORCE(IllegalArgumentException);
+            }
+            const std::string content = commandTemplate.substr(start + 3, end - start - 3);
+            if (isRange)
+            {
+                const size_t dash = content.find('-');
+                segment.placeholder.type = PlaceholderType::RANGE;
+                segment.placeholder.min = (u32)strtoul(content.substr(0, dash).c_str(), nullptr, 10);
+                segment.placeholder.max = dash == std::string::npos ? 0 : (u32)strtoul(content.substr(dash + 1).c_str(), nullptr, 10);
+                if (dash == std::string::npos || segment.placeholder.max < segment.placeholder.min)
+                {
+                    printf("Range must be given as [[[min-max]]] in template \"%s\"" EOL, commandTemplate.c_str());
+                    SIMEXCEPTIONFORCE(IllegalArgumentException);
+                }
+            }
+            else
+            {
+                segment.placeholder.type = PlaceholderType::OPTION;
+                std::stringstream options(content);
+                std::string option;
+                while (std::getline(options, option, '|'))
+                {
+                    segment.placeholder.options.push_back(option);
+                }
+                if (segment.placeholder.options.size() < 2)
+                {
+                    printf("Options must be separated by | in template \"%s\"" EOL, commandTemplate.c_str());
+                    SIMEXCEPTIONFORCE(IllegalArgumentException);
+                }
+            }
+            position = end + 3;
+        }
+        segments.push_back(segment);
+    }
+}
+
+u32 SimFuzzer::GetAmountOfOptions(const Placeholder& placeholder) const
+{
+    switch (placeholder.type)
+    {
+    case PlaceholderType::RANGE:
+        //A range over all u32 values has one more option than can be counted, the last one is never chosen
+        return std::max(placeholder.max - placeholder.min + 1, 1u);
+    case PlaceholderType::OPTION:
+        return (u32)placeholder.options.size();
+    case PlaceholderType::SERIAL:
+        return std::max((u32)config.serialNumbers.size(), 1u);
+    default:
+        return 1;
+    }
+}
+
+u32 SimFuzzer::GetAmountOfPlaceholders(u32 templateIndex) const
+{
+    //The last segment never has a placeholder
+    return (u32)parsedTemplates[templateIndex].size() - 1;
+}
+
+std::string SimFuzzer::ExpandCommand(const Step& step) const
+{
+    if (step.type != StepType::COMMAND || step.templateIndex >= parsedTemplates.size()) return "";
+
+    std::string command;
+    u32 placeholderIndex = 0;
+    for (const TemplateSegment& segment : parsedTemplates[step.templateIndex])
+    {
+        command += segment.text;
+        const Placeholder& placeholder = segment.placeholder;
+        if (placeholder.type == PlaceholderType::NONE) continue;
+
+        const u32 choice = placeholderIndex < step.choices.size() ? step.choices[placeholderIndex] : 0;
+        const u32 value = choice % GetAmountOfOptions(placeholder);
+        placeholderIndex++;
+
+        if (placeholder.type == PlaceholderType::RANGE) command += std::to_string(placeholder.min + value);
+        else if (placeholder.type == PlaceholderType::OPTION) command += placeholder.options[value];
+        else if (!config.serialNumbers.empty()) command += config.serialNumbers[value];
+    }
+    return command;
+}
+
+//################################## Generation and Mutation ###############################
+
+SimFuzzer::Step SimFuzzer::GenerateStep()
+{
+    Step step;
+    if (parsedTemplates.empty() || random.NextU32(0, 99) < config.packetProbabilityPercent)
+    {
+        step.type = StepType::PACKET;
+        step.target = random.NextU32(0, config.amountOfNodes - 1);
+        GeneratePacket(step);
+    }
+    else
+    {
+        step.type = StepType::COMMAND;
+        step.target = random.NextU32(0, config.amountOfNodes);
+        step.templateIndex = random.NextU32(0, (u32)parsedTemplates.size() - 1);
+        step.choices.resize(GetAmountOfPlaceholders(step.templateIndex));
+        for (u32& choice : step.choices) choice = random.NextU32();
+    }
+    //Mostly one step so that the steps interleave with what the mesh does, sometimes time for timeouts to happen
+    step.sleepSteps = random.NextPsrng(UINT32_MAX / 4) ? random.NextU32(2, 100) : 1;
+    return step;
+}
+
+void SimFuzzer::GeneratePacket(Step& step)
+{
+    const MessageType messageType = random.NextPsrng(UINT32_MAX / 8)
+        ? (MessageType)random.NextU32(0, 0xFF)
+        : interestingMessageTypes[random.NextU32(0, sizeof(interestingMessageTypes) / sizeof(interestingMessageTypes[0]) - 1)];
+
+    //Mostly sent from one node of the mesh to the receiving node or to everyone
+    const u32 sender = random.NextPsrng(UINT32_MAX / 8) ? random.NextU32(0, 0xFFFF) : random.NextU32(1, config.amountOfNodes);
+    const u32 receiverKind = random.NextU32(0, 3);
+    const u32 receiver = receiverKind == 0 ? NODE_ID_BROADCAST : (receiverKind == 1 ? random.NextU32(0, 0xFFFF) : step.target + 1);
+
+    std::vector<u8>& packet = step.packet;
+    packet.clear();
+    packet.push_back((u8)messageType);
+    packet.push_back((u8)(sender & 0xFF));
+    packet.push_back((u8)(sender >> 8));
+    packet.push_back((u8)(receiver & 0xFF));
+    packet.push_back((u8)(receiver >> 8));
+
+    if (messageType >= MessageType::MODULE_MESSAGES_START && messageType <= MessageType::MODULE_MESSAGES_END)
+    {
+        packet.push_back((u8)interestingModuleIds[random.NextU32(0, sizeof(interestingModuleIds) / sizeof(interestingModuleIds[0]) - 1)]);
+        packet.push_back((u8)random.NextU32(0, 0xFF)); //requestHandle
+        packet.push_back((u8)random.NextU32(0, 20)); //actionType
+    }
+
+    const u32 payloadLength = random.NextU32(0, 24);
+    for (u32 i = 0; i < payloadLength; i++)
+    {
+        packet.push_back(random.NextPsrng(UINT32_MAX / 4) ? interestingBytes[random.NextU32(0, sizeof(interestingBytes) - 1)] : (u8)random.NextU32(0, 0xFF));
+    }
+}
+
+void SimFuzzer::MutatePacket(std::vector<u8>& packet)
+{
+    switch (random.NextU32(0, 5))
+    {
+    case 0: //Flip a bit
+        if (!packet.empty()) packet[random.NextU32(0, (u32)packet.size() - 1)] ^= (u8)(1 << random.NextU32(0, 7));
+        break;
+    case 1: //Replace a byte with a boundary value
+        if (!packet.empty()) packet[random.NextU32(0, (u32)packet.size() - 1)] = interestingBytes[random.NextU32(0, sizeof(interestingBytes) - 1)];
+        break;
+    case 2: //Insert a byte
+        if (packet.size() < MAX_PACKET_SIZE) packet.insert(packet.begin() + random.NextU32(0, (u32)packet.size()), (u8)random.NextU32(0, 0xFF));
+        break;
+    case 3: //Remove a byte
+        if (!packet.empty()) packet.erase(packet.begin() + random.NextU32(0, (u32)packet.size() - 1));
+        break;
+    case 4: //Cut the packet
+        if (!packet.empty()) packet.resize(random.NextU32(0, (u32)packet.size() - 1));
+        break;
+    default: //Change the message type
+        if (!packet.empty()) packet[0] = (u8)interestingMessageTypes[random.NextU32(0, sizeof(interestingMessageTypes) / sizeof(interestingMessageTypes[0]) - 1)];
+        break;
+    }
+}
+
+void SimFuzzer::MutateStep(Step& step)
+{
+    const u32 mutation = random.NextU32(0, 3);
+    if (mutation == 0)
+    {
+        step.target = step.type == StepType::COMMAND ? random.NextU32(0, config.amountOfNodes) : random.NextU32(0, config.amountOfNodes - 1);
+    }
+    else if (mutation == 1)
+    {
+        step.sleepSteps = random.NextPsrng(UINT32_MAX / 2) ? 1 : random.NextU32(2, 100);
+    }
+    else if (step.type == StepType::PACKET)
+    {
+        MutatePacket(step.packet);
+    }
+    else if (step.choices.empty() || (mutation == 2 && random.NextPsrng(UINT32_MAX / 4)))
+    {
+        //Same node and time, but a different command
+        step.templateIndex = random.NextU32(0, (u32)parsedTemplates.size() - 1);
+        step.choices.resize(GetAmountOfPlaceholders(step.templateIndex));
+        for (u32& choice : step.choices) choice = random.NextU32();
+    }
+    else
+    {
+        //Change one value, the neighbouring values and the boundaries of ranges are the most interesting ones
+        u32& choice = step.choices[random.NextU32(0, (u32)step.choices.size() - 1)];
+        switch (random.NextU32(0, 3))
+        {
+        case 0: choice++; break;
+        case 1: choice--; break;
+        case 2: choice = 0; break;
+        default: choice = random.NextU32(); break;
+        }
+    }
+}
+
+SimFuzzer::Input SimFuzzer::GenerateInput()
+{
+    Input input;
+    const u32 amountOfSteps = random.NextU32(1, std::min(config.maxSteps, 8u));
+    for (u32 i = 0; i < amountOfSteps; i++)
+    {
+        input.push_back(GenerateStep());
+    }
+    return input;
+}
+
+SimFuzzer::Input SimFuzzer::Mutate(const Input& input)
+{
+    Input result = input;
+    const u32 amountOfMutations = random.NextU32(1, 4);
+    for (u32 i = 0; i < amountOfMutations; i++)
+    {
+        const u32 size = (u32)result.size();
+        switch (random.NextU32(0, 5))
+        {
+        case 0: //Insert a new step
+            if (size < config.maxSteps) result.insert(result.begin() + random.NextU32(0, size), GenerateStep());
+            break;
+        case 1: //Remove a step
+            if (size > 1) result.erase(result.begin() + random.NextU32(0, size - 1));
+            break;
+        case 2: //Repeat a step
+            if (size > 0 && size < config.maxSteps)
+            {
+                const Step step = result[random.NextU32(0, size - 1)];
+                result.insert(result.begin() + random.NextU32(0, size), step);
+            }
+            break;
+        case 3: //Swap two steps
+            if (size > 1) std::swap(result[random.NextU32(0, size - 1)], result[random.NextU32(0, size - 1)]);
+            break;
+        case 4: //Continue with the end of another input of the corpus
+            if (size > 0 && !corpus.empty())
+            {
+                const Input& other = corpus[random.NextU32(0, (u32)corpus.size() - 1)].input;
+                result.resize(random.NextU32(1, size));
+                const u32 otherStart = random.NextU32(0, (u32)other.size() - 1);
+                for (u32 k = otherStart; k < other.size() && result.size() < config.maxSteps; k++)
+                {
+                    result.push_back(other[k]);
+                }
+            }
+            break;
+        default: //Change a step
+            if (size > 0) MutateStep(result[random.NextU32(0, size - 1)]);
+            break;
+        }
+    }
+    if (result.empty()) result.push_back(GenerateStep());
+    return result;
+}
+
+//################################## Execution #############################################
+
+int64_t SimFuzzer::GetTimeMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SimFuzzer::ExecuteStep(CherrySimTester& tester, const Step& step)
+{
+    if (step.type == StepType::COMMAND)
+    {
+        const std::string command = ExpandCommand(step);
+        tester.SendTerminalCommand(step.target % (config.amountOfNodes + 1), "%s", command.c_str());
+    }
+    else
+    {
+        //Copied into a zeroed buffer so that the firmware can read a complete header even from shorter packets
+        uint64_t buffer[MAX_PACKET_SIZE / sizeof(uint64_t) + 1] = {};
+        const u16 length = (u16)std::min((u32)step.packet.size(), MAX_PACKET_SIZE);
+        if (length > 0) CheckedMemcpy(buffer, step.packet.data(), length);
+
+        BaseConnectionSendData sendData;
+        sendData.characteristicHandle = FruityHal::FH_BLE_INVALID_HANDLE;
+        sendData.deliveryOption = DeliveryOption::WRITE_CMD;
+        sendData.dataLength = length;
+
+        NodeIndexSetter setter(step.target % config.amountOfNodes);
+        StackBaseSetter sbs;
+        try
+        {
+            GS->cm.DispatchMeshMessage(nullptr, &sendData, (const ConnPacketHeader*)buffer, true);
+        }
+        catch (const NodeSystemResetException&)
+        {
+            //The packet made the node reboot, the simulation loop handles this the same way
+        }
+    }
+    tester.SimulateGivenNumberOfSteps((int)step.sleepSteps);
+}
+
+void SimFuzzer::CollectLogFeatures(std::string& log, std::vector<u32>& features)
+{
+    //A FNV-1a hash over each line without its digits, so that the same message with other values is the same feature
+    u32 hash = 2166136261u;
+    bool lineHasContent = false;
+    for (const char c : log)
+    {
+        if (c == '\n')
+        {
+            if (lineHasContent) features.push_back(0x80000000u | (hash & 0x7FFFFFFFu));
+            hash = 2166136261u;
+            lineHasContent = false;
+        }
+        else if (c < '0' || c > '9')
+        {
+            hash = (hash ^ (u8)c) * 16777619u;
+            lineHasContent = true;
+        }
+    }
+    if (lineHasContent) features.push_back(0x80000000u | (hash & 0x7FFFFFFFu));
+    log.clear();
+}
+
+void SimFuzzer::CollectEdgeFeatures(std::vector<u32>& features)
+{
+#ifdef SIM_FUZZING_COVERAGE
+    for (u32 i = 0; i < COVERAGE_MAP_SIZE; i++)
+    {
+        const u8 count = coverageCounters[i];
+        if (count == 0) continue;
+        //Bucketed like AFL, so that a loop that runs a few more times is a new feature but not every single iteration
+        u32 bucket = 7;
+        if (count == 1) bucket = 0;
+        else if (count == 2) bucket = 1;
+        else if (count == 3) bucket = 2;
+        else if (count < 8) bucket = 3;
+        else if (count < 16) bucket = 4;
+        else if (count < 32) bucket = 5;
+        else if (count < 128) bucket = 6;
+        features.push_back(i * 8 + bucket);
+    }
+#endif //SIM_FUZZING_COVERAGE
+}
+
+std::string SimFuzzer::DescribeStep(const Step* step) const
+{
+    if (step == nullptr) return "boot or recovery";
+    if (step->type == StepType::PACKET)
+    {
+        return "packet of type " + std::to_string(step->packet.empty() ? 0 : step->packet[0]);
+    }
+    return "command " + config.templates[step->templateIndex];
+}
+
+SimFuzzer::Execution SimFuzzer::Execute(const Input& input)
+{
+    Execution execution;
+#ifdef SIM_FUZZING_COVERAGE
+    CheckedMemset(coverageCounters, 0, sizeof(coverageCounters));
+    previousLocation = 0;
+#endif //SIM_FUZZING_COVERAGE
+
+    currentInputText = Serialize(input);
+    const int64_t startMs = GetTimeMs();
+    executionStartMs = startMs;
+    executionRunning = true;
+
+    const Step* currentStep = nullptr;
+    const Step* slowestStep = nullptr;
+    int64_t slowestStepMs = -1;
+    try
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.seed = config.seed;
+        simConfig.terminalId = 0;
+        simConfig.verboseCommands = false;
+        simConfig.useLogAccumulator = true;
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+        if (config.amountOfNodes > 1) simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", config.amountOfNodes - 1 });
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+        CollectLogFeatures(tester.sim->logAccumulator, execution.features);
+
+        for (const Step& step : input)
+        {
+            currentStep = &step;
+            const int64_t stepStartMs = GetTimeMs();
+            ExecuteStep(tester, step);
+            CollectLogFeatures(tester.sim->logAccumulator, execution.features);
+            if (GetTimeMs() - stepStartMs > slowestStepMs)
+            {
+                slowestStepMs = GetTimeMs() - stepStartMs;
+                slowestStep = &step;
+            }
+        }
+        currentStep = nullptr;
+
+        tester.SimulateForGivenTime((int)config.recoveryTimeMs);
+        CollectLogFeatures(tester.sim->logAccumulator, execution.features);
+    }
+    catch (const std::exception& e)
+    {
+        execution.outcome = Outcome::CRASH;
+        execution.signature = std::string(typeid(e).name()) + " in " + DescribeStep(currentStep);
+    }
+    catch (...)
+    {
+        execution.outcome = Outcome::CRASH;
+        execution.signature = "unknown exception in " + DescribeStep(currentStep);
+    }
+    executionRunning = false;
+
+    if (execution.outcome == Outcome::OK && GetTimeMs() - startMs > config.hangTimeoutMs)
+    {
+        execution.outcome = Outcome::HANG;
+        execution.signature = "hang in " + DescribeStep(slowestStep);
+    }
+
+    CollectEdgeFeatures(execution.features);
+    std::sort(execution.features.begin(), execution.features.end());
+    execution.features.erase(std::unique(execution.features.begin(), execution.features.end()), execution.features.end());
+
+    statistics.executions++;
+    return execution;
+}
+
+//################################## Corpus and Findings ###################################
+
+bool SimFuzzer::AddToCorpus(const Input& input, const Execution& execution)
+{
+    u32 amountOfNewFeatures = 0;
+    for (const u32 feature : execution.features)
+    {
+        if (seenFeatures.insert(feature).second) amountOfNewFeatures++;
+    }
+    if (amountOfNewFeatures == 0) return false;
+
+    corpus.push_back({ input, execution.features });
+    return true;
+}
+
+void SimFuzzer::HandleFinding(const Input& input, const Execution& execution)
+{
+    //Only the first input of each signature is kept, everything else is most likely the same bug
+    if (!seenSignatures.insert(execution.signature).second) return;
+
+    Finding finding;
+    finding.outcome = execution.outcome;
+    finding.signature = execution.signature;
+    finding.input = input;
+    //Hangs are not minimized as every try would take at least the hang timeout
+    if (execution.outcome == Outcome::CRASH)
+    {
+        finding.input = MinimizeInput(input, [&](const Input& candidate) {
+            const Execution result = Execute(candidate);
+            return result.outcome == Outcome::CRASH && result.signature == execution.signature;
+        }, config.maxMinimizationExecutions);
+        statistics.crashes++;
+    }
+    else
+    {
+        statistics.hangs++;
+    }
+    findings.push_back(finding);
+
+    const char* kind = execution.outcome == Outcome::CRASH ? "crash" : "hang";
+    char fileName[64];
+    snprintf(fileName, sizeof(fileName), "%s-%08X.txt", kind, Utility::CalculateCrc32String(execution.signature.c_str()));
+    printf("Found %s: %s (%u steps)" EOL, kind, execution.signature.c_str(), (u32)finding.input.size());
+    WriteFile(fileName, "# " + execution.signature + "\n" + Serialize(finding.input));
+}
+
+void SimFuzzer::WriteFile(const std::string& name, const std::string& content) const
+{
+    if (config.outputPrefix.empty()) return;
+    std::ofstream file(config.outputPrefix + name, std::ios::binary | std::ios::trunc);
+    file << content;
+}
+
+bool SimFuzzer::LoadCorpus(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::stringstream content;
+    content << file.rdbuf();
+    for (Input& input : Deserialize(content.str()))
+    {
+        corpus.push_back({ std::move(input), {} });
+    }
+    return true;
+}
+
+void SimFuzzer::SaveCorpus(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    for (const CorpusEntry& entry : corpus)
+    {
+        file << Serialize(entry.input);
+    }
+}
+
+void SimFuzzer::MinimizeCorpus()
+{
+    std::vector<std::vector<u32>> featuresOfInputs;
+    for (const CorpusEntry& entry : corpus)
+    {
+        featuresOfInputs.push_back(entry.features);
+    }
+    std::vector<CorpusEntry> minimized;
+    for (const u32 index : SelectCorpus(featuresOfInputs))
+    {
+        minimized.push_back(std::move(corpus[index]));
+    }
+    corpus = std::move(minimized);
+}
+
+std::vector<u32> SimFuzzer::SelectCorpus(const std::vector<std::vector<u32>>& featuresOfInputs)
+{
+    //Inputs with many features first, each input is kept if it covers a feature that no kept input covers
+    std::vector<u32> order(featuresOfInputs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+        return featuresOfInputs[a].size() > featuresOfInputs[b].size();
+    });
+
+    std::unordered_set<u32> covered;
+    std::vector<u32> selected;
+    for (const u32 index : order)
+    {
+        bool addsFeature = false;
+        for (const u32 feature : featuresOfInputs[index])
+        {
+            if (covered.insert(feature).second) addsFeature = true;
+        }
+        if (addsFeature) selected.push_back(index);
+    }
+    std::sort(selected.begin(), selected.end());
+    return selected;
+}
+
+SimFuzzer::Input SimFuzzer::MinimizeInput(const Input& input, const std::function<bool(const Input&)>& stillFails, u32 maxExecutions)
+{
+    Input current = input;
+    u32 executions = 0;
+    auto tryCandidate = [&](const Input& candidate) {
+        if (executions >= maxExecutions) return false;
+        executions++;
+        if (!stillFails(candidate)) return false;
+        current = candidate;
+        return true;
+    };
+
+    //Remove chunks of steps, starting with big ones
+    for (size_t chunkSize = std::max<size_t>(current.size() / 2, 1); !current.empty(); chunkSize /= 2)
+    {
+        for (size_t start = 0; start + chunkSize <= current.size();)
+        {
+            Input candidate = current;
+            candidate.erase(candidate.begin() + start, candidate.begin() + start + chunkSize);
+            if (!tryCandidate(candidate)) start += chunkSize;
+        }
+        if (chunkSize == 1) break;
+    }
+
+    //Some steps are only needed for the time that passes after them (see TestMonkey ReduceCommandVector)
+    for (size_t i = 1; i < current.size();)
+    {
+        Input candidate = current;
+        candidate[i - 1].sleepSteps += candidate[i].sleepSteps;
+        candidate.erase(candidate.begin() + i);
+        if (!tryCandidate(candidate)) i++;
+    }
+
+    //Simplify the remaining steps
+    for (size_t i = 0; i < current.size(); i++)
+    {
+        for (size_t k = 0; k < current[i].choices.size(); k++)
+        {
+            if (current[i].choices[k] == 0) continue;
+            Input candidate = current;
+            candidate[i].choices[k] = 0;
+            tryCandidate(candidate);
+        }
+        while (current[i].packet.size() > 0)
+        {
+            Input candidate = current;
+            candidate[i].packet.pop_back();
+            if (!tryCandidate(candidate)) break;
+        }
+        if (current[i].sleepSteps > 1)
+        {
+            Input candidate = current;
+            candidate[i].sleepSteps = 1;
+            tryCandidate(candidate);
+        }
+    }
+    return current;
+}
+
+//################################## Serialization #########################################
+
+std::string SimFuzzer::Serialize(const Input& input) const
+{
+    std::string text;
+    for (const Step& step : input)
+    {
+        const std::string prefix = std::to_string(step.target) + " " + std::to_string(step.sleepSteps) + " ";
+        if (step.type == StepType::COMMAND)
+        {
+            if (step.templateIndex >= config.templates.size()) continue;
+            std::string choices;
+            for (const u32 choice : step.choices)
+            {
+                choices += (choices.empty() ? "" : ",") + std::to_string(choice);
+            }
+            text += "# " + ExpandCommand(step) + "\n";
+            text += "cmd " + prefix + (choices.empty() ? "-" : choices) + " " + config.templates[step.templateIndex] + "\n";
+        }
+        else
+        {
+            std::string hex;
+            for (const u8 byte : step.packet)
+            {
+                char digits[3];
+                snprintf(digits, sizeof(digits), "%02X", byte);
+                hex += digits;
+            }
+            text += "pkt " + prefix + (hex.empty() ? "-" : hex) + "\n";
+        }
+    }
+    text += "end\n";
+    return text;
+}
+
+std::vector<SimFuzzer::Input> SimFuzzer::Deserialize(const std::string& text) const
+{
+    std::vector<Input> inputs;
+    Input input;
+    std::stringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        if (line == "end")
+        {
+            inputs.push_back(input);
+            input.clear();
+            continue;
+        }
+
+        std::stringstream tokens(line);
+        std::string kind, values;
+        Step step;
+        tokens >> kind >> step.target >> step.sleepSteps >> values;
+        if (!tokens || (kind != "cmd" && kind != "pkt"))
+        {
+            printf("Ignoring malformed fuzzer input line \"%s\"" EOL, line.c_str());
+            continue;
+        }
+
+        if (kind == "cmd")
+        {
+            std::string commandTemplate;
+            std::getline(tokens, commandTemplate);
+            commandTemplate.erase(0, commandTemplate.find_first_not_of(' '));
+            const auto templateEntry = std::find(config.templates.begin(), config.templates.end(), commandTemplate);
+            if (templateEntry == config.templates.end())
+            {
+                printf("Ignoring command with unknown template \"%s\"" EOL, commandTemplate.c_str());
+                continue;
+            }
+            step.type = StepType::COMMAND;
+            step.templateIndex = (u32)(templateEntry - config.templates.begin());
+            if (values != "-")
+            {
+                std::stringstream choices(values);
+                std::string choice;
+                while (std::getline(choices, choice, ','))
+                {
+                    step.choices.push_back((u32)strtoul(choice.c_str(), nullptr, 10));
+                }
+            }
+        }
+        else
+        {
+            step.type = StepType::PACKET;
+            if (values != "-")
+            {
+                for (size_t i = 0; i + 1 < values.size() && step.packet.size() < MAX_PACKET_SIZE; i += 2)
+                {
+                    step.packet.push_back((u8)strtoul(values.substr(i, 2).c_str(), nullptr, 16));
+                }
+            }
+        }
+        input.push_back(step);
+    }
+    if (!input.empty()) inputs.push_back(input);
+    return inputs;
+}
+
+//################################## Fuzzing Loop ##########################################
+
+void SimFuzzer::PrintStatus()
+{
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    statistics.seconds = seconds;
+    statistics.executionsPerSecond = seconds > 0 ? statistics.executions / seconds : 0;
+    statistics.corpusSize = (u32)corpus.size();
+    statistics.features = (u32)seenFeatures.size();
+    printf("#%llu features: %u corpus: %u crashes: %u hangs: %u exec/s: %.1f" EOL,
+        (unsigned long long)statistics.executions, statistics.features, statistics.corpusSize, statistics.crashes, statistics.hangs, statistics.executionsPerSecond);
+    lastStatusTime = std::chrono::steady_clock::now();
+}
+
+void SimFuzzer::RunWatchdog()
+{
+    while (!stopWatchdog)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (executionRunning && GetTimeMs() - executionStartMs > config.hardHangTimeoutMs)
+        {
+            //The simulation can't be interrupted, so the input is saved and the process is ended
+            printf("Execution did not finish within %u ms" EOL, config.hardHangTimeoutMs);
+            WriteFile("hang-unfinished.txt", currentInputText);
+            std::_Exit(2);
+        }
+    }
+}
+
+void SimFuzzer::HandleFatalSignal(int signal)
+{
+    if (activeFuzzer != nullptr && activeFuzzer->executionRunning)
+    {
+        activeFuzzer->WriteFile("crash-signal-" + std::to_string(signal) + ".txt", activeFuzzer->currentInputText);
+    }
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+
+void SimFuzzer::HandleSanitizerDeath()
+{
+    if (activeFuzzer != nullptr && activeFuzzer->executionRunning)
+    {
+        activeFuzzer->WriteFile("crash-sanitizer.txt", activeFuzzer->currentInputText);
+    }
+}
+
+SimFuzzer::Statistics SimFuzzer::Run()
+{
+    Exceptions::DisableDebugBreakOnException disableDebugBreak;
+    for (const std::type_index& exception : config.ignoredExceptions)
+    {
+        Exceptions::DisableExceptionByIndex(exception);
+    }
+
+    activeFuzzer = this;
+    const int fatalSignals[] = { SIGSEGV, SIGFPE, SIGILL, SIGABRT };
+    for (const int fatalSignal : fatalSignals)
+    {
+        std::signal(fatalSignal, &SimFuzzer::HandleFatalSignal);
+    }
+#if defined(__SANITIZE_ADDRESS__)
+    __sanitizer_set_death_callback(&SimFuzzer::HandleSanitizerDeath);
+#endif
+    stopWatchdog = false;
+    watchdog = std::thread(&SimFuzzer::RunWatchdog, this);
+
+    startTime = std::chrono::steady_clock::now();
+    lastStatusTime = startTime;
+    auto limitReached = [&]() {
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        return (config.maxExecutions != 0 && statistics.executions >= config.maxExecutions)
+            || (config.maxSeconds != 0 && seconds >= config.maxSeconds);
+    };
+    auto runInput = [&](const Input& input) {
+        const Execution execution = Execute(input);
+        if (execution.outcome != Outcome::OK) HandleFinding(input, execution);
+        else AddToCorpus(input, execution);
+
+        if (config.statusIntervalSeconds != 0
+            && std::chrono::steady_clock::now() - lastStatusTime >= std::chrono::seconds(config.statusIntervalSeconds))
+        {
+            PrintStatus();
+        }
+    };
+
+    //A loaded corpus is executed again as its features depend on the build. Without one,
+    //every template is executed once with the first value of each placeholder.
+    std::vector<Input> seeds;
+    for (const CorpusEntry& entry : corpus)
+    {
+        seeds.push_back(entry.input);
+    }
+    corpus.clear();
+    if (seeds.empty())
+    {
+        for (u32 i = 0; i < parsedTemplates.size(); i++)
+        {
+            Step step;
+            step.templateIndex = i;
+            step.choices.resize(GetAmountOfPlaceholders(i));
+            seeds.push_back({ step });
+        }
+    }
+    for (const Input& seed : seeds)
+    {
+        if (limitReached()) break;
+        runInput(seed);
+    }
+
+    while (!limitReached())
+    {
+        //Mostly mutations of the corpus, but also new inputs so that the fuzzer can't get stuck
+        if (corpus.empty() || random.NextPsrng(UINT32_MAX / 10)) runInput(GenerateInput());
+        else runInput(Mutate(corpus[random.NextU32(0, (u32)corpus.size() - 1)].input));
+    }
+
+    stopWatchdog = true;
+    watchdog.join();
+#if defined(__SANITIZE_ADDRESS__)
+    __sanitizer_set_death_callback(nullptr);
+#endif
+    for (const int fatalSignal : fatalSignals)
+    {
+        std::signal(fatalSignal, SIG_DFL);
+    }
+    activeFuzzer = nullptr;
+    for (const std::type_index& exception : config.ignoredExceptions)
+    {
+        Exceptions::EnableExceptionByIndex(exception);
+    }
+
+    PrintStatus();
+    if (!config.outputPrefix.empty()) SaveCorpus(config.outputPrefix + "corpus.txt");
+    return statistics;
+}
+
+const std::vector<SimFuzzer::Finding>& SimFuzzer::GetFindings() const
+{
+    return findings;
+}
+
+u32 SimFuzzer::GetCorpusSize() const
+{
+    return (u32)corpus.size();
+}
+
+const SimFuzzer::Statistics& SimFuzzer::GetStatistics() const
+{
+    return statistics;
+}
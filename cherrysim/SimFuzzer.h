@@ -0,0 +1,243 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <FmTypes.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <typeindex>
+#include <unordered_set>
+#include <vector>
+#include <MersenneTwister.h>
+
+class CherrySimTester;
+
+/*
+ * A coverage guided fuzzer that runs the simulator in-process.
+ *
+ * An input is a list of steps. A step either sends a terminal command that is built from a
+ * command template or injects a raw mesh packet at ConnectionManager::DispatchMeshMessage of
+ * a node. Templates use the syntax of the TestMonkey: [[[a-b]]] is a number in the given range,
+ * {{{x|y}}} is one of the given options and %%%SERIAL%%% is one of the configured serial numbers.
+ * Instead of the filled in command, a step stores one value per placeholder, so that mutations
+ * can change single values and an input stays valid when it is mutated.
+ *
+ * Every input is executed in a new simulation with the same seed, which makes executions
+ * reproducible. The features of an execution are:
+ *  - Every distinct kind of log line, which is the line without its digits.
+ *  - If the simulator was built with SIMULATOR_FUZZING_COVERAGE, every edge of the firmware
+ *    that was executed, bucketed by the number of executions like AFL does.
+ * Inputs that produce a feature that no input produced before are added to the corpus.
+ *
+ * Exceptions that escape the simulation are crashes, executions that take longer than the
+ * hang timeout are hangs. Findings are deduplicated by a signature of the exception type and
+ * the last step, minimized and written to a file (see Config::outputPrefix). Crashes that can't
+ * be caught (signals, sanitizer reports) and executions that never return write the current
+ * input to a file before the process ends.
+ */
+class SimFuzzer
+{
+public:
+    static constexpr u32 COVERAGE_MAP_SIZE = 1 << 16;
+    static constexpr u32 MAX_PACKET_SIZE = 200;
+
+    enum class StepType : u8
+    {
+        COMMAND,
+        PACKET,
+    };
+
+    struct Step
+    {
+        StepType type = StepType::COMMAND;
+        u32 target = 0; //Terminal of the node that receives the command (0 for all nodes) or index of the node that receives the packet
+        u32 sleepSteps = 1; //Simulation steps after the step was executed
+        u32 templateIndex = 0;
+        std::vector<u32> choices; //One value per placeholder of the template, taken modulo the amount of options of the placeholder
+        std::vector<u8> packet;
+
+        bool operator==(const Step& other) const;
+    };
+    using Input = std::vector<Step>;
+
+    enum class Outcome : u8
+    {
+        OK,
+        CRASH,
+        HANG,
+    };
+
+    struct Execution
+    {
+        Outcome outcome = Outcome::OK;
+        std::string signature;
+        std::vector<u32> features;
+    };
+
+    struct Finding
+    {
+        Outcome outcome = Outcome::CRASH;
+        std::string signature;
+        Input input; //Minimized for crashes
+    };
+
+    static std::vector<std::type_index> GetDefaultIgnoredExceptions();
+
+    struct Config
+    {
+        std::vector<std::string> templates;
+        std::vector<std::string> serialNumbers = { "BBBBB", "BBBBC", "BBBBD" };
+        u32 amountOfNodes = 3; //One sink, the rest are mesh nodes
+        u32 seed = 1;
+        u32 maxSteps = 32; //Maximum amount of steps of an input
+        u32 packetProbabilityPercent = 30; //How many of the generated steps inject a packet instead of sending a command
+        u32 recoveryTimeMs = 10 * 1000; //Simulated after the last step, so that late effects of the input are executed as well
+        u32 hangTimeoutMs = 10 * 1000; //Wall clock time after which an execution is a hang
+        u32 hardHangTimeoutMs = 60 * 1000; //Wall clock time after which a still running execution is written to a file and the process is ended
+        uint64_t maxExecutions = 0; //0 for no limit
+        u32 maxSeconds = 0; //0 for no limit
+        u32 maxMinimizationExecutions = 200; //Per finding
+        u32 statusIntervalSeconds = 10; //Interval of the status line, 0 to disable it
+        std::string outputPrefix = ""; //Prefix of the corpus and finding files, e.g. a directory. No files are written if empty.
+        std::vector<std::type_index> ignoredExceptions = GetDefaultIgnoredExceptions(); //Exceptions that are expected for random inputs and are no crash
+    };
+
+    struct Statistics
+    {
+        uint64_t executions = 0;
+        double seconds = 0;
+        double executionsPerSecond = 0;
+        u32 corpusSize = 0;
+        u32 features = 0;
+        u32 crashes = 0;
+        u32 hangs = 0;
+    };
+
+private:
+    enum class PlaceholderType : u8
+    {
+        NONE,
+        RANGE,
+        OPTION,
+        SERIAL,
+    };
+    struct Placeholder
+    {
+        PlaceholderType type = PlaceholderType::NONE;
+        u32 min = 0;
+        u32 max = 0;
+        std::vector<std::string> options;
+    };
+    struct TemplateSegment
+    {
+        std::string text; //Literal text that is put before the placeholder
+        Placeholder placeholder;
+    };
+    struct CorpusEntry
+    {
+        Input input;
+        std::vector<u32> features;
+    };
+
+    Config config;
+    std::vector<std::vector<TemplateSegment>> parsedTemplates;
+    MersenneTwister random;
+    std::vector<CorpusEntry> corpus;
+    std::unordered_set<u32> seenFeatures;
+    std::vector<Finding> findings;
+    std::unordered_set<std::string> seenSignatures;
+    Statistics statistics;
+    std::chrono::time_point<std::chrono::steady_clock> startTime;
+    std::chrono::time_point<std::chrono::steady_clock> lastStatusTime;
+
+    std::string currentInputText; //Serialized input of the running execution, written to a file if the process ends during the execution
+    std::atomic<bool> executionRunning{ false };
+    std::atomic<int64_t> executionStartMs{ 0 };
+    std::atomic<bool> stopWatchdog{ false };
+    std::thread watchdog;
+
+    static std::vector<TemplateSegment> ParseTemplate(const std::string& commandTemplate);
+    u32 GetAmountOfOptions(const Placeholder& placeholder) const;
+    u32 GetAmountOfPlaceholders(u32 templateIndex) const;
+
+    Step GenerateStep();
+    void GeneratePacket(Step& step);
+    void MutateStep(Step& step);
+    void MutatePacket(std::vector<u8>& packet);
+
+    void ExecuteStep(CherrySimTester& tester, const Step& step);
+    static void CollectLogFeatures(std::string& log, std::vector<u32>& features);
+    static void CollectEdgeFeatures(std::vector<u32>& features);
+    std::string DescribeStep(const Step* step) const;
+
+    bool AddToCorpus(const Input& input, const Execution& execution);
+    void HandleFinding(const Input& input, const Execution& execution);
+    void WriteFile(const std::string& name, const std::string& content) const;
+    void PrintStatus();
+    void RunWatchdog();
+    static void HandleFatalSignal(int signal);
+    static void HandleSanitizerDeath();
+    static int64_t GetTimeMs();
+
+public:
+    explicit SimFuzzer(const Config& config);
+    ~SimFuzzer();
+    SimFuzzer(const SimFuzzer& other) = delete;
+    SimFuzzer& operator=(const SimFuzzer& other) = delete;
+
+    //Runs until maxExecutions or maxSeconds is reached. Starts with the loaded corpus
+    //or with one input per template if no corpus was loaded.
+    Statistics Run();
+    Execution Execute(const Input& input);
+
+    //Loads all inputs of the given file into the corpus, returns false if the file can't be read
+    bool LoadCorpus(const std::string& path);
+    void SaveCorpus(const std::string& path) const;
+    //Reduces the corpus to the inputs that are needed to keep all features
+    void MinimizeCorpus();
+
+    Input GenerateInput();
+    Input Mutate(const Input& input);
+    std::string ExpandCommand(const Step& step) const;
+    std::string Serialize(const Input& input) const;
+    std::vector<Input> Deserialize(const std::string& text) const; //Steps with a template that is not configured are dropped
+
+    //Removes steps and simplifies the remaining ones as long as stillFails returns true for the smaller input
+    static Input MinimizeInput(const Input& input, const std::function<bool(const Input&)>& stillFails, u32 maxExecutions);
+    //Greedily selects inputs so that all features are still covered, returns their indices
+    static std::vector<u32> SelectCorpus(const std::vector<std::vector<u32>>& featuresOfInputs);
+
+    const std::vector<Finding>& GetFindings() const;
+    u32 GetCorpusSize() const;
+    const Statistics& GetStatistics() const;
+};
@@ -0,0 +1,168 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include <SimMemory.h>
+#include <CherrySimTypes.h>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+    void UpdatePool(SimMemoryOccupancy& pool, u32 used, u32 firmwareHighWater, u32 capacity)
+    {
+        pool.used = used;
+        pool.capacity = capacity;
+        pool.highWater = std::max(pool.highWater, std::max(used, firmwareHighWater));
+        const u32 bucket = capacity == 0 ? 0 : std::min(used * SIM_MEMORY_HISTOGRAM_BUCKETS / capacity, SIM_MEMORY_HISTOGRAM_BUCKETS - 1);
+        pool.histogram[bucket]++;
+    }
+
+    double GetHighWaterPercent(const SimMemoryOccupancy& pool)
+    {
+        return pool.capacity > 0 ? 100.0 * pool.highWater / pool.capacity : 0.0;
+    }
+}
+
+const char* SimMemory::GetPoolName(SimMemoryPool pool)
+{
+    switch (pool)
+    {
+    case SimMemoryPool::MODULE_ALLOCATOR:        return "moduleAllocator";
+    case SimMemoryPool::CONNECTION_ALLOCATOR:    return "connectionAllocator";
+    case SimMemoryPool::QUEUE_CHUNKS:            return "queueChunks";
+    case SimMemoryPool::CONNECTION_QUEUE_CHUNKS: return "connectionQueue";
+    default:                                     return "unknown";
+    }
+}
+
+void SimMemory::Sample(NodeEntry& node)
+{
+    GlobalState& gs = node.gs;
+    SimMemoryUsage& memory = node.memory;
+
+    //The connection queues are reported by the fullest connection of the node
+    u32 queueChunks = 0;
+    u32 maxQueueChunks = 0;
+    u32 queuePackets = 0;
+    u32 maxQueuePackets = 0;
+    for (u32 i = 0; i < TOTAL_NUM_CONNECTIONS; i++)
+    {
+        const BaseConnection* conn = gs.cm.allConnections[i];
+        if (conn == nullptr) continue;
+        queueChunks = std::max(queueChunks, conn->queue.GetAmountOfChunks());
+        maxQueueChunks = std::max(maxQueueChunks, conn->queue.GetMaxAmountOfChunks());
+        queuePackets = std::max(queuePackets, conn->queue.GetAmountOfPackets());
+        maxQueuePackets = std::max(maxQueuePackets, conn->queue.GetMaxAmountOfPackets());
+    }
+
+    const u32 moduleMemoryUsed = gs.moduleAllocator.GetUsedMemorySize();
+    UpdatePool(memory.pools[(u32)SimMemoryPool::MODULE_ALLOCATOR], moduleMemoryUsed, moduleMemoryUsed, gs.moduleAllocator.GetMemorySize());
+    UpdatePool(memory.pools[(u32)SimMemoryPool::CONNECTION_ALLOCATOR],
+        gs.connectionAllocator.GetAmountOfAllocatedConnections(), gs.connectionAllocator.GetMaxAmountOfAllocatedConnections(), ConnectionAllocator::GetPoolSize());
+    UpdatePool(memory.pools[(u32)SimMemoryPool::QUEUE_CHUNKS],
+        gs.connectionQueueMemoryAllocator.GetAmountOfUsedChunks(), gs.connectionQueueMemoryAllocator.GetMaxAmountOfUsedChunks(), CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT);
+    UpdatePool(memory.pools[(u32)SimMemoryPool::CONNECTION_QUEUE_CHUNKS], queueChunks, maxQueueChunks, CONNECTION_QUEUE_MEMORY_MAX_CHUNKS_PER_CONNECTION);
+
+    memory.queuePackets = queuePackets;
+    memory.maxQueuePackets = std::max(memory.maxQueuePackets, std::max(queuePackets, maxQueuePackets));
+    memory.samples++;
+}
+
+void SimMemory::PrintNode(const NodeEntry& node)
+{
+    const SimMemoryUsage& memory = node.memory;
+    printf("Memory usage of node %d (%u samples):" EOL, node.id, memory.samples);
+    for (u32 i = 0; i < (u32)SimMemoryPool::AMOUNT; i++)
+    {
+        const SimMemoryOccupancy& pool = memory.pools[i];
+        printf("  %-20s %6u / %6u, high-water %6u (%5.1f %%)" EOL,
+            GetPoolName((SimMemoryPool)i), pool.used, pool.capacity, pool.highWater, GetHighWaterPercent(pool));
+    }
+    printf("  connectionQueue packets %u, high-water %u" EOL, memory.queuePackets, memory.maxQueuePackets);
+}
+
+void SimMemory::PrintSummary(const NodeEntry* nodes, u32 amountOfNodes, u32 topN)
+{
+    std::vector<const NodeEntry*> sortedNodes;
+    for (u32 i = 0; i < amountOfNodes; i++) sortedNodes.push_back(&nodes[i]);
+
+    for (u32 i = 0; i < (u32)SimMemoryPool::AMOUNT; i++)
+    {
+        std::array<u32, SIM_MEMORY_HISTOGRAM_BUCKETS> histogram = {};
+        for (u32 k = 0; k < amountOfNodes; k++)
+        {
+            for (u32 bucket = 0; bucket < SIM_MEMORY_HISTOGRAM_BUCKETS; bucket++) histogram[bucket] += nodes[k].memory.pools[i].histogram[bucket];
+        }
+        printf("%s samples per fill level:", GetPoolName((SimMemoryPool)i));
+        for (u32 bucket = 0; bucket < SIM_MEMORY_HISTOGRAM_BUCKETS; bucket++) printf(" %u%%:%u", bucket * 100 / SIM_MEMORY_HISTOGRAM_BUCKETS, histogram[bucket]);
+        printf(EOL);
+
+        //The nodes that came closest to running out of this pool
+        std::stable_sort(sortedNodes.begin(), sortedNodes.end(), [i](const NodeEntry* a, const NodeEntry* b) {
+            return GetHighWaterPercent(a->memory.pools[i]) > GetHighWaterPercent(b->memory.pools[i]);
+        });
+        for (u32 k = 0; k < topN && k < sortedNodes.size(); k++)
+        {
+            const SimMemoryOccupancy& pool = sortedNodes[k]->memory.pools[i];
+            printf("  node %d high-water %u / %u (%5.1f %%)" EOL, sortedNodes[k]->id, pool.highWater, pool.capacity, GetHighWaterPercent(pool));
+        }
+    }
+}
+
+bool SimMemory::WriteCsv(const std::string& path, const NodeEntry* nodes, u32 amountOfNodes)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) return false;
+
+    file << "nodeId,samples";
+    for (u32 i = 0; i < (u32)SimMemoryPool::AMOUNT; i++)
+    {
+        const char* name = GetPoolName((SimMemoryPool)i);
+        file << "," << name << "Used," << name << "HighWater," << name << "Capacity";
+        for (u32 bucket = 0; bucket < SIM_MEMORY_HISTOGRAM_BUCKETS; bucket++)
+        {
+            file << "," << name << "Fill" << bucket * 100 / SIM_MEMORY_HISTOGRAM_BUCKETS;
+        }
+    }
+    file << ",queuePackets,maxQueuePackets\n";
+
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        const SimMemoryUsage& memory = nodes[i].memory;
+        file << nodes[i].id << "," << memory.samples;
+        for (const SimMemoryOccupancy& pool : memory.pools)
+        {
+            file << "," << pool.used << "," << pool.highWater << "," << pool.capacity;
+            for (u32 count : pool.histogram) file << "," << count;
+        }
+        file << "," << memory.queuePackets << "," << memory.maxQueuePackets << "\n";
+    }
+    return (bool)file;
+}
@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <FmTypes.h>
+#include <array>
+#include <string>
+
+struct NodeEntry;
+
+//The memory pools of a node whose occupancy is sampled by the simulator
+enum class SimMemoryPool : u8
+{
+    MODULE_ALLOCATOR        = 0, //Bytes given to the modules by the ModuleAllocator
+    CONNECTION_ALLOCATOR    = 1, //Connections allocated from the pool of the ConnectionAllocator
+    QUEUE_CHUNKS            = 2, //Chunks of the ConnectionQueueMemoryAllocator, shared by all connections
+    CONNECTION_QUEUE_CHUNKS = 3, //Chunks held by the ChunkedPriorityPacketQueue of the fullest connection
+    AMOUNT                  = 4,
+};
+
+constexpr u32 SIM_MEMORY_HISTOGRAM_BUCKETS = 10; //Each bucket covers 10 % of the capacity, full pools are counted in the last one
+
+struct SimMemoryOccupancy
+{
+    u32 used = 0; //At the last sample
+    u32 highWater = 0; //Highest value since the node was created, also across reboots
+    u32 capacity = 0;
+    std::array<u32, SIM_MEMORY_HISTOGRAM_BUCKETS> histogram = {}; //Number of samples per fill level
+};
+
+//The memory occupancy of a node, kept in NodeEntry::memory
+struct SimMemoryUsage
+{
+    std::array<SimMemoryOccupancy, (u32)SimMemoryPool::AMOUNT> pools = {};
+    u32 queuePackets = 0; //Packets in the queue of the fullest connection at the last sample
+    u32 maxQueuePackets = 0;
+    u32 samples = 0;
+};
+
+/*
+ * Samples the occupancy of the allocators and connection queues of the simulated nodes. The
+ * firmware keeps its own high-water marks (see the "memstat" terminal command of the DebugModule),
+ * which are merged into every sample so that peaks between two samples are not missed. Sampling
+ * only reads a few counters per node and connection, so it can be enabled for large meshes with
+ * simConfig.memorySampleIntervalMs.
+ */
+namespace SimMemory
+{
+    const char* GetPoolName(SimMemoryPool pool);
+
+    void Sample(NodeEntry& node);
+
+    //Prints the occupancy and high-water mark of each pool of a node
+    void PrintNode(const NodeEntry& node);
+    //Prints the histogram of each pool over all nodes and samples and the nodes with the highest high-water marks
+    void PrintSummary(const NodeEntry* nodes, u32 amountOfNodes, u32 topN);
+    //Writes one row per node with the occupancy, high-water mark, capacity and histogram of each pool
+    bool WriteCsv(const std::string& path, const NodeEntry* nodes, u32 amountOfNodes);
+}
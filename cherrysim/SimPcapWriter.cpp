@@ -0,0 +1,440 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include <SimPcapWriter.h>
+#include <Exceptions.h>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    constexpr u32 BLOCK_TYPE_SECTION_HEADER         = 0x0A0D0D0A;
+    constexpr u32 BLOCK_TYPE_INTERFACE_DESCRIPTION  = 0x00000001;
+    constexpr u32 BLOCK_TYPE_INTERFACE_STATISTICS   = 0x00000005;
+    constexpr u32 BLOCK_TYPE_ENHANCED_PACKET        = 0x00000006;
+    constexpr u32 BYTE_ORDER_MAGIC                  = 0x1A2B3C4D;
+
+    constexpr u16 OPTION_END_OF_OPTIONS = 0;
+    constexpr u16 OPTION_COMMENT        = 1;
+    constexpr u16 OPTION_SHB_USERAPPL   = 4;
+    constexpr u16 OPTION_IF_NAME        = 2;
+    constexpr u16 OPTION_IF_TSRESOL     = 9;
+    constexpr u16 OPTION_ISB_IFDROP     = 5;
+
+    constexpr u8 NORDIC_BOARD_ID         = 0;
+    constexpr u8 NORDIC_HEADER_LENGTH    = 6;
+    constexpr u8 NORDIC_PACKET_HEADER_LENGTH = 10;
+    constexpr u8 NORDIC_PROTOCOL_VERSION = 1;
+    constexpr u8 NORDIC_EVENT_PACKET     = 0x06;
+    constexpr u8 NORDIC_FLAG_CRC_OK      = 0x01;
+    constexpr u8 NORDIC_FLAG_MASTER_TO_SLAVE = 0x02;
+
+    constexpr u32 MAX_ADVERTISING_DATA_LENGTH = 31;
+    constexpr u8 ADVERTISING_CHANNEL = 37;
+    constexpr u8 DATA_CHANNEL        = 0;
+    constexpr u32 DATA_ACCESS_ADDRESS_BASE = 0x50000000;
+
+    constexpr u8 LLID_CONTINUATION = 0x01;
+    constexpr u8 LLID_START        = 0x02;
+    constexpr u16 L2CAP_CID_ATT    = 0x0004;
+
+    constexpr u32 WRITER_POLL_INTERVAL_MS = 10;
+
+    void PutU16(u8* buffer, u16 value)
+    {
+        buffer[0] = (u8)value;
+        buffer[1] = (u8)(value >> 8);
+    }
+
+    void PutU32(u8* buffer, u32 value)
+    {
+        for (u32 i = 0; i < 4; i++) buffer[i] = (u8)(value >> (8 * i));
+    }
+
+    void AppendU16(std::vector<u8>& buffer, u16 value)
+    {
+        buffer.push_back((u8)value);
+        buffer.push_back((u8)(value >> 8));
+    }
+
+    void AppendU32(std::vector<u8>& buffer, u32 value)
+    {
+        for (u32 i = 0; i < 4; i++) buffer.push_back((u8)(value >> (8 * i)));
+    }
+
+    void AppendPadded(std::vector<u8>& buffer, const u8* data, u32 length)
+    {
+        buffer.insert(buffer.end(), data, data + length);
+        while (buffer.size() % 4 != 0) buffer.push_back(0);
+    }
+
+    void AppendOption(std::vector<u8>& buffer, u16 code, const void* value, u32 length)
+    {
+        AppendU16(buffer, code);
+        AppendU16(buffer, (u16)length);
+        AppendPadded(buffer, (const u8*)value, length);
+    }
+
+    void AppendTimestamp(std::vector<u8>& buffer, u32 timestampMs)
+    {
+        //Interfaces use the default resolution of microseconds
+        const uint64_t timestampUs = (uint64_t)timestampMs * 1000;
+        AppendU32(buffer, (u32)(timestampUs >> 32));
+        AppendU32(buffer, (u32)timestampUs);
+    }
+
+    u8 ReverseBits(u8 value)
+    {
+        u8 result = 0;
+        for (u32 i = 0; i < 8; i++)
+        {
+            result = (u8)((result << 1) | ((value >> i) & 1));
+        }
+        return result;
+    }
+
+    u8 AdvTypeToPduType(u8 advType)
+    {
+        //FruityHal::BleGapAdvType follows the SoftDevice numbering, which differs from the link layer PDU types
+        switch (advType)
+        {
+            case 0x00: return 0x00; //ADV_IND
+            case 0x01: return 0x01; //ADV_DIRECT_IND
+            case 0x02: return 0x06; //ADV_SCAN_IND
+            case 0x03: return 0x02; //ADV_NONCONN_IND
+            default:   return 0x02;
+        }
+    }
+}
+
+SimPcapWriter::SimPcapWriter(const std::string& path, const std::vector<std::string>& interfaceNames, u32 bufferSize)
+    : file(path, std::ios::binary | std::ios::out | std::ios::trunc),
+      ring(bufferSize + 1), //One slot always stays empty to tell a full ring apart from an empty one
+      droppedPerInterface(interfaceNames.size(), 0)
+{
+    if (!file || bufferSize == 0)
+    {
+        SIMEXCEPTIONFORCE(FileException);
+    }
+
+    WriteSectionHeader();
+    for (const std::string& name : interfaceNames)
+    {
+        WriteInterfaceDescription(name);
+    }
+
+    writerThread = std::thread(&SimPcapWriter::WriterMain, this);
+}
+
+SimPcapWriter::~SimPcapWriter()
+{
+    Close();
+}
+
+SimPcapPacket* SimPcapWriter::AcquireSlot(u32 interfaceId)
+{
+    if (closed || interfaceId >= droppedPerInterface.size()) return nullptr;
+
+    const u32 write = writeIndex.load(std::memory_order_relaxed);
+    const u32 next = (write + 1) % ring.size();
+    if (next == readIndex.load(std::memory_order_acquire))
+    {
+        numDropped++;
+        droppedPerInterface[interfaceId]++;
+        return nullptr;
+    }
+    return &ring[write];
+}
+
+void SimPcapWriter::CommitSlot()
+{
+    const u32 write = writeIndex.load(std::memory_order_relaxed);
+    writeIndex.store((write + 1) % ring.size(), std::memory_order_release);
+    numCaptured++;
+}
+
+bool SimPcapWriter::CaptureAdvertisement(u32 interfaceId, u32 timestampMs, u8 advType, bool randomAddress, const u8* address, const u8* data, u32 dataLength)
+{
+    SimPcapPacket* packet = AcquireSlot(interfaceId);
+    if (packet == nullptr) return false;
+
+    if (dataLength > MAX_ADVERTISING_DATA_LENGTH) dataLength = MAX_ADVERTISING_DATA_LENGTH;
+
+    packet->interfaceId    = interfaceId;
+    packet->timestampMs    = timestampMs;
+    packet->accessAddress  = ADVERTISING_ACCESS_ADDRESS;
+    packet->receiverId     = 0;
+    packet->globalPacketId = 0;
+    packet->isData         = false;
+    packet->advPduHeader   = (u8)(AdvTypeToPduType(advType) | (randomAddress ? 0x40 : 0x00));
+    packet->flags          = NORDIC_FLAG_CRC_OK;
+    packet->payloadLength  = (u8)(6 + dataLength);
+    memcpy(packet->payload, address, 6);
+    memcpy(packet->payload + 6, data, dataLength);
+
+    lastTimestampMs = timestampMs;
+    CommitSlot();
+    return true;
+}
+
+bool SimPcapWriter::CaptureAttPacket(u32 interfaceId, u32 timestampMs, u16 connHandle, bool fromCentral, u8 attOpcode, u16 attHandle, const u8* value, u32 valueLength, u32 receiverId, u32 globalPacketId)
+{
+    SimPcapPacket* packet = AcquireSlot(interfaceId);
+    if (packet == nullptr) return false;
+
+    //L2CAP header (4) + ATT opcode (1) + ATT handle (2)
+    if (valueLength > SimPcapPacket::MAX_PAYLOAD_LENGTH - 7) valueLength = SimPcapPacket::MAX_PAYLOAD_LENGTH - 7;
+
+    packet->interfaceId    = interfaceId;
+    packet->timestampMs    = timestampMs;
+    packet->accessAddress  = DATA_ACCESS_ADDRESS_BASE | connHandle;
+    packet->receiverId     = receiverId;
+    packet->globalPacketId = globalPacketId;
+    packet->isData         = true;
+    packet->advPduHeader   = 0;
+    packet->flags          = (u8)(NORDIC_FLAG_CRC_OK | (fromCentral ? NORDIC_FLAG_MASTER_TO_SLAVE : 0));
+    packet->payloadLength  = (u8)(7 + valueLength);
+    PutU16(packet->payload, (u16)(3 + valueLength));
+    PutU16(packet->payload + 2, L2CAP_CID_ATT);
+    packet->payload[4] = attOpcode;
+    PutU16(packet->payload + 5, attHandle);
+    memcpy(packet->payload + 7, value, valueLength);
+
+    lastTimestampMs = timestampMs;
+    CommitSlot();
+    return true;
+}
+
+void SimPcapWriter::Flush()
+{
+    if (closed) return;
+    wakeUp.notify_one();
+    while (readIndex.load(std::memory_order_acquire) != writeIndex.load(std::memory_order_relaxed))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::lock_guard<std::mutex> guard(mutex);
+    file.flush();
+}
+
+void SimPcapWriter::Close()
+{
+    if (closed) return;
+    closed = true;
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopRequested = true;
+    }
+    wakeUp.notify_one();
+    writerThread.join();
+
+    for (u32 i = 0; i < droppedPerInterface.size(); i++)
+    {
+        if (droppedPerInterface[i] != 0) WriteInterfaceStatistics(i, lastTimestampMs, droppedPerInterface[i]);
+    }
+    file.close();
+}
+
+u32 SimPcapWriter::GetNumCapturedPackets() const
+{
+    return numCaptured;
+}
+
+u32 SimPcapWriter::GetNumDroppedPackets() const
+{
+    return numDropped;
+}
+
+void SimPcapWriter::WriterMain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopRequested)
+    {
+        wakeUp.wait_for(lock, std::chrono::milliseconds(WRITER_POLL_INTERVAL_MS));
+        DrainRing();
+    }
+    DrainRing();
+    file.flush();
+}
+
+void SimPcapWriter::DrainRing()
+{
+    u32 read = readIndex.load(std::memory_order_relaxed);
+    const u32 write = writeIndex.load(std::memory_order_acquire);
+    while (read != write)
+    {
+        WritePacket(ring[read]);
+        read = (read + 1) % ring.size();
+        //Hand the slot back immediately so that the simulation can reuse it while we keep writing
+        readIndex.store(read, std::memory_order_release);
+    }
+}
+
+void SimPcapWriter::WriteBlock(u32 blockType, const u8* body, u32 bodyLength)
+{
+    u8 header[8];
+    const u32 totalLength = 12 + bodyLength;
+    PutU32(header, blockType);
+    PutU32(header + 4, totalLength);
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)body, bodyLength);
+    file.write((const char*)(header + 4), 4);
+}
+
+void SimPcapWriter::WriteSectionHeader()
+{
+    std::vector<u8> body;
+    AppendU32(body, BYTE_ORDER_MAGIC);
+    AppendU16(body, 1); //Major version
+    AppendU16(body, 0); //Minor version
+    AppendU32(body, 0xFFFFFFFF); //Section length not specified
+    AppendU32(body, 0xFFFFFFFF);
+    const char application[] = "CherrySim";
+    AppendOption(body, OPTION_SHB_USERAPPL, application, sizeof(application) - 1);
+    AppendOption(body, OPTION_END_OF_OPTIONS, nullptr, 0);
+    WriteBlock(BLOCK_TYPE_SECTION_HEADER, body.data(), (u32)body.size());
+}
+
+void SimPcapWriter::WriteInterfaceDescription(const std::string& name)
+{
+    std::vector<u8> body;
+    AppendU16(body, LINKTYPE_NORDIC_BLE_LEGACY);
+    AppendU16(body, 0);
+    AppendU32(body, 0); //No snap length
+    AppendOption(body, OPTION_IF_NAME, name.data(), (u32)name.size());
+    const u8 microseconds = 6;
+    AppendOption(body, OPTION_IF_TSRESOL, &microseconds, sizeof(microseconds));
+    AppendOption(body, OPTION_END_OF_OPTIONS, nullptr, 0);
+    WriteBlock(BLOCK_TYPE_INTERFACE_DESCRIPTION, body.data(), (u32)body.size());
+}
+
+void SimPcapWriter::WriteEnhancedPacket(u32 interfaceId, u32 timestampMs, const u8* data, u32 length, const std::string& comment)
+{
+    blockBuffer.clear();
+    AppendU32(blockBuffer, interfaceId);
+    AppendTimestamp(blockBuffer, timestampMs);
+    AppendU32(blockBuffer, length); //Captured length
+    AppendU32(blockBuffer, length); //Original length
+    AppendPadded(blockBuffer, data, length);
+    if (!comment.empty())
+    {
+        AppendOption(blockBuffer, OPTION_COMMENT, comment.data(), (u32)comment.size());
+        AppendOption(blockBuffer, OPTION_END_OF_OPTIONS, nullptr, 0);
+    }
+    WriteBlock(BLOCK_TYPE_ENHANCED_PACKET, blockBuffer.data(), (u32)blockBuffer.size());
+}
+
+void SimPcapWriter::WritePacket(const SimPcapPacket& packet)
+{
+    u8 encoded[MAX_ENCODED_PACKET_SIZE];
+
+    if (!packet.isData)
+    {
+        const u8 pduHeader[2] = { packet.advPduHeader, packet.payloadLength };
+        const u32 length = EncodeNordicBlePacket(packet.accessAddress, ADVERTISING_CHANNEL, packet.flags, packetCounter++, pduHeader, packet.payload, packet.payloadLength, encoded);
+        WriteEnhancedPacket(packet.interfaceId, packet.timestampMs, encoded, length, "");
+        return;
+    }
+
+    //Split the L2CAP packet into link layer fragments, only the first one carries the comment
+    const std::string comment = "to node " + std::to_string(packet.receiverId) + ", globalPacketId " + std::to_string(packet.globalPacketId);
+    for (u32 offset = 0; offset < packet.payloadLength; offset += MAX_DATA_PDU_PAYLOAD_LENGTH)
+    {
+        u32 fragmentLength = packet.payloadLength - offset;
+        if (fragmentLength > MAX_DATA_PDU_PAYLOAD_LENGTH) fragmentLength = MAX_DATA_PDU_PAYLOAD_LENGTH;
+        const u8 pduHeader[2] = { offset == 0 ? LLID_START : LLID_CONTINUATION, (u8)fragmentLength };
+        const u32 length = EncodeNordicBlePacket(packet.accessAddress, DATA_CHANNEL, packet.flags, packetCounter++, pduHeader, packet.payload + offset, fragmentLength, encoded);
+        WriteEnhancedPacket(packet.interfaceId, packet.timestampMs, encoded, length, offset == 0 ? comment : "");
+    }
+}
+
+void SimPcapWriter::WriteInterfaceStatistics(u32 interfaceId, u32 timestampMs, u32 dropped)
+{
+    std::vector<u8> body;
+    AppendU32(body, interfaceId);
+    AppendTimestamp(body, timestampMs);
+    const uint64_t dropped64 = dropped;
+    u8 droppedLe[8];
+    PutU32(droppedLe, (u32)dropped64);
+    PutU32(droppedLe + 4, (u32)(dropped64 >> 32));
+    AppendOption(body, OPTION_ISB_IFDROP, droppedLe, sizeof(droppedLe));
+    AppendOption(body, OPTION_END_OF_OPTIONS, nullptr, 0);
+    WriteBlock(BLOCK_TYPE_INTERFACE_STATISTICS, body.data(), (u32)body.size());
+}
+
+u32 SimPcapWriter::CalculateBleCrc(const u8* pdu, u32 length, u32 crcInit)
+{
+    //Bits are transmitted least significant bit first, polynomial x^24 + x^10 + x^9 + x^6 + x^4 + x^3 + x + 1
+    u32 crc = crcInit & 0xFFFFFF;
+    for (u32 i = 0; i < length; i++)
+    {
+        for (u32 bit = 0; bit < 8; bit++)
+        {
+            const u32 feedback = ((crc >> 23) ^ (pdu[i] >> bit)) & 1;
+            crc = (crc << 1) & 0xFFFFFF;
+            if (feedback) crc ^= 0x00065B;
+        }
+    }
+    return crc;
+}
+
+u32 SimPcapWriter::EncodeNordicBlePacket(u32 accessAddress, u8 channel, u8 flags, u16 packetCounter, const u8* pduHeader, const u8* payload, u32 payloadLength, u8* buffer)
+{
+    const u32 blePacketLength = 4 + 2 + payloadLength + 3;
+    u32 offset = 0;
+
+    //Legacy Nordic sniffer header, see the nordic_ble dissector in Wireshark
+    buffer[offset++] = NORDIC_BOARD_ID;
+    buffer[offset++] = NORDIC_HEADER_LENGTH;
+    buffer[offset++] = (u8)(NORDIC_PACKET_HEADER_LENGTH + blePacketLength);
+    buffer[offset++] = NORDIC_PROTOCOL_VERSION;
+    PutU16(buffer + offset, packetCounter); offset += 2;
+    buffer[offset++] = NORDIC_EVENT_PACKET;
+    buffer[offset++] = NORDIC_PACKET_HEADER_LENGTH;
+    buffer[offset++] = flags;
+    buffer[offset++] = channel;
+    buffer[offset++] = 0; //RSSI is receiver dependent and thus unknown for the sender
+    PutU16(buffer + offset, 0); offset += 2; //Event counter
+    PutU32(buffer + offset, 0); offset += 4; //Delta time, the pcapng timestamp is authoritative
+
+    //BLE link layer packet
+    PutU32(buffer + offset, accessAddress); offset += 4;
+    buffer[offset++] = pduHeader[0];
+    buffer[offset++] = pduHeader[1];
+    memcpy(buffer + offset, payload, payloadLength);
+    offset += payloadLength;
+
+    const u32 crc = CalculateBleCrc(buffer + offset - payloadLength - 2, payloadLength + 2, 0x555555);
+    buffer[offset++] = ReverseBits((u8)(crc >> 16));
+    buffer[offset++] = ReverseBits((u8)(crc >> 8));
+    buffer[offset++] = ReverseBits((u8)crc);
+
+    return offset;
+}
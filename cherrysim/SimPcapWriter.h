@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <FmTypes.h>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Capture sink that writes the simulated radio traffic to a pcapng file so that it
+ * can be analysed offline with Wireshark and util/wireshark/fruitymesh.lua.
+ *
+ * Packets use the legacy Nordic BLE sniffer encapsulation (LINKTYPE_USER10, which is
+ * what the fruitymesh dissector hooks into) followed by the BLE link layer packet.
+ * Advertising packets are written as ADV_* PDUs. GATT writes and notifications are
+ * written as L2CAP/ATT packets on the data channel, fragmented into link layer PDUs
+ * of at most 27 bytes like a connection without data length extension would do.
+ * Every node is represented by its own pcapng interface that is named after its node
+ * id and serial number, the receiver of a data packet is stored in the packet comment.
+ * Timestamps are the simulated time.
+ *
+ * Capturing must never slow down the simulation. The simulation thread only copies
+ * the packet into a preallocated single producer / single consumer ring, encoding and
+ * file IO happen on a separate writer thread. If the ring is full, the packet is
+ * dropped and counted. The drop counts are written as interface statistics once the
+ * capture is closed.
+ */
+
+struct SimPcapPacket
+{
+    static constexpr u32 MAX_PAYLOAD_LENGTH = 255;
+
+    u32 interfaceId;
+    u32 timestampMs;
+    u32 accessAddress;
+    u32 receiverId;         //0 for advertising packets
+    u32 globalPacketId;     //0 for advertising packets
+    bool isData;            //Payload is an L2CAP packet instead of an advertising PDU payload
+    u8 advPduHeader;        //Only for advertising packets: PDU type, TxAdd and RxAdd
+    u8 flags;               //Nordic sniffer flags
+    u8 payloadLength;
+    u8 payload[MAX_PAYLOAD_LENGTH];
+};
+
+class SimPcapWriter
+{
+public:
+    static constexpr u32 DEFAULT_BUFFER_SIZE = 4096;
+    static constexpr u16 LINKTYPE_NORDIC_BLE_LEGACY = 157; //LINKTYPE_USER10, wtap encapsulation 55
+    static constexpr u32 ADVERTISING_ACCESS_ADDRESS = 0x8E89BED6;
+    static constexpr u32 MAX_DATA_PDU_PAYLOAD_LENGTH = 27;
+    static constexpr u32 MAX_ENCODED_PACKET_SIZE = 17 + 4 + 2 + SimPcapPacket::MAX_PAYLOAD_LENGTH + 3; //Nordic header, access address, PDU header, payload, CRC
+
+    //interfaceNames contains one name per node, the index of a name is the interfaceId used when capturing.
+    SimPcapWriter(const std::string& path, const std::vector<std::string>& interfaceNames, u32 bufferSize = DEFAULT_BUFFER_SIZE);
+    ~SimPcapWriter();
+    SimPcapWriter(const SimPcapWriter&) = delete;
+    SimPcapWriter& operator=(const SimPcapWriter&) = delete;
+
+    //Both capture functions return false if the packet was dropped because the ring was full.
+    //advType is a FruityHal::BleGapAdvType.
+    bool CaptureAdvertisement(u32 interfaceId, u32 timestampMs, u8 advType, bool randomAddress, const u8* address, const u8* data, u32 dataLength);
+    bool CaptureAttPacket(u32 interfaceId, u32 timestampMs, u16 connHandle, bool fromCentral, u8 attOpcode, u16 attHandle, const u8* value, u32 valueLength, u32 receiverId, u32 globalPacketId);
+
+    //Blocks until the writer thread wrote all packets that were captured so far.
+    void Flush();
+
+    //Flushes all remaining packets, writes the drop statistics and closes the file.
+    void Close();
+
+    u32 GetNumCapturedPackets() const;
+    u32 GetNumDroppedPackets() const;
+
+    //Calculates the BLE link layer CRC over the PDU header and payload.
+    static u32 CalculateBleCrc(const u8* pdu, u32 length, u32 crcInit);
+
+    //Encodes a single link layer PDU including the Nordic sniffer header, returns the encoded length.
+    static u32 EncodeNordicBlePacket(u32 accessAddress, u8 channel, u8 flags, u16 packetCounter, const u8* pduHeader, const u8* payload, u32 payloadLength, u8* buffer);
+
+private:
+    std::ofstream file;
+    std::vector<SimPcapPacket> ring;
+    std::vector<u32> droppedPerInterface;
+    std::atomic<u32> writeIndex{ 0 }; //Only written by the simulation thread
+    std::atomic<u32> readIndex{ 0 };  //Only written by the writer thread
+    u32 numCaptured = 0;
+    u32 numDropped = 0;
+    u32 lastTimestampMs = 0;
+    bool closed = false;
+
+    //Only used by the writer thread
+    u16 packetCounter = 0;
+    std::vector<u8> blockBuffer;
+
+    std::thread writerThread;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopRequested = false;
+
+    SimPcapPacket* AcquireSlot(u32 interfaceId);
+    void CommitSlot();
+
+    void WriterMain();
+    void DrainRing();
+    void WriteBlock(u32 blockType, const u8* body, u32 bodyLength);
+    void WriteSectionHeader();
+    void WriteInterfaceDescription(const std::string& name);
+    void WriteEnhancedPacket(u32 interfaceId, u32 timestampMs, const u8* data, u32 length, const std::string& comment);
+    void WritePacket(const SimPcapPacket& packet);
+    void WriteInterfaceStatistics(u32 interfaceId, u32 timestampMs, u32 dropped);
+};
@@ -0,0 +1,206 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "SimPlacement.h"
+#include "MersenneTwister.h"
+#include "Exceptions.h"
+#include "Config.h"
+#include "SystemTest.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+SimPlacement::SimPlacement(double range, double mapWidth, double mapHeight, double mapElevation)
+    : range(range), mapWidth(mapWidth), mapHeight(mapHeight), mapElevation(mapElevation)
+{
+    if (!(range > 0))
+    {
+        SIMEXCEPTION(IllegalArgumentException);
+    }
+}
+
+double SimPlacement::CalculateConnectionRange(double propagationConstant)
+{
+    return pow(10, ((double)-STABLE_CONNECTION_RSSI_THRESHOLD + SIMULATOR_NODE_DEFAULT_CALIBRATED_TX + SIMULATOR_NODE_DEFAULT_DBM_TX) / 10 / propagationConstant);
+}
+
+void SimPlacement::CalculateMapSizeForDensity(u32 amountOfNodes, double nodesPer100SquareMeters, u32 & inOutWidth, u32 & inOutHeight)
+{
+    if (!(nodesPer100SquareMeters > 0))
+    {
+        SIMEXCEPTION(IllegalArgumentException);
+    }
+    const double area = amountOfNodes / nodesPer100SquareMeters * 100.0;
+    const double aspectRatio = (inOutWidth != 0 && inOutHeight != 0) ? (double)inOutWidth / inOutHeight : 1.0;
+    const double height = std::sqrt(area / aspectRatio);
+    inOutWidth  = std::max<u32>(1, (u32)std::ceil(height * aspectRatio));
+    inOutHeight = std::max<u32>(1, (u32)std::ceil(height));
+}
+
+u32 SimPlacement::Find(u32 index)
+{
+    while (parents[index] != index)
+    {
+        //Path halving
+        parents[index] = parents[parents[index]];
+        index = parents[index];
+    }
+    return index;
+}
+
+void SimPlacement::Unite(u32 a, u32 b)
+{
+    a = Find(a);
+    b = Find(b);
+    if (a < b) parents[b] = a;
+    else if (b < a) parents[a] = b;
+}
+
+bool SimPlacement::IsInRange(const ThreeDimStruct<double>& a, const ThreeDimStruct<double>& b) const
+{
+    //Same calculation as the euclidean_dist of the dbscan so that the results do not differ at the boundary
+    return sqrt(pow(a.x - b.x, 2) + pow(a.y - b.y, 2) + pow(a.z - b.z, 2)) <= range;
+}
+
+ThreeDimStruct<double> SimPlacement::ToMeters(const ThreeDimStruct<float>& position) const
+{
+    ThreeDimStruct<double> retVal = {};
+    retVal.x = (double)position.x * mapWidth;
+    retVal.y = (double)position.y * mapHeight;
+    retVal.z = (double)position.z * mapElevation;
+    return retVal;
+}
+
+static uint64_t GetCellKey(int64_t cellX, int64_t cellY, int64_t cellZ)
+{
+    //Cells that are 2^21 cells apart share a key, which only costs some additional distance checks
+    constexpr uint64_t mask = (1ULL << 21) - 1;
+    return (((uint64_t)cellX & mask) << 42) | (((uint64_t)cellY & mask) << 21) | ((uint64_t)cellZ & mask);
+}
+
+void SimPlacement::FindConnectedToFirst(const std::vector<ThreeDimStruct<float>>& positions, u32 amountOfNodes, std::vector<bool>& outConnected)
+{
+    if (amountOfNodes > positions.size())
+    {
+        SIMEXCEPTION(IllegalArgumentException);
+    }
+    outConnected.assign(amountOfNodes, false);
+    if (amountOfNodes == 0) return;
+
+    std::vector<ThreeDimStruct<double>> meters(amountOfNodes);
+    for (u32 i = 0; i < amountOfNodes; i++) meters[i] = ToMeters(positions[i]);
+
+    parents.resize(amountOfNodes);
+    std::iota(parents.begin(), parents.end(), 0);
+    nextInCell.assign(amountOfNodes, UINT32_MAX);
+    cellHeads.clear();
+    cellHeads.reserve(amountOfNodes);
+
+    //Two nodes in range are at most one cell apart, so every node is only compared with the nodes
+    //that were already sorted into its own and the 26 surrounding cells.
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        const int64_t cellX = (int64_t)std::floor(meters[i].x / range);
+        const int64_t cellY = (int64_t)std::floor(meters[i].y / range);
+        const int64_t cellZ = (int64_t)std::floor(meters[i].z / range);
+        for (int64_t dx = -1; dx <= 1; dx++)
+        {
+            for (int64_t dy = -1; dy <= 1; dy++)
+            {
+                for (int64_t dz = -1; dz <= 1; dz++)
+                {
+                    const auto it = cellHeads.find(GetCellKey(cellX + dx, cellY + dy, cellZ + dz));
+                    if (it == cellHeads.end()) continue;
+                    for (u32 other = it->second; other != UINT32_MAX; other = nextInCell[other])
+                    {
+                        if (IsInRange(meters[i], meters[other])) Unite(i, other);
+                    }
+                }
+            }
+        }
+        const auto inserted = cellHeads.emplace(GetCellKey(cellX, cellY, cellZ), UINT32_MAX);
+        nextInCell[i] = inserted.first->second;
+        inserted.first->second = i;
+    }
+
+    const u32 firstRoot = Find(0);
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        outConnected[i] = Find(i) == firstRoot;
+    }
+}
+
+u32 SimPlacement::PlaceConnected(std::vector<ThreeDimStruct<float>>& positions, u32 amountOfNodes, MersenneTwister & rnd, bool attachUnconnected)
+{
+    std::vector<bool> connected;
+    u32 passes = 0;
+    while (true)
+    {
+        passes++;
+        FindConnectedToFirst(positions, amountOfNodes, connected);
+
+        if (attachUnconnected)
+        {
+            std::vector<u32> connectedIndices;
+            for (u32 i = 0; i < amountOfNodes; i++)
+            {
+                if (connected[i]) connectedIndices.push_back(i);
+            }
+            for (u32 i = 0; i < amountOfNodes; i++)
+            {
+                if (connected[i]) continue;
+
+                //A position within range of the anchor stays within range if it is clamped to the map
+                const u32 anchor = connectedIndices[rnd.NextU32(0, (u32)connectedIndices.size() - 1)];
+                const double angle = (double)rnd.NextU32() / (double)UINT32_MAX * 2 * 3.14159265358979323846;
+                const double distance = std::sqrt((double)rnd.NextU32() / (double)UINT32_MAX) * range * 0.9;
+                const ThreeDimStruct<double> anchorMeters = ToMeters(positions[anchor]);
+                const double x = std::min<double>(std::max<double>(anchorMeters.x + std::cos(angle) * distance, 0), mapWidth);
+                const double y = std::min<double>(std::max<double>(anchorMeters.y + std::sin(angle) * distance, 0), mapHeight);
+                positions[i].x = mapWidth  > 0 ? (float)(x / mapWidth)  : 0.0f;
+                positions[i].y = mapHeight > 0 ? (float)(y / mapHeight) : 0.0f;
+                positions[i].z = positions[anchor].z;
+                connectedIndices.push_back(i);
+            }
+            return passes;
+        }
+
+        bool retry = false;
+        for (u32 i = 0; i < amountOfNodes; i++)
+        {
+            if (!connected[i])
+            {
+                retry = true;
+                positions[i].x = (float)rnd.NextU32() / (float)0xFFFFFFFF;
+                positions[i].y = (float)rnd.NextU32() / (float)0xFFFFFFFF;
+            }
+        }
+        if (!retry) return passes;
+    }
+}
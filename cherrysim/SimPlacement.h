@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "FmTypes.h"
+#include "PrimitiveTypes.h"
+
+class MersenneTwister;
+
+//Places nodes randomly on the map so that they can form a single mesh. Whether two nodes can connect is
+//decided by their distance, which must not exceed the range at which the rssi is still stable. To find
+//out which nodes are connected, all nodes are sorted into a grid with cells as large as that range and
+//a union-find is done over the nodes of neighbouring cells only. This replaces the dbscan clustering,
+//which compared every node with every other node and was repeated for every retry.
+class SimPlacement
+{
+TESTER_PUBLIC:
+    double range;
+    double mapWidth;
+    double mapHeight;
+    double mapElevation;
+
+    std::vector<u32> parents;
+    std::vector<u32> nextInCell;
+    std::unordered_map<uint64_t, u32> cellHeads;
+
+    u32 Find(u32 index);
+    void Unite(u32 a, u32 b);
+    bool IsInRange(const ThreeDimStruct<double>& a, const ThreeDimStruct<double>& b) const;
+    ThreeDimStruct<double> ToMeters(const ThreeDimStruct<float>& position) const;
+
+public:
+    //The map dimensions are in meters, positions are given relative to them (0 to 1) as for the NodeEntry.
+    SimPlacement(double range, double mapWidth, double mapHeight, double mapElevation);
+
+    //The distance at which two nodes with the default transmission power still receive a stable rssi.
+    static double CalculateConnectionRange(double propagationConstant);
+
+    //Calculates the width and height in meters that result in the given density (nodes per 100 square meters).
+    //The current aspect ratio is kept if both are set.
+    static void CalculateMapSizeForDensity(u32 amountOfNodes, double nodesPer100SquareMeters, u32& inOutWidth, u32& inOutHeight);
+
+    //Sets outConnected[i] for every one of the first amountOfNodes positions that is connected to the
+    //first position, either directly or over other positions.
+    void FindConnectedToFirst(const std::vector<ThreeDimStruct<float>>& positions, u32 amountOfNodes, std::vector<bool>& outConnected);
+
+    //Moves the first amountOfNodes positions until all of them are connected to the first one. By default,
+    //nodes that are not connected get a new random position and the check is repeated, which gives the same
+    //layouts as the former dbscan based placement. If attachUnconnected is set, each such node is instead
+    //placed within range of a random connected node, which always succeeds in a single pass.
+    //Returns the number of passes.
+    u32 PlaceConnected(std::vector<ThreeDimStruct<float>>& positions, u32 amountOfNodes, MersenneTwister& rnd, bool attachUnconnected);
+};
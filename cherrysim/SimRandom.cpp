@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "SimRandom.h"
+#include "MersenneTwister.h"
+#include "Exceptions.h"
+#include "Utility.h"
+
+uint64_t SimRandom::Mix(uint64_t value)
+{
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+SimRandom::SimRandom()
+{
+}
+
+SimRandom::SimRandom(uint32_t seed, uint32_t streamOwner, SimRandomStream stream)
+{
+    SetSeed(seed, streamOwner, stream);
+}
+
+void SimRandom::SetSeed(uint32_t seed, uint32_t streamOwner, SimRandomStream stream)
+{
+    if (stream >= SimRandomStream::AMOUNT)
+    {
+        SIMEXCEPTION(IllegalArgumentException);
+    }
+    //Uses the same seed offset as the MersenneTwister so that the tester can vary all random numbers at once
+    seed += MersenneTwister::seedOffset;
+    const uint64_t streamId = ((uint64_t)streamOwner << 8) | (uint64_t)stream;
+    key = Mix(Mix((uint64_t)seed + 0x9E3779B97F4A7C15ULL) ^ streamId);
+    counter = 0;
+    seeded = true;
+}
+
+SimRandom SimRandom::ForLink(uint32_t seed, uint32_t sender, uint32_t receiver, SimLinkRandom purpose, uint64_t eventId)
+{
+    seed += MersenneTwister::seedOffset;
+    const uint64_t linkId = ((uint64_t)sender << 32) | (uint64_t)receiver;
+    SimRandom random;
+    random.key = Mix(Mix(Mix((uint64_t)seed + 0x9E3779B97F4A7C15ULL) ^ linkId) ^ ((eventId << 8) | (uint64_t)purpose));
+    random.counter = 0;
+    random.seeded = true;
+    return random;
+}
+
+uint32_t SimRandom::PeekU32(uint64_t n) const
+{
+    //The golden ratio increment of SplitMix64, the key places every stream at a different position
+    return (uint32_t)(Mix(key + (n + 1) * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+uint32_t SimRandom::NextU32()
+{
+    //Same restriction as for the MersenneTwister, see MersenneTwister::NextU32
+    if (MersenneTwisterDisabler::disableLevel > 0)
+    {
+        SIMEXCEPTION(IllegalStateException);
+    }
+    if (!seeded)
+    {
+        SIMEXCEPTION(IllegalStateException);
+    }
+
+    const uint32_t retVal = PeekU32(counter);
+    counter++;
+    return retVal;
+}
+
+uint32_t SimRandom::NextU32(uint32_t min, uint32_t max)
+{
+    if (min > max)
+    {
+        SIMEXCEPTION(IllegalArgumentException);
+    }
+    if (min == max)
+    {
+        return min;
+    }
+    //Multiply and shift instead of a modulo, the range can be 2^32 if min is 0 and max is UINT32_MAX
+    const uint64_t range = (uint64_t)max - min + 1;
+    return (uint32_t)(((uint64_t)NextU32() * range) >> 32) + min;
+}
+
+bool SimRandom::NextPsrng(uint32_t probability)
+{
+    if (probability == 0) return false;
+    if (probability == UINT32_MAX) return true;
+    const uint32_t rand = NextU32();
+    return rand < probability;
+}
+
+uint64_t SimRandom::GetCounter() const
+{
+    return counter;
+}
+
+uint32_t SimRandom::GetStateChecksum() const
+{
+    uint32_t crc = Utility::CalculateCrc32((const u8*)&key, sizeof(key));
+    return Utility::CalculateCrc32((const u8*)&counter, sizeof(counter), crc);
+}
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <stdint.h>
+
+//The independent random streams of each node. Every subsystem draws from its own stream so that
+//e.g. an additional sensor reading does not change the packet loss that a node experiences.
+enum class SimRandomStream : uint8_t
+{
+    FIRMWARE   = 0, //Results of SoftDevice and HAL calls, e.g. busy errors, random vectors
+    SENSOR     = 1, //Simulated sensor values
+    RADIO      = 2, //Radio effects that are not bound to a single link, e.g. injected faults
+    CONNECTION = 3, //Connection events, e.g. the number of packets per event and timeouts
+    SCHEDULING = 4, //Flash commit timing and interrupts
+    AMOUNT     = 5,
+};
+
+//The random decisions that are made for a single event on the link between two nodes, see SimRandom::ForLink
+enum class SimLinkRandom : uint8_t
+{
+    RECEPTION  = 0, //Whether a packet is received
+    RSSI_NOISE = 1, //Noise that is added to the calculated rssi
+};
+
+//A counter based pseudo random number generator. Each number is calculated by hashing a counter
+//together with a key that is derived from the seed, the node and the stream (SplitMix64 finalizer).
+//The whole state is 16 bytes, which allows to keep one generator per node and stream, so that
+//the random numbers of a node do not depend on how many numbers other nodes have drawn before.
+class SimRandom
+{
+private:
+    uint64_t key = 0;
+    uint64_t counter = 0;
+    bool seeded = false;
+
+    static uint64_t Mix(uint64_t value);
+
+public:
+    SimRandom();
+    SimRandom(uint32_t seed, uint32_t streamOwner, SimRandomStream stream);
+
+    //The streamOwner is typically the id of the node that uses the stream.
+    void SetSeed(uint32_t seed, uint32_t streamOwner, SimRandomStream stream);
+
+    //Returns a generator for a single event on the link from sender to receiver, e.g. the reception of one
+    //advertising packet. Its numbers only depend on the seed, both nodes, the purpose and the eventId. They
+    //therefore stay the same no matter how many other nodes exist or how many numbers they draw.
+    static SimRandom ForLink(uint32_t seed, uint32_t sender, uint32_t receiver, SimLinkRandom purpose, uint64_t eventId);
+
+    uint32_t NextU32();
+
+    uint32_t NextU32(uint32_t min, uint32_t max);
+
+    bool NextPsrng(uint32_t probability);
+
+    //Returns the number that the n-th call to NextU32 returns without changing the state.
+    uint32_t PeekU32(uint64_t n) const;
+
+    uint64_t GetCounter() const;
+
+    //A checksum over the complete internal state, used to check that two simulations did not diverge.
+    uint32_t GetStateChecksum() const;
+};
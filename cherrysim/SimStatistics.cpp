@@ -0,0 +1,142 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include <SimStatistics.h>
+#include <Exceptions.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+std::vector<SimStatistics::Entry> SimStatistics::entries;
+std::map<std::pair<SimStatistics::Type, std::string>, u32> SimStatistics::handlesByKey;
+std::vector<SimStatValue> SimStatistics::globalValues;
+
+u32 SimStatistics::Register(const char* key, Type type)
+{
+    const auto result = handlesByKey.insert({ { type, key }, (u32)entries.size() });
+    if (result.second)
+    {
+        entries.push_back({ key, type });
+        globalValues.resize(entries.size());
+    }
+    return result.first->second;
+}
+
+u32 SimStatistics::FindHandle(const std::string& key, Type type)
+{
+    const auto entry = handlesByKey.find({ type, key });
+    return entry != handlesByKey.end() ? entry->second : INVALID_HANDLE;
+}
+
+u32 SimStatistics::GetAmountOfStatistics()
+{
+    return (u32)entries.size();
+}
+
+const std::string& SimStatistics::GetKey(u32 handle)
+{
+    if (handle >= entries.size()) SIMEXCEPTIONFORCE(IllegalArgumentException);
+    return entries[handle].key;
+}
+
+SimStatistics::Type SimStatistics::GetType(u32 handle)
+{
+    if (handle >= entries.size()) SIMEXCEPTIONFORCE(IllegalArgumentException);
+    return entries[handle].type;
+}
+
+const std::vector<SimStatValue>& SimStatistics::GetGlobalValues()
+{
+    return globalValues;
+}
+
+void SimStatistics::ClearGlobalValues()
+{
+    std::fill(globalValues.begin(), globalValues.end(), SimStatValue());
+}
+
+SimStatValue SimStatistics::GetValue(const std::vector<SimStatValue>& values, u32 handle)
+{
+    return handle < values.size() ? values[handle] : SimStatValue();
+}
+
+void SimStatistics::Print(const std::vector<SimStatValue>& values)
+{
+    //Sorted by key, as the handles are only in the order in which the call sites were reached
+    std::vector<u32> handles;
+    for (const auto& entry : handlesByKey)
+    {
+        if (GetValue(values, entry.second).count > 0) handles.push_back(entry.second);
+    }
+    std::sort(handles.begin(), handles.end(), [](u32 a, u32 b) { return entries[a].key < entries[b].key; });
+
+    printf("------ COUNTS --------" EOL);
+    for (const u32 handle : handles)
+    {
+        if (entries[handle].type != Type::COUNT) continue;
+        printf("Key: %s, Count: %llu" EOL, entries[handle].key.c_str(), (unsigned long long)values[handle].count);
+    }
+
+    printf("------ AVG --------" EOL);
+    for (const u32 handle : handles)
+    {
+        if (entries[handle].type != Type::AVG) continue;
+        const SimStatValue& value = values[handle];
+        printf("Key: %s, Count: %llu, Avg: %lld" EOL, entries[handle].key.c_str(), (unsigned long long)value.count, (long long)(value.total / (int64_t)value.count));
+    }
+
+    printf("--------------" EOL);
+}
+
+bool SimStatistics::WriteTimeSeriesCsv(const std::string& path, const std::vector<SimStatSnapshot>& snapshots)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) return false;
+
+    file << "simTimeMs";
+    for (const Entry& entry : entries)
+    {
+        file << "," << entry.key;
+    }
+    file << "\n";
+
+    for (const SimStatSnapshot& snapshot : snapshots)
+    {
+        file << snapshot.simTimeMs;
+        for (u32 handle = 0; handle < entries.size(); handle++)
+        {
+            const SimStatValue value = GetValue(snapshot.values, handle);
+            file << ",";
+            if (entries[handle].type == Type::COUNT) file << value.count;
+            else if (value.count > 0) file << (double)value.total / value.count;
+        }
+        file << "\n";
+    }
+    return (bool)file;
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <FmTypes.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct SimStatValue
+{
+    uint64_t count = 0;
+    int64_t total = 0; //Sum of all collected values, only meaningful for averages
+};
+
+struct SimStatSnapshot
+{
+    u32 simTimeMs = 0;
+    std::vector<SimStatValue> values; //Indexed by handle, statistics registered after the snapshot are missing
+};
+
+/*
+ * Registry and storage of the statistics that are collected with SIMSTATCOUNT and SIMSTATAVG.
+ *
+ * Each call site of the macros registers its key once and keeps the returned handle in a
+ * function local static, so collecting a value only increments the counters at that index
+ * instead of building a std::string and looking it up in a map. The simulation runs on a
+ * single thread, which is why the counters need no synchronization.
+ *
+ * The global values live as long as the process so that e.g. the runner can average over
+ * several simulations. The values per node are kept in NodeEntry::statistics and the
+ * CherrySim takes snapshots of the global values for a time series if
+ * simConfig.statisticSnapshotIntervalMs is set.
+ */
+class SimStatistics
+{
+public:
+    enum class Type : u8
+    {
+        COUNT,
+        AVG,
+    };
+    static constexpr u32 INVALID_HANDLE = UINT32_MAX;
+
+private:
+    struct Entry
+    {
+        std::string key;
+        Type type;
+    };
+    static std::vector<Entry> entries;
+    static std::map<std::pair<Type, std::string>, u32> handlesByKey;
+    static std::vector<SimStatValue> globalValues;
+
+public:
+    //Returns the handle of an already registered key of the same type
+    static u32 Register(const char* key, Type type);
+    static u32 FindHandle(const std::string& key, Type type);
+    static u32 GetAmountOfStatistics();
+    static const std::string& GetKey(u32 handle);
+    static Type GetType(u32 handle);
+
+    //nodeValues may be nullptr if the value was not collected by a node
+    static void Collect(u32 handle, i32 value, std::vector<SimStatValue>* nodeValues)
+    {
+        SimStatValue& globalValue = globalValues[handle];
+        globalValue.count++;
+        globalValue.total += value;
+        if (nodeValues != nullptr)
+        {
+            if (nodeValues->size() <= handle) nodeValues->resize(entries.size());
+            SimStatValue& nodeValue = (*nodeValues)[handle];
+            nodeValue.count++;
+            nodeValue.total += value;
+        }
+    }
+
+    static const std::vector<SimStatValue>& GetGlobalValues();
+    static void ClearGlobalValues();
+    //Returns an empty value if the statistic was never collected in the given values
+    static SimStatValue GetValue(const std::vector<SimStatValue>& values, u32 handle);
+
+    static void Print(const std::vector<SimStatValue>& values);
+    //One row per snapshot with the count of each counter and the average of each average
+    static bool WriteTimeSeriesCsv(const std::string& path, const std::vector<SimStatSnapshot>& snapshots);
+};
@@ -0,0 +1,424 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include <SimSweep.h>
+#include <CherrySim.h>
+#include <Exceptions.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <typeinfo>
+
+namespace
+{
+    constexpr char MESH_CONNECTION_INTERVAL_PARAMETER[] = "meshConnectionInterval";
+
+    std::string EscapeCsv(const std::string& value)
+    {
+        if (value.find_first_of(",\"\n") == std::string::npos) return value;
+
+        std::string escaped = "\"";
+        for (char c : value)
+        {
+            if (c == '"') escaped += '"';
+            escaped += c;
+        }
+        return escaped + "\"";
+    }
+
+    //Splits a row into its fields and undoes EscapeCsv
+    std::vector<std::string> SplitCsvRow(const std::string& row)
+    {
+        std::vector<std::string> fields(1);
+        bool quoted = false;
+        for (size_t i = 0; i < row.size(); i++)
+        {
+            const char c = row[i];
+            if (quoted && c == '"' && i + 1 < row.size() && row[i + 1] == '"')
+            {
+                fields.back() += c;
+                i++;
+            }
+            else if (c == '"') quoted = !quoted;
+            else if (c == ',' && !quoted) fields.emplace_back();
+            else fields.back() += c;
+        }
+        return fields;
+    }
+
+    u32 GetMilliSecondsSince(const std::chrono::steady_clock::time_point& startTime)
+    {
+        return (u32)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+    }
+}
+
+SimSweep::SimSweep(const nlohmann::json& description, const SimConfiguration& baseConfiguration)
+    : baseConfiguration(baseConfiguration)
+{
+    for (nlohmann::json::const_iterator it = description.begin(); it != description.end(); ++it)
+    {
+        if (it.key() == "baseConfiguration")
+        {
+            //Entries replace the ones of the given base configuration as a whole, e.g. the complete nodeConfigName
+            for (nlohmann::json::const_iterator entry = it->begin(); entry != it->end(); ++entry)
+            {
+                this->baseConfiguration[entry.key()] = entry.value();
+            }
+        }
+        else if (it.key() == "parameters")
+        {
+            for (nlohmann::json::const_iterator parameter = it->begin(); parameter != it->end(); ++parameter)
+            {
+                if (!parameter->is_array() || parameter->empty())
+                {
+                    printf("Sweep parameter %s must be a non empty array of values" EOL, parameter.key().c_str());
+                    SIMEXCEPTIONFORCE(IllegalArgumentException);
+                }
+                parameterNames.push_back(parameter.key());
+                parameterValues.push_back(parameter.value());
+                numRuns *= (u32)parameter->size();
+            }
+        }
+        else if (it.key() == "maxSimTimeMs"            ) maxSimTimeMs             = *it;
+        else if (it.key() == "simTimeAfterClusteringMs") simTimeAfterClusteringMs = *it;
+        else if (it.key() == "batteryCapacityMah"      ) batteryCapacityMah       = *it;
+        else if (it.key() == "workers"                 ) numWorkers               = *it;
+        else if (it.key() == "resultPath"              ) resultPath               = it->get<std::string>();
+        else SIMEXCEPTIONFORCE(UnknownJsonEntryException);
+    }
+
+    if (numWorkers == 0) numWorkers = std::max(1u, std::thread::hardware_concurrency());
+
+    //Make sure that all runs can be configured before the first one is started
+    for (u32 i = 0; i < numRuns; i++)
+    {
+        CreateRunConfiguration(i);
+    }
+}
+
+nlohmann::json SimSweep::LoadDescription(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        SIMEXCEPTIONFORCE(FileException);
+    }
+    nlohmann::json description;
+    file >> description;
+    return description;
+}
+
+u32 SimSweep::GetNumRuns() const
+{
+    return numRuns;
+}
+
+u32 SimSweep::GetNumWorkers() const
+{
+    return numWorkers;
+}
+
+const std::string& SimSweep::GetResultPath() const
+{
+    return resultPath;
+}
+
+nlohmann::json SimSweep::GetRunParameters(u32 runIndex) const
+{
+    if (runIndex >= numRuns)
+    {
+        SIMEXCEPTIONFORCE(IllegalArgumentException);
+    }
+
+    //The run index is a mixed radix number in which the last parameter changes fastest
+    nlohmann::json parameters = nlohmann::json::object();
+    for (size_t i = parameterNames.size(); i-- > 0;)
+    {
+        const u32 numValues = (u32)parameterValues[i].size();
+        parameters[parameterNames[i]] = parameterValues[i][runIndex % numValues];
+        runIndex /= numValues;
+    }
+    return parameters;
+}
+
+SimConfiguration SimSweep::CreateRunConfiguration(u32 runIndex) const
+{
+    nlohmann::json configJson = baseConfiguration;
+    const nlohmann::json parameters = GetRunParameters(runIndex);
+    for (nlohmann::json::const_iterator it = parameters.begin(); it != parameters.end(); ++it)
+    {
+        if (it.key() == MESH_CONNECTION_INTERVAL_PARAMETER) continue;
+        else if (it.key()[0] == '/') configJson[nlohmann::json::json_pointer(it.key())] = it.value();
+        else configJson[it.key()] = it.value();
+    }
+
+    SimConfiguration config;
+    from_json(configJson, config);
+    return config;
+}
+
+SimSweepRunResult SimSweep::ExecuteRun(u32 runIndex) const
+{
+    const auto startTime = std::chrono::steady_clock::now();
+    const nlohmann::json parameters = GetRunParameters(runIndex);
+    const bool setConnectionInterval = parameters.contains(MESH_CONNECTION_INTERVAL_PARAMETER);
+    const u16 connectionInterval = setConnectionInterval ? parameters[MESH_CONNECTION_INTERVAL_PARAMETER].get<u16>() : 0;
+
+    SimSweepRunResult result;
+    result.runIndex = runIndex;
+
+    CherrySim sim(CreateRunConfiguration(runIndex));
+    sim.energyModel.batteryCapacityMah = batteryCapacityMah;
+    try
+    {
+        sim.Init();
+        for (u32 i = 0; i < sim.GetTotalNodes(); i++)
+        {
+#ifdef GITHUB_RELEASE
+            sim.nodes[i].nodeConfiguration = sim.RedirectFeatureset(sim.nodes[i].nodeConfiguration);
+#endif
+            NodeIndexSetter setter(i);
+            sim.BootCurrentNode();
+        }
+
+        //The connection interval is set once after every boot of a node, as a reboot resets the configuration
+        std::vector<u32> configuredRestartCounters(sim.GetTotalNodes(), 0);
+
+        u32 stopTimeMs = maxSimTimeMs;
+        while (sim.simState.simTimeMs < stopTimeMs)
+        {
+            for (u32 i = 0; i < sim.GetTotalNodes() && setConnectionInterval; i++)
+            {
+                if (sim.nodes[i].restartCounter == configuredRestartCounters[i]) continue;
+                sim.nodes[i].gs.config.meshMinConnectionInterval = connectionInterval;
+                sim.nodes[i].gs.config.meshMaxConnectionInterval = connectionInterval;
+                configuredRestartCounters[i] = sim.nodes[i].restartCounter;
+            }
+
+            sim.SimulateStepForAllNodes();
+
+            if (!result.clustered && sim.IsClusteringDone())
+            {
+                result.clustered = true;
+                result.clusteringTimeMs = sim.simState.simTimeMs;
+                stopTimeMs = std::min(maxSimTimeMs, sim.simState.simTimeMs + simTimeAfterClusteringMs);
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        result.status = std::string("exception ") + typeid(e).name();
+    }
+
+    result.simTimeMs = sim.simState.simTimeMs;
+    uint64_t totalCurrentMicroAmpere = 0;
+    for (u32 i = 0; i < sim.GetTotalNodes() && result.simTimeMs > 0; i++)
+    {
+        result.droppedMeshPackets += sim.nodes[i].gs.cm.droppedMeshPackets;
+
+        const u32 currentMicroAmpere = (u32)sim.nodes[i].energy.GetAverageCurrentMicroAmpere(result.simTimeMs);
+        totalCurrentMicroAmpere += currentMicroAmpere;
+        result.maxCurrentMicroAmpere = std::max(result.maxCurrentMicroAmpere, currentMicroAmpere);
+    }
+    if (sim.GetTotalNodes() > 0) result.avgCurrentMicroAmpere = (u32)(totalCurrentMicroAmpere / sim.GetTotalNodes());
+    //The node with the highest current is the first one that runs out of battery
+    if (result.maxCurrentMicroAmpere > 0) result.batteryLifeDays = sim.energyModel.EstimateBatteryLifeDays(result.maxCurrentMicroAmpere);
+
+    result.wallTimeMs = GetMilliSecondsSince(startTime);
+    return result;
+}
+
+std::string SimSweep::GetCsvHeader() const
+{
+    std::string header = "runIndex";
+    for (const std::string& name : parameterNames)
+    {
+        header += "," + EscapeCsv(name);
+    }
+    header += ",status,clustered,clusteringTimeMs,simTimeMs,droppedMeshPackets,avgCurrentMicroAmpere,maxCurrentMicroAmpere,batteryLifeDays,wallTimeMs";
+    return header;
+}
+
+std::string SimSweep::GetCsvRow(const SimSweepRunResult& result) const
+{
+    std::string row = std::to_string(result.runIndex);
+    const nlohmann::json parameters = GetRunParameters(result.runIndex);
+    for (const std::string& name : parameterNames)
+    {
+        const nlohmann::json& value = parameters[name];
+        row += "," + EscapeCsv(value.is_string() ? value.get<std::string>() : value.dump());
+    }
+    row += "," + EscapeCsv(result.status);
+    row += "," + std::to_string(result.clustered ? 1 : 0);
+    row += "," + std::to_string(result.clusteringTimeMs);
+    row += "," + std::to_string(result.simTimeMs);
+    row += "," + std::to_string(result.droppedMeshPackets);
+    row += "," + std::to_string(result.avgCurrentMicroAmpere);
+    row += "," + std::to_string(result.maxCurrentMicroAmpere);
+    row += "," + std::to_string(result.batteryLifeDays);
+    row += "," + std::to_string(result.wallTimeMs);
+    return row;
+}
+
+std::set<u32> SimSweep::LoadCompletedRuns() const
+{
+    std::set<u32> completedRuns;
+    std::ifstream file(resultPath);
+    std::string line;
+    if (!file || !std::getline(file, line)) return completedRuns;
+
+    if (line != GetCsvHeader())
+    {
+        //Resuming only works if the parameters did not change, otherwise the run indices have a different meaning
+        printf("The result file %s belongs to a different sweep" EOL, resultPath.c_str());
+        SIMEXCEPTIONFORCE(IllegalArgumentException);
+    }
+
+    //Runs that crashed or threw an exception are retried, they get another row once they are done
+    const size_t statusColumn = 1 + parameterNames.size();
+    while (std::getline(file, line))
+    {
+        if (line.empty()) continue;
+        const std::vector<std::string> fields = SplitCsvRow(line);
+        if (fields.size() > statusColumn && fields[statusColumn] == "ok")
+        {
+            completedRuns.insert((u32)std::stoul(fields[0]));
+        }
+    }
+    return completedRuns;
+}
+
+std::string SimSweep::GetRunResultPath(u32 runIndex) const
+{
+    return resultPath + ".run" + std::to_string(runIndex);
+}
+
+bool SimSweep::ExecuteRunAndStoreResult(u32 runIndex) const
+{
+    const SimSweepRunResult result = ExecuteRun(runIndex);
+
+    //Written to a temporary file first so that a crash never leaves a partial row behind
+    const std::string path = GetRunResultPath(runIndex);
+    {
+        std::ofstream file(path + ".tmp", std::ios::trunc);
+        file << GetCsvRow(result) << "\n";
+    }
+    std::remove(path.c_str());
+    std::rename((path + ".tmp").c_str(), path.c_str());
+
+    return result.status == "ok";
+}
+
+void SimSweep::Run(const std::string& executablePath, const std::string& descriptionPath) const
+{
+    const std::set<u32> completedRuns = LoadCompletedRuns();
+    std::vector<u32> pendingRuns;
+    for (u32 i = 0; i < numRuns; i++)
+    {
+        if (completedRuns.count(i) == 0) pendingRuns.push_back(i);
+    }
+    printf("Sweep: %u runs, %u already done, %u workers" EOL, numRuns, (u32)completedRuns.size(), numWorkers);
+
+    //The header of an existing result file was already checked by LoadCompletedRuns
+    bool isNewResultFile = false;
+    {
+        std::ifstream existingFile(resultPath);
+        isNewResultFile = !existingFile || existingFile.peek() == std::ifstream::traits_type::eof();
+    }
+
+    std::ofstream resultFile(resultPath, std::ios::app);
+    if (!resultFile)
+    {
+        SIMEXCEPTIONFORCE(FileException);
+    }
+    if (isNewResultFile) resultFile << GetCsvHeader() << "\n" << std::flush;
+
+    std::atomic<u32> nextPendingRun{ 0 };
+    std::mutex resultMutex;
+    u32 numFinished = 0;
+
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            const u32 pendingIndex = nextPendingRun++;
+            if (pendingIndex >= pendingRuns.size()) return;
+            const u32 runIndex = pendingRuns[pendingIndex];
+            const std::string runResultPath = GetRunResultPath(runIndex);
+            const std::string logPath = runResultPath + ".log";
+            std::remove(runResultPath.c_str());
+
+            const auto startTime = std::chrono::steady_clock::now();
+            std::string command = "\"" + executablePath + "\" \"Sweep=" + descriptionPath + "\" SweepRun=" + std::to_string(runIndex) + " > \"" + logPath + "\" 2>&1";
+#ifdef _WIN32
+            //cmd.exe strips the outer quotes if the command starts with a quote
+            command = "\"" + command + "\"";
+#endif
+            const int exitCode = std::system(command.c_str());
+
+            std::string row;
+            {
+                std::ifstream runResultFile(runResultPath);
+                std::getline(runResultFile, row);
+            }
+            std::remove(runResultPath.c_str());
+            if (row.empty())
+            {
+                SimSweepRunResult result;
+                result.runIndex = runIndex;
+                result.status = "crashed with exit code " + std::to_string(exitCode);
+                result.wallTimeMs = GetMilliSecondsSince(startTime);
+                row = GetCsvRow(result);
+            }
+            //Logs are only kept for runs that did not finish normally
+            if (exitCode == 0) std::remove(logPath.c_str());
+
+            std::lock_guard<std::mutex> guard(resultMutex);
+            resultFile << row << "\n" << std::flush;
+            numFinished++;
+            printf("[%u/%u] %s" EOL, numFinished, (u32)pendingRuns.size(), row.c_str());
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (u32 i = 0; i < std::min(numWorkers, (u32)pendingRuns.size()); i++)
+    {
+        workers.emplace_back(worker);
+    }
+    for (std::thread& thread : workers)
+    {
+        thread.join();
+    }
+    printf("Sweep done, results are in %s" EOL, resultPath.c_str());
+}
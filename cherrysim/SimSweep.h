@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <FmTypes.h>
+#include <CherrySimTypes.h>
+#include "json.hpp"
+#include <set>
+#include <string>
+#include <vector>
+
+/*
+ * Runs the same scenario for every combination of a set of parameters and collects
+ * some metrics of each run into a single csv file. The description is a json file:
+ *
+ * {
+ *   "baseConfiguration": { "nodeConfigName": { "prod_sink_nrf52": 1 }, "simulateAsyncFlash": true },
+ *   "parameters": {
+ *     "seed": [1, 2, 3],
+ *     "mapWidthInMeters": [60, 120],
+ *     "/nodeConfigName/prod_mesh_nrf52": [10, 50, 100],
+ *     "meshConnectionInterval": [12, 24]
+ *   },
+ *   "maxSimTimeMs": 600000,
+ *   "simTimeAfterClusteringMs": 60000,
+ *   "batteryCapacityMah": 220,
+ *   "workers": 0,
+ *   "resultPath": "sweep.csv"
+ * }
+ *
+ * Parameter names are SimConfiguration entries, json pointers into the SimConfiguration
+ * (starting with a "/") or meshConnectionInterval, which sets the mesh connection interval
+ * of all nodes in 1.25ms units. A run simulates until the mesh is clustered or maxSimTimeMs
+ * is reached and continues for simTimeAfterClusteringMs afterwards.
+ *
+ * Every run is executed in its own process so that runs can be distributed over all cores
+ * and a crashing run does not stop the sweep. The result file is appended after each run.
+ * Restarting an interrupted sweep skips all runs that already have a row with the status "ok"
+ * in the result file. Runs that crashed or threw an exception are executed again.
+ */
+
+struct SimSweepRunResult
+{
+    u32 runIndex = 0;
+    std::string status = "ok";
+    bool clustered = false;
+    u32 clusteringTimeMs = 0;
+    u32 simTimeMs = 0;
+    u32 droppedMeshPackets = 0;
+    u32 avgCurrentMicroAmpere = 0;
+    u32 maxCurrentMicroAmpere = 0;
+    u32 batteryLifeDays = 0;
+    u32 wallTimeMs = 0;
+};
+
+class SimSweep
+{
+public:
+    //baseConfiguration is used for all entries that are neither given in the baseConfiguration of the description nor as a parameter.
+    SimSweep(const nlohmann::json& description, const SimConfiguration& baseConfiguration);
+    static nlohmann::json LoadDescription(const std::string& path);
+
+    u32 GetNumRuns() const;
+    u32 GetNumWorkers() const;
+    const std::string& GetResultPath() const;
+
+    //Returns the value of every parameter for the given run.
+    nlohmann::json GetRunParameters(u32 runIndex) const;
+    SimConfiguration CreateRunConfiguration(u32 runIndex) const;
+
+    //Executes a single run in this process.
+    SimSweepRunResult ExecuteRun(u32 runIndex) const;
+
+    //Executes all runs that are not yet part of the result file in worker processes that are started using
+    //the given executable. The executable must call ExecuteRunAndStoreResult for "SweepRun=<runIndex>".
+    void Run(const std::string& executablePath, const std::string& descriptionPath) const;
+    //Returns true if the run finished without an exception.
+    bool ExecuteRunAndStoreResult(u32 runIndex) const;
+
+    std::string GetCsvHeader() const;
+    std::string GetCsvRow(const SimSweepRunResult& result) const;
+    std::set<u32> LoadCompletedRuns() const;
+
+private:
+    nlohmann::json baseConfiguration;
+    std::vector<std::string> parameterNames;
+    std::vector<nlohmann::json> parameterValues;
+    u32 numRuns = 1;
+    u32 maxSimTimeMs = 10 * 60 * 1000;
+    u32 simTimeAfterClusteringMs = 0;
+    u32 batteryCapacityMah = 220;
+    u32 numWorkers = 0;
+    std::string resultPath = "sweep.csv";
+
+    std::string GetRunResultPath(u32 runIndex) const;
+};
@@ -0,0 +1,312 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include <SimTerminalMux.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+
+SimTerminalMux::SimTerminalMux(const CommandSender& commandSender, const NodeListGetter& nodeListGetter, const ClusterResolver& clusterResolver, u32 scrollbackLines)
+    : scrollbackLines(std::max(scrollbackLines, 1u)),
+    commandSender(commandSender),
+    nodeListGetter(nodeListGetter),
+    clusterResolver(clusterResolver)
+{
+}
+
+void SimTerminalMux::Append(NodeId nodeId, const char* text)
+{
+    NodeBuffer& buffer = buffers[nodeId];
+    const char* lineStart = text;
+    for (const char* c = text; *c != '\0'; c++)
+    {
+        if (*c != '\n') continue;
+        buffer.partialLine.append(lineStart, c - lineStart);
+        AddLine(nodeId, buffer, buffer.partialLine);
+        lineStart = c + 1;
+    }
+    buffer.partialLine.append(lineStart);
+}
+
+void SimTerminalMux::AddLine(NodeId nodeId, NodeBuffer& buffer, std::string& text)
+{
+    if (!text.empty() && text.back() == '\r') text.pop_back();
+
+    if (buffer.lines.size() >= scrollbackLines) buffer.lines.pop_front();
+    buffer.lines.push_back({ nextSequence++, nodeId, std::move(text) });
+    text.clear();
+
+    if (!paused && IsInView(buffer.lines.back())) AppendToOutput(buffer.lines.back());
+}
+
+bool SimTerminalMux::ParseNumber(const std::string& text, u32 maxValue, u32& value)
+{
+    //Leading zeros do not select octal, just like in the terminal commands of the nodes
+    const bool isHex = text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+    const char* digits = text.c_str() + (isHex ? 2 : 0);
+    if (!isxdigit((unsigned char)digits[0]) || (!isHex && !isdigit((unsigned char)digits[0]))) return false;
+    errno = 0;
+    char* end = nullptr;
+    const unsigned long long number = strtoull(digits, &end, isHex ? 16 : 10);
+    if (errno != 0 || *end != '\0' || number > maxValue) return false;
+    value = (u32)number;
+    return true;
+}
+
+std::string SimTerminalMux::GetTag(const std::string& line)
+{
+    //Log lines of the prompt mode: "0001234:2:[Node.cpp@123 NODE]: message"
+    const size_t end = line.find("]: ");
+    if (end != std::string::npos)
+    {
+        const size_t start = line.rfind(' ', end);
+        const size_t bracket = line.rfind('[', end);
+        if (start != std::string::npos && bracket != std::string::npos && start > bracket)
+        {
+            return line.substr(start + 1, end - start - 1);
+        }
+    }
+    //Log lines of the json mode: {"type":"log","tag":"NODE",...
+    const size_t jsonTag = line.find("\"tag\":\"");
+    if (jsonTag != std::string::npos)
+    {
+        const size_t start = jsonTag + 7;
+        const size_t jsonEnd = line.find('"', start);
+        if (jsonEnd != std::string::npos) return line.substr(start, jsonEnd - start);
+    }
+    return "";
+}
+
+bool SimTerminalMux::IsInView(const Line& line) const
+{
+    if (!viewAllNodes && viewNodes.count(line.nodeId) == 0) return false;
+    if (!viewTags.empty() && viewTags.count(GetTag(line.text)) == 0) return false;
+    return true;
+}
+
+void SimTerminalMux::AppendToOutput(const Line& line)
+{
+    //A single node is already known from the view, for multiple nodes each line is prefixed
+    if (viewAllNodes || viewNodes.size() > 1)
+    {
+        output += std::to_string(line.nodeId);
+        output += "| ";
+    }
+    output += line.text;
+    output += EOL;
+}
+
+std::vector<const SimTerminalMux::Line*> SimTerminalMux::GetViewLines(u32 amountOfLines) const
+{
+    std::vector<const Line*> lines;
+    for (const auto& entry : buffers)
+    {
+        if (!viewAllNodes && viewNodes.count(entry.first) == 0) continue;
+        //Only the newest lines of each node can be part of the result
+        u32 amountOfNodeLines = 0;
+        for (auto it = entry.second.lines.rbegin(); it != entry.second.lines.rend() && amountOfNodeLines < amountOfLines; ++it)
+        {
+            if (!IsInView(*it)) continue;
+            lines.push_back(&*it);
+            amountOfNodeLines++;
+        }
+    }
+    std::sort(lines.begin(), lines.end(), [](const Line* a, const Line* b) { return a->sequence < b->sequence; });
+    if (lines.size() > amountOfLines) lines.erase(lines.begin(), lines.end() - amountOfLines);
+    return lines;
+}
+
+const std::deque<SimTerminalMux::Line>* SimTerminalMux::GetNodeLines(NodeId nodeId) const
+{
+    const auto entry = buffers.find(nodeId);
+    return entry != buffers.end() ? &entry->second.lines : nullptr;
+}
+
+void SimTerminalMux::PrintScrollback(u32 amountOfLines)
+{
+    output += "---- scrollback ----" EOL;
+    for (const Line* line : GetViewLines(amountOfLines))
+    {
+        AppendToOutput(*line);
+    }
+    output += "--------------------" EOL;
+}
+
+void SimTerminalMux::PrintView()
+{
+    std::string description = "mux: showing ";
+    if (viewAllNodes)
+    {
+        description += "all nodes";
+    }
+    else
+    {
+        std::vector<NodeId> nodes(viewNodes.begin(), viewNodes.end());
+        std::sort(nodes.begin(), nodes.end());
+        description += "nodes";
+        for (const NodeId nodeId : nodes) description += " " + std::to_string(nodeId);
+    }
+    if (!viewTags.empty())
+    {
+        description += ", tags";
+        for (const std::string& tag : viewTags) description += " " + tag;
+    }
+    if (paused) description += " (paused)";
+    output += description + EOL;
+}
+
+void SimTerminalMux::SendToView(const std::string& command)
+{
+    const std::vector<NodeId> nodes = viewAllNodes ? nodeListGetter() : std::vector<NodeId>(viewNodes.begin(), viewNodes.end());
+    for (const NodeId nodeId : nodes)
+    {
+        commandSender(nodeId, command);
+    }
+}
+
+void SimTerminalMux::HandleInput(const std::string& input)
+{
+    if (input.empty()) return;
+    if (input[0] != ':')
+    {
+        SendToView(input);
+        return;
+    }
+
+    std::istringstream stream(input.substr(1));
+    std::string command;
+    stream >> command;
+    std::vector<std::string> args;
+    for (std::string arg; stream >> arg;) args.push_back(arg);
+
+    std::vector<NodeId> nodeIds;
+    bool didError = false;
+    if (command == "node" || command == "cluster" || command == "send")
+    {
+        const size_t amountOfIds = command == "node" ? args.size() : std::min<size_t>(args.size(), 1);
+        for (size_t i = 0; i < amountOfIds; i++)
+        {
+            u32 nodeId = 0;
+            didError = !ParseNumber(args[i], UINT16_MAX, nodeId);
+            if (didError) break;
+            nodeIds.push_back((NodeId)nodeId);
+        }
+        if (nodeIds.empty() || didError)
+        {
+            output += "mux: expected a node id, see :help" EOL;
+            return;
+        }
+    }
+
+    if (command == "all")
+    {
+        viewAllNodes = true;
+        viewNodes.clear();
+        PrintView();
+    }
+    else if (command == "node" || command == "cluster")
+    {
+        if (command == "cluster") nodeIds = clusterResolver(nodeIds[0]);
+        viewAllNodes = false;
+        viewNodes = std::unordered_set<NodeId>(nodeIds.begin(), nodeIds.end());
+        PrintView();
+    }
+    else if (command == "tag")
+    {
+        viewTags = std::unordered_set<std::string>(args.begin(), args.end());
+        PrintView();
+    }
+    else if (command == "back")
+    {
+        u32 amountOfLines = 50;
+        if (!args.empty() && !ParseNumber(args[0], UINT32_MAX, amountOfLines))
+        {
+            output += "mux: expected an amount of lines, see :help" EOL;
+            return;
+        }
+        PrintScrollback(amountOfLines);
+    }
+    else if (command == "pause" || command == "resume")
+    {
+        paused = command == "pause";
+        PrintView();
+    }
+    else if (command == "send" || command == "bcast")
+    {
+        //The command is everything after the node id, including its original spacing
+        const size_t skippedWords = command == "send" ? 2 : 1;
+        size_t position = 1;
+        for (size_t i = 0; i < skippedWords && position != std::string::npos; i++)
+        {
+            position = input.find_first_not_of(' ', position);
+            if (position != std::string::npos) position = input.find(' ', position);
+        }
+        position = position == std::string::npos ? std::string::npos : input.find_first_not_of(' ', position);
+        if (position == std::string::npos)
+        {
+            output += "mux: missing command, see :help" EOL;
+            return;
+        }
+        if (command == "send")
+        {
+            commandSender(nodeIds[0], input.substr(position));
+        }
+        else
+        {
+            for (const NodeId nodeId : nodeListGetter()) commandSender(nodeId, input.substr(position));
+        }
+    }
+    else if (command == "help")
+    {
+        output +=
+            "mux commands:" EOL
+            "  :all                    show the output of all nodes" EOL
+            "  :node <id> [<id> ...]   show the output of the given nodes" EOL
+            "  :cluster <id>           show the output of all nodes in the current cluster of the given node" EOL
+            "  :tag [<tag> ...]        only show log lines with one of the tags, no tags to show everything" EOL
+            "  :back [<lines>]         print the last lines of the view (default 50)" EOL
+            "  :pause / :resume        stop or continue printing new lines, they are still stored" EOL
+            "  :send <id> <command>    send a command to a single node" EOL
+            "  :bcast <command>        send a command to all nodes" EOL
+            "  <command>               send a command to all nodes of the view" EOL;
+    }
+    else
+    {
+        output += "mux: unknown command, see :help" EOL;
+    }
+}
+
+std::string SimTerminalMux::TakeOutput()
+{
+    std::string result;
+    result.swap(output);
+    return result;
+}
@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <FmTypes.h>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/*
+ * Splits the terminal output of a simulation by node, so that big simulations can be followed
+ * in the CherrySimRunner (start it with "TerminalMux").
+ *
+ * Every node has a scrollback with the last lines that it printed. The view selects the nodes
+ * (all nodes, a list of nodes or the nodes of a cluster) and optionally the log tags that are
+ * shown. New lines in the view are collected and printed once per simulation step, the lines of
+ * all other nodes are only stored. Logging from many nodes therefore costs little more than
+ * appending to a string.
+ *
+ * Input lines that start with ':' control the multiplexer (see ":help"), all other lines are
+ * sent as a terminal command to every node in the view.
+ */
+class SimTerminalMux
+{
+public:
+    static constexpr u32 DEFAULT_SCROLLBACK_LINES = 1000;
+    static constexpr NodeId SIMULATOR_NODE_ID = 0; //Used for output that does not belong to a node
+
+    using CommandSender = std::function<void(NodeId nodeId, const std::string& command)>;
+    using NodeListGetter = std::function<std::vector<NodeId>()>;
+    using ClusterResolver = std::function<std::vector<NodeId>(NodeId nodeId)>; //Returns all nodes in the cluster of the given node
+
+    struct Line
+    {
+        uint64_t sequence = 0; //Order of the lines of all nodes
+        NodeId nodeId = 0;
+        std::string text; //Without the line break
+    };
+
+private:
+    struct NodeBuffer
+    {
+        std::string partialLine;
+        std::deque<Line> lines;
+    };
+
+    u32 scrollbackLines;
+    uint64_t nextSequence = 0;
+    std::unordered_map<NodeId, NodeBuffer> buffers;
+
+    bool viewAllNodes = true;
+    std::unordered_set<NodeId> viewNodes;
+    std::unordered_set<std::string> viewTags; //Empty if all tags are shown
+    bool paused = false;
+    std::string output;
+
+    CommandSender commandSender;
+    NodeListGetter nodeListGetter;
+    ClusterResolver clusterResolver;
+
+    void AddLine(NodeId nodeId, NodeBuffer& buffer, std::string& text);
+    bool IsInView(const Line& line) const;
+    void AppendToOutput(const Line& line);
+    void PrintScrollback(u32 amountOfLines);
+    void PrintView();
+    void SendToView(const std::string& command);
+
+public:
+    SimTerminalMux(const CommandSender& commandSender, const NodeListGetter& nodeListGetter, const ClusterResolver& clusterResolver, u32 scrollbackLines = DEFAULT_SCROLLBACK_LINES);
+
+    //Called with everything that a node (or the simulator) prints, may contain partial or multiple lines
+    void Append(NodeId nodeId, const char* text);
+    void HandleInput(const std::string& input);
+    //Returns everything that should be printed since the last call
+    std::string TakeOutput();
+
+    //Returns the log tag of a line, e.g. "NODE" for "0001234:2:[Node.cpp@123 NODE]: ..." or for json logs, empty if there is none
+    static std::string GetTag(const std::string& line);
+    //Parses a decimal or 0x prefixed hex number without any node bound helpers, as there is no current node while
+    //the mux handles input. Returns false if the text is not a number or larger than maxValue.
+    static bool ParseNumber(const std::string& text, u32 maxValue, u32& value);
+    //Returns the newest lines of the view, oldest first
+    std::vector<const Line*> GetViewLines(u32 amountOfLines) const;
+    const std::deque<Line>* GetNodeLines(NodeId nodeId) const;
+};
@@ -35,34 +35,30 @@
 
 std::vector<const void*> StackWatcher::stackBase;
 u32 StackWatcher::disableValue = 0;
+uintptr_t StackWatcher::stackLimit = 0;
 
-void StackWatcher::Check()
+void StackWatcher::UpdateStackLimit()
 {
-    if (stackBase.size() == 0)
+    if (stackBase.size() == 0 || disableValue != 0)
     {
         //Test is disabled if no stack base is set.
+        stackLimit = 0;
         return;
     }
-    if (StackWatcher::disableValue != 0)
-    {
-        return;
-    }
-
-    int someDummyStackVariable = 0;
-
-    const u32 uncleanedStackSize = (const char*)StackWatcher::stackBase.back() - (const char*)&someDummyStackVariable;
-    const u32 cleanedStackSize = uncleanedStackSize - sizeof(StackBaseSetter);
+    const uintptr_t base = (uintptr_t)stackBase.back();
+    const uintptr_t maxSize = MAX_STACK_SIZE + sizeof(StackBaseSetter);
+    stackLimit = base > maxSize ? base - maxSize : 0;
+}
 
-    if (cleanedStackSize > 12000)
-    {
+void StackWatcher::ReportStackOverflow()
+{
 #if !defined(GITHUB_RELEASE) && !defined(__clang__)
-        SIMEXCEPTION(StackOverflowException);
+    SIMEXCEPTION(StackOverflowException);
 #else
-        //The "GITHUB_RELEASE" configuration executes only github featuresets which, by definition, consume much more RAM.
-        //__clang__ has vastly different stack frames and is thus not supported as well. As this is just a sanity check,
-        //supporting one compiler for the pipeline and one for local runs is sufficient.
+    //The "GITHUB_RELEASE" configuration executes only github featuresets which, by definition, consume much more RAM.
+    //__clang__ has vastly different stack frames and is thus not supported as well. As this is just a sanity check,
+    //supporting one compiler for the pipeline and one for local runs is sufficient.
 #endif //GITHUB_RELEASE
-    }
 }
 
 StackBaseSetter::StackBaseSetter()
@@ -72,19 +68,23 @@ StackBaseSetter::StackBaseSetter()
     // given to the container anywhere. We just care about value of the pointer itself.
     // cppcheck-suppress danglingLifetime
     StackWatcher::stackBase.push_back(&someDummyStackVariable);
+    StackWatcher::UpdateStackLimit();
 }
 
 StackBaseSetter::~StackBaseSetter()
 {
     StackWatcher::stackBase.pop_back();
+    StackWatcher::UpdateStackLimit();
 }
 
 StackWatcherDisabler::StackWatcherDisabler()
 {
     StackWatcher::disableValue++;
+    StackWatcher::UpdateStackLimit();
 }
 
 StackWatcherDisabler::~StackWatcherDisabler()
 {
     StackWatcher::disableValue--;
+    StackWatcher::UpdateStackLimit();
 }
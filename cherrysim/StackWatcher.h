@@ -29,6 +29,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #pragma once
+#include <cstdint>
 #include <vector>
 
 class StackBaseSetter
@@ -52,10 +53,25 @@ class StackWatcher
     friend StackBaseSetter;
     friend StackWatcherDisabler;
 private:
+    static constexpr u32 MAX_STACK_SIZE = 12000;
+
     static std::vector<const void*> stackBase;
     static u32 disableValue;
+    //Lowest allowed stack address for the current stack base, 0 if no check is done. Stacks grow downwards
+    //on all supported platforms, so the check only has to compare the address of a local variable with it.
+    static uintptr_t stackLimit;
 
-public:
-    static void Check();
+    static void UpdateStackLimit();
+    static void ReportStackOverflow();
 
+public:
+    //Called at the start of every instrumented function (see START_OF_FUNCTION), which is why it is inline
+    static void Check()
+    {
+        const int someDummyStackVariable = 0;
+        if ((uintptr_t)&someDummyStackVariable < stackLimit)
+        {
+            ReportStackOverflow();
+        }
+    }
 };
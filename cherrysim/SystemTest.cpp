@@ -39,10 +39,11 @@
 #include <Logger.h>
 #include <fstream>
 #include <limits>
+#include <SimAes.h>
+#include <SimStatistics.h>
 
 extern "C" {
 #include <app_timer.h>
-#include <aes.h>
 }
 
 /**
@@ -56,11 +57,11 @@ All calls work in conjunction with helper methods and simulation routines define
 using json = nlohmann::json;
 
 //These variables are normally defined by the linker sections, so we need to define them here
-uint32_t __application_start_address;
-uint32_t __application_end_address;
-uint32_t __application_ram_start_address;
-uint32_t __start_conn_type_resolvers;
-uint32_t __stop_conn_type_resolvers;
+uintptr_t __application_start_address;
+uintptr_t __application_end_address;
+uintptr_t __application_ram_start_address;
+uintptr_t __start_conn_type_resolvers;
+uintptr_t __stop_conn_type_resolvers;
 
 //Pointer to FruityMesh state
 GlobalState* simGlobalStatePtr;
@@ -306,10 +307,10 @@ extern "C"
             //Was not initialized!
             SIMEXCEPTION(IllegalStateException);
         }
-        gyro->x = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
-        gyro->y = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
-        gyro->z = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
-        gyro->sensortime = cherrySimInstance->simState.rnd.NextU32();
+        gyro->x = (uint16_t)NODE_RANDOM(SENSOR).NextU32();
+        gyro->y = (uint16_t)NODE_RANDOM(SENSOR).NextU32();
+        gyro->z = (uint16_t)NODE_RANDOM(SENSOR).NextU32();
+        gyro->sensortime = NODE_RANDOM(SENSOR).NextU32();
         return BMG250_OK;
     }
 
@@ -387,10 +388,10 @@ extern "C"
             //Was not initialized!
             SIMEXCEPTION(IllegalStateException);
         }
-        out->x = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
-        out->y = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
-        out->z = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
-        out->temp = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
+        out->x = (uint16_t)NODE_RANDOM(SENSOR).NextU32();
+        out->y = (uint16_t)NODE_RANDOM(SENSOR).NextU32();
+        out->z = (uint16_t)NODE_RANDOM(SENSOR).NextU32();
+        out->temp = (uint16_t)NODE_RANDOM(SENSOR).NextU32();
         return 0;
     }
 
@@ -399,7 +400,7 @@ extern "C"
     uint32_t sd_ble_gap_adv_data_set(const uint8_t* p_data, uint8_t dlen, const uint8_t* p_sr_data, uint8_t srdlen)
     {
         START_OF_FUNCTION();
-        if (cherrySimInstance->simConfig.sdBleGapAdvDataSetFailProbability != 0 && PSRNG(cherrySimInstance->simConfig.sdBleGapAdvDataSetFailProbability)) {
+        if (cherrySimInstance->simConfig.sdBleGapAdvDataSetFailProbability != 0 && NODE_PSRNG(FIRMWARE, cherrySimInstance->simConfig.sdBleGapAdvDataSetFailProbability)) {
             printf("Simulated fail for sd_ble_gap_adv_data_set\n");
             return NRF_ERROR_INVALID_STATE;
         }
@@ -455,7 +456,7 @@ extern "C"
     uint32_t sd_ble_gap_adv_start(const ble_gap_adv_params_t* p_adv_params, uint32_t)
     {
         START_OF_FUNCTION();
-        if (PSRNG(cherrySimInstance->simConfig.sdBusyProbability)) {
+        if (NODE_PSRNG(FIRMWARE, cherrySimInstance->simConfig.sdBusyProbability)) {
             return NRF_ERROR_BUSY;
         }
 
@@ -636,9 +637,9 @@ extern "C"
             return (int32_t)ErrorType::NULL_ERROR;
         }
         axis3bit16_t* buffer = (axis3bit16_t*)buff;
-        buffer->i16bit[0] = (i16)cherrySimInstance->simState.rnd.NextU32();
-        buffer->i16bit[1] = (i16)cherrySimInstance->simState.rnd.NextU32();
-        buffer->i16bit[2] = (i16)cherrySimInstance->simState.rnd.NextU32();
+        buffer->i16bit[0] = (i16)NODE_RANDOM(SENSOR).NextU32();
+        buffer->i16bit[1] = (i16)NODE_RANDOM(SENSOR).NextU32();
+        buffer->i16bit[2] = (i16)NODE_RANDOM(SENSOR).NextU32();
 
         return (int32_t)ErrorType::SUCCESS;
 
@@ -787,7 +788,7 @@ extern "C"
             SIMEXCEPTION(IllegalStateException);
         }
 
-        return cherrySimInstance->simState.rnd.NextU32() % (std::numeric_limits<u16>::max() * 512);
+        return NODE_RANDOM(SENSOR).NextU32() % (std::numeric_limits<u16>::max() * 512);
     }
     int32_t bme280_get_temperature()
     {
@@ -797,7 +798,7 @@ extern "C"
             //Not initialized!
             SIMEXCEPTION(IllegalStateException);
         }
-        return ((int32_t)cherrySimInstance->simState.rnd.NextU32()) % std::numeric_limits<i16>::max();
+        return ((int32_t)NODE_RANDOM(SENSOR).NextU32()) % std::numeric_limits<i16>::max();
     }
     uint32_t bme280_get_humidity()
     {
@@ -808,7 +809,7 @@ extern "C"
             SIMEXCEPTION(IllegalStateException);
         }
 
-        return cherrySimInstance->simState.rnd.NextU32() % (std::numeric_limits<u8>::max() * 1024);
+        return NODE_RANDOM(SENSOR).NextU32() % (std::numeric_limits<u8>::max() * 1024);
     }
 
     uint32_t sd_ble_gap_connect(const ble_gap_addr_t* p_peer_addr, const ble_gap_scan_params_t* p_scan_params, const ble_gap_conn_params_t* p_conn_params, uint32_t)
@@ -818,7 +819,7 @@ extern "C"
             return NRF_ERROR_INVALID_STATE;
         }
 
-        if (PSRNG(cherrySimInstance->simConfig.sdBusyProbability)) {
+        if (NODE_PSRNG(FIRMWARE, cherrySimInstance->simConfig.sdBusyProbability)) {
             return NRF_ERROR_BUSY;
         }
 
@@ -887,7 +888,7 @@ extern "C"
     uint32_t sd_ble_gap_encrypt(uint16_t conn_handle, const ble_gap_master_id_t* p_master_id, const ble_gap_enc_info_t* p_enc_info)
     {
         START_OF_FUNCTION();
-        if (PSRNG(cherrySimInstance->simConfig.sdBusyProbability)) {
+        if (NODE_PSRNG(FIRMWARE, cherrySimInstance->simConfig.sdBusyProbability)) {
             return NRF_ERROR_BUSY;
         }
 
@@ -911,7 +912,7 @@ extern "C"
         s1.bleEvent.evt.gap_evt.params.sec_info_request.enc_info = 0; //TODO: incomplete information
         s1.bleEvent.evt.gap_evt.params.sec_info_request.id_info = 0; //TODO: incomplete information
         s1.bleEvent.evt.gap_evt.params.sec_info_request.sign_info = 0; //TODO: incomplete information
-        connection->partner->eventQueue.push_back(s1);
+        connection->partner->eventQueue.PushBack(s1);
 
         //Save the key that should be used for encrypting the connection
         CheckedMemcpy(cherrySimInstance->currentNode->state.currentLtkForEstablishingSecurity, p_enc_info->ltk, 16);
@@ -944,7 +945,7 @@ extern "C"
             s1.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.encr_key_size = 16;
             s1.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.sm = 1;
             s1.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.lv = 3;
-            cherrySimInstance->currentNode->eventQueue.push_back(s1);
+            cherrySimInstance->currentNode->eventQueue.PushBack(s1);
 
             //Set our own partners connection to encrypted
             connection->partnerConnection->connectionEncrypted = true;
@@ -957,7 +958,7 @@ extern "C"
             s2.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.encr_key_size = 16;
             s2.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.sm = 1;
             s2.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.lv = 3;
-            connection->partner->eventQueue.push_back(s2);
+            connection->partner->eventQueue.PushBack(s2);
         }
         //Keys do not match, generate a failure
         else {
@@ -971,7 +972,7 @@ extern "C"
     uint32_t sd_ble_gap_conn_param_update(uint16_t conn_handle, const ble_gap_conn_params_t* p_conn_params)
     {
         START_OF_FUNCTION();
-        if (PSRNG(cherrySimInstance->simConfig.sdBusyProbability)) {
+        if (NODE_PSRNG(FIRMWARE, cherrySimInstance->simConfig.sdBusyProbability)) {
             return NRF_ERROR_BUSY;
         }
 
@@ -993,7 +994,7 @@ extern "C"
     uint32_t sd_ble_gap_scan_start(const ble_gap_scan_params_t* p_scan_params)
     {
         START_OF_FUNCTION();
-        if (PSRNG(cherrySimInstance->simConfig.sdBusyProbability)) {
+        if (NODE_PSRNG(FIRMWARE, cherrySimInstance->simConfig.sdBusyProbability)) {
             return NRF_ERROR_BUSY;
         }
 
@@ -1010,7 +1011,7 @@ extern "C"
     uint32_t sd_ble_gap_addr_set(const ble_gap_addr_t* p_addr)
     {
         START_OF_FUNCTION();
-        if (PSRNG(cherrySimInstance->simConfig.sdBusyProbability)) {
+        if (NODE_PSRNG(FIRMWARE, cherrySimInstance->simConfig.sdBusyProbability)) {
             return NRF_ERROR_BUSY;
         }
 
@@ -1192,7 +1193,7 @@ extern "C"
     uint32_t sd_ble_gattc_write(uint16_t conn_handle, const ble_gattc_write_params_t* p_write_params)
     {
         START_OF_FUNCTION();
-        if (PSRNG(cherrySimInstance->simConfig.sdBusyProbability)) {
+        if (NODE_PSRNG(FIRMWARE, cherrySimInstance->simConfig.sdBusyProbability)) {
             return NRF_ERROR_BUSY;
         }
 
@@ -1269,13 +1270,17 @@ extern "C"
         for (u32 i = 0; i < FruityHal::GetCodePageSize() / 4; i++) {
             p[i] = 0xFFFFFFFF;
         }
+        cherrySimInstance->flashStore.MarkDirty(cherrySimInstance->currentNode->index, (u32)page_number * FruityHal::GetCodePageSize(), FruityHal::GetCodePageSize());
+        cherrySimInstance->currentNode->energy.flashErasedPages++;
+        cherrySimInstance->AddEnergyUsage(cherrySimInstance->currentNode, SimEnergySubsystem::FLASH, cherrySimInstance->energyModel.GetFlashPageEraseCharge());
 
 
         if (cherrySimInstance->simConfig.simulateAsyncFlash) {
             cherrySimInstance->currentNode->state.numWaitingFlashOperations++;
         }
         else {
-            DispatchSystemEvents(FruityHal::SystemEvents::FLASH_OPERATION_SUCCESS);
+            const bool fail = cherrySimInstance->faultInjector.ShouldFailFlashOperation(cherrySimInstance->currentNode->id);
+            DispatchSystemEvents(fail ? FruityHal::SystemEvents::FLASH_OPERATION_ERROR : FruityHal::SystemEvents::FLASH_OPERATION_SUCCESS);
         }
 
         return NRF_SUCCESS;
@@ -1284,12 +1289,12 @@ extern "C"
     uint32_t sd_flash_write(uint32_t* const p_dst, const uint32_t* const p_src, uint32_t size)
     {
         START_OF_FUNCTION();
-        u32 sourcePage            = ((u32)p_src - FLASH_REGION_START_ADDRESS) / FruityHal::GetCodePageSize();
-        u32 sourcePageOffset      = ((u32)p_src - FLASH_REGION_START_ADDRESS) % FruityHal::GetCodePageSize();
-        u32 destinationPage       = ((u32)p_dst - FLASH_REGION_START_ADDRESS) / FruityHal::GetCodePageSize();
-        u32 destinationPageOffset = ((u32)p_dst - FLASH_REGION_START_ADDRESS) % FruityHal::GetCodePageSize();
+        u32 sourcePage            = (u32)(((uintptr_t)p_src - FLASH_REGION_START_ADDRESS) / FruityHal::GetCodePageSize());
+        u32 sourcePageOffset      = (u32)(((uintptr_t)p_src - FLASH_REGION_START_ADDRESS) % FruityHal::GetCodePageSize());
+        u32 destinationPage       = (u32)(((uintptr_t)p_dst - FLASH_REGION_START_ADDRESS) / FruityHal::GetCodePageSize());
+        u32 destinationPageOffset = (u32)(((uintptr_t)p_dst - FLASH_REGION_START_ADDRESS) % FruityHal::GetCodePageSize());
 
-        if ((u32)p_src >= FLASH_REGION_START_ADDRESS && (u32)p_src < FLASH_REGION_START_ADDRESS + FruityHal::GetCodeSize()*FruityHal::GetCodePageSize()) {
+        if ((uintptr_t)p_src >= FLASH_REGION_START_ADDRESS && (uintptr_t)p_src < FLASH_REGION_START_ADDRESS + FruityHal::GetCodeSize()*FruityHal::GetCodePageSize()) {
             logt("RS", "Copy from page %u (+%u) to page %u (+%u), len %u", sourcePage, sourcePageOffset, destinationPage, destinationPageOffset, size * 4);
         }
         else {
@@ -1301,12 +1306,12 @@ extern "C"
             return NRF_ERROR_INVALID_LENGTH;
         }
 
-        if (((u32)p_src) % 4 != 0) {
+        if (((uintptr_t)p_src) % 4 != 0) {
             logt("ERROR", "source unaligned");
             SIMEXCEPTION(IllegalArgumentException);
             return NRF_ERROR_INVALID_ADDR;
         }
-        if (((u32)p_dst) % 4 != 0) {
+        if (((uintptr_t)p_dst) % 4 != 0) {
             logt("ERROR", "dest unaligned");
             SIMEXCEPTION(IllegalArgumentException);
             return NRF_ERROR_INVALID_ADDR;
@@ -1316,12 +1321,16 @@ extern "C"
         for (u32 i = 0; i < size; i++) {
             p_dst[i] &= p_src[i];
         }
+        cherrySimInstance->flashStore.MarkDirty(cherrySimInstance->currentNode->index, destinationPage * FruityHal::GetCodePageSize() + destinationPageOffset, size * 4);
+        cherrySimInstance->currentNode->energy.flashWrittenWords += size;
+        cherrySimInstance->AddEnergyUsage(cherrySimInstance->currentNode, SimEnergySubsystem::FLASH, cherrySimInstance->energyModel.GetFlashWriteCharge(size));
 
         if (cherrySimInstance->simConfig.simulateAsyncFlash) {
             cherrySimInstance->currentNode->state.numWaitingFlashOperations++;
         }
         else {
-            DispatchSystemEvents(FruityHal::SystemEvents::FLASH_OPERATION_SUCCESS);
+            const bool fail = cherrySimInstance->faultInjector.ShouldFailFlashOperation(cherrySimInstance->currentNode->id);
+            DispatchSystemEvents(fail ? FruityHal::SystemEvents::FLASH_OPERATION_ERROR : FruityHal::SystemEvents::FLASH_OPERATION_SUCCESS);
         }
 
         return NRF_SUCCESS;
@@ -1385,18 +1394,19 @@ extern "C"
     uint32_t sd_ble_evt_get(uint8_t* p_dest, uint16_t* p_len)
     {
         START_OF_FUNCTION();
-        if (cherrySimInstance->currentNode->eventQueue.size() > 0) {
+        if (!cherrySimInstance->currentNode->eventQueue.Empty()) {
 
-            simBleEvent bleEvent = cherrySimInstance->currentNode->eventQueue.front();
-            cherrySimInstance->currentNode->eventQueue.pop_front();
+            //We copy the current event so that we can access it during debugging if we want to get more information
+            simBleEvent& bleEvent = cherrySimInstance->currentNode->currentEvent;
+            CheckedMemcpy(&bleEvent, &cherrySimInstance->currentNode->eventQueue.Front(), sizeof(simBleEvent));
+            cherrySimInstance->currentNode->eventQueue.PopFront();
+            cherrySimInstance->currentNode->energy.cpuEvents++;
+            cherrySimInstance->AddEnergyUsage(cherrySimInstance->currentNode, SimEnergySubsystem::CPU, cherrySimInstance->energyModel.GetCpuCharge(1));
 
             if (cherrySimInstance->simEventListener != nullptr) {
                 cherrySimInstance->simEventListener->CherrySimBleEventHandler(cherrySimInstance->currentNode, &bleEvent, FruityHal::GetEventBufferSize());
             }
 
-            //We copy the current event so that we can access it during debugging if we want to get more information
-            CheckedMemcpy(&cherrySimInstance->currentNode->currentEvent, &bleEvent, sizeof(simBleEvent));
-
             CheckedMemcpy(p_dest, &bleEvent.bleEvent, FruityHal::GetEventBufferSize());
             *p_len = FruityHal::GetEventBufferSize();
 
@@ -1413,7 +1423,7 @@ extern "C"
     {
         START_OF_FUNCTION();
         for (int i = 0; i < length; i++) {
-            p_buff[i] = (u8)(PSRNGINT(0, 255));
+            p_buff[i] = (u8)(NODE_PSRNGINT(FIRMWARE, 0, 255));
         }
 
         return 0;
@@ -1557,7 +1567,7 @@ extern "C"
 
     uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const *p_hvx_params) {
         START_OF_FUNCTION();
-        if (PSRNG(cherrySimInstance->simConfig.sdBusyProbability)) {
+        if (NODE_PSRNG(FIRMWARE, cherrySimInstance->simConfig.sdBusyProbability)) {
             return NRF_ERROR_BUSY;
         }
 
@@ -1604,7 +1614,7 @@ extern "C"
 
     uint32_t sd_ecb_block_encrypt(nrf_ecb_hal_data_t * p_ecb_data) {
         START_OF_FUNCTION();
-        AES_ECB_encrypt(p_ecb_data->cleartext, p_ecb_data->key, p_ecb_data->ciphertext, 16);
+        SimAes::EcbEncryptBlock(p_ecb_data->key, p_ecb_data->cleartext, p_ecb_data->ciphertext);
 
         return 0;
     }
@@ -1630,50 +1640,31 @@ const char *__asan_default_options() {
 // These calls can be made within FruityMesh using the macros (e.g. SIMSTATCOUNT)
 //#########################################################################################
 
-std::map<std::string, int> simStatCounts;
+uint32_t sim_register_statistic(const char* key, bool isAverage)
+{
+    return SimStatistics::Register(key, isAverage ? SimStatistics::Type::AVG : SimStatistics::Type::COUNT);
+}
+
+void sim_collect_statistic(uint32_t handle, int value)
+{
+    NodeEntry* node = cherrySimInstance != nullptr ? cherrySimInstance->currentNode : nullptr;
+    SimStatistics::Collect(handle, value, node != nullptr ? &node->statistics : nullptr);
+}
+
+//Slower than the macros as the key is looked up on every call, only meant for keys that are built at runtime
 void sim_collect_statistic_count(const char* key)
 {
-    if (simStatCounts.find(key) != simStatCounts.end())
-    {
-        simStatCounts[key] = simStatCounts[key] + 1;
-    }
-    else {
-        simStatCounts[key] = 1;
-    }
+    sim_collect_statistic(sim_register_statistic(key, false), 1);
 }
 
-std::map<std::string, int> simStatAvgCounts;
-std::map<std::string, int> simStatAvgTotal;
 void sim_collect_statistic_avg(const char* key, int value)
 {
-    if (simStatAvgCounts.find(key) != simStatAvgCounts.end())
-    {
-        simStatAvgCounts[key] = simStatAvgCounts[key] + 1;
-        simStatAvgTotal[key] = simStatAvgTotal[key] + value;
-    }
-    else {
-        simStatAvgCounts[key] = 1;
-        simStatAvgTotal[key] = value;
-    }
+    sim_collect_statistic(sim_register_statistic(key, true), value);
 }
 
 void sim_print_statistics()
 {
-    printf("------ COUNTS --------" EOL);
-    std::map<std::string, int>::iterator it;
-    for (it = simStatCounts.begin(); it != simStatCounts.end(); it++) {
-        printf("Key: %s, Count: %d" EOL, it->first.c_str(), it->second);
-    }
-
-    printf("------ AVG --------" EOL);
-    std::map<std::string, int>::iterator it2;
-    for (it2 = simStatAvgCounts.begin(); it2 != simStatAvgCounts.end(); it2++) {
-        const char* key = it2->first.c_str();
-        int avg = simStatAvgTotal[key] / simStatAvgCounts[key];
-        printf("Key: %s, Count: %d, Avg: %d" EOL, key, simStatAvgCounts[key], avg);
-    }
-
-    printf("--------------" EOL);
+    SimStatistics::Print(SimStatistics::GetGlobalValues());
 }
 
 uint32_t sim_get_stack_type()
@@ -710,11 +710,12 @@ extern uint8_t* simFlashPtr;
 //The flash region start address points to the beginning of the flash memory. All address calculations must
 //use the correct addresses including the start address of the flash space.
 //The pages however are always counted from the beginning of the flash memory.
-#define FLASH_REGION_START_ADDRESS ((u32)simFlashPtr)
+#define FLASH_REGION_START_ADDRESS ((uintptr_t)simFlashPtr)
 
-//Used to collect statistic counts in the simulator, a hashmap is used to count all calls to this function under the given key
-#define SIMSTATCOUNT(key) sim_collect_statistic_count(key)
-#define SIMSTATAVG(key, value) sim_collect_statistic_avg(key, value)
+//Used to collect statistic counts in the simulator. Each call site registers its key once and
+//afterwards only passes the registered handle (see SimStatistics.h)
+#define SIMSTATCOUNT(key) do { static const uint32_t simStatHandle = sim_register_statistic(key, false); sim_collect_statistic(simStatHandle, 1); } while(0)
+#define SIMSTATAVG(key, value) do { static const uint32_t simStatHandle = sim_register_statistic(key, true); sim_collect_statistic(simStatHandle, value); } while(0)
 
 
 uint32_t sd_ble_gap_adv_data_set(uint8_t const *p_data, uint8_t dlen, uint8_t const *p_sr_data, uint8_t srdlen);
@@ -774,6 +775,8 @@ uint32_t app_timer_cnt_diff_compute(uint32_t nowTime, uint32_t previousTime);
 typedef void (*ble_radio_notification_evt_handler_t) (bool radio_active);
 
 
+uint32_t sim_register_statistic(const char* key, bool isAverage);
+void sim_collect_statistic(uint32_t handle, int value);
 void sim_collect_statistic_count(const char* key);
 void sim_collect_statistic_avg(const char* key, int value);
 void sim_print_statistics();
@@ -220,3 +220,58 @@ TEST(TestChunkedPacketQueue, TestSimpleAllocations)
         }
     }
 }
+
+TEST(TestChunkedPacketQueue, TestOccupancyCounters)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    simConfig.SetToPerfectConditions();
+
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    NodeIndexSetter setter(0);
+    MeshConnections connections = GS->cm.GetMeshConnections(ConnectionDirection::INVALID);
+    ASSERT_EQ(connections.count, 1);
+    MeshConnection* conn = connections.handles[0].GetConnection();
+
+    // As in TestSimpleAllocations, no further step is simulated after this point.
+    ChunkedPacketQueue& queue = *conn->queue.GetQueueByPriority(DeliveryPriority::HIGH);
+    queue.SimReset();
+    ASSERT_EQ(queue.GetAmountOfChunks(), 1);
+    const u32 usedChunksBefore = GS->connectionQueueMemoryAllocator.GetAmountOfUsedChunks();
+
+    std::array<u8, MAX_MESH_PACKET_SIZE> arr{};
+    constexpr u32 amountOfMessages = 5;
+    for (u32 i = 0; i < amountOfMessages; i++)
+    {
+        ASSERT_TRUE(queue.AddMessage(arr.data(), MAX_MESH_PACKET_SIZE));
+    }
+
+    // Five messages of 200 bytes do not fit into a single chunk of 256 bytes.
+    ASSERT_GT(queue.GetAmountOfChunks(), 1);
+    ASSERT_EQ(queue.GetAmountOfChunks() - 1, GS->connectionQueueMemoryAllocator.GetAmountOfUsedChunks() - usedChunksBefore);
+    ASSERT_GE(GS->connectionQueueMemoryAllocator.GetMaxAmountOfUsedChunks(), GS->connectionQueueMemoryAllocator.GetAmountOfUsedChunks());
+
+    for (u32 i = 0; i < amountOfMessages; i++)
+    {
+        queue.PopPacket();
+    }
+    ASSERT_EQ(queue.GetAmountOfChunks(), 1);
+    ASSERT_EQ(GS->connectionQueueMemoryAllocator.GetAmountOfUsedChunks(), usedChunksBefore);
+
+    // The priority queue keeps the high-water marks of all its queues.
+    ASSERT_TRUE(conn->queue.SplitAndAddMessage(DeliveryPriority::LOW, arr.data(), 100, 20));
+    ASSERT_GE(conn->queue.GetMaxAmountOfPackets(), conn->queue.GetAmountOfPackets());
+    ASSERT_GE(conn->queue.GetMaxAmountOfChunks(), conn->queue.GetAmountOfChunks());
+    ASSERT_GE(conn->queue.GetAmountOfChunks(), AMOUNT_OF_SEND_QUEUE_PRIORITIES);
+
+    ASSERT_GE(GS->connectionAllocator.GetAmountOfAllocatedConnections(), 1);
+    ASSERT_GE(GS->connectionAllocator.GetMaxAmountOfAllocatedConnections(), GS->connectionAllocator.GetAmountOfAllocatedConnections());
+    ASSERT_GT(GS->moduleAllocator.GetUsedMemorySize(), 0);
+    ASSERT_LE(GS->moduleAllocator.GetUsedMemorySize(), GS->moduleAllocator.GetMemorySize());
+}
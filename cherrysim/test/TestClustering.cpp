@@ -35,6 +35,7 @@
 #include <algorithm>
 #include <regex>
 #include "DebugModule.h"
+#include "SimStatistics.h"
 
 
 //This test fixture is used to run a parametrized test based on the chosen BLE Stack
@@ -625,9 +626,9 @@ TEST_P(MultiStackFixture, TestSinkDetectionWithSingleSink)
     }
 }
 
-extern std::map<std::string, int> simStatCounts;
 TEST(TestClustering, TestVitalPrioQueueFull) {
-    for (int seed = 0; seed < 3; seed++) {
+    //Whether the vital queue overflows depends on the timing of the clustering, which differs between seeds
+    for (int seed = 0; seed < 6; seed++) {
         CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
         //testerConfig.verbose = true;
         SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
@@ -652,8 +653,7 @@ TEST(TestClustering, TestVitalPrioQueueFull) {
         }); 
     }
     
-    ASSERT_TRUE(simStatCounts.find("vitalPrioQueueFull") != simStatCounts.end());
-    ASSERT_TRUE(simStatCounts["vitalPrioQueueFull"] > 3);
+    ASSERT_TRUE(SimStatistics::GetValue(SimStatistics::GetGlobalValues(), SimStatistics::FindHandle("vitalPrioQueueFull", SimStatistics::Type::COUNT)).count > 3);
 }
 
 TEST(TestClustering, TestInfluceOfNodeWithWrongNetworkKey) {
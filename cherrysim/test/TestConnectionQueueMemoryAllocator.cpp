@@ -122,9 +122,36 @@ TEST(TestConnectionQueueMemoryAllocator, TestSimpleAllocations) {
     ASSERT_EQ(chunks[0]->nextChunk, nullptr);
 }
 
+TEST(TestConnectionQueueMemoryAllocator, TestOccupancyCounters) {
+    ConnectionQueueMemoryAllocator allocator;
+    std::array<ConnectionQueueMemoryChunk*, CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT> chunks{};
+
+    ASSERT_EQ(allocator.GetAmountOfUsedChunks(), 0u);
+    ASSERT_EQ(allocator.GetMaxAmountOfUsedChunks(), 0u);
+
+    for (u32 i = 0; i < CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT; i++)
+    {
+        chunks[i] = allocator.Allocate(true);
+        ASSERT_NE(chunks[i], nullptr);
+    }
+
+    ASSERT_EQ(allocator.GetAmountOfUsedChunks(), CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT);
+    ASSERT_EQ(allocator.GetMaxAmountOfUsedChunks(), CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT);
+
+    //Deallocate every second chunk.
+    for (u32 i = 0; i < CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT; i += 2)
+    {
+        allocator.Deallocate(chunks[i]);
+    }
+
+    //The high-water mark stays at the maximum
+    ASSERT_EQ(allocator.GetAmountOfUsedChunks(), CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT / 2);
+    ASSERT_EQ(allocator.GetMaxAmountOfUsedChunks(), CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT);
+}
+
 static std::array<u8, CONNECTION_QUEUE_MEMORY_CHUNK_SIZE> GenerateUniqueChunkData(ConnectionQueueMemoryChunk* chunk)
 {
-    MersenneTwister chunkFingerprint((uint32_t)chunk); //Using the chunk memory address as seed to generate unique chunk data.
+    MersenneTwister chunkFingerprint((uint32_t)(uintptr_t)chunk); //Using the chunk memory address as seed to generate unique chunk data.
 
     std::array<u8, CONNECTION_QUEUE_MEMORY_CHUNK_SIZE> retVal;
     for (u32 i = 0; i < CONNECTION_QUEUE_MEMORY_CHUNK_SIZE; i++)
@@ -0,0 +1,207 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <SimEnergy.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+TEST(TestEnergy, TestModel)
+{
+    const SimEnergyModel model;
+
+    //Higher tx power draws more current
+    ASSERT_GT(model.GetTxCurrentMicroAmpere(4), model.GetTxCurrentMicroAmpere(0));
+    ASSERT_GT(model.GetTxCurrentMicroAmpere(0), model.GetTxCurrentMicroAmpere(-20));
+    ASSERT_EQ(model.GetTxCurrentMicroAmpere(-40), model.GetTxCurrentMicroAmpere(-100));
+
+    //Longer advertising data, higher tx power and listening for requests cost more
+    ASSERT_GT(model.GetAdvertisingEventCharge(31, 0, true), model.GetAdvertisingEventCharge(10, 0, true));
+    ASSERT_GT(model.GetAdvertisingEventCharge(31, 4, true), model.GetAdvertisingEventCharge(31, 0, true));
+    ASSERT_GT(model.GetAdvertisingEventCharge(31, 0, true), model.GetAdvertisingEventCharge(31, 0, false));
+
+    //Advertising 31 bytes every 100 ms is in the range that the power profiler gives for the nRF52832
+    const uint64_t advertisingCurrent = model.GetAdvertisingEventCharge(31, 0, true) / 100;
+    ASSERT_GE(advertisingCurrent, 40u);
+    ASSERT_LE(advertisingCurrent, 150u);
+
+    ASSERT_GT(model.GetPacketCharge(20, true, 4), model.GetPacketCharge(20, true, 0));
+    ASSERT_GT(model.GetPacketCharge(100, false, 0), model.GetPacketCharge(20, false, 0));
+    ASSERT_EQ(model.GetScanningCharge(0, 100, 1000), 0u);
+    ASSERT_EQ(model.GetScanningCharge(50, 100, 1000), model.GetScanningCharge(100, 100, 500));
+    ASSERT_EQ(model.GetScanningCharge(100, 100, 1000), (uint64_t)model.rxCurrentMicroAmpere * 1000);
+    ASSERT_EQ(model.GetFlashWriteCharge(0), 0u);
+    ASSERT_GT(model.GetFlashPageEraseCharge(), model.GetFlashWriteCharge(256));
+    ASSERT_EQ(model.GetCpuCharge(10), 10 * model.GetCpuCharge(1));
+
+    //220 mAh at 10 uA
+    ASSERT_EQ(model.EstimateBatteryLifeDays(10), 916u);
+    ASSERT_EQ(model.EstimateBatteryLifeDays(0), UINT32_MAX);
+
+    SimEnergyUsage usage;
+    usage.chargeNanoCoulomb[(u32)SimEnergySubsystem::IDLE] = 10 * 1000;
+    usage.chargeNanoCoulomb[(u32)SimEnergySubsystem::CPU] = 5 * 1000;
+    ASSERT_EQ(usage.GetTotalCharge(), 15u * 1000);
+    ASSERT_EQ(usage.GetAverageCurrentMicroAmpere(1000), 15u);
+    ASSERT_EQ(usage.GetAverageCurrentMicroAmpere(SimEnergySubsystem::CPU, 1000), 5u);
+    ASSERT_EQ(usage.GetAverageCurrentMicroAmpere(0), 0u);
+}
+
+TEST(TestEnergy, TestBreakdown)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.SetToPerfectConditions();
+    simConfig.terminalId = 0;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 4 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //Saving a record writes to flash
+    const NodeEntry* node = tester.sim->FindNodeById(2);
+    const SimEnergyUsage energyBeforeFlash = node->energy;
+    tester.SendTerminalCommand(2, "saverec 13 DE:AD:BE:EF");
+    tester.SimulateForGivenTime(10 * 1000);
+    ASSERT_GT(node->energy.flashWrittenWords, energyBeforeFlash.flashWrittenWords);
+    ASSERT_GT(node->energy.chargeNanoCoulomb[(u32)SimEnergySubsystem::FLASH], energyBeforeFlash.chargeNanoCoulomb[(u32)SimEnergySubsystem::FLASH]);
+
+    const u32 simTimeMs = tester.sim->simState.simTimeMs;
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        const NodeEntry& node = tester.sim->nodes[i];
+
+        //The breakdown adds up to the total that the simulator used before
+        ASSERT_EQ(node.energy.GetTotalCharge(), node.nanoAmperePerMsTotal);
+
+        //Every node drew idle current for the whole time and exchanged mesh packets
+        ASSERT_NEAR((double)node.energy.GetAverageCurrentMicroAmpere(SimEnergySubsystem::IDLE, simTimeMs), tester.sim->energyModel.idleCurrentMicroAmpere, 1.0);
+        ASSERT_GT(node.energy.chargeNanoCoulomb[(u32)SimEnergySubsystem::CONNECTION_EVENTS], 0u);
+        ASSERT_GT(node.energy.txPackets, 0u);
+        ASSERT_GT(node.energy.rxPackets, 0u);
+        ASSERT_GT(node.energy.cpuEvents, 0u);
+    }
+
+    tester.SendTerminalCommand(1, "sim energy");
+    tester.SimulateGivenNumberOfSteps(1);
+    tester.SendTerminalCommand(1, "sim energy 2");
+    tester.SimulateGivenNumberOfSteps(1);
+
+    tester.SendTerminalCommand(1, "sim energycsv energy.csv");
+    tester.SimulateGivenNumberOfSteps(1);
+    u32 lines = 0;
+    {
+        std::ifstream file("energy.csv");
+        lines = (u32)std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n');
+    }
+    std::remove("energy.csv");
+    ASSERT_EQ(lines, tester.sim->GetTotalNodes() + 1);
+}
+
+namespace
+{
+    struct EnergyBenchmarkScenario
+    {
+        const char* name;
+        u32 meshNodes;
+        u32 trafficIntervalMs; //Interval of a status request to all nodes, 0 for no traffic
+    };
+}
+
+//Simulates a few typical networks with a fixed seed so that the projected battery life and the
+//throughput of firmware changes can be compared. Only the time after clustering is measured.
+TEST(TestEnergy, EnergyBenchmark_scheduled)
+{
+    const std::vector<EnergyBenchmarkScenario> scenarios = {
+        { "idle mesh", 9, 0 },
+        { "mesh with status requests", 9, 1000 },
+        { "large idle mesh", 49, 0 },
+        { "large mesh with status requests", 49, 5000 },
+    };
+    constexpr u32 measureTimeMs = 5 * 60 * 1000;
+
+    printf("scenario,nodes,avgMicroAmpere,maxMicroAmpere,batteryLifeDays,rxPacketsPerSecond");
+    for (u32 i = 0; i < (u32)SimEnergySubsystem::AMOUNT; i++) printf(",%sMicroAmpere", SimEnergy::GetSubsystemName((SimEnergySubsystem)i));
+    printf(EOL);
+
+    for (const EnergyBenchmarkScenario& scenario : scenarios)
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.seed = 1;
+        simConfig.terminalId = 0;
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", scenario.meshNodes });
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+        tester.SimulateUntilClusteringDone(10 * 60 * 1000);
+
+        std::vector<SimEnergyUsage> energyAtStart;
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++) energyAtStart.push_back(tester.sim->nodes[i].energy);
+
+        for (u32 timeMs = 0; timeMs < measureTimeMs; )
+        {
+            const u32 stepTimeMs = scenario.trafficIntervalMs > 0 ? scenario.trafficIntervalMs : measureTimeMs;
+            if (scenario.trafficIntervalMs > 0) tester.SendTerminalCommand(1, "action 0 status get_status");
+            tester.SimulateForGivenTime(stepTimeMs);
+            timeMs += stepTimeMs;
+        }
+
+        uint64_t totalCurrent = 0;
+        uint64_t maxCurrent = 0;
+        uint64_t rxPackets = 0;
+        std::array<uint64_t, (u32)SimEnergySubsystem::AMOUNT> subsystemCharge = {};
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+        {
+            const SimEnergyUsage& energy = tester.sim->nodes[i].energy;
+            uint64_t charge = 0;
+            for (u32 k = 0; k < (u32)SimEnergySubsystem::AMOUNT; k++)
+            {
+                const uint64_t subsystemDelta = energy.chargeNanoCoulomb[k] - energyAtStart[i].chargeNanoCoulomb[k];
+                subsystemCharge[k] += subsystemDelta;
+                charge += subsystemDelta;
+            }
+            totalCurrent += charge / measureTimeMs;
+            maxCurrent = std::max(maxCurrent, charge / measureTimeMs);
+            rxPackets += energy.rxPackets - energyAtStart[i].rxPackets;
+        }
+
+        const u32 amountOfNodes = tester.sim->GetTotalNodes();
+        printf("%s,%u,%u,%u,%u,%.1f", scenario.name, amountOfNodes, (u32)(totalCurrent / amountOfNodes), (u32)maxCurrent,
+            tester.sim->energyModel.EstimateBatteryLifeDays(maxCurrent), rxPackets * 1000.0 / measureTimeMs);
+        for (const uint64_t charge : subsystemCharge) printf(",%u", (u32)(charge / measureTimeMs / amountOfNodes));
+        printf(EOL);
+
+        ASSERT_GT(totalCurrent, 0u);
+    }
+}
@@ -0,0 +1,318 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <SimFaultInjector.h>
+
+namespace
+{
+    CherrySimTester CreateFaultTester(u32 meshNodes)
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.SetToPerfectConditions();
+        simConfig.terminalId = 0;
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", meshNodes });
+        return CherrySimTester(testerConfig, simConfig);
+    }
+
+    uint64_t GetTotalReceivedPackets(const CherrySim& sim)
+    {
+        uint64_t packets = 0;
+        for (u32 i = 0; i < sim.GetTotalNodes(); i++) packets += sim.nodes[i].energy.rxPackets;
+        return packets;
+    }
+}
+
+TEST(TestFaultInjection, TestScenarioParsing)
+{
+    const nlohmann::json scenario = nlohmann::json::parse(R"({
+        "faults": [
+            { "type": "packetLoss", "node": 3, "bidirectional": true, "probability": 0.5, "startMs": 1000, "durationMs": 2000, "burstMs": 100, "gapMs": 400 },
+            { "type": "latency", "node": 2, "partner": 4, "latencyMs": 300 },
+            { "type": "txStall", "node": 2 },
+            { "type": "clockDrift", "node": 5, "driftPpm": -5000 },
+            { "type": "flashFailure", "probability": 1.0 },
+            { "type": "disconnect", "node": 2, "startMs": 120000 }
+        ]
+    })");
+
+    SimFaultInjector injector;
+    injector.AddScenario(scenario);
+    const std::vector<SimFault>& faults = injector.GetFaults();
+    ASSERT_EQ(faults.size(), 6u);
+    ASSERT_EQ(faults[0].type, SimFaultType::PACKET_LOSS);
+    ASSERT_EQ(faults[0].node, 3);
+    ASSERT_EQ(faults[0].partner, 0);
+    ASSERT_TRUE(faults[0].bidirectional);
+    ASSERT_EQ(faults[0].probability, UINT32_MAX / 2);
+    ASSERT_EQ(faults[0].startMs, 1000u);
+    ASSERT_EQ(faults[0].durationMs, 2000u);
+    ASSERT_EQ(faults[0].burstMs, 100u);
+    ASSERT_EQ(faults[0].gapMs, 400u);
+    ASSERT_EQ(faults[1].type, SimFaultType::LATENCY);
+    ASSERT_EQ(faults[1].latencyMs, 300u);
+    ASSERT_EQ(faults[2].probability, UINT32_MAX);
+    ASSERT_EQ(faults[3].driftPpm, -5000);
+    ASSERT_EQ(faults[4].node, 0);
+    ASSERT_EQ(faults[5].type, SimFaultType::DISCONNECT);
+
+    //The json representation can be read again
+    const nlohmann::json j = faults[0];
+    const SimFault copy = j.get<SimFault>();
+    ASSERT_EQ(copy.type, faults[0].type);
+    ASSERT_EQ(copy.node, faults[0].node);
+    ASSERT_EQ(copy.gapMs, faults[0].gapMs);
+    ASSERT_NEAR((double)copy.probability, (double)faults[0].probability, 2.0);
+
+    Exceptions::DisableDebugBreakOnException disable;
+    ASSERT_THROW(injector.AddScenario(nlohmann::json::parse(R"({ "fault": [] })")), UnknownJsonEntryException);
+    ASSERT_THROW(injector.AddScenario(nlohmann::json::parse(R"({ "faults": [ { "type": "packetLoss", "nod": 1 } ] })")), UnknownJsonEntryException);
+    ASSERT_THROW(injector.AddScenario(nlohmann::json::parse(R"({ "faults": [ { "type": "lightning" } ] })")), IllegalArgumentException);
+    ASSERT_THROW(injector.AddScenario(nlohmann::json::parse(R"({ "faults": [ { "node": 1 } ] })")), IllegalArgumentException);
+    ASSERT_THROW(injector.AddScenario(nlohmann::json::parse(R"({ "faults": [ { "type": "packetLoss", "probability": 1.5 } ] })")), IllegalArgumentException);
+    ASSERT_THROW(injector.AddScenario(nlohmann::json::parse(R"({ "faults": [ { "type": "packetLoss", "burstMs": 100 } ] })")), IllegalArgumentException);
+}
+
+TEST(TestFaultInjection, TestLinksAndBursts)
+{
+    SimFaultInjector injector;
+    std::vector<const SimFault*> dueDisconnects;
+    injector.SetSeed(1);
+    ASSERT_TRUE(injector.IsEmpty());
+    ASSERT_FALSE(injector.ShouldDropPacket(2, 3));
+
+    //Asymmetric link from 2 to 3 between 1 and 2 seconds
+    SimFault loss;
+    loss.type = SimFaultType::PACKET_LOSS;
+    loss.node = 2;
+    loss.partner = 3;
+    loss.startMs = 1000;
+    loss.durationMs = 1000;
+    injector.AddFault(loss);
+    injector.Update(500, dueDisconnects);
+    ASSERT_FALSE(injector.ShouldDropPacket(2, 3));
+    injector.Update(1500, dueDisconnects);
+    ASSERT_TRUE(injector.ShouldDropPacket(2, 3));
+    ASSERT_FALSE(injector.ShouldDropPacket(3, 2));
+    ASSERT_FALSE(injector.ShouldDropPacket(2, 4));
+    injector.Update(2000, dueDisconnects);
+    ASSERT_FALSE(injector.ShouldDropPacket(2, 3));
+    ASSERT_EQ(injector.GetFaults()[0].triggerCount, 1u);
+
+    //A flaky node loses packets in both directions
+    injector.Clear();
+    SimFault flakyNode;
+    flakyNode.type = SimFaultType::PACKET_LOSS;
+    flakyNode.node = 5;
+    flakyNode.bidirectional = true;
+    injector.AddFault(flakyNode);
+    ASSERT_TRUE(injector.ShouldDropPacket(5, 1));
+    ASSERT_TRUE(injector.ShouldDropPacket(1, 5));
+    ASSERT_FALSE(injector.ShouldDropPacket(1, 2));
+    ASSERT_FALSE(injector.IsTxStalled(5, 1));
+    ASSERT_EQ(injector.GetLatencyMs(5, 1), 0u);
+
+    //Bursts are active for about burstMs / (burstMs + gapMs) of the time
+    injector.Clear();
+    SimFault interference;
+    interference.type = SimFaultType::PACKET_LOSS;
+    interference.burstMs = 1000;
+    interference.gapMs = 3000;
+    injector.AddFault(interference);
+    u32 activeSteps = 0;
+    u32 burstStarts = 0;
+    bool wasActive = false;
+    constexpr u32 steps = 20000;
+    for (u32 i = 0; i < steps; i++)
+    {
+        injector.Update(i * 50, dueDisconnects);
+        const bool active = injector.GetFaults()[0].IsActive(i * 50);
+        if (active) activeSteps++;
+        if (active && !wasActive) burstStarts++;
+        wasActive = active;
+    }
+    ASSERT_NEAR((double)activeSteps / steps, 0.25, 0.05);
+    ASSERT_NEAR(burstStarts, steps * 50 / 4000, steps * 50 / 4000 / 4);
+
+    //The same seed gives the same bursts
+    SimFaultInjector other;
+    other.SetSeed(1);
+    other.AddFault(interference);
+    injector.SetSeed(1);
+    for (u32 i = 0; i < 2000; i++)
+    {
+        injector.Update(i * 50, dueDisconnects);
+        other.Update(i * 50, dueDisconnects);
+        ASSERT_EQ(injector.GetFaults()[0].IsActive(i * 50), other.GetFaults()[0].IsActive(i * 50));
+    }
+    ASSERT_TRUE(dueDisconnects.empty());
+}
+
+TEST(TestFaultInjection, TestFlakyNodeRecovers)
+{
+    CherrySimTester tester = CreateFaultTester(5);
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //Node 3 can neither send nor receive, so it is dropped from the mesh
+    SimFault fault;
+    fault.type = SimFaultType::PACKET_LOSS;
+    fault.node = 3;
+    fault.bidirectional = true;
+    fault.startMs = tester.sim->simState.simTimeMs;
+    fault.durationMs = 60 * 1000;
+    tester.sim->faultInjector.AddFault(fault);
+    tester.SimulateForGivenTime(50 * 1000);
+    ASSERT_EQ(tester.sim->FindNodeById(3)->gs.node.GetClusterSize(), 1);
+    ASSERT_FALSE(tester.sim->IsClusteringDone());
+
+    //Once the fault is over, the mesh must recover in bounded time
+    tester.SimulateForGivenTime(10 * 1000);
+    tester.SimulateUntilClusteringDone(60 * 1000);
+}
+
+TEST(TestFaultInjection, TestBurstyInterferenceRecovers)
+{
+    CherrySimTester tester = CreateFaultTester(5);
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //Bursts of interference on all links that are long enough to drop some connections
+    tester.SendTerminalCommand(1, "sim fault add {\"type\":\"packetLoss\",\"probability\":0.95,\"startMs\":%u,\"durationMs\":60000,\"burstMs\":8000,\"gapMs\":8000}", tester.sim->simState.simTimeMs);
+    tester.SimulateForGivenTime(60 * 1000);
+    ASSERT_EQ(tester.sim->faultInjector.GetFaults().size(), 1u);
+    ASSERT_GT(tester.sim->faultInjector.GetFaults()[0].triggerCount, 0u);
+
+    tester.SimulateUntilClusteringDone(60 * 1000);
+}
+
+TEST(TestFaultInjection, TestDisconnectAndStall)
+{
+    CherrySimTester tester = CreateFaultTester(5);
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //Disconnect all connections of node 2 once
+    SimFault disconnect;
+    disconnect.type = SimFaultType::DISCONNECT;
+    disconnect.node = 2;
+    disconnect.bidirectional = true;
+    disconnect.startMs = tester.sim->simState.simTimeMs + 1000;
+    tester.sim->faultInjector.AddFault(disconnect);
+    tester.SimulateForGivenTime(2000);
+    ASSERT_EQ(tester.sim->faultInjector.GetFaults()[0].triggerCount, 1u);
+    tester.SimulateUntilClusteringDone(60 * 1000);
+
+    //While all links are stalled, the connections stay up but no data is delivered
+    tester.sim->faultInjector.Clear();
+    SimFault stall;
+    stall.type = SimFaultType::TX_STALL;
+    stall.startMs = tester.sim->simState.simTimeMs;
+    stall.durationMs = 5000;
+    tester.sim->faultInjector.AddFault(stall);
+    tester.SimulateGivenNumberOfSteps(1);
+    const uint64_t receivedPackets = GetTotalReceivedPackets(*tester.sim);
+    tester.SendTerminalCommand(1, "action 0 status get_status");
+    tester.SimulateForGivenTime(4000);
+    ASSERT_EQ(GetTotalReceivedPackets(*tester.sim), receivedPackets);
+    ASSERT_TRUE(tester.sim->IsClusteringDone());
+
+    //Queued packets are delivered after the stall
+    tester.SimulateForGivenTime(5000);
+    ASSERT_GT(GetTotalReceivedPackets(*tester.sim), receivedPackets);
+    ASSERT_TRUE(tester.sim->IsClusteringDone());
+}
+
+TEST(TestFaultInjection, TestClockDrift)
+{
+    CherrySimTester tester = CreateFaultTester(1);
+    tester.Start();
+
+    //The timer of node 2 runs 10 % faster
+    SimFault drift;
+    drift.type = SimFaultType::CLOCK_DRIFT;
+    drift.node = 2;
+    drift.driftPpm = 100 * 1000;
+    tester.sim->faultInjector.AddFault(drift);
+
+    const u32 startDs1 = tester.sim->FindNodeById(1)->gs.appTimerDs;
+    const u32 startDs2 = tester.sim->FindNodeById(2)->gs.appTimerDs;
+    tester.SimulateForGivenTime(100 * 1000);
+    const u32 passedDs1 = tester.sim->FindNodeById(1)->gs.appTimerDs - startDs1;
+    const u32 passedDs2 = tester.sim->FindNodeById(2)->gs.appTimerDs - startDs2;
+    ASSERT_NEAR(passedDs1, 1000, 10);
+    ASSERT_NEAR(passedDs2, 1100, 10);
+}
+
+TEST(TestFaultInjection, TestFlashFailures)
+{
+    CherrySimTester tester = CreateFaultTester(1);
+    tester.Start();
+    tester.SimulateGivenNumberOfSteps(10);
+
+    //Every second flash operation fails, the flash storage retries until the record is saved
+    tester.SendTerminalCommand(1, "sim fault add {\"type\":\"flashFailure\",\"node\":2,\"probability\":0.5}");
+    tester.SimulateGivenNumberOfSteps(1);
+    tester.SendTerminalCommand(2, "saverec 13 DE:AD:BE:EF");
+    tester.SimulateForGivenTime(10 * 1000);
+    tester.SendTerminalCommand(2, "getrec 13");
+    tester.SimulateUntilMessageReceived(10 * 1000, 2, "DE:AD:BE:EF:");
+}
+
+TEST(TestFaultInjection, TestMalformedFaultIsRejected)
+{
+    CherrySimTester tester = CreateFaultTester(1);
+    tester.Start();
+    tester.SimulateGivenNumberOfSteps(10);
+
+    const char* const malformedFaults[] = {
+        "{\"type\":\"packetLoss\",",                                 //Truncated json
+        "[\"packetLoss\"]",                                           //Not an object
+        "{\"type\":\"packetLoss\",\"node\":\"three\"}",              //Entry of the wrong type
+        "{\"type\":\"packetLoss\",\"node\":70000}",                  //Node id out of range
+        "{\"type\":\"solarFlare\"}",                                 //Unknown fault type
+        "{\"node\":3}",                                              //Missing type
+        "{\"type\":\"packetLoss\",\"colour\":1}",                    //Unknown entry
+        "{\"type\":\"packetLoss\",\"probability\":1.5}",             //Probability above 1
+        "{\"type\":\"packetLoss\",\"probability\":-0.5}",            //Probability below 0
+        "{\"type\":\"packetLoss\",\"burstMs\":100}",                 //Burst without gap
+        "{\"type\":\"disconnect\",\"burstMs\":100,\"gapMs\":100}",   //Burst of a disconnect
+    };
+    Exceptions::DisableDebugBreakOnException disabler;
+    for (const char* fault : malformedFaults)
+    {
+        tester.SendTerminalCommand(1, "sim fault add %s", fault);
+        ASSERT_THROW(tester.SimulateGivenNumberOfSteps(1), WrongCommandParameterException) << fault;
+    }
+
+    ASSERT_TRUE(tester.sim->faultInjector.GetFaults().empty());
+}
@@ -0,0 +1,187 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <chrono>
+#include <CherrySimTester.h>
+#include <FruitySimServer.h>
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+//Applies a devices response to the devices that a client already knows, as a client polling with ?since= has to do it.
+static u32 ApplyDevicesResponse(std::map<std::string, json>& devicesByUuid, const std::string& response)
+{
+    const json responseJson = json::parse(response);
+    if (responseJson["full"]) devicesByUuid.clear();
+    for (const json& delta : responseJson["result"])
+    {
+        devicesByUuid[delta["uuid"].get<std::string>()].merge_patch(delta);
+    }
+    return responseJson["revision"];
+}
+
+TEST(TestFruitySimServer, TestDevicesDiffMatchesFullResponse)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 9 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    tester.SimulateForGivenTime(1000);
+
+    FruitySimServer* server = tester.sim->server;
+    std::map<std::string, json> clientDevices;
+
+    const json first = json::parse(server->GenerateDevicesJson());
+    ASSERT_TRUE(first["full"].get<bool>());
+    ASSERT_EQ(first["result"].size(), 10);
+    u32 revision = ApplyDevicesResponse(clientDevices, first.dump());
+    ASSERT_EQ(revision, server->GetDevicesRevision());
+
+    //Nothing was simulated in between, so nothing must have changed
+    const json unchanged = json::parse(server->GenerateDevicesJson(revision));
+    ASSERT_FALSE(unchanged["full"].get<bool>());
+    ASSERT_EQ(unchanged["result"].size(), 0);
+    ASSERT_EQ(unchanged["revision"].get<u32>(), revision);
+
+    //Apply the deltas during clustering and check that the client always ends up with the same state as a full request
+    for (u32 i = 0; i < 10; i++)
+    {
+        tester.SimulateForGivenTime(2000);
+        const std::string deltaResponse = server->GenerateDevicesJson(revision);
+        ASSERT_FALSE(json::parse(deltaResponse)["full"].get<bool>());
+        revision = ApplyDevicesResponse(clientDevices, deltaResponse);
+
+        std::map<std::string, json> fullDevices;
+        ApplyDevicesResponse(fullDevices, server->GenerateDevicesJson());
+        ASSERT_EQ(clientDevices, fullDevices);
+    }
+
+    //A client that skipped some responses must still get all changes
+    const u32 oldRevision = revision;
+    std::map<std::string, json> oldClientDevices = clientDevices;
+    tester.SimulateForGivenTime(5000);
+    server->GenerateDevicesJson(revision);
+    tester.SimulateForGivenTime(5000);
+    ApplyDevicesResponse(oldClientDevices, server->GenerateDevicesJson(oldRevision));
+    std::map<std::string, json> fullDevices;
+    ApplyDevicesResponse(fullDevices, server->GenerateDevicesJson());
+    ASSERT_EQ(oldClientDevices, fullDevices);
+
+    //Unknown revisions, e.g. of a previous simulation, result in a full response
+    ASSERT_TRUE(json::parse(server->GenerateDevicesJson(server->GetDevicesRevision() + 100))["full"].get<bool>());
+}
+
+TEST(TestFruitySimServer, TestDevicesDiffContainsRssiChanges)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    FruitySimServer* server = tester.sim->server;
+    std::map<std::string, json> clientDevices;
+    u32 revision = ApplyDevicesResponse(clientDevices, server->GenerateDevicesJson());
+
+    //Find the node that reports the rssi of its inConnection, the uuid ends with its index
+    std::string uuid;
+    for (const auto& device : clientDevices)
+    {
+        if (device.second["inConnectionPartner"] != 0) uuid = device.first;
+    }
+    ASSERT_FALSE(uuid.empty());
+    NodeEntry* node = &tester.sim->nodes[std::stoul(uuid.substr(uuid.size() - 4))];
+    const int rssiBefore = clientDevices[uuid]["inConnectionRssi"];
+
+    //Neither value is part of the device json, but both change the rssi
+    node->gs.boardconf.configuration.calibratedTX -= 10;
+    revision = ApplyDevicesResponse(clientDevices, server->GenerateDevicesJson(revision));
+    ASSERT_NE(clientDevices[uuid]["inConnectionRssi"], rssiBefore);
+
+    node->impossibleConnection.push_back(node->index == 0 ? 1 : 0);
+    revision = ApplyDevicesResponse(clientDevices, server->GenerateDevicesJson(revision));
+    ASSERT_EQ(clientDevices[uuid]["inConnectionRssi"], -10000);
+
+    std::map<std::string, json> fullDevices;
+    ApplyDevicesResponse(fullDevices, server->GenerateDevicesJson());
+    ASSERT_EQ(clientDevices, fullDevices);
+}
+
+TEST(TestFruitySimServer, BenchmarkDevicesJson_long)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 999 });
+    simConfig.mapWidthInMeters = 400;
+    simConfig.mapHeightInMeters = 400;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    tester.SimulateForGivenTime(1000);
+
+    FruitySimServer* server = tester.sim->server;
+    auto measure = [](const std::function<std::string()>& request, size_t& bytes) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        bytes = request().size();
+        return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+    };
+
+    //The first request has to generate every device, this is what every request used to cost
+    size_t coldBytes = 0;
+    const double coldUs = measure([&]() { return server->GenerateDevicesJson(); }, coldBytes);
+    u32 revision = server->GetDevicesRevision();
+
+    constexpr u32 numRequests = 20;
+    double deltaUs = 0;
+    double fullUs = 0;
+    size_t deltaBytes = 0;
+    size_t fullBytes = 0;
+    for (u32 i = 0; i < numRequests; i++)
+    {
+        tester.SimulateForGivenTime(100);
+
+        size_t bytes = 0;
+        deltaUs += measure([&]() { return server->GenerateDevicesJson(revision); }, bytes);
+        deltaBytes += bytes;
+        revision = server->GetDevicesRevision();
+
+        fullUs += measure([&]() { return server->GenerateDevicesJson(); }, bytes);
+        fullBytes += bytes;
+    }
+
+    printf("Devices json for %u nodes:" EOL, tester.sim->GetTotalNodes());
+    printf("Cold full request: %.0f us, %u bytes" EOL, coldUs, (u32)coldBytes);
+    printf("Warm full request: %.0f us, %u bytes" EOL, fullUs / numRequests, (u32)(fullBytes / numRequests));
+    printf("Delta request (100 ms simulated): %.0f us, %u bytes" EOL, deltaUs / numRequests, (u32)(deltaBytes / numRequests));
+}
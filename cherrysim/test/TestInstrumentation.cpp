@@ -0,0 +1,212 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <StackWatcher.h>
+#include <chrono>
+
+//Uses about 1 KB of stack per level. Not instrumented by the address sanitizer so that the buffer
+//is not moved to a fake stack.
+#if defined(__GNUC__)
+__attribute__((no_sanitize_address))
+#endif
+static u32 RecurseWithStackUsage(u32 depth)
+{
+    START_OF_FUNCTION();
+    volatile u8 buffer[1000] = {};
+    buffer[depth % sizeof(buffer)] = (u8)depth;
+    if (depth == 0) return buffer[0];
+    return RecurseWithStackUsage(depth - 1) + buffer[depth % sizeof(buffer)];
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void InstrumentedFunction(u32* counter)
+{
+    START_OF_FUNCTION();
+    (*counter)++;
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void UninstrumentedFunction(u32* counter)
+{
+    (*counter)++;
+}
+
+//START_OF_FUNCTION as it was before the stack limit and the interrupt schedule were calculated in advance,
+//kept as a reference for the speed. Both parts were out of line calls and a random number was drawn on
+//every call while an interrupt was queued.
+static std::vector<const void*> referenceStackBase;
+static u32 referenceStackWatcherDisableValue = 0;
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void ReferenceStackWatcherCheck()
+{
+    if (referenceStackBase.size() == 0)
+    {
+        return;
+    }
+    if (referenceStackWatcherDisableValue != 0)
+    {
+        return;
+    }
+
+    int someDummyStackVariable = 0;
+
+    const u32 uncleanedStackSize = (const char*)referenceStackBase.back() - (const char*)&someDummyStackVariable;
+    const u32 cleanedStackSize = uncleanedStackSize - sizeof(StackBaseSetter);
+
+    if (cleanedStackSize > 12000)
+    {
+        SIMEXCEPTION(StackOverflowException);
+    }
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void ReferenceSimulateInterrupts(CherrySim* sim)
+{
+    NodeEntry* currentNode = sim->currentNode;
+    if (currentNode->interruptQueue.size() > 0)
+    {
+        if (NODE_PSRNG(SCHEDULING, sim->simConfig.interruptProbability))
+        {
+            u32 pin = currentNode->interruptQueue.front();
+            currentNode->interruptQueue.pop();
+
+            if (currentNode->gpioInitializedPins.find(pin) != currentNode->gpioInitializedPins.end()) {
+                InterruptSettings &settings = currentNode->gpioInitializedPins[pin];
+                if (settings.isEnabled)
+                {
+                    settings.handler(pin, 0);
+                }
+            }
+        }
+    }
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void ReferenceInstrumentedFunction(u32* counter)
+{
+    ReferenceStackWatcherCheck(); if(cherrySimInstance != nullptr) {ReferenceSimulateInterrupts(cherrySimInstance);}
+    (*counter)++;
+}
+
+#if !defined(GITHUB_RELEASE) && !defined(__clang__)
+TEST(TestInstrumentation, TestStackOverflowIsDetected)
+{
+    Exceptions::DisableDebugBreakOnException disabler;
+    StackBaseSetter sbs;
+    RecurseWithStackUsage(5);
+    ASSERT_THROW(RecurseWithStackUsage(20), StackOverflowException);
+    {
+        StackWatcherDisabler stackWatcherDisabler;
+        RecurseWithStackUsage(20);
+    }
+    ASSERT_THROW(RecurseWithStackUsage(20), StackOverflowException);
+}
+#endif
+
+TEST(TestInstrumentation, TestDrawCallsUntilInterrupt)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    NodeIndexSetter setter(0);
+
+    tester.sim->simConfig.interruptProbability = 0;
+    ASSERT_EQ(tester.sim->DrawCallsUntilInterrupt(), 0);
+    tester.sim->simConfig.interruptProbability = UINT32_MAX;
+    ASSERT_EQ(tester.sim->DrawCallsUntilInterrupt(), 1);
+
+    //With a probability of 1/10 per call, an interrupt happens after 10 calls on average
+    tester.sim->simConfig.interruptProbability = UINT32_MAX / 10;
+    constexpr u32 amountOfDraws = 100 * 1000;
+    uint64_t sum = 0;
+    for (u32 i = 0; i < amountOfDraws; i++)
+    {
+        const u32 calls = tester.sim->DrawCallsUntilInterrupt();
+        ASSERT_GE(calls, 1);
+        sum += calls;
+    }
+    ASSERT_NEAR((double)sum / amountOfDraws, 10.0, 0.2);
+}
+
+TEST(TestInstrumentation, BenchmarkStartOfFunction_long)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    NodeIndexSetter setter(0);
+    StackBaseSetter sbs;
+    int someDummyStackVariable = 0;
+    referenceStackBase.push_back(&someDummyStackVariable);
+
+    constexpr u32 amountOfCalls = 10 * 1000 * 1000;
+    u32 counter = 0;
+    auto measure = [&](void (*function)(u32*))
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (u32 i = 0; i < amountOfCalls; i++) function(&counter);
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / amountOfCalls;
+    };
+
+    const double uninstrumentedNs = measure(UninstrumentedFunction);
+    printf("Uninstrumented call: %.2f ns" EOL, uninstrumentedNs);
+    const double instrumentedNs = measure(InstrumentedFunction);
+    const double referenceNs = measure(ReferenceInstrumentedFunction);
+    printf("No interrupt queued, instrumented call: %.2f ns, previous instrumentation: %.2f ns" EOL, instrumentedNs, referenceNs);
+
+    //Queue interrupts for a pin without handler that are simulated about once every million calls
+    NodeEntry* node = tester.sim->currentNode;
+    tester.sim->simConfig.interruptProbability = UINT32_MAX / (1000 * 1000);
+    const u32 unusedPin = 0xFFFF;
+    for (u32 i = 0; i < 1000; i++) node->interruptQueue.push(unusedPin);
+    node->callsUntilInterrupt = tester.sim->DrawCallsUntilInterrupt();
+    const double queuedInstrumentedNs = measure(InstrumentedFunction);
+    const double queuedReferenceNs = measure(ReferenceInstrumentedFunction);
+    printf("Interrupt queued, instrumented call: %.2f ns, previous instrumentation: %.2f ns" EOL, queuedInstrumentedNs, queuedReferenceNs);
+    ASSERT_GT(node->interruptQueue.size(), 0);
+
+    referenceStackBase.pop_back();
+    ASSERT_EQ(counter, 5 * amountOfCalls);
+}
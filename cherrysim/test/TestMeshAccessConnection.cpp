@@ -0,0 +1,211 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include "Utility.h"
+#include "CherrySimTester.h"
+#include "CherrySimUtils.h"
+#include "MeshAccessConnection.h"
+#include <vector>
+
+//Known answer tests for the MeshAccessConnection encryption with precomputed keystreams
+class TestMeshAccessConnection : public ::testing::Test
+{
+private:
+    CherrySimTester* tester = nullptr;
+public:
+    MeshAccessConnection* conn = nullptr;
+    static constexpr u8 sessionKey[16] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+    static constexpr u32 nonceBase = 0x11223344;
+    static constexpr u8 packetLength = 12;
+    static constexpr u8 packet[packetLength] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C };
+
+    void SetUp() override
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+        tester = new CherrySimTester(testerConfig, simConfig);
+        tester->Start();
+        NodeIndexSetter setter(0);
+
+        FruityHal::BleGapAddr partnerAddress = {};
+        conn = new MeshAccessConnection(0, ConnectionDirection::DIRECTION_IN, &partnerAddress, FmKeyId::NETWORK, MeshAccessTunnelType::PEER_TO_PEER);
+    }
+
+    void TearDown() override
+    {
+        {
+            NodeIndexSetter setter(0);
+            delete conn;
+        }
+        delete tester;
+    }
+
+    //Sets up the connection as if the handshake was done with the same session key and nonce in both directions
+    void StartSession(u32 counter)
+    {
+        CheckedMemcpy(conn->encryptionEcb.key, sessionKey, 16);
+        CheckedMemcpy(conn->decryptionEcb.key, sessionKey, 16);
+        conn->encryptionNonce[0] = conn->decryptionNonce[0] = nonceBase;
+        conn->ResetKeystreamCaches();
+        SetCounters(counter);
+        conn->encryptionState = EncryptionState::ENCRYPTED;
+        conn->connectionState = ConnectionState::HANDSHAKE_DONE;
+    }
+
+    //Changes the nonce counters without touching the keystream caches
+    void SetCounters(u32 counter)
+    {
+        conn->encryptionNonce[1] = conn->decryptionNonce[1] = counter;
+    }
+
+    u32 GetDecryptionCounter()
+    {
+        return conn->decryptionNonce[1];
+    }
+
+    bool IsEncryptionKeystreamCached(u32 counter)
+    {
+        const u32 slot = counter % MESH_ACCESS_KEYSTREAM_CACHE_SIZE;
+        return (conn->encryptionKeystreamCache.validFlags & (1 << slot)) != 0 && conn->encryptionKeystreamCache.counters[slot] == counter;
+    }
+
+    //Encrypts the packet just like the connection does when sending, including the counter increment
+    std::vector<u8> Encrypt(const u8* data, u8 length)
+    {
+        std::vector<u8> encrypted(length + MESH_ACCESS_MIC_LENGTH);
+        CheckedMemcpy(encrypted.data(), data, length);
+        conn->EncryptPacket(encrypted.data(), length);
+        conn->encryptionNonce[1] += 2;
+        return encrypted;
+    }
+
+    //Uncached reference implementation that generates every keystream block from scratch
+    static std::vector<u8> EncryptReference(u32 counter, const u8* data, u8 length)
+    {
+        Aes128Block cleartext;
+        Aes128Block keystream;
+        Aes128Block ciphertext;
+        std::vector<u8> encrypted(length + MESH_ACCESS_MIC_LENGTH);
+
+        CheckedMemset(cleartext.data, 0x00, 16);
+        CheckedMemcpy(cleartext.data, &nonceBase, sizeof(u32));
+        CheckedMemcpy(cleartext.data + sizeof(u32), &counter, sizeof(u32));
+        Utility::Aes128BlockEncrypt(&cleartext, (const Aes128Block*)sessionKey, &keystream);
+        Utility::XorBytes(keystream.data, data, length, encrypted.data());
+
+        const u32 micCounter = counter + 1;
+        CheckedMemcpy(cleartext.data + sizeof(u32), &micCounter, sizeof(u32));
+        Utility::Aes128BlockEncrypt(&cleartext, (const Aes128Block*)sessionKey, &keystream);
+
+        CheckedMemset(ciphertext.data, 0x00, 16);
+        CheckedMemcpy(ciphertext.data, encrypted.data(), length);
+        Utility::XorBytes(keystream.data, ciphertext.data, 16, cleartext.data);
+        Utility::Aes128BlockEncrypt(&cleartext, (const Aes128Block*)sessionKey, &ciphertext);
+        CheckedMemcpy(encrypted.data() + length, ciphertext.data, MESH_ACCESS_MIC_LENGTH);
+
+        return encrypted;
+    }
+
+    void ExpectDecryptsToPacket(const std::vector<u8>& encrypted)
+    {
+        u8 decrypted[packetLength];
+        ASSERT_TRUE(conn->DecryptPacket(encrypted.data(), decrypted, (u16)encrypted.size()));
+        ASSERT_EQ(memcmp(decrypted, packet, packetLength), 0);
+    }
+};
+constexpr u8 TestMeshAccessConnection::sessionKey[16];
+constexpr u8 TestMeshAccessConnection::packet[TestMeshAccessConnection::packetLength];
+
+TEST_F(TestMeshAccessConnection, TestEncryptionWithCachedKeystream) {
+    NodeIndexSetter setter(0);
+    StartSession(100);
+    conn->PrecomputeKeystreams();
+    ASSERT_TRUE(IsEncryptionKeystreamCached(100));
+    ASSERT_TRUE(IsEncryptionKeystreamCached(101));
+
+    const std::vector<u8> expected = { 0xC8, 0x17, 0x6B, 0x58, 0x45, 0xAA, 0x93, 0x2F, 0x54, 0x87, 0x1B, 0xF0, 0x1A, 0xAE, 0x65, 0xAD };
+    ASSERT_EQ(EncryptReference(100, packet, packetLength), expected);
+
+    const std::vector<u8> encrypted = Encrypt(packet, packetLength);
+    ASSERT_EQ(encrypted, expected);
+
+    ExpectDecryptsToPacket(encrypted);
+    ASSERT_EQ(GetDecryptionCounter(), 102);
+}
+
+TEST_F(TestMeshAccessConnection, TestEncryptionAfterCounterJump) {
+    NodeIndexSetter setter(0);
+    StartSession(100);
+    conn->PrecomputeKeystreams();
+
+    //The slots of the new counters are still filled with the keystreams of the old counters and must not be used
+    SetCounters(1000);
+    ASSERT_FALSE(IsEncryptionKeystreamCached(1000));
+
+    const std::vector<u8> expected = { 0xDF, 0x17, 0xDD, 0x15, 0x50, 0x52, 0xB2, 0xBE, 0x1E, 0x35, 0x2A, 0xB4, 0xFA, 0xFC, 0xAD, 0x7D };
+    ASSERT_EQ(EncryptReference(1000, packet, packetLength), expected);
+
+    const std::vector<u8> encrypted = Encrypt(packet, packetLength);
+    ASSERT_EQ(encrypted, expected);
+    ASSERT_TRUE(IsEncryptionKeystreamCached(1000));
+
+    ExpectDecryptsToPacket(encrypted);
+    ASSERT_EQ(GetDecryptionCounter(), 1002);
+}
+
+TEST_F(TestMeshAccessConnection, TestEncryptionWithCounterWrap) {
+    NodeIndexSetter setter(0);
+    StartSession(0xFFFFFFFF);
+    conn->PrecomputeKeystreams();
+    //The keystream for the MIC uses the wrapped counter
+    ASSERT_TRUE(IsEncryptionKeystreamCached(0));
+
+    const std::vector<u8> expected = { 0x2C, 0xEB, 0xEF, 0xD6, 0xC8, 0x73, 0xFC, 0x11, 0xB0, 0xAB, 0xA8, 0x5C, 0xF6, 0x7A, 0x8D, 0x0E };
+    ASSERT_EQ(EncryptReference(0xFFFFFFFF, packet, packetLength), expected);
+
+    const std::vector<u8> encrypted = Encrypt(packet, packetLength);
+    ASSERT_EQ(encrypted, expected);
+    ExpectDecryptsToPacket(encrypted);
+    ASSERT_EQ(GetDecryptionCounter(), 1);
+
+    //Continue over the wrap with a mix of precomputed and generated keystreams
+    StartSession(0xFFFFFFF0);
+    for (u32 i = 0; i < 20; i++)
+    {
+        const u32 counter = 0xFFFFFFF0 + i * 2;
+        if (i % 3 == 0) conn->PrecomputeKeystreams();
+        const std::vector<u8> wrapped = Encrypt(packet, (u8)(1 + i % packetLength));
+        ASSERT_EQ(wrapped, EncryptReference(counter, packet, (u8)(1 + i % packetLength)));
+        u8 decrypted[packetLength];
+        ASSERT_TRUE(conn->DecryptPacket(wrapped.data(), decrypted, (u16)wrapped.size()));
+        ASSERT_EQ(memcmp(decrypted, packet, 1 + i % packetLength), 0);
+    }
+}
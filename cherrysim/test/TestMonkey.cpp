@@ -34,8 +34,9 @@
 #include "gtest/gtest.h"
 #include "CherrySimTester.h"
 #include "CherrySimUtils.h"
+#include "TestMonkey.h"
 
-const std::vector<std::string> templates{
+const std::vector<std::string> monkeyTemplates{
 /****************/
 /* DEBUG MODULE */
 /****************/
@@ -337,7 +338,7 @@ std::vector<CommandWithTarget> CreateCommands(int amount, u32 seed, u32 amountOf
     std::vector<CommandWithTarget> retVal;
     for (int commandNum = 0; commandNum < amount; commandNum++)
     {
-        std::string command = getRandomCommand(monkeyRand, templates, { "BBBBB", "BBBBC", "BBBBD" }, (allCommandsInOrder ? commandNum : -1));
+        std::string command = getRandomCommand(monkeyRand, monkeyTemplates, { "BBBBB", "BBBBC", "BBBBD" }, (allCommandsInOrder ? commandNum : -1));
         if (!onlyValidCommands) {
             command = corruptCommand(monkeyRand, command);
         }
@@ -444,7 +445,7 @@ void StartTestMonkey(bool onlyValidCommands, bool allCommandsInOrder, bool reduc
         }
         printf("Seed: %u" EOL, seed);
         
-        std::vector<CommandWithTarget> commands = CreateCommands((allCommandsInOrder ? templates.size() : 1024), seed, amountOfNodes, onlyValidCommands, allCommandsInOrder);
+        std::vector<CommandWithTarget> commands = CreateCommands((allCommandsInOrder ? monkeyTemplates.size() : 1024), seed, amountOfNodes, onlyValidCommands, allCommandsInOrder);
         try 
         {
             ExecuteCommands(commands, seed, amountOfNodes);
@@ -323,6 +323,67 @@ TEST(TestMoveAnimation, TestSimpleDiamondAnimationLooped) {
     }
 }
 
+TEST(TestMoveAnimation, TestEngineMatchesEvaluate) {
+    //Tests that the batched MoveAnimationEngine produces exactly the same positions as MoveAnimation::Evaluate
+    std::vector<MoveAnimation> animations;
+    const MoveAnimationType types[] = { MoveAnimationType::LERP, MoveAnimationType::COSINE, MoveAnimationType::BOOLEAN };
+    for (u32 i = 0; i < 12; i++)
+    {
+        MoveAnimation animation;
+        animation.SetLooped(i % 2 == 0);
+        for (u32 k = 0; k < 1 + i % 5; k++)
+        {
+            //Durations that are not exactly representable as floats to cover the millisecond rounding
+            animation.AddKeyPoint(MoveAnimationKeyPoint(0.3f * i - k, 1.7f * k, 0.1f * (i + k), 0.1f + 0.37f * ((i + k) % 4), types[(i + k) % 3]));
+        }
+        animation.Start(i * 13, { 0.5f * i, -0.25f * i, 1.0f });
+        animations.push_back(animation);
+    }
+
+    MoveAnimationEngine engine;
+    std::vector<bool> running(animations.size(), true);
+    for (u32 timeMs = 0; timeMs < 8000; timeMs += 7)
+    {
+        engine.BeginSync();
+        for (u32 i = 0; i < animations.size(); i++)
+        {
+            if (animations[i].IsStarted()) engine.Sync(i, animations[i]);
+        }
+        engine.Evaluate(timeMs);
+
+        for (u32 i = 0; i < animations.size(); i++)
+        {
+            if (!animations[i].IsStarted()) continue;
+            //Every other node skips some steps, like a node that is not simulated due to jittering
+            if (i % 4 == 1 && (timeMs / 7) % 3 == 0) continue;
+
+            ThreeDimStruct<float> enginePosition = {};
+            bool finished = false;
+            ASSERT_TRUE(engine.GetPosition(i, animations[i], timeMs, enginePosition, finished));
+
+            const ThreeDimStruct<float> referencePosition = animations[i].Evaluate(timeMs);
+            ASSERT_EQ(enginePosition.x, referencePosition.x);
+            ASSERT_EQ(enginePosition.y, referencePosition.y);
+            ASSERT_EQ(enginePosition.z, referencePosition.z);
+            ASSERT_EQ(finished, !animations[i].IsStarted());
+        }
+    }
+
+    //Looped animations never end, the others have all been reset by now
+    for (u32 i = 0; i < animations.size(); i++)
+    {
+        ASSERT_EQ(animations[i].IsStarted(), i % 2 == 0);
+    }
+    ASSERT_EQ(engine.GetAmountOfMovingNodes(), animations.size() / 2);
+
+    //An animation that was restarted after the last evaluation must not use the stale result
+    ThreeDimStruct<float> position = {};
+    bool finished = false;
+    ASSERT_TRUE(engine.GetPosition(0, animations[0], 7994, position, finished));
+    animations[0].Start(7994, { 0, 0, 0 });
+    ASSERT_FALSE(engine.GetPosition(0, animations[0], 7994, position, finished));
+}
+
 #ifndef GITHUB_RELEASE
 TEST(TestMoveAnimation, TestBuildUpViaCommands) {
     //Builds up animations via Terminal Commands and starts them.
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <chrono>
+#include <set>
+
+//Reboots every node of the simulation the given amount of times without simulating in between
+static void RebootAllNodes(CherrySimTester& tester, u32 rounds)
+{
+    for (u32 round = 0; round < rounds; round++)
+    {
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+        {
+            NodeIndexSetter setter(i);
+            tester.sim->ResetCurrentNode(RebootReason::LOCAL_RESET, false);
+        }
+    }
+}
+
+TEST(TestNodeBoot, TestRebootReusesNodeMemory)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 2 });
+    simConfig.SetToPerfectConditions();
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //Every featureset was measured once, each node allocated its HAL and module memory once.
+    //Featuresets might be redirected to the same one (see CherrySim::RedirectFeatureset).
+    std::set<std::string> featuresets;
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++) featuresets.insert(tester.sim->nodes[i].nodeConfiguration);
+    ASSERT_EQ(tester.sim->nodeBootTemplates.size(), featuresets.size());
+    ASSERT_EQ(tester.sim->amountOfNodeMemoryAllocations, 2 * tester.sim->GetTotalNodes());
+    const u8* halMemory = tester.sim->nodes[1].halMemory;
+    const u8* moduleMemoryBlock = tester.sim->nodes[1].moduleMemoryBlock;
+
+    tester.SendTerminalCommand(2, "reset");
+    tester.SimulateUntilMessageReceived(10 * 1000, 2, "{\"type\":\"reboot\",\"reason\":7");
+    ASSERT_EQ(tester.sim->nodes[1].restartCounter, 2);
+    //Node 3 might only be reachable through node 2
+    tester.SimulateUntilClusteringDone(100 * 1000);
+    tester.SendTerminalCommand(1, "action 3 node reset");
+    tester.SimulateForGivenTime(20 * 1000);
+    ASSERT_EQ(tester.sim->nodes[2].restartCounter, 2);
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    ASSERT_EQ(tester.sim->amountOfNodeMemoryAllocations, 2 * tester.sim->GetTotalNodes());
+    ASSERT_EQ(tester.sim->nodes[1].halMemory, halMemory);
+    ASSERT_EQ(tester.sim->nodes[1].moduleMemoryBlock, moduleMemoryBlock);
+    ASSERT_EQ(tester.sim->nodes[1].gs.halMemory, halMemory);
+
+    //The modules must still work with their reused memory
+    tester.SendTerminalCommand(1, "action 2 status get_status");
+    tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":2,\"type\":\"status\"");
+}
+
+TEST(TestNodeBoot, TestFastBootBehavesLikeFullBoot)
+{
+    //The same reboots must lead to the same mesh, no matter if the memory is reused or not
+    std::vector<ClusterId> clusterIds[2];
+    for (int fastNodeBoot = 0; fastNodeBoot <= 1; fastNodeBoot++)
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 4 });
+        simConfig.SetToPerfectConditions();
+        simConfig.fastNodeBoot = fastNodeBoot == 1;
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+        tester.SimulateUntilClusteringDone(100 * 1000);
+
+        RebootAllNodes(tester, 3);
+        tester.SimulateForGivenTime(30 * 1000);
+        tester.SimulateUntilClusteringDone(100 * 1000);
+
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+        {
+            ASSERT_EQ(tester.sim->nodes[i].restartCounter, 4);
+            clusterIds[fastNodeBoot].push_back(tester.sim->nodes[i].gs.node.clusterId);
+        }
+        //Without the fast boot, every boot allocates
+        const u32 expectedAllocations = 2 * tester.sim->GetTotalNodes() * (fastNodeBoot == 1 ? 1 : 4);
+        ASSERT_EQ(tester.sim->amountOfNodeMemoryAllocations, expectedAllocations);
+    }
+    ASSERT_EQ(clusterIds[0], clusterIds[1]);
+}
+
+TEST(TestNodeBoot, BenchmarkRebootStorm_long)
+{
+    constexpr u32 amountOfNodes = 200;
+    constexpr u32 rounds = 20;
+    for (int fastNodeBoot = 0; fastNodeBoot <= 1; fastNodeBoot++)
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", amountOfNodes });
+        simConfig.nodeDensity = 0.5;
+        simConfig.fastNodeBoot = fastNodeBoot == 1;
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        RebootAllNodes(tester, rounds);
+        const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        printf("fastNodeBoot %d: %u reboots in %.3f s (%.1f us per reboot), %u memory allocations" EOL,
+            fastNodeBoot, amountOfNodes * rounds, seconds, seconds * 1000 * 1000 / (amountOfNodes * rounds), tester.sim->amountOfNodeMemoryAllocations);
+
+        //The mesh must form again after the storm
+        tester.SimulateUntilClusteringDone(1000 * 1000);
+    }
+}
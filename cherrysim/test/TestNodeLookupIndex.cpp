@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <NodeLookupIndex.h>
+#include <Utility.h>
+
+//Checks every lookup of the simulator against a linear search over all nodes
+static void AssertLookupsMatchLinearSearch(CherrySim* sim)
+{
+    ASSERT_TRUE(sim->AreNodeLookupIndicesConsistent());
+    for (u32 i = 0; i < sim->GetTotalNodes(); i++)
+    {
+        ASSERT_EQ(sim->FindNodeById(sim->nodes[i].id), &sim->nodes[i]);
+
+        const u32 serialNumber = sim->nodes[i].gs.config.GetSerialNumberIndex();
+        NodeEntry* expected = nullptr;
+        for (u32 k = 0; k < sim->GetTotalNodes() && expected == nullptr; k++)
+        {
+            if (sim->nodes[k].gs.config.GetSerialNumberIndex() == serialNumber) expected = &sim->nodes[k];
+        }
+        ASSERT_EQ(sim->GetNodeEntryBySerialNumber(serialNumber), expected);
+    }
+    ASSERT_EQ(sim->FindNodeById(0), nullptr);
+    ASSERT_EQ(sim->FindNodeById(sim->GetTotalNodes() + 1), nullptr);
+}
+
+TEST(TestNodeLookupIndex, TestSharedAndChangedKeys)
+{
+    NodeLookupIndex<u32> index;
+    index.Reset(4);
+    ASSERT_EQ(index.Find(0), UINT32_MAX);
+
+    //Like a linear search, the smallest node index wins if nodes share a key
+    index.Set(2, 7);
+    index.Set(1, 7);
+    index.Set(3, 7);
+    index.Set(0, 5);
+    ASSERT_EQ(index.Find(7), 1);
+    ASSERT_EQ(index.Find(5), 0);
+
+    index.Set(1, 9);
+    ASSERT_EQ(index.Find(7), 2);
+    ASSERT_EQ(index.Find(9), 1);
+    index.Set(2, 9);
+    index.Set(3, 9);
+    ASSERT_EQ(index.Find(7), UINT32_MAX);
+    ASSERT_EQ(index.Find(9), 1);
+
+    const u32 keys[] = { 5, 9, 9, 9 };
+    ASSERT_TRUE(index.IsConsistent([&](u32 nodeIndex) { return keys[nodeIndex]; }));
+    const u32 changedKeys[] = { 5, 9, 4, 9 };
+    ASSERT_FALSE(index.IsConsistent([&](u32 nodeIndex) { return changedKeys[nodeIndex]; }));
+}
+
+TEST(TestNodeLookupIndex, TestSimulatorIndicesStayConsistent)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 4 });
+    simConfig.SetToPerfectConditions();
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    AssertLookupsMatchLinearSearch(tester.sim);
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+    AssertLookupsMatchLinearSearch(tester.sim);
+
+    //Changing the serial number is persisted and followed by a reboot
+    tester.SendTerminalCommand(3, "set_serial BRTCR");
+    tester.SimulateUntilMessageReceived(100, 3, "Serial Number Index set to 364543");
+    ASSERT_EQ(tester.sim->GetNodeEntryBySerialNumber(364543), &tester.sim->nodes[2]);
+    AssertLookupsMatchLinearSearch(tester.sim);
+    tester.SimulateUntilMessageReceived(10 * 1000, 3, "{\"type\":\"reboot\",\"reason\":19");
+    ASSERT_EQ(tester.sim->GetNodeEntryBySerialNumber(364543), &tester.sim->nodes[2]);
+    ASSERT_EQ(tester.sim->GetNodeEntryBySerialNumber(2), nullptr);
+    AssertLookupsMatchLinearSearch(tester.sim);
+
+    //A plain reboot keeps the serial number
+    tester.SendTerminalCommand(3, "reset");
+    tester.SimulateUntilMessageReceived(10 * 1000, 3, "reboot");
+    ASSERT_EQ(tester.sim->GetNodeEntryBySerialNumber(364543), &tester.sim->nodes[2]);
+    AssertLookupsMatchLinearSearch(tester.sim);
+
+    //Enrolling changes the nodeId in the mesh, but neither the simulator id nor the serial number
+    tester.SimulateUntilClusteringDone(100 * 1000);
+    tester.SendTerminalCommand(1, "action 0 enroll basic %s 123 456 11:22:33:44:55:66:77:88:11:22:33:44:55:66:77:88", tester.sim->nodes[1].gs.config.GetSerialNumber());
+    tester.SimulateForGivenTime(50000);
+    ASSERT_EQ(tester.sim->nodes[1].gs.node.configuration.nodeId, 123);
+    ASSERT_EQ(tester.sim->FindNodeById(2), &tester.sim->nodes[1]);
+    ASSERT_EQ(tester.sim->GetNodeEntryBySerialNumber(tester.sim->nodes[1].gs.config.GetSerialNumberIndex()), &tester.sim->nodes[1]);
+    AssertLookupsMatchLinearSearch(tester.sim);
+}
+
+TEST(TestNodeLookupIndex, TestIndicesAfterRestartWithMoreNodes)
+{
+    //Nodes that are added by restarting the simulation with a different configuration must be found as well
+    for (int amountOfNodes = 2; amountOfNodes <= 6; amountOfNodes += 4)
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", amountOfNodes });
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+        AssertLookupsMatchLinearSearch(tester.sim);
+        ASSERT_NE(tester.sim->FindNodeById(amountOfNodes), nullptr);
+    }
+}
@@ -39,12 +39,20 @@
 #include "RingIndexGenerator.h"
 #include "json.hpp"
 #include "SimpleQueue.h"
+#include "SimAes.h"
+#include "MersenneTwister.h"
+#include "ReplayFile.h"
 
 
 extern "C"{
 #include <ccm_soft.h>
 }
 
+//Independent AES implementation that is used by aes-ccm
+u32 * aes_encrypt_init(const u8 *key, size_t len);
+void aes_encrypt(void *ctx, const u8 *plain, u8 *crypt);
+void aes_encrypt_deinit(u32 *ctx);
+
 
 TEST(TestOther, BatteryTest)
 {
@@ -337,6 +345,21 @@ TEST(TestOther, TestJsonConfigSerialization)
     new (&simConfig->replayPath) std::string;
     simConfig->replayPath = "path";
     simConfig->logReplayCommands = true;
+    new (&simConfig->replayRecordPath) std::string;
+    simConfig->replayRecordPath = "record";
+    simConfig->replayCheckpointIntervalMs = 20;
+    simConfig->replaySeekTimeMs = 21;
+    simConfig->replayVerifyCheckpoints = false;
+    new (&simConfig->pcapCapturePath) std::string;
+    simConfig->pcapCapturePath = "capture";
+    simConfig->pcapCaptureBufferSize = 22;
+    simConfig->nodeDensity = 0.75;
+    simConfig->attachUnconnectedNodes = true;
+    simConfig->fastNodeBoot = false;
+    simConfig->statisticSnapshotIntervalMs = 23;
+    simConfig->memorySampleIntervalMs = 24;
+    new (&simConfig->faultScenarioPath) std::string;
+    simConfig->faultScenarioPath = "faults";
     simConfig->useLogAccumulator = true;
     simConfig->defaultNetworkId = 19;
     new (&simConfig->preDefinedPositions)std::vector<std::pair<double, double>>;
@@ -352,22 +375,91 @@ TEST(TestOther, TestJsonConfigSerialization)
     simConfig->verboseCommands = true;
     simConfig->defaultBleStackType = BleStackType::NRF_SD_132_ANY;
 
-    for (size_t i = 0; i < sizeof(memoryArea) / sizeof(*memoryArea); i++)
+    //Every member is listed in declaration order. The only bytes that may lie between two members are the padding
+    //bytes required by the alignment of the next member, which differs between 32 and 64 bit builds. A member that
+    //was added to SimConfiguration but not to this list therefore leaves a gap and fails the test.
+    struct SimConfigurationMember
     {
+        const char* name;
+        size_t offset;
+        size_t size;
+        size_t alignment;
+        bool isStl; //STL types are allowed to have uninitialized memory.
+    };
 #define myOffsetOf(x, y) ((size_t)((char*)(&(x->y)) - (char*)((x))))
-#define IsInSTLRange(x) (byteIndex >= myOffsetOf(simConfig, x) && byteIndex < myOffsetOf(simConfig, x) + sizeof(SimConfiguration::x))
-        const size_t byteIndex = i * sizeof(u32);
-        //The byte is ignored if it's in the range of an STL type as those are allowed to have uninitialized memory.
-
-        if(IsInSTLRange(siteJsonPath)
-            || IsInSTLRange(devicesJsonPath)
-            || IsInSTLRange(replayPath)
-            || IsInSTLRange(preDefinedPositions)
-            || IsInSTLRange(nodeConfigName)
-            || IsInSTLRange(storeFlashToFile)) continue;
-#undef IsInSTLRange
-        ASSERT_NE(memoryArea[i], garbageMagicNumber);
+#define MEMBER(x, isStl) { #x, myOffsetOf(simConfig, x), sizeof(SimConfiguration::x), alignof(decltype(SimConfiguration::x)), isStl }
+    const SimConfigurationMember members[] = {
+        MEMBER(nodeConfigName, true),
+        MEMBER(seed, false),
+        MEMBER(mapWidthInMeters, false),
+        MEMBER(mapHeightInMeters, false),
+        MEMBER(mapElevationInMeters, false),
+        MEMBER(simTickDurationMs, false),
+        MEMBER(terminalId, false),
+        MEMBER(simOtherDelay, false),
+        MEMBER(playDelay, false),
+        MEMBER(interruptProbability, false),
+        MEMBER(connectionTimeoutProbabilityPerSec, false),
+        MEMBER(sdBleGapAdvDataSetFailProbability, false),
+        MEMBER(sdBusyProbability, false),
+        MEMBER(simulateAsyncFlash, false),
+        MEMBER(asyncFlashCommitTimeProbability, false),
+        MEMBER(importFromJson, false),
+        MEMBER(realTime, false),
+        MEMBER(receptionProbabilityVeryClose, false),
+        MEMBER(receptionProbabilityClose, false),
+        MEMBER(receptionProbabilityFar, false),
+        MEMBER(receptionProbabilityVeryFar, false),
+        MEMBER(siteJsonPath, true),
+        MEMBER(devicesJsonPath, true),
+        MEMBER(replayPath, true),
+        MEMBER(logReplayCommands, false),
+        MEMBER(replayRecordPath, true),
+        MEMBER(replayCheckpointIntervalMs, false),
+        MEMBER(replaySeekTimeMs, false),
+        MEMBER(replayVerifyCheckpoints, false),
+        MEMBER(pcapCapturePath, true),
+        MEMBER(pcapCaptureBufferSize, false),
+        MEMBER(nodeDensity, false),
+        MEMBER(attachUnconnectedNodes, false),
+        MEMBER(fastNodeBoot, false),
+        MEMBER(statisticSnapshotIntervalMs, false),
+        MEMBER(memorySampleIntervalMs, false),
+        MEMBER(faultScenarioPath, true),
+        MEMBER(useLogAccumulator, false),
+        MEMBER(defaultNetworkId, false),
+        MEMBER(preDefinedPositions, true),
+        MEMBER(rssiNoise, false),
+        MEMBER(simulateWatchdog, false),
+        MEMBER(simulateJittering, false),
+        MEMBER(verbose, false),
+        MEMBER(enableClusteringValidityCheck, false),
+        MEMBER(enableSimStatistics, false),
+        MEMBER(storeFlashToFile, true),
+        MEMBER(verboseCommands, false),
+        MEMBER(defaultBleStackType, false),
+    };
+#undef MEMBER
+#undef myOffsetOf
+
+    size_t expectedOffset = 0;
+    for (const SimConfigurationMember& member : members)
+    {
+        expectedOffset = (expectedOffset + member.alignment - 1) / member.alignment * member.alignment;
+        ASSERT_EQ(member.offset, expectedOffset) << "A member before " << member.name << " is missing in this test";
+        expectedOffset += member.size;
+
+        if (member.isStl) continue;
+        //The member must have been written, i.e. it must not consist of garbage only.
+        bool written = false;
+        for (size_t i = member.offset; i < member.offset + member.size; i++)
+        {
+            if (reinterpret_cast<const u8*>(memoryArea)[i] != reinterpret_cast<const u8*>(&garbageMagicNumber)[i % sizeof(garbageMagicNumber)]) written = true;
+        }
+        ASSERT_TRUE(written) << member.name << " was not set by this test";
     }
+    expectedOffset = (expectedOffset + alignof(SimConfiguration) - 1) / alignof(SimConfiguration) * alignof(SimConfiguration);
+    ASSERT_EQ(sizeof(SimConfiguration), expectedOffset) << "A member after the last one is missing in this test";
 
     nlohmann::json j = *simConfig;
     SimConfiguration copy = j.get<SimConfiguration>();
@@ -398,6 +490,18 @@ TEST(TestOther, TestJsonConfigSerialization)
     ASSERT_EQ(copy.devicesJsonPath, "bbb");
     ASSERT_EQ(copy.replayPath, "path");
     ASSERT_EQ(copy.logReplayCommands, true);
+    ASSERT_EQ(copy.replayRecordPath, "record");
+    ASSERT_EQ(copy.replayCheckpointIntervalMs, 20);
+    ASSERT_EQ(copy.replaySeekTimeMs, 21);
+    ASSERT_EQ(copy.replayVerifyCheckpoints, false);
+    ASSERT_EQ(copy.pcapCapturePath, "capture");
+    ASSERT_EQ(copy.pcapCaptureBufferSize, 22);
+    ASSERT_NEAR(copy.nodeDensity, 0.75, 0.01);
+    ASSERT_EQ(copy.attachUnconnectedNodes, true);
+    ASSERT_EQ(copy.fastNodeBoot, false);
+    ASSERT_EQ(copy.statisticSnapshotIntervalMs, 23);
+    ASSERT_EQ(copy.memorySampleIntervalMs, 24);
+    ASSERT_EQ(copy.faultScenarioPath, "faults");
     ASSERT_EQ(copy.useLogAccumulator, true);
     ASSERT_EQ(copy.defaultNetworkId, 19);
     ASSERT_EQ(copy.preDefinedPositions.size(), 2);
@@ -420,6 +524,9 @@ TEST(TestOther, TestJsonConfigSerialization)
     simConfig->preDefinedPositions.~vector();
     simConfig->devicesJsonPath.~basic_string();
     simConfig->replayPath.~basic_string();
+    simConfig->replayRecordPath.~basic_string();
+    simConfig->pcapCapturePath.~basic_string();
+    simConfig->faultScenarioPath.~basic_string();
     simConfig->siteJsonPath.~basic_string();
 }
 
@@ -504,6 +611,137 @@ TEST(TestOther, TestReplay)
 }
 #endif //GITHUB_RELEASE
 
+TEST(TestOther, TestBinaryReplay)
+{
+    const std::string replayPath = "TestBinaryReplay.fmreplay";
+    constexpr u32 totalSleep = 30 * 1000;
+    u32 recordedStateHash = 0;
+
+    {
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52",1 });
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52",9 });
+        simConfig.replayRecordPath = replayPath;
+        simConfig.replayCheckpointIntervalMs = 1000;
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+
+        tester.SimulateForGivenTime(1000);
+        tester.SendTerminalCommand(1, "action 0 status get_status");
+        tester.SimulateForGivenTime(10 * 1000);
+        tester.SendTerminalCommand(7, "status");
+        tester.SimulateForGivenTime(totalSleep - 11 * 1000);
+        recordedStateHash = tester.sim->CalculateReplayStateHash();
+    }
+
+    {
+        ReplayFileReader reader(replayPath);
+        ASSERT_EQ(reader.GetFmVersion(), FM_VERSION);
+        ASSERT_TRUE(reader.HasIndex());
+        ASSERT_GE(reader.GetNumCommands(), 2);
+        ASSERT_EQ(reader.GetNumCheckpoints(), totalSleep / 1000);
+        ASSERT_EQ(reader.GetEndTimeMs(), totalSleep);
+
+        reader.SeekToTime(5000);
+        ASSERT_EQ(reader.Peek()->type, ReplayRecordType::CHECKPOINT);
+        ASSERT_EQ(reader.Peek()->time, 5000);
+        reader.Pop();
+        ASSERT_EQ(reader.Peek()->type, ReplayRecordType::CHECKPOINT);
+        ASSERT_EQ(reader.Peek()->time, 6000);
+    }
+
+    //Replaying the recording must pass all checkpoints and end in the same state,
+    //also when fast forwarding to a later time first.
+    for (u32 seekTimeMs : { 0u, 20u * 1000u })
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.replayPath = replayPath;
+        simConfig.replaySeekTimeMs = seekTimeMs;
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+
+        tester.SimulateForGivenTime(totalSleep);
+        ASSERT_EQ(tester.sim->CalculateReplayStateHash(), recordedStateHash);
+        ASSERT_EQ(tester.sim->replayFileReader->Peek(), nullptr);
+    }
+
+    remove(replayPath.c_str());
+}
+
+TEST(TestOther, TestReplayFileSeek)
+{
+    const std::string replayPath = "TestReplayFileSeek.fmreplay";
+    {
+        ReplayFileWriter writer(replayPath);
+        writer.WriteConfiguration("{\"seed\":1}");
+        for (u32 time = 0; time < 100 * 1000; time += 100)
+        {
+            writer.WriteCommand(time, time % 7, "cmd " + std::to_string(time));
+            if (time % 1000 == 0) writer.WriteCheckpoint(time, time * 3);
+        }
+    }
+
+    {
+        ReplayFileReader reader(replayPath);
+        ASSERT_TRUE(ReplayFileReader::IsReplayFile(replayPath));
+        ASSERT_TRUE(reader.HasIndex());
+        ASSERT_EQ(reader.GetConfiguration(), "{\"seed\":1}");
+        ASSERT_EQ(reader.GetNumCommands(), 1000);
+        ASSERT_EQ(reader.GetNumCheckpoints(), 100);
+        ASSERT_EQ(reader.GetEndTimeMs(), 99900);
+
+        //Seeking in between two records must land on the next one
+        reader.SeekToTime(54321);
+        ASSERT_EQ(reader.Peek()->type, ReplayRecordType::COMMAND);
+        ASSERT_EQ(reader.Peek()->time, 54400);
+        ASSERT_EQ(reader.Peek()->index, 54400 % 7);
+        ASSERT_EQ(reader.Peek()->command, "cmd 54400");
+
+        //Commands are stored before checkpoints with the same time
+        reader.SeekToTime(60000);
+        ASSERT_EQ(reader.Peek()->type, ReplayRecordType::COMMAND);
+        reader.Pop();
+        ASSERT_EQ(reader.Peek()->type, ReplayRecordType::CHECKPOINT);
+        ASSERT_EQ(reader.Peek()->stateHash, 180000);
+
+        //Seeking backwards works as well
+        reader.SeekToTime(0);
+        ASSERT_EQ(reader.Peek()->command, "cmd 0");
+
+        reader.SeekToTime(200 * 1000);
+        ASSERT_EQ(reader.Peek(), nullptr);
+    }
+
+    //A recording that was interrupted has no index and may end with a partially written record.
+    //It must still be readable.
+    std::ifstream in(replayPath, std::ios::binary);
+    const std::string fileContents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const std::string truncatedPath = "TestReplayFileSeekTruncated.fmreplay";
+    {
+        std::ofstream out(truncatedPath, std::ios::binary);
+        out << fileContents.substr(0, fileContents.size() / 2 + 3);
+    }
+    {
+        ReplayFileReader reader(truncatedPath);
+        ASSERT_FALSE(reader.HasIndex());
+        reader.SeekToTime(10050);
+        ASSERT_EQ(reader.Peek()->command, "cmd 10100");
+
+        u32 lastTime = 0;
+        for (; reader.Peek() != nullptr; reader.Pop()) lastTime = reader.Peek()->time;
+        ASSERT_GT(lastTime, 10100);
+        ASSERT_LT(lastTime, 99900);
+    }
+
+    ASSERT_FALSE(ReplayFileReader::IsReplayFile("TestReplayFileSeekDoesNotExist.fmreplay"));
+
+    in.close();
+    remove(replayPath.c_str());
+    remove(truncatedPath.c_str());
+}
+
 TEST(TestOther, TestSimCommandCrc)
 {
     CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
@@ -614,6 +852,45 @@ TEST(TestOther, TestEncryption) {
     ccm_soft_encrypt(&ccme);
 }
 
+TEST(TestOther, TestSimAesBackends) {
+    //Test vector from FIPS-197 Appendix B
+    const u8 fipsKey[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+    const u8 fipsCleartext[16] = { 0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d, 0x31, 0x31, 0x98, 0xa2, 0xe0, 0x37, 0x07, 0x34 };
+    const u8 fipsCiphertext[16] = { 0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb, 0xdc, 0x11, 0x85, 0x97, 0x19, 0x6a, 0x0b, 0x32 };
+
+    printf("AES-NI supported: %u" EOL, (u32)SimAes::IsAesNiSupported());
+
+    MersenneTwister mt(1);
+    for (u32 backend = 0; backend < 2; backend++)
+    {
+        SimAes::SetAesNiEnabled(backend == 0);
+
+        u8 ciphertext[16];
+        SimAes::EcbEncryptBlock(fipsKey, fipsCleartext, ciphertext);
+        ASSERT_EQ(memcmp(ciphertext, fipsCiphertext, 16), 0);
+
+        //Compare against the aes-ccm implementation. Only a few different keys are used so that
+        //the key schedule cache is hit as well as missed.
+        u8 keys[8][16];
+        for (u32 i = 0; i < sizeof(keys); i++) ((u8*)keys)[i] = (u8)mt.NextU32();
+        for (u32 i = 0; i < 1000; i++)
+        {
+            const u8* key = keys[mt.NextU32(0, 7)];
+            u8 cleartext[16];
+            for (u32 k = 0; k < 16; k++) cleartext[k] = (u8)mt.NextU32();
+
+            u8 expected[16];
+            u32* ctx = aes_encrypt_init(key, 16);
+            aes_encrypt(ctx, cleartext, expected);
+            aes_encrypt_deinit(ctx);
+
+            SimAes::EcbEncryptBlock(key, cleartext, ciphertext);
+            ASSERT_EQ(memcmp(ciphertext, expected, 16), 0);
+        }
+    }
+    SimAes::SetAesNiEnabled(true);
+}
+
 #ifndef GITHUB_RELEASE
 TEST(TestOther, TestConnectionAllocator) {
     CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
@@ -733,7 +1010,7 @@ TEST(TestOther, TestGattcEvtTimeoutReporting) {
     s.bleEvent.evt.gattc_evt.conn_handle = conn->connectionHandle;
     //s.bleEvent.evt.gattc_evt.gatt_status = ?
     s.bleEvent.evt.gattc_evt.params.timeout.src = BLE_GATT_TIMEOUT_SRC_PROTOCOL;
-    tester.sim->nodes[0].eventQueue.push_back(s);
+    tester.sim->nodes[0].eventQueue.PushBack(s);
 
     //Wait until the live report about the mesh disconnect with the proper disconnect reason is received
     tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"type\":\"live_report\",\"nodeId\":1,\"module\":3,\"code\":51,\"extra\":2,\"extra2\":31}");
@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <CherrySimUtils.h>
+#include <AdvertisingMessageTypes.h>
+#include <ConnectionMessageTypes.h>
+#include <RecordStorage.h>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+//Everything that is sent over the air or stored in flash must have the same layout in the 32 bit and the 64 bit
+//simulator, as both must behave exactly like the nodes (which use 4 byte pointers).
+static_assert(offsetof(ConnPacketClusterWelcome, payload) == 5, "");
+static_assert(offsetof(ConnPacketPayloadClusterWelcome, networkId) == 11, "");
+static_assert(offsetof(ConnPacketModule, actionType) == 7, "");
+static_assert(offsetof(ConnPacketModule, data) == 8, "");
+static_assert(offsetof(AdvPacketJoinMeV0, payload) == 11, "");
+static_assert(offsetof(AdvPacketPayloadJoinMeV0, ackField) == 16, "");
+static_assert(offsetof(RecordStorageRecord, recordId) == 4, "");
+static_assert(offsetof(RecordStorageRecord, data) == SIZEOF_RECORD_STORAGE_RECORD_HEADER, "");
+static_assert(offsetof(RecordStoragePage, data) == SIZEOF_RECORD_STORAGE_PAGE_HEADER, "");
+
+template<typename T>
+static std::string ToHex(const T& value, size_t length = sizeof(T))
+{
+    std::string retVal;
+    char buffer[3];
+    for (size_t i = 0; i < length; i++)
+    {
+        snprintf(buffer, sizeof(buffer), "%02X", ((const u8*)&value)[i]);
+        retVal += buffer;
+    }
+    return retVal;
+}
+
+TEST(TestPointerSize, TestWireFormatsDoNotDependOnPointerSize)
+{
+    ConnPacketClusterWelcome welcome;
+    CheckedMemset(&welcome, 0, sizeof(welcome));
+    welcome.header.messageType = MessageType::CLUSTER_WELCOME;
+    welcome.header.sender = 0x1234;
+    welcome.header.receiver = 0x5678;
+    welcome.payload.clusterId = 0x9ABCDEF0;
+    welcome.payload.clusterSize = 0x1122;
+    welcome.payload.meshWriteHandle = 0x3344;
+    welcome.payload.hopsToSink = 0x5566;
+    welcome.payload.preferredConnectionInterval = 0x77;
+    welcome.payload.networkId = 0x8899;
+    ASSERT_EQ(ToHex(welcome), "1434127856F0DEBC9A22114433665577" "9988");
+
+    ConnPacketModule module;
+    CheckedMemset(&module, 0, sizeof(module));
+    module.header.messageType = MessageType::MODULE_TRIGGER_ACTION;
+    module.header.sender = 1;
+    module.header.receiver = 0xFFFF;
+    module.moduleId = ModuleId::STATUS_REPORTER_MODULE;
+    module.requestHandle = 0xAB;
+    module.actionType = 0x05;
+    module.data[0] = 0xCD;
+    ASSERT_EQ(ToHex(module, SIZEOF_CONN_PACKET_MODULE + 1), "330100FFFF03AB05CD");
+
+    AdvPacketJoinMeV0 joinMe;
+    CheckedMemset(&joinMe, 0, sizeof(joinMe));
+    joinMe.header.flags.len = 0x02;
+    joinMe.header.flags.type = 0x01;
+    joinMe.header.flags.flags = 0x06;
+    joinMe.header.manufacturer.len = 0x1A;
+    joinMe.header.manufacturer.type = 0xFF;
+    joinMe.header.manufacturer.companyIdentifier = 0x024D;
+    joinMe.header.meshIdentifier = 0xF0;
+    joinMe.header.networkId = 0x1234;
+    joinMe.header.messageType = ServiceDataMessageType::JOIN_ME_V0;
+    joinMe.payload.sender = 0x0102;
+    joinMe.payload.clusterId = 0x03040506;
+    joinMe.payload.clusterSize = 0x0708;
+    joinMe.payload.freeMeshInConnections = 1;
+    joinMe.payload.freeMeshOutConnections = 3;
+    joinMe.payload.batteryRuntime = 0x09;
+    joinMe.payload.txPower = -4;
+    joinMe.payload.deviceType = DeviceType::STATIC;
+    joinMe.payload.hopsToSink = 0x0A0B;
+    joinMe.payload.meshWriteHandle = 0x0C0D;
+    joinMe.payload.ackField = 0x0E0F1011;
+    ASSERT_EQ(ToHex(joinMe), "0201061AFF4D02F03412" "01" "0201060504030807" "1909FC01" "0B0A0D0C11100F0E");
+}
+
+TEST(TestPointerSize, TestFlashLayoutDoesNotDependOnPointerSize)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.SetToPerfectConditions();
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    //The record operations are queued in RAM with a pointer size dependent layout, the record in flash must not be affected
+    tester.SendTerminalCommand(1, "saverec 1234 01:02:03:04:05");
+    tester.SendTerminalCommand(1, "getrec 1234");
+    tester.SimulateUntilMessageReceived(10 * 1000, 1, "01:02:03:04:05");
+
+    NodeIndexSetter setter(0);
+    const RecordStorageRecord* record = GS->recordStorage.GetRecord(1234);
+    ASSERT_NE(record, nullptr);
+
+    //Header: crc, flags (active, 3 bytes of padding), length including header and padding, recordId, versionCounter
+    const std::string header = ToHex(*record, SIZEOF_RECORD_STORAGE_RECORD_HEADER);
+    ASSERT_EQ(header.substr(2), "FF1000D2040100");
+    ASSERT_EQ(ToHex(record->data[0], 8), "0102030405FFFFFF");
+
+    //The record lies word aligned in one of the record storage pages
+    const uintptr_t offset = (uintptr_t)record - (uintptr_t)tester.sim->nodes[0].flash;
+    ASSERT_EQ(offset % sizeof(u32), 0);
+    ASSERT_GE(offset, Utility::GetSettingsPageBaseAddress() - FLASH_REGION_START_ADDRESS);
+}
+
+TEST(TestPointerSize, BenchmarkNodeScaling_long)
+{
+    //A 32 bit simulator can at most address 4 GB, of which the node memory must share a part with the rest of the process
+    constexpr uint64_t addressSpace32Bit = 4ULL * 1024 * 1024 * 1024;
+
+    for (u32 amountOfNodes : { 1000, 2000, 4000, 8000, 12000 })
+    {
+        const uint64_t nodeMemory = (uint64_t)sizeof(NodeEntry) * amountOfNodes;
+        if (sizeof(void*) == 4 && nodeMemory >= addressSpace32Bit)
+        {
+            printf("%u nodes need at least %llu MB and do not fit into a 32 bit simulator" EOL, amountOfNodes, (unsigned long long)(nodeMemory / 1024 / 1024));
+            break;
+        }
+
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", amountOfNodes });
+        simConfig.nodeDensity = 0.5;
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        tester.Start();
+        const double startSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        tester.SimulateForGivenTime(1000);
+        const double simulationSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        printf("%u nodes (%u bit): %llu MB of node memory, started in %.1f s, 1 s simulated in %.1f s" EOL,
+            amountOfNodes, (u32)(sizeof(void*) * 8), (unsigned long long)(nodeMemory / 1024 / 1024), startSeconds, simulationSeconds);
+    }
+}
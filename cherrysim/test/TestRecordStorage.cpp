@@ -44,6 +44,7 @@ private:
 public:
     u8* startPage;
     static constexpr u16 numPages = RECORD_STORAGE_NUM_PAGES;
+    u32 batchCallbackCounter = 0;
 
     void SetUp() override
     {
@@ -77,6 +78,9 @@ public:
     void DefragmentPage(RecordStoragePage* pageToDefragment, bool force) {
         GS->recordStorage.DefragmentPage(*pageToDefragment, false);
     }
+    bool DefragmentIfIdle() {
+        return GS->recordStorage.DefragmentIfIdle();
+    }
 
     void RecordStorageEventHandler(u16 recordId, RecordStorageResultCode resultCode, u32 userType, u8* userData, u16 userDataLength) override
     {
@@ -92,6 +96,20 @@ public:
                 SIMEXCEPTION(IllegalStateException); //TEST FAILED //LCOV_EXCL_LINE assertion
             }
         }
+        if (userType == 3) {
+            if (resultCode != RecordStorageResultCode::SUCCESS || recordId != RECORD_STORAGE_RECORD_ID_INVALID) {
+                logt("ERROR", "---- FAIL ----");                   //LCOV_EXCL_LINE assertion
+                SIMEXCEPTION(IllegalStateException); //TEST FAILED //LCOV_EXCL_LINE assertion
+            }
+            batchCallbackCounter++;
+        }
+        if (userType == 4) {
+            if (resultCode != RecordStorageResultCode::BUSY || recordId != RECORD_STORAGE_RECORD_ID_INVALID) {
+                logt("ERROR", "---- FAIL ----");                   //LCOV_EXCL_LINE assertion
+                SIMEXCEPTION(IllegalStateException); //TEST FAILED //LCOV_EXCL_LINE assertion
+            }
+            batchCallbackCounter++;
+        }
     }
 };
 
@@ -462,6 +480,186 @@ TEST_F(TestRecordStorage, TestAsyncQueuing) {
 
 }
 
+TEST_F(TestRecordStorage, TestCommitBatch) {
+    NodeIndexSetter setter(0);
+    logt("WARNING", "---- CLEANUP ----");
+
+    //Setup
+    CheckedMemset(startPage, 0xff, numPages*FruityHal::GetCodePageSize());
+    RepairPages();
+
+    cherrySimInstance->SimCommitFlashOperations();
+
+    logt("WARNING", "---- TEST COMMIT BATCH ----");
+
+    u8 data[] = { 1,2,3,4,5,6,7,8 };
+    GS->recordStorage.SaveRecord(3, data, sizeof(data), nullptr, 0);
+    GS->recordStorage.SaveRecord(4, data, sizeof(data), nullptr, 0);
+    cherrySimInstance->SimCommitFlashOperations();
+
+    RecordStorageRecord* unchangedRecord = GS->recordStorage.GetRecord(4);
+
+    //Saves two new records, deactivates record 3, keeps record 4 and uses only the last entry of record 6
+    u8 data2[] = { 9,8,7 };
+    u8 data3[] = { 5,5,5,5,5 };
+    RecordStorageBatchItem items[] = {
+        { RecordStorageOperationType::SAVE_RECORD,       5, data2, sizeof(data2) },
+        { RecordStorageOperationType::DEACTIVATE_RECORD, 3, nullptr, 0 },
+        { RecordStorageOperationType::SAVE_RECORD,       4, data, sizeof(data) },
+        { RecordStorageOperationType::SAVE_RECORD,       6, data, sizeof(data) },
+        { RecordStorageOperationType::SAVE_RECORD,       6, data3, sizeof(data3) },
+    };
+    if (GS->recordStorage.CommitBatch(items, sizeof(items) / sizeof(items[0]), this, 3) != RecordStorageResultCode::SUCCESS) {
+        FAIL() << "Batch should have been queued"; //LCOV_EXCL_LINE assertion
+    }
+
+    cherrySimInstance->SimCommitFlashOperations();
+
+    if (batchCallbackCounter != 1) {
+        FAIL() << "Batch must call its listener exactly once"; //LCOV_EXCL_LINE assertion
+    }
+
+    SizedData record5 = GS->recordStorage.GetRecordData(5);
+    if (record5.length != sizeof(data2) || memcmp(record5.data, data2, sizeof(data2)) != 0) {
+        FAIL() << "Record 5 not saved by batch"; //LCOV_EXCL_LINE assertion
+    }
+    if (GS->recordStorage.GetRecordData(3).length != 0) {
+        FAIL() << "Record 3 not deactivated by batch"; //LCOV_EXCL_LINE assertion
+    }
+    if (GS->recordStorage.GetRecord(4) != unchangedRecord) {
+        FAIL() << "Unchanged record must not be written again"; //LCOV_EXCL_LINE assertion
+    }
+    SizedData record6 = GS->recordStorage.GetRecordData(6);
+    if (record6.length != sizeof(data3) || memcmp(record6.data, data3, sizeof(data3)) != 0) {
+        FAIL() << "Last entry of record 6 should have been saved"; //LCOV_EXCL_LINE assertion
+    }
+    if (GS->recordStorage.GetRecord(6)->versionCounter != 1) {
+        FAIL() << "Superseded entry must not be written"; //LCOV_EXCL_LINE assertion
+    }
+
+    //Records of a batch are stored contiguously
+    RecordStorageRecord* record5Header = GS->recordStorage.GetRecord(5);
+    if ((u8*)record5Header + record5Header->recordLength != (u8*)GS->recordStorage.GetRecord(6)) {
+        FAIL() << "Batch records should be stored contiguously"; //LCOV_EXCL_LINE assertion
+    }
+}
+
+TEST_F(TestRecordStorage, TestCommitBatchFlashFail) {
+    NodeIndexSetter setter(0);
+    logt("WARNING", "---- CLEANUP ----");
+
+    //Setup
+    CheckedMemset(startPage, 0xff, numPages*FruityHal::GetCodePageSize());
+    RepairPages();
+
+    cherrySimInstance->SimCommitFlashOperations();
+
+    logt("WARNING", "---- TEST COMMIT BATCH FLASH FAIL ----");
+
+    u8 data[] = { 1,2,3,4,5,6,7,8 };
+    GS->recordStorage.SaveRecord(3, data, sizeof(data), nullptr, 0);
+    GS->recordStorage.SaveRecord(4, data, sizeof(data), nullptr, 0);
+    cherrySimInstance->SimCommitFlashOperations();
+
+    //The batch queues one write for record 5 and one for each deactivation
+    RecordStorageBatchItem items[] = {
+        { RecordStorageOperationType::SAVE_RECORD,       5, data, sizeof(data) },
+        { RecordStorageOperationType::DEACTIVATE_RECORD, 3, nullptr, 0 },
+        { RecordStorageOperationType::DEACTIVATE_RECORD, 4, nullptr, 0 },
+    };
+    if (GS->recordStorage.CommitBatch(items, sizeof(items) / sizeof(items[0]), this, 4) != RecordStorageResultCode::SUCCESS) {
+        FAIL() << "Batch should have been queued"; //LCOV_EXCL_LINE assertion
+    }
+
+    //Let the first write fail more often than it is retried
+    u8 failData[FLASH_STORAGE_RETRY_COUNT + 1];
+    CheckedMemset(failData, 1, sizeof(failData));
+    cherrySimInstance->SimCommitSomeFlashOperations(failData, sizeof(failData));
+
+    if (batchCallbackCounter != 0) {
+        FAIL() << "Batch must wait for all of its flash tasks"; //LCOV_EXCL_LINE assertion
+    }
+
+    cherrySimInstance->SimCommitFlashOperations();
+
+    //The error of the first write must not be hidden by the successful deactivations
+    if (batchCallbackCounter != 1) {
+        FAIL() << "Batch must report the failed write exactly once"; //LCOV_EXCL_LINE assertion
+    }
+}
+
+TEST_F(TestRecordStorage, TestIdleDefragmentation) {
+    NodeIndexSetter setter(0);
+    logt("WARNING", "---- CLEANUP ----");
+
+    //Setup
+    CheckedMemset(startPage, 0xff, numPages*FruityHal::GetCodePageSize());
+    RepairPages();
+
+    cherrySimInstance->SimCommitFlashOperations();
+
+    logt("WARNING", "---- TEST IDLE DEFRAGMENTATION ----");
+
+    const RecordStorageStatistics statisticsBefore = GS->recordStorage.GetStatistics();
+    if (statisticsBefore.garbageSpace != 0 || statisticsBefore.liveSpace != 0) {
+        FAIL() << "Empty storage must not contain records"; //LCOV_EXCL_LINE assertion
+    }
+
+    //Without garbage, we must not wear out the flash
+    if (DefragmentIfIdle()) {
+        FAIL() << "Should not defragment without garbage"; //LCOV_EXCL_LINE assertion
+    }
+
+    //Update a record until the garbage is bigger than the remaining free space
+    u8 data[100];
+    u32 numSaves = 0;
+    while (GS->recordStorage.GetStatistics().freeSpace > GS->recordStorage.GetStatistics().garbageSpace) {
+        CheckedMemset(data, numSaves, sizeof(data));
+        GS->recordStorage.SaveRecord(1, data, sizeof(data), nullptr, 0);
+        cherrySimInstance->SimCommitFlashOperations();
+        numSaves++;
+        if (numSaves > 1000) {
+            FAIL() << "Garbage did not grow"; //LCOV_EXCL_LINE assertion
+        }
+    }
+
+    const RecordStorageStatistics statisticsFull = GS->recordStorage.GetStatistics();
+    if (statisticsFull.liveSpace != sizeof(data) + SIZEOF_RECORD_STORAGE_RECORD_HEADER) {
+        FAIL() << "Only the latest record version should be live"; //LCOV_EXCL_LINE assertion
+    }
+    if (statisticsFull.numDefragmentations != statisticsBefore.numDefragmentations) {
+        FAIL() << "Saves should not have defragmented yet"; //LCOV_EXCL_LINE assertion
+    }
+
+    if (!DefragmentIfIdle()) {
+        FAIL() << "Should have started an idle defragmentation"; //LCOV_EXCL_LINE assertion
+    }
+    cherrySimInstance->SimCommitFlashOperations();
+
+    const RecordStorageStatistics statisticsAfter = GS->recordStorage.GetStatistics();
+    if (statisticsAfter.garbageSpace != 0) {
+        FAIL() << "Garbage should have been removed"; //LCOV_EXCL_LINE assertion
+    }
+    if (statisticsAfter.numIdleDefragmentations != statisticsBefore.numIdleDefragmentations + 1
+        || statisticsAfter.numDefragmentations != statisticsBefore.numDefragmentations + 1) {
+        FAIL() << "Defragmentation not counted"; //LCOV_EXCL_LINE assertion
+    }
+    u32 erasesBefore = 0;
+    u32 erasesAfter = 0;
+    for (u32 i = 0; i < numPages; i++) {
+        erasesBefore += statisticsBefore.pageEraseCounters[i];
+        erasesAfter += statisticsAfter.pageEraseCounters[i];
+    }
+    if (erasesAfter != erasesBefore + 1) {
+        FAIL() << "Defragmentation must erase exactly one page"; //LCOV_EXCL_LINE assertion
+    }
+
+    SizedData record = GS->recordStorage.GetRecordData(1);
+    if (record.length != sizeof(data) || memcmp(record.data, data, sizeof(data)) != 0) {
+        FAIL() << "Record corrupted by idle defragmentation"; //LCOV_EXCL_LINE assertion
+    }
+}
+
 //Must be below 256 because of test limit when storing length in byte
 #define MULTI_RECORD_TEST_NUM_RECORD_IDS 20
 //Must be below 256 because of test limit when storing length in byte
@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <deque>
+#include <chrono>
+#include <CherrySimTester.h>
+#include "MersenneTwister.h"
+
+static void FillEvent(simBleEvent& event, u32 id)
+{
+    event.globalId = id;
+    event.bleEvent.header.evt_id = BLE_GAP_EVT_ADV_REPORT;
+    event.bleEvent.header.evt_len = id;
+    event.additionalInfo = ~id;
+}
+
+TEST(TestSimBleEventQueue, TestMatchesDeque)
+{
+    SimBleEventQueue queue(4);
+    std::deque<u32> reference;
+    MersenneTwister mt(1);
+    u32 idCounter = 0;
+
+    for (u32 i = 0; i < 10000; i++)
+    {
+        if (mt.NextU32(0, 2) != 0)
+        {
+            FillEvent(queue.EmplaceBack(), idCounter);
+            reference.push_back(idCounter);
+            idCounter++;
+        }
+        else if (!reference.empty())
+        {
+            ASSERT_EQ(queue.Front().globalId, reference.front());
+            ASSERT_EQ(queue.Front().additionalInfo, ~reference.front());
+            queue.PopFront();
+            reference.pop_front();
+        }
+
+        ASSERT_EQ(queue.Size(), reference.size());
+        for (u32 k = 0; k < reference.size(); k++)
+        {
+            ASSERT_EQ(queue[k].globalId, reference[k]);
+        }
+    }
+
+    //The queue started with a capacity of 4 and had to grow, which must be accounted for
+    ASSERT_GE(queue.GetCapacity(), queue.GetMaxSize());
+    ASSERT_GT(queue.GetNumOverflows(), 0u);
+
+    queue.Clear();
+    ASSERT_TRUE(queue.Empty());
+
+    //Events must be zeroed when they are constructed in place
+    simBleEvent& event = queue.EmplaceBack();
+    ASSERT_EQ(event.globalId, 0u);
+    ASSERT_EQ(event.additionalInfo, 0u);
+}
+
+TEST(TestSimBleEventQueue, BenchmarkEventQueue_long)
+{
+    constexpr u32 numNodes = 500;
+    constexpr u32 eventsPerNode = 16;
+    constexpr u32 iterations = 200;
+    const u32 numEvents = numNodes * eventsPerNode * iterations;
+    u32 checksum = 0;
+
+    //Previous implementation: events are built on the stack, copied into a deque and copied out again
+    std::vector<std::deque<simBleEvent>> dequeQueues(numNodes);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u32 i = 0; i < iterations; i++)
+    {
+        for (u32 n = 0; n < numNodes; n++)
+        {
+            for (u32 e = 0; e < eventsPerNode; e++)
+            {
+                simBleEvent s;
+                CheckedMemset(&s, 0, sizeof(s));
+                FillEvent(s, e);
+                dequeQueues[n].push_back(s);
+            }
+        }
+        for (u32 n = 0; n < numNodes; n++)
+        {
+            while (!dequeQueues[n].empty())
+            {
+                simBleEvent s = dequeQueues[n].front();
+                dequeQueues[n].pop_front();
+                checksum += s.globalId;
+            }
+        }
+    }
+    const double dequeSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    //Ring: events are constructed in place and read directly from the ring
+    std::vector<SimBleEventQueue> ringQueues(numNodes);
+    start = std::chrono::high_resolution_clock::now();
+    for (u32 i = 0; i < iterations; i++)
+    {
+        for (u32 n = 0; n < numNodes; n++)
+        {
+            for (u32 e = 0; e < eventsPerNode; e++)
+            {
+                FillEvent(ringQueues[n].EmplaceBack(), e);
+            }
+        }
+        for (u32 n = 0; n < numNodes; n++)
+        {
+            while (!ringQueues[n].Empty())
+            {
+                checksum += ringQueues[n].Front().globalId;
+                ringQueues[n].PopFront();
+            }
+        }
+    }
+    const double ringSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    printf("std::deque: %.0f events/sec" EOL, numEvents / (dequeSeconds > 0 ? dequeSeconds : 1e-9));
+    printf("SimBleEventQueue: %.0f events/sec" EOL, numEvents / (ringSeconds > 0 ? ringSeconds : 1e-9));
+    printf("Checksum %u" EOL, checksum);
+}
+
+TEST(TestSimBleEventQueue, BenchmarkSimulatedEvents_long)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 49 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    const u32 eventsBefore = tester.sim->simState.globalEventIdCounter;
+    const auto start = std::chrono::high_resolution_clock::now();
+    tester.SimulateForGivenTime(60 * 1000);
+    const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    const u32 numEvents = tester.sim->simState.globalEventIdCounter - eventsBefore;
+
+    u32 maxQueueSize = 0;
+    u32 numOverflows = 0;
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        maxQueueSize = std::max(maxQueueSize, tester.sim->nodes[i].eventQueue.GetMaxSize());
+        numOverflows += tester.sim->nodes[i].eventQueue.GetNumOverflows();
+    }
+
+    printf("Simulated %u events in %.2f s: %.0f events/sec, max queue size %u, overflows %u" EOL,
+        numEvents, seconds, numEvents / (seconds > 0 ? seconds : 1e-9), maxQueueSize, numOverflows);
+}
@@ -0,0 +1,219 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <SimFlashStore.h>
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+    constexpr u32 FLASH_SIZE = SimFlashStore::PAGE_SIZE * 8;
+    constexpr u32 AMOUNT_OF_NODES = 3;
+
+    std::vector<u8> ReadFile(const char* path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::vector<u8>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    bool FileExists(const std::string& path)
+    {
+        return std::ifstream(path).good();
+    }
+
+    //Checks that the file holds the header followed by the given flash of all nodes
+    void AssertFileMatchesFlash(const char* path, u8 flash[AMOUNT_OF_NODES][FLASH_SIZE])
+    {
+        const std::vector<u8> content = ReadFile(path);
+        ASSERT_EQ(content.size(), sizeof(FlashFileHeader) + AMOUNT_OF_NODES * FLASH_SIZE);
+        for (u32 i = 0; i < AMOUNT_OF_NODES; i++)
+        {
+            ASSERT_EQ(memcmp(content.data() + sizeof(FlashFileHeader) + i * FLASH_SIZE, flash[i], FLASH_SIZE), 0);
+        }
+    }
+}
+
+TEST(TestSimFlashStore, TestOnlyDirtyPagesAreWritten)
+{
+    const char* path = "TestSimFlashStore.bin";
+    std::remove(path);
+
+    static u8 flash[AMOUNT_OF_NODES][FLASH_SIZE];
+    memset(flash, 0xFF, sizeof(flash));
+    auto getFlash = [](u32 nodeIndex) { return flash[nodeIndex]; };
+
+    SimFlashStore store;
+    store.Reset(path, FLASH_SIZE, AMOUNT_OF_NODES, 1);
+    ASSERT_FALSE(store.Load(getFlash));
+    ASSERT_EQ(store.GetAmountOfDirtyPages(), AMOUNT_OF_NODES * 8);
+
+    //The first store writes the complete file
+    ASSERT_EQ(store.Store(getFlash), AMOUNT_OF_NODES * 8);
+    AssertFileMatchesFlash(path, flash);
+    ASSERT_EQ(store.Store(getFlash), 0);
+
+    //A write across a page boundary dirties both pages
+    flash[1][SimFlashStore::PAGE_SIZE * 2 - 2] = 0x12;
+    flash[1][SimFlashStore::PAGE_SIZE * 2 + 1] = 0x34;
+    store.MarkDirty(1, SimFlashStore::PAGE_SIZE * 2 - 2, 4);
+    flash[2][0] = 0x56;
+    store.MarkDirty(2, 0, 1);
+    store.MarkDirty(2, 0, 4);
+    ASSERT_TRUE(store.IsPageDirty(1, 1));
+    ASSERT_TRUE(store.IsPageDirty(1, 2));
+    ASSERT_FALSE(store.IsPageDirty(1, 3));
+    ASSERT_EQ(store.GetAmountOfDirtyPages(), 3);
+
+    //A modification that was not marked dirty must not be written
+    flash[0][5] = 0x78;
+    ASSERT_EQ(store.Store(getFlash), 3);
+    ASSERT_FALSE(FileExists(store.GetJournalPath()));
+    flash[0][5] = 0xFF;
+    AssertFileMatchesFlash(path, flash);
+
+    //Loading restores the flash and leaves no page dirty
+    memset(flash, 0x00, sizeof(flash));
+    SimFlashStore loadingStore;
+    loadingStore.Reset(path, FLASH_SIZE, AMOUNT_OF_NODES, 1);
+    ASSERT_TRUE(loadingStore.Load(getFlash));
+    ASSERT_EQ(loadingStore.GetAmountOfDirtyPages(), 0);
+    ASSERT_EQ(flash[1][SimFlashStore::PAGE_SIZE * 2 - 2], 0x12);
+    ASSERT_EQ(flash[1][SimFlashStore::PAGE_SIZE * 2 + 1], 0x34);
+    ASSERT_EQ(flash[2][0], 0x56);
+    ASSERT_EQ(flash[2][1], 0xFF);
+    ASSERT_EQ(loadingStore.Store(getFlash), 0);
+
+    //A file for a different amount of nodes is not loaded
+    {
+        Exceptions::DisableDebugBreakOnException disable;
+        SimFlashStore otherStore;
+        otherStore.Reset(path, FLASH_SIZE, AMOUNT_OF_NODES + 1, 1);
+        ASSERT_THROW(otherStore.Load(getFlash), CorruptOrOutdatedSavefile);
+    }
+
+    std::remove(path);
+}
+
+TEST(TestSimFlashStore, TestInterruptedStores)
+{
+    const char* path = "TestSimFlashStoreJournal.bin";
+    std::remove(path);
+
+    static u8 flash[AMOUNT_OF_NODES][FLASH_SIZE];
+    memset(flash, 0xFF, sizeof(flash));
+    auto getFlash = [](u32 nodeIndex) { return flash[nodeIndex]; };
+
+    SimFlashStore store;
+    store.Reset(path, FLASH_SIZE, AMOUNT_OF_NODES, 1);
+    store.Store(getFlash);
+    const std::vector<u8> fileBeforeStore = ReadFile(path);
+
+    //The simulation stops after the journal was written but before the file was updated
+    flash[0][SimFlashStore::PAGE_SIZE * 7] = 0xAB;
+    store.MarkDirty(0, SimFlashStore::PAGE_SIZE * 7, 1);
+    ASSERT_TRUE(store.WriteJournal(getFlash));
+    ASSERT_EQ(ReadFile(path), fileBeforeStore);
+    const std::vector<u8> journal = ReadFile(store.GetJournalPath().c_str());
+
+    memset(flash, 0x00, sizeof(flash));
+    SimFlashStore recoveringStore;
+    recoveringStore.Reset(path, FLASH_SIZE, AMOUNT_OF_NODES, 1);
+    ASSERT_TRUE(recoveringStore.Load(getFlash));
+    ASSERT_FALSE(FileExists(recoveringStore.GetJournalPath()));
+    ASSERT_EQ(flash[0][SimFlashStore::PAGE_SIZE * 7], 0xAB);
+    const std::vector<u8> fileAfterStore = ReadFile(path);
+
+    //The simulation stops while the journal is written, the previous state is kept
+    {
+        std::ofstream truncatedJournal(recoveringStore.GetJournalPath(), std::ios::binary);
+        truncatedJournal.write((const char*)journal.data(), journal.size() - 1);
+    }
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write((const char*)fileBeforeStore.data(), fileBeforeStore.size());
+    }
+    memset(flash, 0x00, sizeof(flash));
+    SimFlashStore discardingStore;
+    discardingStore.Reset(path, FLASH_SIZE, AMOUNT_OF_NODES, 1);
+    ASSERT_TRUE(discardingStore.Load(getFlash));
+    ASSERT_FALSE(FileExists(discardingStore.GetJournalPath()));
+    ASSERT_EQ(flash[0][SimFlashStore::PAGE_SIZE * 7], 0xFF);
+    ASSERT_EQ(ReadFile(path), fileBeforeStore);
+    ASSERT_NE(fileBeforeStore, fileAfterStore);
+
+    std::remove(path);
+}
+
+TEST(TestSimFlashStore, TestSimulationOnlyStoresModifiedPages)
+{
+    const char* path = "TestSimFlashStoreSimulation.bin";
+    std::remove(path);
+
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.storeFlashToFile = path;
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 9 });
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+        tester.SimulateUntilClusteringDone(100 * 1000);
+        tester.sim->StoreFlashToFile();
+        ASSERT_EQ(tester.sim->flashStore.GetAmountOfDirtyPages(), 0);
+
+        //Saving a single record must only dirty a few pages of that node
+        tester.SendTerminalCommand(2, "set_serial BRTCR");
+        tester.SimulateUntilMessageReceived(100, 2, "Serial Number Index set to 364543");
+        const u32 dirtyPages = tester.sim->flashStore.GetAmountOfDirtyPages();
+        ASSERT_GT(dirtyPages, 0);
+        ASSERT_LT(dirtyPages, SIM_MAX_FLASH_SIZE / SimFlashStore::PAGE_SIZE);
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+        {
+            if (i == 1) continue;
+            for (u32 page = 0; page < SIM_MAX_FLASH_SIZE / SimFlashStore::PAGE_SIZE; page++)
+            {
+                ASSERT_FALSE(tester.sim->flashStore.IsPageDirty(i, page));
+            }
+        }
+        tester.sim->StoreFlashToFile();
+
+        //The file must match the flash of all nodes
+        const std::vector<u8> content = ReadFile(path);
+        ASSERT_EQ(content.size(), sizeof(FlashFileHeader) + (size_t)SIM_MAX_FLASH_SIZE * tester.sim->GetTotalNodes());
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+        {
+            ASSERT_EQ(memcmp(content.data() + sizeof(FlashFileHeader) + (size_t)SIM_MAX_FLASH_SIZE * i, tester.sim->nodes[i].flash, SIM_MAX_FLASH_SIZE), 0);
+        }
+
+    }
+
+    std::remove(path);
+}
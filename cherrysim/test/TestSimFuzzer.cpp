@@ -0,0 +1,215 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <SimFuzzer.h>
+#include "TestMonkey.h"
+
+static SimFuzzer::Step CreateCommandStep(u32 templateIndex, std::vector<u32> choices)
+{
+    SimFuzzer::Step step;
+    step.type = SimFuzzer::StepType::COMMAND;
+    step.templateIndex = templateIndex;
+    step.choices = choices;
+    return step;
+}
+
+TEST(TestSimFuzzer, TestExpandCommand)
+{
+    SimFuzzer::Config config;
+    config.templates = {
+        "action [[[0-4]]] status get_status",
+        "send {{{r|u|b}}} [[[10-12]]] %%%SERIAL%%%",
+        "reset",
+    };
+    SimFuzzer fuzzer(config);
+
+    //Choices are taken modulo the amount of options of their placeholder
+    ASSERT_EQ(fuzzer.ExpandCommand(CreateCommandStep(0, { 3 })), "action 3 status get_status");
+    ASSERT_EQ(fuzzer.ExpandCommand(CreateCommandStep(0, { 7 })), "action 2 status get_status");
+    ASSERT_EQ(fuzzer.ExpandCommand(CreateCommandStep(1, { 1, 2, 1 })), "send u 12 BBBBC");
+    ASSERT_EQ(fuzzer.ExpandCommand(CreateCommandStep(1, { 5, 3, 3 })), "send b 10 BBBBB");
+    ASSERT_EQ(fuzzer.ExpandCommand(CreateCommandStep(2, {})), "reset");
+
+    //Missing choices use the first option
+    ASSERT_EQ(fuzzer.ExpandCommand(CreateCommandStep(1, {})), "send r 10 BBBBB");
+
+    //All templates of the TestMonkey must be understood by the fuzzer
+    config.templates = monkeyTemplates;
+    SimFuzzer monkeyFuzzer(config);
+    for (u32 i = 0; i < monkeyTemplates.size(); i++)
+    {
+        const std::string command = monkeyFuzzer.ExpandCommand(CreateCommandStep(i, {}));
+        ASSERT_EQ(command.find("[[["), std::string::npos);
+        ASSERT_EQ(command.find("{{{"), std::string::npos);
+        ASSERT_EQ(command.find("%%%"), std::string::npos);
+    }
+}
+
+TEST(TestSimFuzzer, TestIllegalTemplates)
+{
+    Exceptions::DisableDebugBreakOnException disabler;
+    SimFuzzer::Config config;
+    config.templates = { "send [[[0-255 u" };
+    ASSERT_THROW(SimFuzzer fuzzer(config), IllegalArgumentException);
+    config.templates = { "send [[[255]]]" };
+    ASSERT_THROW(SimFuzzer fuzzer(config), IllegalArgumentException);
+    config.templates = { "data {{{sink}}}" };
+    ASSERT_THROW(SimFuzzer fuzzer(config), IllegalArgumentException);
+}
+
+TEST(TestSimFuzzer, TestSerialization)
+{
+    SimFuzzer::Config config;
+    config.templates = { "action [[[0-4]]] status get_status", "data {{{sink|hop|other}}}" };
+    config.seed = 123;
+    SimFuzzer fuzzer(config);
+
+    std::vector<SimFuzzer::Input> inputs;
+    for (u32 i = 0; i < 20; i++)
+    {
+        inputs.push_back(fuzzer.GenerateInput());
+        inputs.push_back(fuzzer.Mutate(inputs.back()));
+    }
+    //Empty packets must survive as well
+    SimFuzzer::Step emptyPacket;
+    emptyPacket.type = SimFuzzer::StepType::PACKET;
+    emptyPacket.sleepSteps = 7;
+    inputs.push_back({ emptyPacket });
+
+    std::string text;
+    for (const SimFuzzer::Input& input : inputs)
+    {
+        text += fuzzer.Serialize(input);
+    }
+    const std::vector<SimFuzzer::Input> deserialized = fuzzer.Deserialize(text);
+    ASSERT_EQ(deserialized.size(), inputs.size());
+    for (u32 i = 0; i < inputs.size(); i++)
+    {
+        ASSERT_TRUE(deserialized[i] == inputs[i]);
+    }
+
+    //Steps with unknown templates are dropped, the rest of the input is kept
+    const std::vector<SimFuzzer::Input> partial = fuzzer.Deserialize("cmd 0 1 - unknown command\ncmd 1 2 3 action [[[0-4]]] status get_status\nend\n");
+    ASSERT_EQ(partial.size(), 1);
+    ASSERT_EQ(partial[0].size(), 1);
+    ASSERT_EQ(fuzzer.ExpandCommand(partial[0][0]), "action 3 status get_status");
+}
+
+TEST(TestSimFuzzer, TestMinimizeInput)
+{
+    //The input only fails if template 3 is followed by template 7 at some point
+    auto fails = [](const SimFuzzer::Input& input) {
+        bool seenFirst = false;
+        for (const SimFuzzer::Step& step : input)
+        {
+            if (step.templateIndex == 3) seenFirst = true;
+            if (step.templateIndex == 7 && seenFirst) return true;
+        }
+        return false;
+    };
+
+    SimFuzzer::Input input;
+    for (u32 i = 0; i < 30; i++)
+    {
+        input.push_back(CreateCommandStep(i % 10, { i + 1, 17 }));
+    }
+    ASSERT_TRUE(fails(input));
+
+    const SimFuzzer::Input minimized = SimFuzzer::MinimizeInput(input, fails, 1000);
+    ASSERT_EQ(minimized.size(), 2);
+    ASSERT_EQ(minimized[0].templateIndex, 3);
+    ASSERT_EQ(minimized[1].templateIndex, 7);
+    ASSERT_EQ(minimized[0].choices, std::vector<u32>({ 0, 0 }));
+
+    //The minimization stops after the given amount of executions and still returns a failing input
+    u32 executions = 0;
+    const SimFuzzer::Input partlyMinimized = SimFuzzer::MinimizeInput(input, [&](const SimFuzzer::Input& candidate) {
+        executions++;
+        return fails(candidate);
+    }, 5);
+    ASSERT_EQ(executions, 5);
+    ASSERT_TRUE(fails(partlyMinimized));
+}
+
+TEST(TestSimFuzzer, TestSelectCorpus)
+{
+    const std::vector<std::vector<u32>> features = {
+        { 1, 2 },
+        { 1, 2, 3, 4 },
+        { 5 },
+        { 3, 4 },
+        { 4, 5 },
+    };
+    //The biggest input covers 1 to 4, inputs 2 and 4 both add feature 5 and the bigger one is kept
+    ASSERT_EQ(SimFuzzer::SelectCorpus(features), std::vector<u32>({ 1, 4 }));
+}
+
+TEST(TestSimFuzzer, TestFuzzingFindsFeatures)
+{
+    SimFuzzer::Config config;
+    config.templates = monkeyTemplates;
+    config.maxExecutions = 30;
+    config.recoveryTimeMs = 2 * 1000;
+    config.statusIntervalSeconds = 0;
+    SimFuzzer fuzzer(config);
+    const SimFuzzer::Statistics statistics = fuzzer.Run();
+
+    //Minimizing a crash may execute some more inputs
+    ASSERT_GE(statistics.executions, 30);
+    ASSERT_GT(fuzzer.GetCorpusSize(), 0);
+    ASSERT_GT(statistics.features, 0);
+    for (const SimFuzzer::Finding& finding : fuzzer.GetFindings())
+    {
+        printf("Finding: %s" EOL "%s", finding.signature.c_str(), fuzzer.Serialize(finding.input).c_str());
+    }
+
+    //Executions of the same input are reproducible
+    const SimFuzzer::Input input = fuzzer.GenerateInput();
+    const SimFuzzer::Execution first = fuzzer.Execute(input);
+    const SimFuzzer::Execution second = fuzzer.Execute(input);
+    ASSERT_EQ(first.outcome, second.outcome);
+    ASSERT_EQ(first.features, second.features);
+}
+
+TEST(TestSimFuzzer, FuzzMonkeyTemplates_scheduled)
+{
+    SimFuzzer::Config config;
+    config.templates = monkeyTemplates;
+    config.maxSeconds = 30 * 60;
+    SimFuzzer fuzzer(config);
+    fuzzer.Run();
+
+    for (const SimFuzzer::Finding& finding : fuzzer.GetFindings())
+    {
+        printf("Finding: %s" EOL "%s", finding.signature.c_str(), fuzzer.Serialize(finding.input).c_str());
+    }
+    ASSERT_EQ(fuzzer.GetFindings().size(), 0);
+}
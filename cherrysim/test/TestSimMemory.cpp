@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <SimMemory.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+
+TEST(TestSimMemory, TestSampling)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.SetToPerfectConditions();
+    simConfig.terminalId = 0;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 9 });
+    simConfig.memorySampleIntervalMs = 1000;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        const SimMemoryUsage& memory = tester.sim->nodes[i].memory;
+        ASSERT_GT(memory.samples, 0u);
+        for (u32 k = 0; k < (u32)SimMemoryPool::AMOUNT; k++)
+        {
+            const SimMemoryOccupancy& pool = memory.pools[k];
+            ASSERT_EQ(std::accumulate(pool.histogram.begin(), pool.histogram.end(), 0u), memory.samples);
+            ASSERT_GT(pool.capacity, 0u);
+            ASSERT_GE(pool.highWater, pool.used);
+            ASSERT_LE(pool.highWater, pool.capacity);
+        }
+        //Every node had at least one mesh connection with a queue that was used for the clustering
+        ASSERT_GE(memory.pools[(u32)SimMemoryPool::CONNECTION_ALLOCATOR].highWater, 1u);
+        ASSERT_GE(memory.pools[(u32)SimMemoryPool::CONNECTION_QUEUE_CHUNKS].highWater, (u32)AMOUNT_OF_SEND_QUEUE_PRIORITIES);
+        ASSERT_GT(memory.pools[(u32)SimMemoryPool::MODULE_ALLOCATOR].used, 0u);
+        ASSERT_GT(memory.maxQueuePackets, 0u);
+    }
+
+    //The firmware reports the same pools
+    tester.SendTerminalCommand(2, "memstat");
+    tester.SimulateUntilRegexMessageReceived(10 * 1000, 2, "\\{\"type\":\"memstat\",\"nodeId\":2,\"pool\":\"queueChunks\",\"used\":\\d+,\"highWater\":\\d+,\"capacity\":\\d+\\}");
+    tester.SendTerminalCommand(2, "memstat");
+    tester.SimulateUntilRegexMessageReceived(10 * 1000, 2, "\\{\"type\":\"memstat\",\"nodeId\":2,\"pool\":\"connectionQueue\",\"connectionId\":\\d+,\"partnerId\":\\d+,");
+
+    tester.SendTerminalCommand(1, "sim memstat");
+    tester.SimulateGivenNumberOfSteps(1);
+    tester.SendTerminalCommand(1, "sim memstat 2");
+    tester.SimulateGivenNumberOfSteps(1);
+
+    tester.SendTerminalCommand(1, "sim memcsv memory.csv");
+    tester.SimulateGivenNumberOfSteps(1);
+    u32 lines = 0;
+    {
+        std::ifstream file("memory.csv");
+        lines = (u32)std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n');
+    }
+    std::remove("memory.csv");
+    ASSERT_EQ(lines, tester.sim->GetTotalNodes() + 1);
+}
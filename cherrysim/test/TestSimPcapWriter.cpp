@@ -0,0 +1,255 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <SimPcapWriter.h>
+#include <fstream>
+#include <iterator>
+#include <set>
+
+namespace
+{
+    struct PcapBlock
+    {
+        u32 type;
+        std::vector<u8> body;
+    };
+
+    u32 ReadU32(const u8* buffer)
+    {
+        return (u32)buffer[0] | ((u32)buffer[1] << 8) | ((u32)buffer[2] << 16) | ((u32)buffer[3] << 24);
+    }
+
+    std::vector<PcapBlock> ReadPcapBlocks(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        const std::vector<u8> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        std::vector<PcapBlock> blocks;
+        size_t offset = 0;
+        while (offset + 12 <= data.size())
+        {
+            const u32 type = ReadU32(data.data() + offset);
+            const u32 length = ReadU32(data.data() + offset + 4);
+            if (length < 12 || offset + length > data.size() || ReadU32(data.data() + offset + length - 4) != length) break;
+            blocks.push_back({ type, std::vector<u8>(data.begin() + offset + 8, data.begin() + offset + length - 4) });
+            offset += length;
+        }
+        EXPECT_EQ(offset, data.size());
+        return blocks;
+    }
+
+    std::vector<const PcapBlock*> GetBlocksOfType(const std::vector<PcapBlock>& blocks, u32 type)
+    {
+        std::vector<const PcapBlock*> result;
+        for (const PcapBlock& block : blocks)
+        {
+            if (block.type == type) result.push_back(&block);
+        }
+        return result;
+    }
+
+    //Returns the captured packet data of an enhanced packet block
+    std::vector<u8> GetPacketData(const PcapBlock& block)
+    {
+        const u32 capturedLength = ReadU32(block.body.data() + 12);
+        return std::vector<u8>(block.body.begin() + 20, block.body.begin() + 20 + capturedLength);
+    }
+
+    //Calculates the BLE CRC24 independently of the SimPcapWriter, using the reflected form of the LFSR from the
+    //Bluetooth Core specification (polynomial 0x00065B) that processes the PDU least significant bit first.
+    //The advertising CRC init 0x555555 becomes 0xAAAAAA in the reflected form.
+    //Returns the three CRC bytes in the order in which they follow the PDU.
+    std::vector<u8> CalculateReferenceBleCrc(const u8* pdu, u32 length)
+    {
+        u32 state = 0xAAAAAA;
+        for (u32 i = 0; i < length; i++)
+        {
+            u8 byte = pdu[i];
+            for (u32 bit = 0; bit < 8; bit++)
+            {
+                const u32 feedback = (state ^ byte) & 1;
+                byte >>= 1;
+                state >>= 1;
+                if (feedback)
+                {
+                    state |= 1 << 23;
+                    state ^= 0x5A6000;
+                }
+            }
+        }
+        return { (u8)state, (u8)(state >> 8), (u8)(state >> 16) };
+    }
+
+    //The PDU starts after the Nordic header and the access address and is followed by the CRC
+    std::vector<u8> GetPacketCrc(const std::vector<u8>& packet)
+    {
+        return std::vector<u8>(packet.end() - 3, packet.end());
+    }
+
+    std::vector<u8> CalculatePacketCrc(const std::vector<u8>& packet)
+    {
+        return CalculateReferenceBleCrc(packet.data() + 21, (u32)packet.size() - 21 - 3);
+    }
+
+    constexpr u32 SECTION_HEADER_BLOCK = 0x0A0D0D0A;
+    constexpr u32 INTERFACE_DESCRIPTION_BLOCK = 1;
+    constexpr u32 INTERFACE_STATISTICS_BLOCK = 5;
+    constexpr u32 ENHANCED_PACKET_BLOCK = 6;
+}
+
+TEST(TestSimPcapWriter, TestCaptureFormat)
+{
+    const std::string path = "TestCaptureFormat.pcapng";
+    const u8 address[6] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0xC6 };
+    const u8 advData[] = { 0x02, 0x01, 0x06, 0x07, 0xFF, 0x4D, 0x02, 0xF0, 0x01, 0x02, 0x03 };
+    u8 value[60];
+    for (u32 i = 0; i < sizeof(value); i++) value[i] = (u8)i;
+
+    {
+        SimPcapWriter writer(path, { "node 1 BBBBB", "node 2 BBBBC" });
+        ASSERT_TRUE(writer.CaptureAdvertisement(0, 1500, (u8)FruityHal::BleGapAdvType::ADV_IND, true, address, advData, sizeof(advData)));
+        ASSERT_TRUE(writer.CaptureAttPacket(1, 2500, 7, true, 0x52, 0x12, value, sizeof(value), 1, 1234));
+        //Unknown interfaces are ignored
+        ASSERT_FALSE(writer.CaptureAdvertisement(2, 2600, (u8)FruityHal::BleGapAdvType::ADV_IND, true, address, advData, sizeof(advData)));
+        writer.Close();
+        ASSERT_EQ(writer.GetNumCapturedPackets(), 2);
+        ASSERT_EQ(writer.GetNumDroppedPackets(), 0);
+    }
+
+    const std::vector<PcapBlock> blocks = ReadPcapBlocks(path);
+    ASSERT_EQ(blocks[0].type, SECTION_HEADER_BLOCK);
+    const auto interfaces = GetBlocksOfType(blocks, INTERFACE_DESCRIPTION_BLOCK);
+    ASSERT_EQ(interfaces.size(), 2);
+    ASSERT_EQ(interfaces[0]->body[0] | (interfaces[0]->body[1] << 8), SimPcapWriter::LINKTYPE_NORDIC_BLE_LEGACY);
+    ASSERT_EQ(GetBlocksOfType(blocks, INTERFACE_STATISTICS_BLOCK).size(), 0);
+
+    //60 bytes of ATT value need 3 link layer fragments of 27 bytes at most
+    const auto packets = GetBlocksOfType(blocks, ENHANCED_PACKET_BLOCK);
+    ASSERT_EQ(packets.size(), 1 + 3);
+
+    //Advertisement: Interface, simulated timestamp in microseconds and the manufacturer id where the fruitymesh dissector expects it
+    ASSERT_EQ(ReadU32(packets[0]->body.data()), 0);
+    ASSERT_EQ(ReadU32(packets[0]->body.data() + 8), 1500 * 1000);
+    const std::vector<u8> advPacket = GetPacketData(*packets[0]);
+    ASSERT_EQ(ReadU32(advPacket.data() + 17), SimPcapWriter::ADVERTISING_ACCESS_ADDRESS);
+    ASSERT_EQ(advPacket[21], 0x40); //ADV_IND with random TxAdd
+    ASSERT_EQ(advPacket[22], 6 + sizeof(advData));
+    ASSERT_EQ(advPacket[34] | (advPacket[35] << 8), 0x024D);
+    ASSERT_EQ(advPacket[36], 0xF0);
+    ASSERT_EQ(advPacket.size(), 23 + 6 + sizeof(advData) + 3);
+    ASSERT_EQ(GetPacketCrc(advPacket), CalculatePacketCrc(advPacket));
+
+    //Write command: Start fragment with the L2CAP and ATT header, the receiver is in the comment
+    ASSERT_EQ(ReadU32(packets[1]->body.data()), 1);
+    const std::vector<u8> startFragment = GetPacketData(*packets[1]);
+    ASSERT_EQ(startFragment[21], 0x02);
+    ASSERT_EQ(startFragment[22], SimPcapWriter::MAX_DATA_PDU_PAYLOAD_LENGTH);
+    ASSERT_EQ(startFragment[23] | (startFragment[24] << 8), 3 + sizeof(value));
+    ASSERT_EQ(startFragment[25] | (startFragment[26] << 8), 0x0004);
+    ASSERT_EQ(startFragment[27], 0x52);
+    const std::string comment(packets[1]->body.begin(), packets[1]->body.end());
+    ASSERT_NE(comment.find("to node 1, globalPacketId 1234"), std::string::npos);
+    ASSERT_EQ(GetPacketData(*packets[2])[21], 0x01);
+    ASSERT_EQ(GetPacketData(*packets[3])[22], 7 + sizeof(value) - 2 * SimPcapWriter::MAX_DATA_PDU_PAYLOAD_LENGTH);
+    for (u32 i = 1; i < packets.size(); i++)
+    {
+        const std::vector<u8> fragment = GetPacketData(*packets[i]);
+        ASSERT_EQ(GetPacketCrc(fragment), CalculatePacketCrc(fragment));
+    }
+}
+
+TEST(TestSimPcapWriter, TestDropsInsteadOfBlocking)
+{
+    const std::string path = "TestDropsInsteadOfBlocking.pcapng";
+    const u8 address[6] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0xC6 };
+    const u8 advData[] = { 0x02, 0x01, 0x06 };
+    constexpr u32 numPackets = 100000;
+    u32 numDropped = 0;
+
+    {
+        SimPcapWriter writer(path, { "node 1 BBBBB" }, 4);
+        for (u32 i = 0; i < numPackets; i++)
+        {
+            writer.CaptureAdvertisement(0, i, (u8)FruityHal::BleGapAdvType::ADV_NONCONN_IND, false, address, advData, sizeof(advData));
+        }
+        writer.Close();
+        ASSERT_EQ(writer.GetNumCapturedPackets() + writer.GetNumDroppedPackets(), numPackets);
+        //The writer thread can't possibly keep up with a buffer of 4 packets
+        ASSERT_GT(writer.GetNumDroppedPackets(), 0);
+        numDropped = writer.GetNumDroppedPackets();
+    }
+
+    const std::vector<PcapBlock> blocks = ReadPcapBlocks(path);
+    ASSERT_EQ(GetBlocksOfType(blocks, ENHANCED_PACKET_BLOCK).size(), numPackets - numDropped);
+    const auto statistics = GetBlocksOfType(blocks, INTERFACE_STATISTICS_BLOCK);
+    ASSERT_EQ(statistics.size(), 1);
+    //Interface id, timestamp, isb_ifdrop option header, drop count
+    ASSERT_EQ(ReadU32(statistics[0]->body.data() + 16), numDropped);
+}
+
+TEST(TestSimPcapWriter, TestSimulationCapture)
+{
+    const std::string path = "TestSimulationCapture.pcapng";
+    constexpr u32 numNodes = 5;
+
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", numNodes });
+        simConfig.pcapCapturePath = path;
+        //Large enough so that nothing is dropped
+        simConfig.pcapCaptureBufferSize = 100 * 1000;
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+        tester.SimulateUntilClusteringDone(100 * 1000);
+        ASSERT_EQ(tester.sim->pcapWriter->GetNumDroppedPackets(), 0);
+    }
+
+    const std::vector<PcapBlock> blocks = ReadPcapBlocks(path);
+    ASSERT_EQ(GetBlocksOfType(blocks, INTERFACE_DESCRIPTION_BLOCK).size(), numNodes);
+
+    std::set<u32> advertisingInterfaces;
+    u32 numDataPackets = 0;
+    u32 lastTimestampLow = 0;
+    for (const PcapBlock* block : GetBlocksOfType(blocks, ENHANCED_PACKET_BLOCK))
+    {
+        const std::vector<u8> packet = GetPacketData(*block);
+        if (ReadU32(packet.data() + 17) == SimPcapWriter::ADVERTISING_ACCESS_ADDRESS) advertisingInterfaces.insert(ReadU32(block->body.data()));
+        else numDataPackets++;
+
+        //Packets are written in the order of the simulation
+        ASSERT_GE(ReadU32(block->body.data() + 8), lastTimestampLow);
+        lastTimestampLow = ReadU32(block->body.data() + 8);
+    }
+    ASSERT_EQ(advertisingInterfaces.size(), numNodes);
+    //Clustering is done using writes over the mesh connections
+    ASSERT_GT(numDataPackets, 0);
+}
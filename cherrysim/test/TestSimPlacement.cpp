@@ -0,0 +1,207 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <SimPlacement.h>
+#include <MersenneTwister.h>
+extern "C"{
+#include <dbscan.h>
+}
+#include <chrono>
+
+//The dbscan based placement that was used before, kept as a reference for the results and the speed.
+static void PlaceConnectedWithDbscan(std::vector<ThreeDimStruct<float>>& positions, u32 amountOfNodes, MersenneTwister& rnd, double epsilon, double mapWidth, double mapHeight)
+{
+    std::vector<point_t> points(positions.size());
+    bool retry = true;
+    while (retry) {
+        retry = false;
+        for (u32 i = 0; i < positions.size(); i++) {
+            points[i].cluster_id = -1;
+            points[i].x = (double)positions[i].x * mapWidth;
+            points[i].y = (double)positions[i].y * mapHeight;
+            points[i].z = 0;
+        }
+        dbscan(points.data(), amountOfNodes, epsilon, 0, euclidean_dist);
+        for (u32 i = 0; i < amountOfNodes; i++) {
+            if (points[i].cluster_id != 0) {
+                retry = true;
+                positions[i].x = (float)rnd.NextU32() / (float)0xFFFFFFFF;
+                positions[i].y = (float)rnd.NextU32() / (float)0xFFFFFFFF;
+            }
+        }
+    }
+}
+
+static std::vector<ThreeDimStruct<float>> CreateRandomPositions(MersenneTwister& rnd, u32 amountOfNodes)
+{
+    std::vector<ThreeDimStruct<float>> positions(amountOfNodes);
+    for (ThreeDimStruct<float>& position : positions)
+    {
+        position.x = (float)rnd.NextU32() / (float)0xFFFFFFFF;
+        position.y = (float)rnd.NextU32() / (float)0xFFFFFFFF;
+        position.z = 0;
+    }
+    return positions;
+}
+
+TEST(TestSimPlacement, TestSameLayoutAsDbscan)
+{
+    const double range = SimPlacement::CalculateConnectionRange(CherrySim::N);
+    for (u32 seed = 1; seed <= 5; seed++)
+    {
+        const u32 amountOfNodes = 50 * seed;
+        const double mapSize = std::sqrt(amountOfNodes) * 8;
+
+        MersenneTwister referenceRnd(seed);
+        std::vector<ThreeDimStruct<float>> referencePositions = CreateRandomPositions(referenceRnd, amountOfNodes);
+        PlaceConnectedWithDbscan(referencePositions, amountOfNodes, referenceRnd, range, mapSize, mapSize);
+
+        MersenneTwister rnd(seed);
+        std::vector<ThreeDimStruct<float>> positions = CreateRandomPositions(rnd, amountOfNodes);
+        SimPlacement placement(range, mapSize, mapSize, 0);
+        placement.PlaceConnected(positions, amountOfNodes, rnd, false);
+
+        for (u32 i = 0; i < amountOfNodes; i++)
+        {
+            ASSERT_EQ(positions[i].x, referencePositions[i].x);
+            ASSERT_EQ(positions[i].y, referencePositions[i].y);
+        }
+        ASSERT_EQ(rnd.GetStateChecksum(), referenceRnd.GetStateChecksum());
+    }
+}
+
+TEST(TestSimPlacement, TestConnectivity)
+{
+    //Three nodes in a row, the last one is only connected over the middle one
+    std::vector<ThreeDimStruct<float>> positions = { { 0.0f, 0, 0 }, { 0.125f, 0, 0 }, { 0.25f, 0, 0 }, { 0.875f, 0, 0 } };
+    SimPlacement placement(16, 128, 128, 0);
+    std::vector<bool> connected;
+    placement.FindConnectedToFirst(positions, 4, connected);
+    ASSERT_EQ(connected, std::vector<bool>({ true, true, true, false }));
+
+    //Exactly at the range is still connected, as it was with the dbscan
+    positions[3].x = 0.375f;
+    placement.FindConnectedToFirst(positions, 4, connected);
+    ASSERT_TRUE(connected[3]);
+
+    //Only the given amount of nodes is considered
+    placement.FindConnectedToFirst(positions, 2, connected);
+    ASSERT_EQ(connected.size(), 2);
+
+    u32 width = 40;
+    u32 height = 10;
+    SimPlacement::CalculateMapSizeForDensity(100, 1.0, width, height);
+    ASSERT_EQ(width, 200);
+    ASSERT_EQ(height, 50);
+
+    Exceptions::DisableDebugBreakOnException disable;
+    ASSERT_THROW(SimPlacement(0, 100, 100, 0), IllegalArgumentException);
+    ASSERT_THROW(SimPlacement::CalculateMapSizeForDensity(100, 0, width, height), IllegalArgumentException);
+}
+
+TEST(TestSimPlacement, TestAttachUnconnectedNodes)
+{
+    //A map that is far too sparse to ever connect by chance must still be connected after a single pass
+    constexpr u32 amountOfNodes = 2000;
+    MersenneTwister rnd(3);
+    std::vector<ThreeDimStruct<float>> positions = CreateRandomPositions(rnd, amountOfNodes);
+    SimPlacement placement(SimPlacement::CalculateConnectionRange(CherrySim::N), 5000, 5000, 0);
+    ASSERT_EQ(placement.PlaceConnected(positions, amountOfNodes, rnd, true), 1);
+
+    std::vector<bool> connected;
+    placement.FindConnectedToFirst(positions, amountOfNodes, connected);
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        ASSERT_TRUE(connected[i]);
+        ASSERT_GE(positions[i].x, 0.0f);
+        ASSERT_LE(positions[i].x, 1.0f);
+        ASSERT_GE(positions[i].y, 0.0f);
+        ASSERT_LE(positions[i].y, 1.0f);
+    }
+}
+
+TEST(TestSimPlacement, TestDensityInSimulation)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 20 });
+    simConfig.mapWidthInMeters = 30;
+    simConfig.mapHeightInMeters = 30;
+    simConfig.nodeDensity = 0.5;
+    simConfig.attachUnconnectedNodes = true;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    //20 nodes with 0.5 nodes per 100 square meters need 4000 square meters
+    ASSERT_EQ(tester.sim->simConfig.mapWidthInMeters, 64);
+    ASSERT_EQ(tester.sim->simConfig.mapHeightInMeters, 64);
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+}
+
+TEST(TestSimPlacement, BenchmarkStartupPlacement_long)
+{
+    //The same placement of 3000 nodes at about 0.5 nodes per 100 square meters, once with the former dbscan and once with the grid
+    constexpr u32 amountOfNodes = 3000;
+    const double range = SimPlacement::CalculateConnectionRange(CherrySim::N);
+    const double mapSize = std::sqrt(amountOfNodes) * 14;
+
+    MersenneTwister referenceRnd(7);
+    std::vector<ThreeDimStruct<float>> referencePositions = CreateRandomPositions(referenceRnd, amountOfNodes);
+    auto start = std::chrono::high_resolution_clock::now();
+    PlaceConnectedWithDbscan(referencePositions, amountOfNodes, referenceRnd, range, mapSize, mapSize);
+    const double dbscanSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    MersenneTwister rnd(7);
+    std::vector<ThreeDimStruct<float>> positions = CreateRandomPositions(rnd, amountOfNodes);
+    SimPlacement placement(range, mapSize, mapSize, 0);
+    start = std::chrono::high_resolution_clock::now();
+    const u32 passes = placement.PlaceConnected(positions, amountOfNodes, rnd, false);
+    const double gridSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    //Maps with many more nodes are only feasible with the grid
+    constexpr u32 largeAmountOfNodes = 20000;
+    const double largeMapSize = std::sqrt(largeAmountOfNodes) * 14;
+    std::vector<ThreeDimStruct<float>> largePositions = CreateRandomPositions(rnd, largeAmountOfNodes);
+    SimPlacement largePlacement(range, largeMapSize, largeMapSize, 0);
+    start = std::chrono::high_resolution_clock::now();
+    const u32 largePasses = largePlacement.PlaceConnected(largePositions, largeAmountOfNodes, rnd, false);
+    const double largeSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    printf("dbscan: %u nodes placed in %.3f sec" EOL, amountOfNodes, dbscanSeconds);
+    printf("SimPlacement: %u nodes placed in %.3f sec (%u passes)" EOL, amountOfNodes, gridSeconds, passes);
+    printf("SimPlacement: %u nodes placed in %.3f sec (%u passes)" EOL, largeAmountOfNodes, largeSeconds, largePasses);
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        ASSERT_EQ(positions[i].x, referencePositions[i].x);
+        ASSERT_EQ(positions[i].y, referencePositions[i].y);
+    }
+}
@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <SimRandom.h>
+#include <array>
+
+TEST(TestSimRandom, TestReproducibleStreams)
+{
+    SimRandom a(1234, 1, SimRandomStream::RADIO);
+    SimRandom b(1234, 1, SimRandomStream::RADIO);
+    for (u32 i = 0; i < 1000; i++)
+    {
+        ASSERT_EQ(a.PeekU32(i), b.NextU32());
+    }
+    ASSERT_EQ(b.GetCounter(), 1000);
+
+    //Every owner and stream gets a different sequence
+    SimRandom otherNode(1234, 2, SimRandomStream::RADIO);
+    SimRandom otherStream(1234, 1, SimRandomStream::CONNECTION);
+    SimRandom otherSeed(1235, 1, SimRandomStream::RADIO);
+    u32 equalValues = 0;
+    for (u32 i = 0; i < 1000; i++)
+    {
+        const u32 value = a.NextU32();
+        if (value == otherNode.NextU32()) equalValues++;
+        if (value == otherStream.NextU32()) equalValues++;
+        if (value == otherSeed.NextU32()) equalValues++;
+    }
+    ASSERT_LE(equalValues, 1);
+}
+
+TEST(TestSimRandom, TestRanges)
+{
+    SimRandom random(7, 3, SimRandomStream::FIRMWARE);
+
+    //Same range as used for the rssi noise, every value must appear roughly equally often
+    std::array<u32, 8> histogram = {};
+    constexpr u32 amountOfDraws = 80000;
+    for (u32 i = 0; i < amountOfDraws; i++)
+    {
+        const u32 value = random.NextU32(0, 7);
+        ASSERT_LE(value, 7);
+        histogram[value]++;
+    }
+    for (u32 count : histogram)
+    {
+        ASSERT_NEAR(count, amountOfDraws / 8, amountOfDraws / 80);
+    }
+
+    ASSERT_EQ(random.NextU32(5, 5), 5);
+    for (u32 i = 0; i < 1000; i++)
+    {
+        const u32 value = random.NextU32(100, 102);
+        ASSERT_GE(value, 100);
+        ASSERT_LE(value, 102);
+    }
+    const uint64_t counter = random.GetCounter();
+    ASSERT_FALSE(random.NextPsrng(0));
+    ASSERT_TRUE(random.NextPsrng(UINT32_MAX));
+    ASSERT_EQ(random.GetCounter(), counter);
+
+    u32 hits = 0;
+    for (u32 i = 0; i < 10000; i++)
+    {
+        if (random.NextPsrng(UINT32_MAX / 4)) hits++;
+    }
+    ASSERT_NEAR(hits, 2500, 250);
+
+    Exceptions::DisableDebugBreakOnException disable;
+    ASSERT_THROW(random.NextU32(3, 2), IllegalArgumentException);
+    SimRandom unseeded;
+    ASSERT_THROW(unseeded.NextU32(), IllegalStateException);
+}
+
+TEST(TestSimRandom, TestNodeStreamsIndependentOfNodeCount)
+{
+    //The streams of a node must not depend on how many other nodes are simulated
+    std::vector<std::array<u32, (u32)SimRandomStream::AMOUNT>> firstValues;
+    for (int amountOfNodes = 3; amountOfNodes <= 4; amountOfNodes++)
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", amountOfNodes });
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+
+        std::array<u32, (u32)SimRandomStream::AMOUNT> values = {};
+        for (u32 stream = 0; stream < (u32)SimRandomStream::AMOUNT; stream++)
+        {
+            values[stream] = tester.sim->nodes[1].random[stream].PeekU32(0);
+            const SimRandom expected(simConfig.seed, tester.sim->nodes[1].id, (SimRandomStream)stream);
+            ASSERT_EQ(values[stream], expected.PeekU32(0));
+        }
+        firstValues.push_back(values);
+
+        tester.SimulateUntilClusteringDone(100 * 1000);
+    }
+    ASSERT_EQ(firstValues[0], firstValues[1]);
+}
+
+TEST(TestSimRandom, TestLinkRandom)
+{
+    const SimRandom link = SimRandom::ForLink(1234, 1, 2, SimLinkRandom::RECEPTION, 5000);
+    ASSERT_EQ(link.PeekU32(0), SimRandom::ForLink(1234, 1, 2, SimLinkRandom::RECEPTION, 5000).PeekU32(0));
+
+    //Both directions, every purpose, event and seed get a different sequence
+    u32 equalValues = 0;
+    for (u32 i = 0; i < 1000; i++)
+    {
+        const u32 value = link.PeekU32(i);
+        if (value == SimRandom::ForLink(1234, 2, 1, SimLinkRandom::RECEPTION, 5000).PeekU32(i)) equalValues++;
+        if (value == SimRandom::ForLink(1234, 1, 2, SimLinkRandom::RSSI_NOISE, 5000).PeekU32(i)) equalValues++;
+        if (value == SimRandom::ForLink(1234, 1, 2, SimLinkRandom::RECEPTION, 5001).PeekU32(i)) equalValues++;
+        if (value == SimRandom::ForLink(1235, 1, 2, SimLinkRandom::RECEPTION, 5000).PeekU32(i)) equalValues++;
+        if (value == SimRandom(1234, 1, SimRandomStream::RADIO).PeekU32(i)) equalValues++;
+    }
+    ASSERT_LE(equalValues, 1);
+}
+
+TEST(TestSimRandom, TestNodeDrawsIndependentOfOutOfRangeNodes)
+{
+    //Nodes that are out of range must not change what the other nodes draw, neither for their own streams
+    //nor for the packets that they receive. The additional nodes still advertise, scan and draw numbers.
+    constexpr u32 amountOfNodesInRange = 3;
+    struct NodeDraws
+    {
+        std::array<uint64_t, (u32)SimRandomStream::AMOUNT> counters;
+        std::array<u32, (u32)SimRandomStream::AMOUNT> checksums;
+        u32 clusterSize;
+        float rssi;
+    };
+    std::vector<std::vector<NodeDraws>> runs;
+    for (u32 amountOfNodesOutOfRange = 0; amountOfNodesOutOfRange <= 2; amountOfNodesOutOfRange += 2)
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.rssiNoise = true;
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", amountOfNodesInRange + amountOfNodesOutOfRange });
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+
+        //The nodes in range are a few meters apart, the others are more than a kilometer away
+        tester.sim->simConfig.mapWidthInMeters = 1000;
+        tester.sim->simConfig.mapHeightInMeters = 1000;
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+        {
+            const bool inRange = i < amountOfNodesInRange;
+            tester.sim->nodes[i].x = (inRange ? 0.01f : 0.99f) + 0.005f * (i % amountOfNodesInRange);
+            tester.sim->nodes[i].y = inRange ? 0.01f : 0.99f;
+            tester.sim->nodes[i].z = 0;
+        }
+        tester.Start();
+        tester.SimulateForGivenTime(30 * 1000);
+
+        std::vector<NodeDraws> draws;
+        for (u32 i = 0; i < amountOfNodesInRange; i++)
+        {
+            NodeDraws nodeDraws = {};
+            for (u32 stream = 0; stream < (u32)SimRandomStream::AMOUNT; stream++)
+            {
+                nodeDraws.counters[stream] = tester.sim->nodes[i].random[stream].GetCounter();
+                nodeDraws.checksums[stream] = tester.sim->nodes[i].random[stream].GetStateChecksum();
+            }
+            NodeIndexSetter setter(i);
+            nodeDraws.clusterSize = GS->node.GetClusterSize();
+            nodeDraws.rssi = tester.sim->GetReceptionRssi(&tester.sim->nodes[(i + 1) % amountOfNodesInRange], &tester.sim->nodes[i]);
+            draws.push_back(nodeDraws);
+        }
+        runs.push_back(draws);
+    }
+
+    for (u32 i = 0; i < amountOfNodesInRange; i++)
+    {
+        ASSERT_EQ(runs[0][i].counters, runs[1][i].counters);
+        ASSERT_EQ(runs[0][i].checksums, runs[1][i].checksums);
+        ASSERT_EQ(runs[0][i].clusterSize, runs[1][i].clusterSize);
+        ASSERT_EQ(runs[0][i].rssi, runs[1][i].rssi);
+    }
+    //Otherwise nothing was compared
+    ASSERT_EQ(runs[0][0].clusterSize, amountOfNodesInRange);
+    ASSERT_GT(runs[0][0].counters[(u32)SimRandomStream::FIRMWARE], 0);
+}
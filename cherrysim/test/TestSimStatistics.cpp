@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <SimStatistics.h>
+#include <fstream>
+#include <chrono>
+#include <map>
+#include <string>
+
+TEST(TestSimStatistics, TestRegistration)
+{
+    const u32 count = SimStatistics::Register("TestRegistration", SimStatistics::Type::COUNT);
+    const u32 average = SimStatistics::Register("TestRegistration", SimStatistics::Type::AVG);
+
+    //A key is registered once per type
+    ASSERT_NE(count, average);
+    ASSERT_EQ(SimStatistics::Register("TestRegistration", SimStatistics::Type::COUNT), count);
+    ASSERT_EQ(SimStatistics::FindHandle("TestRegistration", SimStatistics::Type::AVG), average);
+    ASSERT_EQ(SimStatistics::FindHandle("TestRegistrationUnknown", SimStatistics::Type::COUNT), SimStatistics::INVALID_HANDLE);
+    ASSERT_EQ(SimStatistics::GetKey(average), "TestRegistration");
+    ASSERT_EQ(SimStatistics::GetType(average), SimStatistics::Type::AVG);
+
+    SimStatistics::ClearGlobalValues();
+    std::vector<SimStatValue> nodeValues;
+    SimStatistics::Collect(average, 10, &nodeValues);
+    SimStatistics::Collect(average, 20, nullptr);
+    SimStatistics::Collect(count, 1, nullptr);
+
+    ASSERT_EQ(SimStatistics::GetValue(SimStatistics::GetGlobalValues(), average).count, 2);
+    ASSERT_EQ(SimStatistics::GetValue(SimStatistics::GetGlobalValues(), average).total, 30);
+    ASSERT_EQ(SimStatistics::GetValue(SimStatistics::GetGlobalValues(), count).count, 1);
+    ASSERT_EQ(SimStatistics::GetValue(nodeValues, average).count, 1);
+    ASSERT_EQ(SimStatistics::GetValue(nodeValues, count).count, 0);
+}
+
+TEST(TestSimStatistics, TestNodeValuesAndSnapshots)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 4 });
+    simConfig.statisticSnapshotIntervalMs = 1000;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    SimStatistics::ClearGlobalValues();
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //The cluster updates are counted within the nodes, so the values of all nodes add up to the global value
+    const u32 handle = SimStatistics::FindHandle("ClusterUpdateCount", SimStatistics::Type::COUNT);
+    ASSERT_NE(handle, SimStatistics::INVALID_HANDLE);
+    uint64_t sumOfNodes = 0;
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        sumOfNodes += SimStatistics::GetValue(tester.sim->nodes[i].statistics, handle).count;
+    }
+    ASSERT_GT(sumOfNodes, 0);
+    ASSERT_EQ(sumOfNodes, SimStatistics::GetValue(SimStatistics::GetGlobalValues(), handle).count);
+
+    //One snapshot per simulated second, counters never decrease
+    const std::vector<SimStatSnapshot>& snapshots = tester.sim->statisticSnapshots;
+    ASSERT_EQ(snapshots.size(), tester.sim->simState.simTimeMs / 1000);
+    for (u32 i = 1; i < snapshots.size(); i++)
+    {
+        ASSERT_EQ(snapshots[i].simTimeMs, snapshots[i - 1].simTimeMs + 1000);
+        ASSERT_GE(SimStatistics::GetValue(snapshots[i].values, handle).count, SimStatistics::GetValue(snapshots[i - 1].values, handle).count);
+    }
+
+    const std::string path = "TestNodeValuesAndSnapshots.csv";
+    tester.SendTerminalCommand(1, "sim statcsv %s", path.c_str());
+    tester.SimulateGivenNumberOfSteps(1);
+    std::ifstream file(path);
+    std::string header;
+    std::getline(file, header);
+    ASSERT_EQ(header.rfind("simTimeMs,", 0), 0);
+    ASSERT_NE(header.find(",ClusterUpdateCount"), std::string::npos);
+    u32 amountOfRows = 0;
+    for (std::string row; std::getline(file, row);) amountOfRows++;
+    ASSERT_GE(amountOfRows, snapshots.size() - 1);
+    file.close();
+    std::remove(path.c_str());
+}
+
+//The string based counting that SIMSTATCOUNT used before the keys were registered, kept as a reference for the speed
+static std::map<std::string, int> referenceStatCounts;
+static void CollectStatisticCountWithMap(const char* key)
+{
+    if (referenceStatCounts.find(key) != referenceStatCounts.end())
+    {
+        referenceStatCounts[key] = referenceStatCounts[key] + 1;
+    }
+    else {
+        referenceStatCounts[key] = 1;
+    }
+}
+
+TEST(TestSimStatistics, BenchmarkStatisticCounting_long)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    //Counts into the node values as well, just like a call site within the firmware
+    NodeIndexSetter setter(0);
+
+    referenceStatCounts.clear();
+    constexpr u32 iterations = 10 * 1000 * 1000;
+    //Every loop does some work of its own, so that the uninstrumented loop is not optimized away
+    volatile u32 work = 0;
+    auto measure = [&](const char* name, const std::function<void()>& loop)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        loop();
+        const auto end = std::chrono::high_resolution_clock::now();
+        const double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+        printf("%s: %.2f ns per iteration" EOL, name, nanoseconds / iterations);
+    };
+
+    measure("Uninstrumented", [&]() {
+        for (u32 i = 0; i < iterations; i++) work = work + 1;
+    });
+    measure("SIMSTATCOUNT", [&]() {
+        for (u32 i = 0; i < iterations; i++) { work = work + 1; SIMSTATCOUNT("BenchmarkStatisticCounting"); }
+    });
+    measure("sim_collect_statistic_count", [&]() {
+        for (u32 i = 0; i < iterations; i++) { work = work + 1; sim_collect_statistic_count("BenchmarkStatisticCounting"); }
+    });
+    measure("std::map with string keys", [&]() {
+        for (u32 i = 0; i < iterations; i++) { work = work + 1; CollectStatisticCountWithMap("BenchmarkStatisticCounting"); }
+    });
+
+    const u32 handle = SimStatistics::FindHandle("BenchmarkStatisticCounting", SimStatistics::Type::COUNT);
+    ASSERT_GE(SimStatistics::GetValue(tester.sim->nodes[0].statistics, handle).count, 2 * iterations);
+    ASSERT_EQ(referenceStatCounts["BenchmarkStatisticCounting"], iterations);
+}
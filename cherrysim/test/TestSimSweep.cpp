@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <SimSweep.h>
+#include <cstdio>
+#include <fstream>
+
+static SimConfiguration CreateSweepBaseConfiguration()
+{
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = -1;
+    return simConfig;
+}
+
+TEST(TestSimSweep, TestParameterExpansion)
+{
+    const nlohmann::json description = nlohmann::json::parse(R"({
+        "baseConfiguration": { "nodeConfigName": { "prod_mesh_nrf52": 1 }, "mapHeightInMeters": 33 },
+        "parameters": {
+            "seed": [1, 2, 3],
+            "/nodeConfigName/prod_mesh_nrf52": [5, 10],
+            "meshConnectionInterval": [12]
+        },
+        "resultPath": "TestParameterExpansion.csv"
+    })");
+    SimSweep sweep(description, CreateSweepBaseConfiguration());
+
+    ASSERT_EQ(sweep.GetNumRuns(), 3 * 2 * 1);
+    ASSERT_GE(sweep.GetNumWorkers(), 1);
+
+    //Parameters are ordered by name, the last one (seed) changes fastest
+    std::set<std::pair<u32, u32>> combinations;
+    for (u32 i = 0; i < sweep.GetNumRuns(); i++)
+    {
+        const nlohmann::json parameters = sweep.GetRunParameters(i);
+        ASSERT_EQ(parameters["meshConnectionInterval"], 12);
+
+        const SimConfiguration config = sweep.CreateRunConfiguration(i);
+        ASSERT_EQ(config.seed, parameters["seed"].get<u32>());
+        ASSERT_EQ(config.nodeConfigName.at("prod_mesh_nrf52"), parameters["/nodeConfigName/prod_mesh_nrf52"].get<int>());
+        ASSERT_EQ(config.nodeConfigName.size(), 1);
+        ASSERT_EQ(config.mapHeightInMeters, 33);
+        ASSERT_EQ(config.terminalId, -1);
+        combinations.insert({ config.seed, (u32)config.nodeConfigName.at("prod_mesh_nrf52") });
+    }
+    ASSERT_EQ(combinations.size(), sweep.GetNumRuns());
+    ASSERT_EQ(sweep.GetRunParameters(0)["/nodeConfigName/prod_mesh_nrf52"], 5);
+    ASSERT_EQ(sweep.GetRunParameters(1)["seed"], 2);
+    ASSERT_EQ(sweep.GetRunParameters(1)["/nodeConfigName/prod_mesh_nrf52"], 5);
+    ASSERT_EQ(sweep.GetRunParameters(3)["seed"], 1);
+    ASSERT_EQ(sweep.GetRunParameters(3)["/nodeConfigName/prod_mesh_nrf52"], 10);
+
+    ASSERT_EQ(sweep.GetCsvHeader().rfind("runIndex,/nodeConfigName/prod_mesh_nrf52,meshConnectionInterval,seed,status,", 0), 0);
+
+    //Invalid descriptions are detected before any run is started
+    {
+        Exceptions::DisableDebugBreakOnException disable;
+        ASSERT_THROW(SimSweep(nlohmann::json::parse(R"({ "unknown": 1 })"), CreateSweepBaseConfiguration()), UnknownJsonEntryException);
+        ASSERT_THROW(SimSweep(nlohmann::json::parse(R"({ "parameters": { "seed": [] } })"), CreateSweepBaseConfiguration()), IllegalArgumentException);
+        ASSERT_THROW(SimSweep(nlohmann::json::parse(R"({ "parameters": { "noSimConfigEntry": [1] } })"), CreateSweepBaseConfiguration()), UnknownJsonEntryException);
+    }
+}
+
+TEST(TestSimSweep, TestExecuteRunAndResume)
+{
+    const std::string resultPath = "TestExecuteRunAndResume.csv";
+    std::remove(resultPath.c_str());
+
+    const nlohmann::json description = nlohmann::json::parse(R"({
+        "baseConfiguration": { "nodeConfigName": { "prod_mesh_nrf52": 3 } },
+        "parameters": { "seed": [1, 2], "meshConnectionInterval": [24] },
+        "maxSimTimeMs": 100000,
+        "simTimeAfterClusteringMs": 5000,
+        "resultPath": "TestExecuteRunAndResume.csv"
+    })");
+    SimSweep sweep(description, CreateSweepBaseConfiguration());
+
+    const SimSweepRunResult result = sweep.ExecuteRun(1);
+    ASSERT_EQ(result.runIndex, 1);
+    ASSERT_EQ(result.status, "ok");
+    ASSERT_TRUE(result.clustered);
+    ASSERT_GT(result.clusteringTimeMs, 0);
+    ASSERT_EQ(result.simTimeMs, result.clusteringTimeMs + 5000);
+    ASSERT_GT(result.avgCurrentMicroAmpere, 0);
+    ASSERT_GE(result.maxCurrentMicroAmpere, result.avgCurrentMicroAmpere);
+    ASSERT_GT(result.batteryLifeDays, 0);
+
+    //Runs that already finished successfully are skipped when the sweep is resumed, crashed runs are retried
+    ASSERT_TRUE(sweep.LoadCompletedRuns().empty());
+    SimSweepRunResult crashedResult;
+    crashedResult.runIndex = 0;
+    crashedResult.status = "crashed with exit code 139";
+    {
+        std::ofstream file(resultPath);
+        file << sweep.GetCsvHeader() << "\n" << sweep.GetCsvRow(crashedResult) << "\n" << sweep.GetCsvRow(result) << "\n";
+    }
+    ASSERT_EQ(sweep.LoadCompletedRuns(), std::set<u32>{ 1 });
+
+    //The status is also found if a parameter value contains commas and quotes
+    const nlohmann::json objectDescription = nlohmann::json::parse(R"({
+        "parameters": { "nodeConfigName": [{ "prod_sink_nrf52": 1, "prod_mesh_nrf52": 2 }] },
+        "resultPath": "TestExecuteRunAndResume.csv"
+    })");
+    SimSweep objectSweep(objectDescription, CreateSweepBaseConfiguration());
+    SimSweepRunResult objectResult;
+    {
+        std::ofstream file(resultPath);
+        file << objectSweep.GetCsvHeader() << "\n" << objectSweep.GetCsvRow(objectResult) << "\n";
+    }
+    ASSERT_EQ(objectSweep.LoadCompletedRuns(), std::set<u32>{ 0 });
+
+    //A result file of a different sweep must not be resumed
+    {
+        std::ofstream file(resultPath);
+        file << "runIndex,seed,somethingElse\n";
+    }
+    {
+        Exceptions::DisableDebugBreakOnException disable;
+        ASSERT_THROW(sweep.LoadCompletedRuns(), IllegalArgumentException);
+    }
+
+    std::remove(resultPath.c_str());
+}
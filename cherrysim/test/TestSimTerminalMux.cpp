@@ -0,0 +1,239 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <SimTerminalMux.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+namespace
+{
+    struct MuxFixture
+    {
+        std::vector<std::pair<NodeId, std::string>> sentCommands;
+        SimTerminalMux mux;
+
+        explicit MuxFixture(u32 scrollbackLines = SimTerminalMux::DEFAULT_SCROLLBACK_LINES)
+            : mux(
+                [this](NodeId nodeId, const std::string& command) { sentCommands.push_back({ nodeId, command }); },
+                []() { return std::vector<NodeId>{ 1, 2, 3, 4 }; },
+                [](NodeId nodeId) { return nodeId <= 2 ? std::vector<NodeId>{ 1, 2 } : std::vector<NodeId>{ 3, 4 }; },
+                scrollbackLines)
+        {
+        }
+    };
+}
+
+TEST(TestSimTerminalMux, TestLineBuffering)
+{
+    MuxFixture f(3);
+
+    //Lines are split on line breaks and may arrive in parts
+    f.mux.Append(1, "first ");
+    f.mux.Append(1, "line\r\nsecond line\n");
+    f.mux.Append(2, "other node\n");
+    f.mux.Append(1, "third line\nfourth line\nincomplete");
+
+    const std::deque<SimTerminalMux::Line>* lines = f.mux.GetNodeLines(1);
+    ASSERT_NE(lines, nullptr);
+    //The scrollback only keeps the newest lines
+    ASSERT_EQ(lines->size(), 3u);
+    ASSERT_EQ(lines->at(0).text, "second line");
+    ASSERT_EQ(lines->at(2).text, "fourth line");
+    ASSERT_EQ(f.mux.GetNodeLines(2)->size(), 1u);
+    ASSERT_EQ(f.mux.GetNodeLines(3), nullptr);
+
+    //Lines of all nodes are merged in the order in which they were printed
+    const std::vector<const SimTerminalMux::Line*> viewLines = f.mux.GetViewLines(3);
+    ASSERT_EQ(viewLines.size(), 3u);
+    ASSERT_EQ(viewLines[0]->text, "other node");
+    ASSERT_EQ(viewLines[1]->text, "third line");
+    ASSERT_EQ(viewLines[2]->text, "fourth line");
+
+    f.mux.Append(1, " line\n");
+    ASSERT_EQ(f.mux.GetNodeLines(1)->back().text, "incomplete line");
+}
+
+TEST(TestSimTerminalMux, TestGetTag)
+{
+    ASSERT_EQ(SimTerminalMux::GetTag("0001234:2:[Node.cpp@123 NODE]: Some message"), "NODE");
+    ASSERT_EQ(SimTerminalMux::GetTag("0001234:2:[Node.cpp@123 NODE]: Contains ]: twice"), "NODE");
+    ASSERT_EQ(SimTerminalMux::GetTag("{\"type\":\"log\",\"tag\":\"CONN\",\"message\":\"x\"}"), "CONN");
+    ASSERT_EQ(SimTerminalMux::GetTag("{\"type\":\"status\",\"nodeId\":2}"), "");
+    ASSERT_EQ(SimTerminalMux::GetTag("mhTerm: status"), "");
+}
+
+TEST(TestSimTerminalMux, TestViews)
+{
+    MuxFixture f;
+    f.mux.Append(1, "0000001:1:[Node.cpp@1 NODE]: a\n");
+    f.mux.Append(2, "0000001:2:[Conn.cpp@1 CONN]: b\n");
+    f.mux.Append(3, "0000001:3:[Node.cpp@1 NODE]: c\n");
+
+    //Everything is shown by default, prefixed with the node id
+    std::string output = f.mux.TakeOutput();
+    ASSERT_NE(output.find("1| 0000001:1:"), std::string::npos);
+    ASSERT_NE(output.find("3| 0000001:3:"), std::string::npos);
+    ASSERT_EQ(f.mux.TakeOutput(), "");
+
+    //A single node without prefix
+    f.mux.HandleInput(":node 2");
+    f.mux.TakeOutput();
+    f.mux.Append(1, "hidden\n");
+    f.mux.Append(2, "shown\n");
+    ASSERT_EQ(f.mux.TakeOutput(), "shown" EOL);
+
+    //The cluster is resolved once when selected
+    f.mux.HandleInput(":cluster 4");
+    f.mux.TakeOutput();
+    f.mux.Append(2, "hidden\n");
+    f.mux.Append(3, "shown\n");
+    ASSERT_EQ(f.mux.TakeOutput(), "3| shown" EOL);
+
+    //Tag filter for all nodes
+    f.mux.HandleInput(":all");
+    f.mux.HandleInput(":tag NODE");
+    f.mux.TakeOutput();
+    f.mux.Append(1, "0000002:1:[Node.cpp@1 NODE]: d\n");
+    f.mux.Append(2, "0000002:2:[Conn.cpp@1 CONN]: e\n");
+    output = f.mux.TakeOutput();
+    ASSERT_NE(output.find(": d"), std::string::npos);
+    ASSERT_EQ(output.find(": e"), std::string::npos);
+
+    //The scrollback uses the same filters
+    f.mux.HandleInput(":back 2");
+    output = f.mux.TakeOutput();
+    ASSERT_NE(output.find("3| 0000001:3:[Node.cpp@1 NODE]: c"), std::string::npos);
+    ASSERT_NE(output.find(": d"), std::string::npos);
+    ASSERT_EQ(output.find(": a"), std::string::npos);
+
+    //While paused, lines are only stored
+    f.mux.HandleInput(":tag");
+    f.mux.HandleInput(":pause");
+    f.mux.TakeOutput();
+    f.mux.Append(4, "stored\n");
+    ASSERT_EQ(f.mux.TakeOutput(), "");
+    f.mux.HandleInput(":resume");
+    f.mux.HandleInput(":back 1");
+    ASSERT_NE(f.mux.TakeOutput().find("4| stored"), std::string::npos);
+}
+
+TEST(TestSimTerminalMux, TestCommands)
+{
+    MuxFixture f;
+
+    //Plain lines go to all nodes of the view
+    f.mux.HandleInput("status");
+    ASSERT_EQ(f.sentCommands.size(), 4u);
+    f.sentCommands.clear();
+
+    f.mux.HandleInput(":node 2 3");
+    f.mux.HandleInput("action this io led on");
+    std::map<NodeId, std::string> commands(f.sentCommands.begin(), f.sentCommands.end());
+    ASSERT_EQ(commands.size(), 2u);
+    ASSERT_EQ(commands[2], "action this io led on");
+    ASSERT_EQ(commands[3], "action this io led on");
+    f.sentCommands.clear();
+
+    f.mux.HandleInput(":send 4 set_serial  BBBBB");
+    ASSERT_EQ(f.sentCommands.size(), 1u);
+    ASSERT_EQ(f.sentCommands[0].first, 4);
+    ASSERT_EQ(f.sentCommands[0].second, "set_serial  BBBBB");
+    f.sentCommands.clear();
+
+    f.mux.HandleInput(":bcast reset");
+    ASSERT_EQ(f.sentCommands.size(), 4u);
+    ASSERT_EQ(f.sentCommands[3].second, "reset");
+    f.sentCommands.clear();
+
+    //Invalid input is reported and nothing is sent
+    f.mux.TakeOutput();
+    f.mux.HandleInput(":send abc status");
+    f.mux.HandleInput(":send 2");
+    f.mux.HandleInput(":send 70000 status");
+    f.mux.HandleInput(":node");
+    f.mux.HandleInput(":back many");
+    f.mux.HandleInput(":unknown");
+    ASSERT_EQ(f.sentCommands.size(), 0u);
+    const std::string output = f.mux.TakeOutput();
+    ASSERT_NE(output.find("expected a node id"), std::string::npos);
+    ASSERT_NE(output.find("expected an amount of lines"), std::string::npos);
+    ASSERT_NE(output.find("missing command"), std::string::npos);
+    ASSERT_NE(output.find("unknown command"), std::string::npos);
+}
+
+TEST(TestSimTerminalMux, TestParseNumber)
+{
+    u32 value = 0;
+    ASSERT_TRUE(SimTerminalMux::ParseNumber("42", UINT16_MAX, value));
+    ASSERT_EQ(value, 42u);
+    ASSERT_TRUE(SimTerminalMux::ParseNumber("010", UINT16_MAX, value));
+    ASSERT_EQ(value, 10u);
+    ASSERT_TRUE(SimTerminalMux::ParseNumber("0xFFFF", UINT16_MAX, value));
+    ASSERT_EQ(value, 0xFFFFu);
+    ASSERT_TRUE(SimTerminalMux::ParseNumber("4294967295", UINT32_MAX, value));
+    ASSERT_EQ(value, UINT32_MAX);
+
+    ASSERT_FALSE(SimTerminalMux::ParseNumber("", UINT16_MAX, value));
+    ASSERT_FALSE(SimTerminalMux::ParseNumber("abc", UINT16_MAX, value));
+    ASSERT_FALSE(SimTerminalMux::ParseNumber("12abc", UINT16_MAX, value));
+    ASSERT_FALSE(SimTerminalMux::ParseNumber("0x", UINT16_MAX, value));
+    ASSERT_FALSE(SimTerminalMux::ParseNumber("-1", UINT16_MAX, value));
+    ASSERT_FALSE(SimTerminalMux::ParseNumber(" 1", UINT16_MAX, value));
+    ASSERT_FALSE(SimTerminalMux::ParseNumber("65536", UINT16_MAX, value));
+    ASSERT_FALSE(SimTerminalMux::ParseNumber("4294967296", UINT32_MAX, value));
+    ASSERT_FALSE(SimTerminalMux::ParseNumber("99999999999999999999999", UINT32_MAX, value));
+}
+
+TEST(TestSimTerminalMux, TestManyNodes)
+{
+    constexpr NodeId amountOfNodes = 1000;
+    constexpr u32 linesPerNode = 200;
+    MuxFixture f(100);
+    f.mux.HandleInput(":node 500");
+    f.mux.TakeOutput();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (u32 i = 0; i < linesPerNode; i++)
+    {
+        for (NodeId nodeId = 1; nodeId <= amountOfNodes; nodeId++)
+        {
+            f.mux.Append(nodeId, "0001234:1:[Node.cpp@123 NODE]: Some typical log line of a node\n");
+        }
+    }
+    const auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    printf("Appended %u lines in %d ms" EOL, (u32)amountOfNodes * linesPerNode, (int)durationMs);
+
+    ASSERT_EQ(f.mux.GetNodeLines(amountOfNodes)->size(), 100u);
+    //Only the lines of the viewed node were collected for printing
+    const std::string output = f.mux.TakeOutput();
+    ASSERT_EQ(std::count(output.begin(), output.end(), '\n'), (long)linesPerNode);
+    ASSERT_EQ(f.mux.GetViewLines(1000).size(), 100u);
+}
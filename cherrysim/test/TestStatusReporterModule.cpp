@@ -354,3 +354,37 @@ TEST(TestStatusReporterModule, TestConnectionRssiReportingWithNoise) {
     }
 }
 #endif //GITHUB_RELEASE
+
+TEST(TestStatusReporterModule, TestRecordStorageStatusIsValidJson) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1});
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    tester.SendTerminalCommand(1, "action 2 status get_record_storage");
+    std::vector<SimulationMessage> message = {
+        SimulationMessage(1, "{\"type\":\"record_storage_status\",\"nodeId\":2,\"module\":3,")
+    };
+    tester.SimulateUntilMessagesReceived(10 * 1000, message);
+
+    json j = json::parse(message[0].GetCompleteMessage());
+    ASSERT_TRUE(j["pageErases"].is_array());
+    ASSERT_GT(j["pageErases"].size(), 0u);
+
+    //A response that announces 3 pages but only contains the erase counter of the first one
+    tester.SendTerminalCommand(2, "rawsend 34:02:00:01:00:03:00:0D:00:01:00:00:00:00:00:00:10:00:00:00:05:00:01:00:00:00:03:07:00");
+    message = {
+        SimulationMessage(1, "{\"type\":\"record_storage_status\",\"nodeId\":2,\"module\":3,\"live\":256,")
+    };
+    tester.SimulateUntilMessagesReceived(10 * 1000, message);
+
+    j = json::parse(message[0].GetCompleteMessage());
+    ASSERT_EQ(j["free"].get<u32>(), 16u);
+    ASSERT_EQ(j["pageErases"].size(), 1u);
+    ASSERT_EQ(j["pageErases"][0].get<u32>(), 7u);
+}
@@ -32,6 +32,9 @@
 #include "CherrySimTester.h"
 #include "CherrySimUtils.h"
 #include <set>
+#include <chrono>
+#include <functional>
+#include "MersenneTwister.h"
 
 TEST(TestUtility, TestGetIndexForSerial) {
     //The original serial number range had 5 characters
@@ -193,6 +196,134 @@ TEST(TestUtility, TestCRC) {
     ASSERT_EQ(Utility::CalculateCrc32((u8*)data, len), 1322553117);
 }
 
+static u32 CalculateCrc32Bitwise(const u8* message, const u32 messageLength, u32 previousCrc = 0)
+{
+    u32 crc = ~previousCrc;
+    for (u32 i = 0; i < messageLength; i++) {
+        crc ^= message[i];
+        for (u32 j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static u16 CalculateCrc16Bitwise(const u8* data, const u32 size)
+{
+    u16 crc = 0xFFFF;
+    for (u32 i = 0; i < size; i++) {
+        crc ^= (u16)(data[i] << 8);
+        for (u32 j = 0; j < 8; j++) {
+            crc = (crc & 0x8000) ? (u16)((crc << 1) ^ 0x1021) : (u16)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+TEST(TestUtility, TestCRCMatchesBitwiseReference) {
+    MersenneTwister mt(1);
+    std::vector<u8> data(1024);
+    for (u8& b : data) b = (u8)mt.NextU32();
+
+    //Check all lengths and alignments around the slicing boundaries
+    for (u32 offset = 0; offset < 8; offset++)
+    {
+        for (u32 length = 0; length <= 64; length++)
+        {
+            ASSERT_EQ(Utility::CalculateCrc32(data.data() + offset, length), CalculateCrc32Bitwise(data.data() + offset, length));
+            ASSERT_EQ(Utility::CalculateCrc16(data.data() + offset, length, nullptr), CalculateCrc16Bitwise(data.data() + offset, length));
+        }
+    }
+
+    //Random lengths, continued in random blocks
+    for (u32 repeat = 0; repeat < 100; repeat++)
+    {
+        const u32 length = mt.NextU32(0, (u32)data.size());
+        const u32 split = mt.NextU32(0, length);
+        const u32 expectedCrc32 = CalculateCrc32Bitwise(data.data(), length);
+        ASSERT_EQ(Utility::CalculateCrc32(data.data(), length), expectedCrc32);
+        ASSERT_EQ(Utility::CalculateCrc32(data.data() + split, length - split, Utility::CalculateCrc32(data.data(), split)), expectedCrc32);
+
+        const u16 partialCrc16 = Utility::CalculateCrc16(data.data(), split, nullptr);
+        ASSERT_EQ(Utility::CalculateCrc16(data.data() + split, length - split, &partialCrc16), CalculateCrc16Bitwise(data.data(), length));
+    }
+}
+
+TEST(TestUtility, TestCRCVariantsMatchBitwiseReference) {
+    MersenneTwister mt(2);
+    std::vector<u8> data(1024);
+    for (u8& b : data) b = (u8)mt.NextU32();
+
+    //Only the configured variant is used by CalculateCrc32 / CalculateCrc16, the others are checked here
+    const u32 crc32TableSlices[] = { 0, 1, 4, 8 };
+    for (u32 tableSlices : crc32TableSlices)
+    {
+        for (u32 offset = 0; offset < 8; offset++)
+        {
+            for (u32 length = 0; length <= 64; length++)
+            {
+                ASSERT_EQ(Utility::CalculateCrc32Variant(data.data() + offset, length, 0, tableSlices), CalculateCrc32Bitwise(data.data() + offset, length));
+            }
+        }
+        for (u32 repeat = 0; repeat < 100; repeat++)
+        {
+            const u32 length = mt.NextU32(0, (u32)data.size());
+            const u32 split = mt.NextU32(0, length);
+            const u32 partialCrc32 = Utility::CalculateCrc32Variant(data.data(), split, 0, tableSlices);
+            ASSERT_EQ(Utility::CalculateCrc32Variant(data.data() + split, length - split, partialCrc32, tableSlices), CalculateCrc32Bitwise(data.data(), length));
+        }
+    }
+
+    for (bool useTable : { false, true })
+    {
+        for (u32 length = 0; length <= 64; length++)
+        {
+            ASSERT_EQ(Utility::CalculateCrc16Variant(data.data() + 3, length, nullptr, useTable), CalculateCrc16Bitwise(data.data() + 3, length));
+        }
+        for (u32 repeat = 0; repeat < 100; repeat++)
+        {
+            const u32 length = mt.NextU32(0, (u32)data.size());
+            const u32 split = mt.NextU32(0, length);
+            const u16 partialCrc16 = Utility::CalculateCrc16Variant(data.data(), split, nullptr, useTable);
+            ASSERT_EQ(Utility::CalculateCrc16Variant(data.data() + split, length - split, &partialCrc16, useTable), CalculateCrc16Bitwise(data.data(), length));
+        }
+    }
+}
+
+TEST(TestUtility, BenchmarkCRC_long) {
+    constexpr u32 bufferSize = 4096;
+    constexpr u32 iterations = 2000;
+    MersenneTwister mt(1);
+    std::vector<u8> data(bufferSize);
+    for (u8& b : data) b = (u8)mt.NextU32();
+
+    //The results are accumulated so that the calculations can not be optimized away
+    u32 accumulator = 0;
+    auto measure = [&](const char* name, const std::function<u32()>& calculate)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (u32 i = 0; i < iterations; i++)
+        {
+            data[i % bufferSize]++;
+            accumulator += calculate();
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+        const double seconds = std::chrono::duration<double>(end - start).count();
+        printf("%s: %.1f MB/s" EOL, name, (double)bufferSize * iterations / 1024 / 1024 / (seconds > 0 ? seconds : 1e-9));
+    };
+
+    measure("CRC8", [&]() { return (u32)Utility::CalculateCrc8(data.data(), (u16)(bufferSize - 1)); });
+    measure("CRC16", [&]() { return (u32)Utility::CalculateCrc16(data.data(), bufferSize, nullptr); });
+    measure("CRC32", [&]() { return Utility::CalculateCrc32(data.data(), bufferSize); });
+    measure("CRC32 nibble table", [&]() { return Utility::CalculateCrc32Variant(data.data(), bufferSize, 0, 0); });
+    measure("CRC32 byte table", [&]() { return Utility::CalculateCrc32Variant(data.data(), bufferSize, 0, 1); });
+    measure("CRC32 slicing-by-4", [&]() { return Utility::CalculateCrc32Variant(data.data(), bufferSize, 0, 4); });
+    measure("CRC32 slicing-by-8", [&]() { return Utility::CalculateCrc32Variant(data.data(), bufferSize, 0, 8); });
+    measure("CRC32 bitwise", [&]() { return CalculateCrc32Bitwise(data.data(), bufferSize); });
+
+    printf("Accumulated: %u" EOL, accumulator);
+}
+
 TEST(TestUtility, TestFindLast) {
     char data[] = "This string has many sheeps! The reason for this is that sheeps are cool. sheeps? sheeps! And apples.";
     ASSERT_STREQ(Utility::FindLast(data, "sheep"), "sheeps! And apples.");
@@ -325,6 +325,9 @@ void Conf::SetSerialNumberIndex(u32 serialNumber)
 
     configuration.overwrittenSerialNumberIndex = serialNumber;
     configuration.isSerialNumberIndexOverwritten = true;
+#ifdef SIM_ENABLED
+    cherrySimInstance->UpdateNodeLookupIndices(cherrySimInstance->currentNode->index);
+#endif
 
     RecordStorageResultCode err = SaveConfigToFlash(this, (u32)RecordTypeConf::SET_SERIAL, nullptr, 0);
     if (err != RecordStorageResultCode::SUCCESS)
@@ -182,6 +182,12 @@ static_assert(false, "Featureset was not defined, which is mandatory!");
 #define ATTR_TABLE_MAX_SIZE 0x200
 #endif
 
+// Number of keystream blocks that each MeshAccessConnection precomputes per direction while idle.
+// Each encrypted packet uses two consecutive nonce counters, must be a power of two between 1 and 8
+#ifndef MESH_ACCESS_KEYSTREAM_CACHE_SIZE
+#define MESH_ACCESS_KEYSTREAM_CACHE_SIZE 4
+#endif
+
 // Maximum MTU size for GATT operations. Using a higher MTU will increase the RAM usage of the SoftDevice
 // enormously as it will consume multiple buffers per connection. Linker script needs to be changed
 // This should be a multiple of 20 bytes + 3 as the ATT header adds 3 bytes, this will make it easier to
@@ -199,6 +205,33 @@ static_assert(false, "Featureset was not defined, which is mandatory!");
 #define RECORD_STORAGE_NUM_PAGES 2
 #endif
 
+// Percentage of the record storage that must be occupied by outdated records before a page is
+// defragmented in the background while the node is idle. Set to 0 to disable idle defragmentation
+#ifndef RECORD_STORAGE_IDLE_DEFRAGMENTATION_GARBAGE_PERCENTAGE
+#define RECORD_STORAGE_IDLE_DEFRAGMENTATION_GARBAGE_PERCENTAGE 25
+#endif
+
+// ########### CRC Settings ##########################################
+// Size of the lookup tables used for CRC32 calculation, trading flash and RAM for speed:
+// 0: nibble table (64 byte flash), 1: byte table (1 kB flash),
+// 4 or 8: slicing-by-4/8 using the byte table and additional tables generated in RAM (3 kB / 7 kB)
+#ifndef CRC32_TABLE_SLICES
+#ifdef SIM_ENABLED
+#define CRC32_TABLE_SLICES 8
+#else
+#define CRC32_TABLE_SLICES 0
+#endif
+#endif
+
+// Uses a 512 byte lookup table for the CRC16 calculation instead of computing it bitwise
+#ifndef CRC16_USE_TABLE
+#ifdef SIM_ENABLED
+#define CRC16_USE_TABLE 1
+#else
+#define CRC16_USE_TABLE 0
+#endif
+#endif
+
 // ########### General ##########################################
 // GAP device name (Not used by the mesh)
 #ifndef DEVICE_NAME
@@ -513,11 +546,11 @@ class Conf
 
 // Linker variables
 #if defined(SIM_ENABLED)
-    extern u32 __application_start_address;
-    extern u32 __application_end_address;
-    extern u32 __application_ram_start_address;
-    extern u32 __start_conn_type_resolvers;
-    extern u32 __stop_conn_type_resolvers;
+    extern uintptr_t __application_start_address;
+    extern uintptr_t __application_end_address;
+    extern uintptr_t __application_ram_start_address;
+    extern uintptr_t __start_conn_type_resolvers;
+    extern uintptr_t __stop_conn_type_resolvers;
 #else
     extern u32 __application_start_address[]; //Variable is set in the linker script
     extern u32 __application_end_address[]; //Variable is set in the linker script
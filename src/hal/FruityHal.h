@@ -236,6 +236,15 @@ namespace FruityHal
 
     };
 
+    //Key, cleartext and ciphertext of an AES-128 ECB operation. The layout matches what the
+    //hardware expects so that a key can stay in place for multiple encryptions
+    struct EcbData
+    {
+        u8 key[16];
+        u8 cleartext[16];
+        u8 ciphertext[16];
+    };
+
     struct UartReadCharBlockingResult
     {
         bool didError = false;
@@ -380,7 +389,7 @@ namespace FruityHal
 
     // ######################### Bootloader ############################
     u32 GetBootloaderVersion();
-    u32 GetBootloaderAddress();
+    uintptr_t GetBootloaderAddress();
     void ActivateBootloaderOnReset();
 
     // ######################### Utility ############################
@@ -413,6 +422,8 @@ namespace FruityHal
     void DelayUs(u32 delayMicroSeconds);
     void DelayMs(u32 delayMs);
     void EcbEncryptBlock(const u8 * p_key, const u8 * p_clearText, u8 * p_cipherText);
+    //Encrypts data->cleartext with data->key into data->ciphertext without any intermediate copies
+    void EcbEncrypt(EcbData* data);
     u8 ConvertPortToGpio(u8 port, u8 pin);
 
     // ######################### FLASH ############################
@@ -497,7 +508,7 @@ namespace FruityHal
     u32 * GetDeviceMemoryAddress();
     void GetCustomerData(u32 * p_data, u8 len);
     void WriteCustomerData(u32 * p_data, u8 len);
-    u32 GetBootloaderSettingsAddress();
+    uintptr_t GetBootloaderSettingsAddress();
     u32 GetCodePageSize();
     u32 GetCodeSize();
     u32 GetDeviceId();
@@ -2057,7 +2057,7 @@ u32 FruityHal::GetBootloaderVersion()
     }
 }
 
-u32 FruityHal::GetBootloaderAddress()
+uintptr_t FruityHal::GetBootloaderAddress()
 {
     return BOOTLOADER_UICR_ADDRESS;
 }
@@ -2210,6 +2210,15 @@ void FruityHal::EcbEncryptBlock(const u8 * p_key, const u8 * p_clearText, u8 * p
     CheckedMemcpy(p_cipherText, ecbData.ciphertext, SOC_ECB_CIPHERTEXT_LENGTH);
 }
 
+void FruityHal::EcbEncrypt(EcbData* data)
+{
+    static_assert(sizeof(EcbData) == sizeof(nrf_ecb_hal_data_t), "EcbData must match nrf_ecb_hal_data_t");
+    static_assert(offsetof(EcbData, cleartext) == offsetof(nrf_ecb_hal_data_t, cleartext), "EcbData must match nrf_ecb_hal_data_t");
+    static_assert(offsetof(EcbData, ciphertext) == offsetof(nrf_ecb_hal_data_t, ciphertext), "EcbData must match nrf_ecb_hal_data_t");
+    //Only returns NRF_SUCCESS
+    sd_ecb_block_encrypt((nrf_ecb_hal_data_t*)data);
+}
+
 ErrorType FruityHal::FlashPageErase(u32 page)
 {
     return nrfErrToGeneric(sd_flash_page_erase(page));
@@ -2650,21 +2659,21 @@ void FruityHal::BleStackErrorHandler(u32 id, u32 info)
         }
         case NRF_FAULT_ID_SDK_ASSERT: //SDK asserts
         {
-            GS->ramRetainStructPtr->code2 = ((assert_info_t *)info)->line_num;
-            u8 len = (u8)strlen((const char*)((assert_info_t *)info)->p_file_name);
+            GS->ramRetainStructPtr->code2 = ((assert_info_t *)(uintptr_t)info)->line_num;
+            u8 len = (u8)strlen((const char*)((assert_info_t *)(uintptr_t)info)->p_file_name);
             if (len > (RAM_PERSIST_STACKSTRACE_SIZE - 1) * 4) len = (RAM_PERSIST_STACKSTRACE_SIZE - 1) * 4;
-            CheckedMemcpy(GS->ramRetainStructPtr->stacktrace + 1, ((assert_info_t *)info)->p_file_name, len);
+            CheckedMemcpy(GS->ramRetainStructPtr->stacktrace + 1, ((assert_info_t *)(uintptr_t)info)->p_file_name, len);
             break;
         }
         case NRF_FAULT_ID_SDK_ERROR: //SDK errors
         {
-            GS->ramRetainStructPtr->code2 = ((error_info_t *)info)->line_num;
-            GS->ramRetainStructPtr->code3 = ((error_info_t *)info)->err_code;
+            GS->ramRetainStructPtr->code2 = ((error_info_t *)(uintptr_t)info)->line_num;
+            GS->ramRetainStructPtr->code3 = ((error_info_t *)(uintptr_t)info)->err_code;
 
             //Copy filename to stacktrace
-            u8 len = (u8)strlen((const char*)((error_info_t *)info)->p_file_name);
+            u8 len = (u8)strlen((const char*)((error_info_t *)(uintptr_t)info)->p_file_name);
             if (len > (RAM_PERSIST_STACKSTRACE_SIZE - 1) * 4) len = (RAM_PERSIST_STACKSTRACE_SIZE - 1) * 4;
-            CheckedMemcpy(GS->ramRetainStructPtr->stacktrace + 1, ((error_info_t *)info)->p_file_name, len);
+            CheckedMemcpy(GS->ramRetainStructPtr->stacktrace + 1, ((error_info_t *)(uintptr_t)info)->p_file_name, len);
             break;
         }
     }
@@ -2824,7 +2833,7 @@ void FruityHal::WriteCustomerData(u32 * p_data, u8 len)
 #endif
 }
 
-u32 FruityHal::GetBootloaderSettingsAddress()
+uintptr_t FruityHal::GetBootloaderSettingsAddress()
 {
     return REGION_BOOTLOADER_SETTINGS_START;
 }
@@ -182,11 +182,12 @@ ErrorType FruityHal::ClearRebootReason(){ return ErrorType::SUCCESS; }
 void FruityHal::StartWatchdog(bool safeBoot){ }
 void FruityHal::FeedWatchdog(){ }
 u32 FruityHal::GetBootloaderVersion(){ return 0; }
-u32 FruityHal::GetBootloaderAddress(){ return 0; }
+uintptr_t FruityHal::GetBootloaderAddress(){ return 0; }
 void FruityHal::ActivateBootloaderOnReset(){ }
 void FruityHal::DelayUs(u32 delayMicroSeconds){ }
 void FruityHal::DelayMs(u32 delayMs){ }
 void FruityHal::EcbEncryptBlock(const u8 * p_key, const u8 * p_clearText, u8 * p_cipherText){ }
+void FruityHal::EcbEncrypt(EcbData* data){ }
 u8 FruityHal::ConvertPortToGpio(u8 port, u8 pin){ return 0; }
 
 // ######################### FLASH ############################
@@ -265,7 +266,7 @@ u32 * FruityHal::GetUserMemoryAddress(){ return 0; }
 u32 * FruityHal::GetDeviceMemoryAddress(){ return 0; }
 void FruityHal::GetCustomerData(u32 * p_data, u8 len) {};
 void FruityHal::WriteCustomerData(u32 * p_data, u8 len) {};
-u32 FruityHal::GetBootloaderSettingsAddress(){ return 0; }
+uintptr_t FruityHal::GetBootloaderSettingsAddress(){ return 0; }
 u32 FruityHal::GetCodePageSize(){ return 0; }
 u32 FruityHal::GetCodeSize(){ return 0; }
 u32 FruityHal::GetDeviceId(){ return 0; }
@@ -225,7 +225,7 @@ void ConnectionManager::GATTServiceDiscoveredHandler(u16 connHandle, FruityHal::
 void ConnectionManager::ResolveConnection(BaseConnection* oldConnection, BaseConnectionSendData* sendData, u8 const * data)
 {
     //ConnectionTypeResolvers are collected in a special linker section
-    u8 numConnTypeResolvers = (((u32)__stop_conn_type_resolvers) - ((u32)__start_conn_type_resolvers)) / sizeof(u32);
+    u8 numConnTypeResolvers = (((uintptr_t)__stop_conn_type_resolvers) - ((uintptr_t)__start_conn_type_resolvers)) / sizeof(ConnTypeResolver);
     ConnTypeResolver* resolvers = (ConnTypeResolver*)__start_conn_type_resolvers;
 
     logt("RCONN", "numConnTypeResolvers %u", numConnTypeResolvers);
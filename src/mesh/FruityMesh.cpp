@@ -371,6 +371,8 @@ void DispatchTimerEvents(u16 passedTimeDs)
 
     FlashStorage::GetInstance().TimerEventHandler(passedTimeDs);
 
+    GS->recordStorage.TimerEventHandler(passedTimeDs);
+
     AdvertisingController::GetInstance().TimerEventHandler(passedTimeDs);
 
     ScanController::GetInstance().TimerEventHandler(passedTimeDs);
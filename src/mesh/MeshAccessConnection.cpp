@@ -301,7 +301,8 @@ void MeshAccessConnection::HandshakeANonce(ConnPacketEncryptCustomStart const *
     decryptionNonce[1] = packet.anonce[1] = Utility::GetRandomInteger();
 
     //Generate the session key for decryption
-    bool keyValid = GenerateSessionKey((u8*)decryptionNonce, partnerId, fmKeyId, sessionDecryptionKey);
+    bool keyValid = GenerateSessionKey((u8*)decryptionNonce, partnerId, fmKeyId, decryptionEcb.key);
+    ResetKeystreamCaches();
 
     if(!keyValid){
         logt("WARNING", "Invalid Key"); //See: IOT-3821
@@ -343,8 +344,9 @@ void MeshAccessConnection::OnANonceReceived(ConnPacketEncryptCustomANonce const
     decryptionNonce[1] = packet->snonce[1] = Utility::GetRandomInteger();
 
     //Generate the session keys for encryption and decryption
-    bool keyValidA = GenerateSessionKey((u8*)encryptionNonce, GS->node.configuration.nodeId, fmKeyId, sessionEncryptionKey);
-    bool keyValidB = GenerateSessionKey((u8*)decryptionNonce, GS->node.configuration.nodeId, fmKeyId, sessionDecryptionKey);
+    bool keyValidA = GenerateSessionKey((u8*)encryptionNonce, GS->node.configuration.nodeId, fmKeyId, encryptionEcb.key);
+    bool keyValidB = GenerateSessionKey((u8*)decryptionNonce, GS->node.configuration.nodeId, fmKeyId, decryptionEcb.key);
+    ResetKeystreamCaches();
 
     if(!keyValidA || !keyValidB){
         logt("ERROR", "Invalid Key %u %u", (u32)keyValidA, (u32)keyValidB);
@@ -394,7 +396,8 @@ void MeshAccessConnection::OnSNonceReceived(ConnPacketEncryptCustomSNonce const
     encryptionNonce[1] = inPacket->snonce[1];
 
     //Generate key for encryption
-    bool keyValid = GenerateSessionKey((u8*)encryptionNonce, partnerId, fmKeyId, sessionEncryptionKey);
+    bool keyValid = GenerateSessionKey((u8*)encryptionNonce, partnerId, fmKeyId, encryptionEcb.key);
+    ResetKeystreamCaches();
 
     if(!keyValid){
         logt("ERROR", "Invalid Key in HD");
@@ -594,6 +597,8 @@ void MeshAccessConnection::OnCorruptedMessage()
 void MeshAccessConnection::LogKeys()
 {
     //Log encryption and decryption keys
+    const u8* sessionEncryptionKey = encryptionEcb.key;
+    const u8* sessionDecryptionKey = decryptionEcb.key;
     TO_HEX(sessionEncryptionKey, 16);
     TO_HEX(sessionDecryptionKey, 16);
     logt("MACONN", "EncrKey: %s", sessionEncryptionKeyHex);
@@ -618,43 +623,18 @@ void MeshAccessConnection::EncryptPacket(u8* data, MessageLength dataLength)
 
     u8 cleartext[16];
     u8 keystream[16];
-    u8 ciphertext[16];
 
     //Generate keystream with nonce
-    CheckedMemset(cleartext, 0x00, 16);
-    CheckedMemcpy(cleartext, encryptionNonce, MESH_ACCESS_HANDSHAKE_NONCE_LENGTH);
-
-    //TO_HEX(cleartext, 16);
-    //logt("MACONN", "Encryption Keystream cleartext %s", cleartextHex);
-
-    Utility::Aes128BlockEncrypt(
-            (Aes128Block*)cleartext,
-            (Aes128Block*)sessionEncryptionKey,
-            (Aes128Block*)keystream);
+    GetKeystream(encryptionEcb, encryptionKeystreamCache, encryptionNonce, encryptionNonce[1], keystream);
 
     //TO_HEX(keystream, 16);
     //logt("MACONN", "Encryption Keystream %s", keystreamHex);
 
     //Xor cleartext with keystream to get the ciphertext
-    CheckedMemcpy(cleartext, data, dataLength.GetRaw());
-    Utility::XorBytes(keystream, cleartext, 16, ciphertext);
-    CheckedMemcpy(data, ciphertext, dataLength.GetRaw());
-
-    //Increment nonce being used as a counter
-    encryptionNonce[1]++;
-
-    //Generate a new Keystream with an updated counter for MIC calculateion
-    CheckedMemset(cleartext, 0x00, 16);
-    CheckedMemcpy(cleartext, encryptionNonce, MESH_ACCESS_HANDSHAKE_NONCE_LENGTH);
-
-    //TO_HEX_2(cleartext, 16);
-    //logt("MACONN", "Encryption Keystream 2 cleartext %s", cleartextHex);
-
-    Utility::Aes128BlockEncrypt( //encrypts nonce
-                (Aes128Block*)cleartext,
-                (Aes128Block*)sessionEncryptionKey,
-                (Aes128Block*)keystream);
+    Utility::XorBytes(keystream, data, dataLength.GetRaw(), data);
 
+    //Generate a new Keystream with an incremented counter for MIC calculation
+    GetKeystream(encryptionEcb, encryptionKeystreamCache, encryptionNonce, encryptionNonce[1] + 1, keystream);
 
     //TO_HEX_2(keystream, 16);
     //logt("MACONN", "Encryption Keystream 2 %s", keystreamHex);
@@ -663,24 +643,14 @@ void MeshAccessConnection::EncryptPacket(u8* data, MessageLength dataLength)
     //we therefore create a pair that cannot be reproduced by an attacker (hopefully :-))
     CheckedMemset(cleartext, 0x00, 16);
     CheckedMemcpy(cleartext, data, dataLength.GetRaw());
-    Utility::XorBytes(keystream, cleartext, 16, cleartext);
-    Utility::Aes128BlockEncrypt(
-            (Aes128Block*)cleartext,
-            (Aes128Block*)sessionEncryptionKey,
-            (Aes128Block*)keystream);
-
-    //Log the keystream generated by the nonce, 4 bytes of keystream are used as MIC
-    //u8 keystream2[16];
-    //CheckedMemcpy(keystream2, keystream, 16);
-    //TO_HEX(keystream2, 16);
-    //logt("MACONN", "MIC nonce %u produces Keystream %s", encryptionNonce[1], keystream2Hex);
+    Utility::XorBytes(keystream, cleartext, 16, encryptionEcb.cleartext);
+    FruityHal::EcbEncrypt(&encryptionEcb);
 
-    //Reset nonce, it is incremented once the packet was successfully queued with the softdevice
-    encryptionNonce[1]--;
+    //The nonce is not incremented here, this happens once the packet was successfully queued with the softdevice
 
-    //Copy nonce to the end of the packet
+    //4 bytes of the encrypted block are used as MIC and copied to the end of the packet
     u8* micPtr = data + dataLength;
-    CheckedMemcpy(micPtr, keystream, MESH_ACCESS_MIC_LENGTH);
+    CheckedMemcpy(micPtr, encryptionEcb.ciphertext, MESH_ACCESS_MIC_LENGTH);
 
     //Log the encrypted packet
     DYNAMIC_ARRAY(data2, dataLength.GetRaw() + MESH_ACCESS_MIC_LENGTH);
@@ -696,45 +666,26 @@ bool MeshAccessConnection::DecryptPacket(u8 const * data, u8 * decryptedOut, Mes
     TO_HEX(data, dataLength.GetRaw());
     logt("MACONN", "Decrypting %s (%u) with nonce %u", dataHex, dataLength.GetRaw(), decryptionNonce[1]);
 
-    u8 cleartext[16];
     u8 keystream[16];
     u8 ciphertext[16];
 
     //We need to calculate the MIC from the ciphertext as was done by the sender
-    decryptionNonce[1]++;
-
-    //Generate a keystream from the nonce
-    CheckedMemset(cleartext, 0x00, 16);
-    CheckedMemcpy(cleartext, decryptionNonce, MESH_ACCESS_HANDSHAKE_NONCE_LENGTH);
-    Utility::Aes128BlockEncrypt( //encrypts nonce
-                (Aes128Block*)cleartext,
-                (Aes128Block*)sessionDecryptionKey,
-                (Aes128Block*)keystream);
+    //Generate a keystream from the incremented nonce
+    GetKeystream(decryptionEcb, decryptionKeystreamCache, decryptionNonce, decryptionNonce[1] + 1, keystream);
 
     //Xor the keystream with the ciphertext
     CheckedMemset(ciphertext, 0x00, 16);
     CheckedMemcpy(ciphertext, data, dataLength.GetRaw() - MESH_ACCESS_MIC_LENGTH);
-    Utility::XorBytes(ciphertext, keystream, 16, cleartext);
+    Utility::XorBytes(ciphertext, keystream, 16, decryptionEcb.cleartext);
     //Encrypt the resulting cleartext
-    Utility::Aes128BlockEncrypt(
-            (Aes128Block*)cleartext,
-            (Aes128Block*)sessionDecryptionKey,
-            (Aes128Block*)keystream);
+    FruityHal::EcbEncrypt(&decryptionEcb);
 
     //Check if the two MICs match
     u8 const * micPtr = data + (dataLength - MESH_ACCESS_MIC_LENGTH);
-    u32 micCheck = memcmp(keystream, micPtr, MESH_ACCESS_MIC_LENGTH);
-
-    //Reset decryptionNonce for decrypting the message
-    decryptionNonce[1]--;
+    u32 micCheck = memcmp(decryptionEcb.ciphertext, micPtr, MESH_ACCESS_MIC_LENGTH);
 
     //Generate keystream with nonce
-    CheckedMemset(cleartext, 0x00, 16);
-    CheckedMemcpy(cleartext, decryptionNonce, MESH_ACCESS_HANDSHAKE_NONCE_LENGTH);
-    Utility::Aes128BlockEncrypt(
-            (Aes128Block*)cleartext,
-            (Aes128Block*)sessionDecryptionKey,
-            (Aes128Block*)keystream);
+    GetKeystream(decryptionEcb, decryptionKeystreamCache, decryptionNonce, decryptionNonce[1], keystream);
 
     //TO_HEX(keystream, 16);
     //logt("MACONN", "Keystream %s", keystreamHex);
@@ -745,18 +696,51 @@ bool MeshAccessConnection::DecryptPacket(u8 const * data, u8 * decryptedOut, Mes
     //Increment nonce being used as a counter
     decryptionNonce[1] += 2;
 
-    //u8 keystream2[16];
-    //CheckedMemcpy(keystream2, keystream, 16);
-    //TO_HEX(keystream2, 16);
-    //logt("MACONN", "MIC nonce %u, Keystream %s", decryptionNonce[1], keystream2Hex);
-
-
     TO_HEX_2(data, dataLength.GetRaw() - MESH_ACCESS_MIC_LENGTH);
     logt("MACONN", "Decrypted as %s (%u) micValid %u", dataHex, dataLength.GetRaw() - MESH_ACCESS_MIC_LENGTH, micCheck == 0);
 
     return micCheck == 0;
 }
 
+/**
+ * Returns the keystream for the given nonce counter value, which is the encrypted
+ * nonce/counter + padding. If it was not precomputed, it is generated and cached.
+ */
+void MeshAccessConnection::GetKeystream(FruityHal::EcbData& ecb, KeystreamCache& cache, const u32* nonce, u32 counter, u8* keystreamOut)
+{
+    const u32 slot = counter % MESH_ACCESS_KEYSTREAM_CACHE_SIZE;
+    if ((cache.validFlags & (1 << slot)) == 0 || cache.counters[slot] != counter)
+    {
+        CheckedMemset(ecb.cleartext, 0x00, 16);
+        CheckedMemcpy(ecb.cleartext, &nonce[0], sizeof(u32));
+        CheckedMemcpy(ecb.cleartext + sizeof(u32), &counter, sizeof(u32));
+        FruityHal::EcbEncrypt(&ecb);
+
+        CheckedMemcpy(cache.keystreams[slot], ecb.ciphertext, 16);
+        cache.counters[slot] = counter;
+        cache.validFlags |= (1 << slot);
+    }
+    CheckedMemcpy(keystreamOut, cache.keystreams[slot], 16);
+}
+
+void MeshAccessConnection::ResetKeystreamCaches()
+{
+    encryptionKeystreamCache.validFlags = 0;
+    decryptionKeystreamCache.validFlags = 0;
+}
+
+void MeshAccessConnection::PrecomputeKeystreams()
+{
+    if (encryptionState != EncryptionState::ENCRYPTED || connectionState != ConnectionState::HANDSHAKE_DONE) return;
+
+    u8 keystream[16];
+    for (u32 i = 0; i < MESH_ACCESS_KEYSTREAM_CACHE_SIZE; i++)
+    {
+        GetKeystream(encryptionEcb, encryptionKeystreamCache, encryptionNonce, encryptionNonce[1] + i, keystream);
+        GetKeystream(decryptionEcb, decryptionKeystreamCache, decryptionNonce, decryptionNonce[1] + i, keystream);
+    }
+}
+
 
 #define ________________________SEND________________________
 
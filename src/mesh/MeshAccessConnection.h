@@ -69,6 +69,7 @@ class MeshAccessConnection
         : public BaseConnection
 {
     friend class MeshAccessModule;
+    friend class TestMeshAccessConnection;
 private:
 
     MeshAccessServiceStruct* meshAccessService;
@@ -83,12 +84,27 @@ private:
     u32 amountOfCorruptedMessages = 0;
     bool allowCorruptedEncryptionStart = false;
 
-    u8 sessionEncryptionKey[16] = {};
-    u8 sessionDecryptionKey[16] = {};
+    //The session keys are stored inside the ECB data so that they do not have to be copied for each block
+    FruityHal::EcbData encryptionEcb = {};
+    FruityHal::EcbData decryptionEcb = {};
 
     u32 encryptionNonce[2] = {};
     u32 decryptionNonce[2] = {};
 
+    //Keystreams generated from upcoming nonce counter values, indexed by counter modulo the cache size
+    struct KeystreamCache
+    {
+        u32 counters[MESH_ACCESS_KEYSTREAM_CACHE_SIZE];
+        u8 keystreams[MESH_ACCESS_KEYSTREAM_CACHE_SIZE][16];
+        u8 validFlags;
+    };
+    static_assert(MESH_ACCESS_KEYSTREAM_CACHE_SIZE >= 1 && MESH_ACCESS_KEYSTREAM_CACHE_SIZE <= 8
+        && (MESH_ACCESS_KEYSTREAM_CACHE_SIZE & (MESH_ACCESS_KEYSTREAM_CACHE_SIZE - 1)) == 0, "Cache size must be a power of two between 1 and 8");
+    KeystreamCache encryptionKeystreamCache = {};
+    KeystreamCache decryptionKeystreamCache = {};
+
+    void GetKeystream(FruityHal::EcbData& ecb, KeystreamCache& cache, const u32* nonce, u32 counter, u8* keystreamOut);
+    void ResetKeystreamCaches();
 
     bool GenerateSessionKey(const u8* nonce, NodeId centralNodeId, FmKeyId fmKeyId, u8* keyOut);
     void OnCorruptedMessage();
@@ -153,6 +169,9 @@ public:
     //Decrypts the data in place (dataLength includes MIC) with the session key
     bool DecryptPacket(u8 const * data, u8 * decryptedOut, MessageLength dataLength);
 
+    //Generates the keystreams for the next nonce counter values in advance, should be called while idle
+    void PrecomputeKeystreams();
+
 
     /*############### Sending ##################*/
     MessageLength ProcessDataBeforeTransmission(u8* message, MessageLength messageLength, MessageLength bufferLength) override final;
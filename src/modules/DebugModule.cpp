@@ -567,12 +567,40 @@ TerminalCommandHandlerReturnType DebugModule::TerminalCommandHandler(const char*
     else if (TERMARGS(0, "heap"))
     {
         u8 checkvar = 1;
-        logjson("NODE", "{\"stack\":%u}" SEP, (u32)(&checkvar - 0x20000000));
+        logjson("NODE", "{\"stack\":%u}" SEP, (u32)((uintptr_t)&checkvar - 0x20000000));
         logt("NODE", "Module usage: %u" SEP, GS->moduleAllocator.GetMemorySize());
 
         return TerminalCommandHandlerReturnType::SUCCESS;
 
     }
+    //Display the occupancy and high-water marks of the allocators and connection queues
+    else if (TERMARGS(0, "memstat"))
+    {
+        const NodeId nodeId = GS->node.configuration.nodeId;
+        const char* format = "{\"type\":\"memstat\",\"nodeId\":%u,\"pool\":\"%s\",\"used\":%u,\"highWater\":%u,\"capacity\":%u}" SEP;
+        const u32 moduleMemoryUsed = GS->moduleAllocator.GetUsedMemorySize();
+        logjson("DEBUGMOD", format, nodeId, "moduleAllocator", moduleMemoryUsed, moduleMemoryUsed, GS->moduleAllocator.GetMemorySize());
+        logjson("DEBUGMOD", format, nodeId, "connectionAllocator",
+            GS->connectionAllocator.GetAmountOfAllocatedConnections(),
+            GS->connectionAllocator.GetMaxAmountOfAllocatedConnections(),
+            ConnectionAllocator::GetPoolSize());
+        logjson("DEBUGMOD", format, nodeId, "queueChunks",
+            GS->connectionQueueMemoryAllocator.GetAmountOfUsedChunks(),
+            GS->connectionQueueMemoryAllocator.GetMaxAmountOfUsedChunks(),
+            (u32)CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT);
+
+        BaseConnections conns = GS->cm.GetBaseConnections(ConnectionDirection::INVALID);
+        for (u32 i = 0; i < conns.count; i++) {
+            const BaseConnection* conn = conns.handles[i].GetConnection();
+            if (conn == nullptr) continue;
+            logjson("DEBUGMOD", "{\"type\":\"memstat\",\"nodeId\":%u,\"pool\":\"connectionQueue\",\"connectionId\":%u,\"partnerId\":%u,\"used\":%u,\"highWater\":%u,\"capacity\":%u,\"packets\":%u,\"maxPackets\":%u}" SEP,
+                nodeId, conn->connectionId, conn->partnerId,
+                conn->queue.GetAmountOfChunks(), conn->queue.GetMaxAmountOfChunks(), (u32)CONNECTION_QUEUE_MEMORY_MAX_CHUNKS_PER_CONNECTION,
+                conn->queue.GetAmountOfPackets(), conn->queue.GetMaxAmountOfPackets());
+        }
+
+        return TerminalCommandHandlerReturnType::SUCCESS;
+    }
     //Reads a page of the memory (0-256) and prints it
     if(TERMARGS(0, "readblock"))
     {
@@ -580,10 +608,10 @@ TerminalCommandHandlerReturnType DebugModule::TerminalCommandHandler(const char*
 
         u16 blockSize = 1024;
 
-        u32 offset = FLASH_REGION_START_ADDRESS;
-        if(TERMARGS(1, "uicr")) offset = (u32)FruityHal::GetUserMemoryAddress();
-        if(TERMARGS(1, "ficr")) offset = (u32)FruityHal::GetDeviceMemoryAddress();
-        if(TERMARGS(1, "ram")) offset = (u32)0x20000000;
+        uintptr_t offset = FLASH_REGION_START_ADDRESS;
+        if(TERMARGS(1, "uicr")) offset = (uintptr_t)FruityHal::GetUserMemoryAddress();
+        if(TERMARGS(1, "ficr")) offset = (uintptr_t)FruityHal::GetDeviceMemoryAddress();
+        if(TERMARGS(1, "ram")) offset = (uintptr_t)0x20000000;
         bool didError = false;
 
         u16 numBlocks = 1;
@@ -609,7 +637,7 @@ TerminalCommandHandlerReturnType DebugModule::TerminalCommandHandler(const char*
             {
                 CheckedMemcpy(buffer, (u8*)(block*blockSize+i*bufferSize + offset), bufferSize);
                 Logger::ConvertBufferToHexString(buffer, bufferSize, (char*)charBuffer, bufferSize*3+1);
-                trace("0x%08X: %s" EOL,(block*blockSize)+i*bufferSize + offset, charBuffer);
+                trace("0x%08X: %s" EOL, (u32)((block*blockSize)+i*bufferSize + offset), charBuffer);
             }
         }
 
@@ -618,7 +646,7 @@ TerminalCommandHandlerReturnType DebugModule::TerminalCommandHandler(const char*
     //Prints a map of empty (0) and used (1) memory pages
     if(TERMARGS(0 ,"memorymap"))
     {
-        u32 offset = FLASH_REGION_START_ADDRESS;
+        uintptr_t offset = FLASH_REGION_START_ADDRESS;
         u16 blockSize = 1024; //Size of a memory block to check
         u16 numBlocks = FruityHal::GetCodeSize() * FruityHal::GetCodePageSize() / blockSize;
 
@@ -824,7 +852,7 @@ TerminalCommandHandlerReturnType DebugModule::TerminalCommandHandler(const char*
     }
     if (TERMARGS(0, "nswrite")  && commandArgsSize >= 3)    //jstodo rename nswrite to flashwrite? Might also be unused because we already have saverec
     {
-        u32 addr = strtoul(commandArgs[1], nullptr, 10) + FLASH_REGION_START_ADDRESS;
+        uintptr_t addr = strtoul(commandArgs[1], nullptr, 10) + FLASH_REGION_START_ADDRESS;
         u8 buffer[200];
         u16 dataLength = Logger::ParseEncodedStringToBuffer(commandArgs[2], buffer, 200);
 
@@ -876,7 +904,7 @@ TerminalCommandHandlerReturnType DebugModule::TerminalCommandHandler(const char*
     {
         if(commandArgsSize < 3) return TerminalCommandHandlerReturnType::NOT_ENOUGH_ARGUMENTS;
 
-        u32 destAddr = Utility::StringToU32(commandArgs[1]) + FLASH_REGION_START_ADDRESS;
+        uintptr_t destAddr = Utility::StringToU32(commandArgs[1]) + FLASH_REGION_START_ADDRESS;
 
         u32 buffer[16];
         u16 len = Logger::ParseEncodedStringToBuffer(commandArgs[2], (u8*)buffer, 64);
@@ -1243,7 +1271,7 @@ void DebugModule::MeshMessageReceivedHandler(BaseConnection* connection, BaseCon
                         break;
                     }
                 }
-                logjson("DEBUGMOD", "{\"nodeId\":%u,\"type\":\"send_max_message_response\", \"correctValues\":%u, \"expectedCorrectValues\":%u}" SEP, packet->header.sender, i, sizeof(message->data));
+                logjson("DEBUGMOD", "{\"nodeId\":%u,\"type\":\"send_max_message_response\", \"correctValues\":%u, \"expectedCorrectValues\":%u}" SEP, packet->header.sender, i, (u32)sizeof(message->data));
             }
             else if (actionType == DebugModuleActionResponseMessages::MEMORY) {
                 if (sendData->dataLength < SIZEOF_CONN_PACKET_MODULE + SIZEOF_DEBUG_MODULE_MEMORY_MESSAGE_HEADER) return;
@@ -1427,7 +1455,7 @@ void DebugModule::CauseStackOverflow() const
     {
         someDummyData[i] = 0x12;
     }
-    logt("MAIN", "Dummy data addr: %u", (u32)&someDummyData);
+    logt("MAIN", "Dummy data addr: %u", (u32)(uintptr_t)&someDummyData);
     CauseStackOverflow();
 }
 #ifdef __clang__
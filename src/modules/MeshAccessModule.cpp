@@ -120,6 +120,10 @@ void MeshAccessModule::TimerEventHandler(u16 passedTimeDs)
                 logt("MAMOD", "Removing ma conn due to SCHEDULED_REMOVE");
                 maConn->DisconnectAndRemove(AppDisconnectReason::SCHEDULED_REMOVE);
             }
+            else
+            {
+                maConn->PrecomputeKeystreams();
+            }
         }
     }
 }
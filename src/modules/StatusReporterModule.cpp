@@ -355,6 +355,35 @@ void StatusReporterModule::SendRebootReason(NodeId toNode, u8 requestHandle) con
         false
     );
 }
+void StatusReporterModule::SendRecordStorageStatus(NodeId toNode, u8 requestHandle) const
+{
+    const RecordStorageStatistics statistics = GS->recordStorage.GetStatistics();
+
+    DYNAMIC_ARRAY(buffer, SIZEOF_STATUS_REPORTER_MODULE_RECORD_STORAGE_STATUS_MESSAGE + RECORD_STORAGE_NUM_PAGES * sizeof(u16));
+    StatusReporterModuleRecordStorageStatusMessage* message = (StatusReporterModuleRecordStorageStatusMessage*)buffer;
+    message->liveSpace = statistics.liveSpace;
+    message->garbageSpace = statistics.garbageSpace;
+    message->freeSpace = statistics.freeSpace;
+    message->maxPageVersion = statistics.maxPageVersion;
+    message->numDefragmentations = statistics.numDefragmentations;
+    message->numIdleDefragmentations = statistics.numIdleDefragmentations;
+    message->numPages = RECORD_STORAGE_NUM_PAGES;
+    for (u32 i = 0; i < RECORD_STORAGE_NUM_PAGES; i++)
+    {
+        message->pageEraseCounters[i] = statistics.pageEraseCounters[i];
+    }
+
+    SendModuleActionMessage(
+        MessageType::MODULE_ACTION_RESPONSE,
+        toNode,
+        (u8)StatusModuleActionResponseMessages::RECORD_STORAGE_STATUS,
+        requestHandle,
+        buffer,
+        SIZEOF_STATUS_REPORTER_MODULE_RECORD_STORAGE_STATUS_MESSAGE + RECORD_STORAGE_NUM_PAGES * sizeof(u16),
+        false
+    );
+}
+
 void StatusReporterModule::SendErrors(NodeId toNode, u8 requestHandle) const{
 
     //Log another error so that we know the uptime of the node when the errors were requested
@@ -634,6 +663,20 @@ TerminalCommandHandlerReturnType StatusReporterModule::TerminalCommandHandler(co
                     false
                 );
 
+                return TerminalCommandHandlerReturnType::SUCCESS;
+            }
+            else if(TERMARGS(3, "get_record_storage"))
+            {
+                SendModuleActionMessage(
+                    MessageType::MODULE_TRIGGER_ACTION,
+                    destinationNode,
+                    (u8)StatusModuleTriggerActionMessages::GET_RECORD_STORAGE_STATUS,
+                    0,
+                    nullptr,
+                    0,
+                    false
+                );
+
                 return TerminalCommandHandlerReturnType::SUCCESS;
             }
         }
@@ -751,6 +794,11 @@ void StatusReporterModule::MeshMessageReceivedHandler(BaseConnection* connection
             {
                 SendRebootReason(packet->header.sender, packet->requestHandle);
             }
+            //Send back the record storage usage
+            else if(actionType == StatusModuleTriggerActionMessages::GET_RECORD_STORAGE_STATUS)
+            {
+                SendRecordStorageStatus(packet->header.sender, packet->requestHandle);
+            }
         }
     }
 
@@ -910,6 +958,19 @@ void StatusReporterModule::MeshMessageReceivedHandler(BaseConnection* connection
                 }
                 logjson("STATUSMOD", "]}" SEP);
             }
+            else if(actionType == StatusModuleActionResponseMessages::RECORD_STORAGE_STATUS && sendData->dataLength >= SIZEOF_CONN_PACKET_MODULE + SIZEOF_STATUS_REPORTER_MODULE_RECORD_STORAGE_STATUS_MESSAGE)
+            {
+                StatusReporterModuleRecordStorageStatusMessage const * data = (StatusReporterModuleRecordStorageStatusMessage const *) (packet->data);
+
+                logjson_partial("STATUSMOD", "{\"type\":\"record_storage_status\",\"nodeId\":%u,\"module\":%u,", packet->header.sender, (u8)ModuleId::STATUS_REPORTER_MODULE);
+                logjson_partial("STATUSMOD", "\"live\":%u,\"garbage\":%u,\"free\":%u,\"maxPageVersion\":%u,", data->liveSpace, data->garbageSpace, data->freeSpace, data->maxPageVersion);
+                logjson_partial("STATUSMOD", "\"defrags\":%u,\"idleDefrags\":%u,\"pageErases\":[", data->numDefragmentations, data->numIdleDefragmentations);
+                for(u8 i=0; i<data->numPages && SIZEOF_CONN_PACKET_MODULE + SIZEOF_STATUS_REPORTER_MODULE_RECORD_STORAGE_STATUS_MESSAGE + (i + 1) * sizeof(u16) <= sendData->dataLength; i++){
+                    //The separator is written before each counter as the list might end before numPages if the message was truncated
+                    logjson_partial("STATUSMOD", (i == 0) ? "%u" : ",%u", data->pageEraseCounters[i]);
+                }
+                logjson("STATUSMOD", "]}" SEP);
+            }
         }
     }
 
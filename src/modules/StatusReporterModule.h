@@ -167,6 +167,7 @@ public:
             GET_DEVICE_INFO_V2 = 10,
             SET_LIVEREPORTING = 11,
             GET_ALL_CONNECTIONS_VERBOSE = 12,
+            GET_RECORD_STORAGE_STATUS = 13,
         };
 
         enum class StatusModuleActionResponseMessages : u8
@@ -182,6 +183,7 @@ public:
             REBOOT_REASON = 8,
             DEVICE_INFO_V2 = 10,
             ALL_CONNECTIONS_VERBOSE = 12,
+            RECORD_STORAGE_STATUS = 13,
         };
 
         enum class StatusModuleGeneralMessages : u8
@@ -260,6 +262,22 @@ private:
             } StatusReporterModuleLiveReportMessage;
             STATIC_ASSERT_SIZE(StatusReporterModuleLiveReportMessage, 9);
 
+            //Reports the space usage and wear of the RecordStorage, followed by numPages u16 erase counters
+            static constexpr int SIZEOF_STATUS_REPORTER_MODULE_RECORD_STORAGE_STATUS_MESSAGE = 19;
+            typedef struct
+            {
+                u32 liveSpace;
+                u32 garbageSpace;
+                u32 freeSpace;
+                u16 maxPageVersion;
+                u16 numDefragmentations; //Since reboot
+                u16 numIdleDefragmentations; //Since reboot
+                u8 numPages;
+                u16 pageEraseCounters[1]; //Since reboot
+
+            } StatusReporterModuleRecordStorageStatusMessage;
+            STATIC_ASSERT_SIZE(StatusReporterModuleRecordStorageStatusMessage, SIZEOF_STATUS_REPORTER_MODULE_RECORD_STORAGE_STATUS_MESSAGE + 2);
+
         #pragma pack(pop)
 
         //####### Module messages end
@@ -280,6 +298,7 @@ private:
         void SendAllConnectionsVerbose(NodeId toNode, u8 requestHandle, u32 connectionIndex) const;
         void SendErrors(NodeId toNode, u8 requestHandle) const;
         void SendRebootReason(NodeId toNode, u8 requestHandle) const;
+        void SendRecordStorageStatus(NodeId toNode, u8 requestHandle) const;
 
         void StartConnectionRSSIMeasurement(MeshConnection& connection) const;
 
@@ -73,7 +73,7 @@ extern "C" {
 
 #ifdef SIM_ENABLED
 #include "StackWatcher.h"
-#define START_OF_FUNCTION() StackWatcher::Check(); if(cherrySimInstance != nullptr) {cherrySimInstance->SimulateInterrupts();}
+#define START_OF_FUNCTION() StackWatcher::Check(); if(cherrySimInstance != nullptr) {cherrySimInstance->SimulateScheduledInterrupts();}
 #else
 #define START_OF_FUNCTION
 #endif
@@ -66,6 +66,7 @@ void ChunkedPacketQueue::AddMessageRaw(u8* data, u16 size)
         }
         writeChunk->nextChunk = newChunk;
         writeChunk = newChunk;
+        amountOfChunks++;
         CheckedMemcpy(writeChunk->data.data(), data + sizeLeftInCurrentWriteChunk, size - sizeLeftInCurrentWriteChunk);
         writeChunk->amountOfByteInThisChunk += size - sizeLeftInCurrentWriteChunk;
         writeChunk->amountOfByteInThisChunk = Utility::NextMultipleOf(writeChunk->amountOfByteInThisChunk, sizeof(QueueEntryHeader));
@@ -164,6 +165,7 @@ ChunkedPacketQueue::ChunkedPacketQueue()
     readChunk = GS->connectionQueueMemoryAllocator.Allocate(true);
     writeChunk = readChunk;
     lookAheadChunk = readChunk;
+    if (readChunk) amountOfChunks = 1;
     if (!readChunk)
     {
         //This must never happen. If it does, it indicates an implementation error.
@@ -351,6 +353,7 @@ void ChunkedPacketQueue::PopPacket()
         readChunk = readChunk->nextChunk;
         if (needToMoveLookAhead) lookAheadChunk = readChunk;
         GS->connectionQueueMemoryAllocator.Deallocate(oldReadChunk);
+        amountOfChunks--;
         const u16 sizeRemovedFromFirstChunk = (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE > oldReadHead ? CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - oldReadHead : 0);
         if (sizeToPop > sizeRemovedFromFirstChunk)
         {
@@ -478,6 +481,11 @@ u32 ChunkedPacketQueue::GetAmountOfPackets() const
     return amountOfPackets;
 }
 
+u32 ChunkedPacketQueue::GetAmountOfChunks() const
+{
+    return amountOfChunks;
+}
+
 void ChunkedPacketQueue::Print() const
 {
     trace("Amount of Packets: %u" EOL, GetAmountOfPackets());
@@ -540,5 +548,6 @@ void ChunkedPacketQueue::SimReset()
     readChunk = GS->connectionQueueMemoryAllocator.Allocate(true);
     writeChunk = readChunk;
     lookAheadChunk = readChunk;
+    amountOfChunks = readChunk ? 1 : 0;
 }
 #endif
@@ -49,6 +49,7 @@ private:
     ConnectionQueueMemoryChunk* lookAheadChunk = nullptr;
     ConnectionQueueMemoryChunk* writeChunk     = nullptr;
     u32 amountOfPackets = 0;
+    u32 amountOfChunks = 0;
     bool isCurrentlySendingSplitMessage = false;
 
     struct QueueEntryHeader
@@ -96,6 +97,7 @@ public:
     bool IsRandomAccessIndexLookedAhead(u16 index) const;
 
     u32 GetAmountOfPackets() const;
+    u32 GetAmountOfChunks() const;
     void Print() const;
 
     DeliveryPriority GetPriority() const;
@@ -77,6 +77,19 @@ ChunkedPriorityPacketQueue::ChunkedPriorityPacketQueue()
 }
 
 bool ChunkedPriorityPacketQueue::SplitAndAddMessage(DeliveryPriority prio, u8* data, u16 size, u16 payloadSizePerSplit)
+{
+    const bool retVal = SplitAndAddMessageToQueue(prio, data, size, payloadSizePerSplit);
+    if (retVal)
+    {
+        const u32 amountOfPackets = GetAmountOfPackets();
+        const u32 amountOfChunks = GetAmountOfChunks();
+        if (amountOfPackets > maxAmountOfPackets) maxAmountOfPackets = amountOfPackets;
+        if (amountOfChunks > maxAmountOfChunks) maxAmountOfChunks = amountOfChunks;
+    }
+    return retVal;
+}
+
+bool ChunkedPriorityPacketQueue::SplitAndAddMessageToQueue(DeliveryPriority prio, u8* data, u16 size, u16 payloadSizePerSplit)
 {
     if ((u32)prio >= AMOUNT_OF_SEND_QUEUE_PRIORITIES)
     {
@@ -117,6 +130,26 @@ u32 ChunkedPriorityPacketQueue::GetAmountOfPackets() const
     return retVal;
 }
 
+u32 ChunkedPriorityPacketQueue::GetAmountOfChunks() const
+{
+    u32 retVal = 0;
+    for (u32 i = 0; i < queues.size(); i++)
+    {
+        retVal += queues[i].GetAmountOfChunks();
+    }
+    return retVal;
+}
+
+u32 ChunkedPriorityPacketQueue::GetMaxAmountOfPackets() const
+{
+    return maxAmountOfPackets;
+}
+
+u32 ChunkedPriorityPacketQueue::GetMaxAmountOfChunks() const
+{
+    return maxAmountOfChunks;
+}
+
 bool ChunkedPriorityPacketQueue::IsCurrentlySendingSplitMessage() const
 {
     return GetSplitQueue().queue != nullptr;
@@ -55,15 +55,22 @@ class ChunkedPriorityPacketQueue
 private:
     std::array<ChunkedPacketQueue, AMOUNT_OF_SEND_QUEUE_PRIORITIES> queues = {};
     std::array<u32,                AMOUNT_OF_SEND_QUEUE_PRIORITIES> priorityDroplets = {};
+    //High-water marks over the lifetime of the connection
+    u32 maxAmountOfPackets = 0;
+    u32 maxAmountOfChunks = 0;
 
     QueuePriorityPair GetSplitQueue();
     QueuePriorityPairConst GetSplitQueue() const;
+    bool SplitAndAddMessageToQueue(DeliveryPriority prio, u8* data, u16 size, u16 payloadSizePerSplit);
 
 public:
     ChunkedPriorityPacketQueue();
 
     bool SplitAndAddMessage(DeliveryPriority prio, u8* data, u16 size, u16 payloadSizePerSplit);
     u32 GetAmountOfPackets() const;
+    u32 GetAmountOfChunks() const;
+    u32 GetMaxAmountOfPackets() const;
+    u32 GetMaxAmountOfChunks() const;
     bool IsCurrentlySendingSplitMessage() const;
     QueuePriorityPair GetSendQueue();
     ChunkedPacketQueue* GetQueueByPriority(DeliveryPriority prio);
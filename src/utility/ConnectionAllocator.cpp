@@ -33,6 +33,11 @@
 
 ConnectionAllocator::ConnectionAllocator()
 {
+    //The allocator relies on free entries being zero after the free list pointer. The constructor of
+    //AnyConnection does not initialize anything and in the simulator the memory might still contain the
+    //connections of the previous boot if the node was reset while it was connected.
+    // cppcheck-suppress memsetClass
+    CheckedMemset(data.data(), 0, sizeof(data));
     for (unsigned i = 0; i < data.size() - 1; i++) {
         data[i].nextConnection = data.data() + (i + 1);
     }
@@ -53,13 +58,19 @@ ConnectionAllocator::AnyConnection * ConnectionAllocator::AllocateMemory()
         GS->logger.LogCustomError(CustomErrorTypes::FATAL_CONNECTION_ALLOCATOR_OUT_OF_MEMORY, 0); //LCOV_EXCL_LINE assertion
         return nullptr;                                                                           //LCOV_EXCL_LINE assertion
     }
-    AnyConnection* oldHead = dataHead; 
-    static_assert(sizeof(void*) == 4, "Only 32 bit supported!");
+    AnyConnection* oldHead = dataHead;
+    //The free list pointer must occupy exactly the first sizeof(void*) bytes so that the rest of a free entry is zero.
+    static_assert(sizeof(void*) == 4 || sizeof(void*) == 8, "Only 32 and 64 bit supported!");
+    static_assert(sizeof(AnyConnection::nextConnection) == sizeof(void*), "nextConnection must be pointer sized!");
+    static_assert(sizeof(AnyConnection) % sizeof(void*) == 0, "AnyConnection must be pointer aligned!");
     if (!Utility::CompareMem(0x00, (u8*)oldHead + sizeof(void*), sizeof(AnyConnection) - sizeof(void*))) {
         SIMEXCEPTION(MemoryCorruptionException); //LCOV_EXCL_LINE assertion
     }
     dataHead = dataHead->nextConnection;
     oldHead->nextConnection = 0;
+
+    amountOfAllocatedConnections++;
+    if (amountOfAllocatedConnections > maxAmountOfAllocatedConnections) maxAmountOfAllocatedConnections = amountOfAllocatedConnections;
     
     return oldHead;
 }
@@ -116,4 +127,15 @@ void ConnectionAllocator::Deallocate(BaseConnection * bc)
     AnyConnection* ac = reinterpret_cast<AnyConnection*>(bc);
     ac->nextConnection = dataHead;
     dataHead = ac;
+    amountOfAllocatedConnections--;
+}
+
+u32 ConnectionAllocator::GetAmountOfAllocatedConnections() const
+{
+    return amountOfAllocatedConnections;
+}
+
+u32 ConnectionAllocator::GetMaxAmountOfAllocatedConnections() const
+{
+    return maxAmountOfAllocatedConnections;
 }
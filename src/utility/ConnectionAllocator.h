@@ -67,6 +67,8 @@ private:
     static constexpr AnyConnection* NO_NEXT_CONNECTION = nullptr;
     std::array<AnyConnection, TOTAL_NUM_CONNECTIONS + 1> data{};    //Max + one resolver connection.
     AnyConnection* dataHead = NO_NEXT_CONNECTION;
+    u32 amountOfAllocatedConnections = 0;
+    u32 maxAmountOfAllocatedConnections = 0;
 
     AnyConnection* AllocateMemory();
 
@@ -86,4 +88,11 @@ public:
 #endif
 
     void Deallocate(BaseConnection* bc);
+
+    u32 GetAmountOfAllocatedConnections() const;
+    u32 GetMaxAmountOfAllocatedConnections() const;
+    static constexpr u32 GetPoolSize()
+    {
+        return TOTAL_NUM_CONNECTIONS + 1;
+    }
 };
@@ -79,6 +79,7 @@ ConnectionQueueMemoryChunk* ConnectionQueueMemoryAllocator::Allocate(bool isNewC
     retVal->currentlyOwnedByAllocator = false;
 #endif
     chunksLeft--;
+    if (chunksLeft < minChunksLeft) minChunksLeft = chunksLeft;
     return retVal;
 }
 
@@ -137,6 +138,16 @@ bool ConnectionQueueMemoryAllocator::IsChunkAvailable(bool isNewConnection, u32
     return true;
 }
 
+u32 ConnectionQueueMemoryAllocator::GetAmountOfUsedChunks() const
+{
+    return CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT - chunksLeft;
+}
+
+u32 ConnectionQueueMemoryAllocator::GetMaxAmountOfUsedChunks() const
+{
+    return CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT - minChunksLeft;
+}
+
 void ConnectionQueueMemoryChunk::Reset()
 {
     data = {};
@@ -70,6 +70,7 @@ private:
     std::array<ConnectionQueueMemoryChunk, CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT> chunks{};
     ConnectionQueueMemoryChunk* head = nullptr;
     u32 chunksLeft = CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT;
+    u32 minChunksLeft = CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT;
 
 public:
     ConnectionQueueMemoryAllocator();
@@ -77,4 +78,7 @@ public:
     ConnectionQueueMemoryChunk* Allocate(bool isNewConnection = false);
     void Deallocate(ConnectionQueueMemoryChunk* chunk);
     bool IsChunkAvailable(bool isNewConnection = false, u32 amountOfChunks = 1) const;
+
+    u32 GetAmountOfUsedChunks() const;
+    u32 GetMaxAmountOfUsedChunks() const;
 };
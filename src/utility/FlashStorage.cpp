@@ -97,7 +97,7 @@ FlashStorageError FlashStorage::ErasePages(u16 startPage, u16 numPages, FlashSto
 
 FlashStorageError FlashStorage::WriteData(u32* source, u32* destination, u16 length, FlashStorageEventListener* callback, u32 userType, u32 extraInfo)
 {
-    logt("FLASH", "Queue Write %u to %u (%u)", (u32)source, (u32)destination, length);
+    logt("FLASH", "Queue Write %u to %u (%u)", (u32)(uintptr_t)source, (u32)(uintptr_t)destination, length);
 
     FlashStorageTaskItem task;
     CheckedMemset(&task, 0, sizeof(FlashStorageTaskItem));
@@ -121,7 +121,7 @@ FlashStorageError FlashStorage::WriteData(u32* source, u32* destination, u16 len
 
 FlashStorageError FlashStorage::CacheAndWriteData(u32 const * source, u32* destination, u16 length, FlashStorageEventListener* callback, u32 userType, u32 extraInfo)
 {
-    logt("FLASH", "Queue CachedWrite %u to %u (%u)", (u32)source, (u32)destination, length);
+    logt("FLASH", "Queue CachedWrite %u to %u (%u)", (u32)(uintptr_t)source, (u32)(uintptr_t)destination, length);
 
     // Items that are bigger than the half size of the queue are not guaranteed to fit into an empty queue.
     if(length + SIZEOF_FLASH_STORAGE_TASK_ITEM_WRITE_CACHED_DATA > FLASH_STORAGE_QUEUE_SIZE / 2){
@@ -236,7 +236,7 @@ void FlashStorage::ProcessQueue(bool continueCurrentTask)
     else if (currentTask->header.command == FlashStorageCommand::WRITE_DATA) {
         FlashStorageTaskItemWriteData* params = &currentTask->params.writeData;
 
-        logt("FLASH", "copy from %u to %u, length %u", (u32)params->dataSource, (u32)params->dataDestination, params->dataLength / 4);
+        logt("FLASH", "copy from %u to %u, length %u", (u32)(uintptr_t)params->dataSource, (u32)(uintptr_t)params->dataDestination, params->dataLength / 4);
 
         err = FruityHal::FlashWrite(params->dataDestination, params->dataSource, params->dataLength / 4); //FIXME: NRF_ERROR_BUSY and others not handeled
     }
@@ -245,7 +245,7 @@ void FlashStorage::ProcessQueue(bool continueCurrentTask)
 
         u8 padding = (4-params->dataLength%4)%4;
 
-        logt("FLASH", "copy cached data to %u, length %u", (u32)params->dataDestination, params->dataLength);
+        logt("FLASH", "copy cached data to %u, length %u", (u32)(uintptr_t)params->dataDestination, params->dataLength);
 
         err = FruityHal::FlashWrite(params->dataDestination, (u32*)params->data, (params->dataLength+padding) / 4); //FIXME: NRF_ERROR_BUSY and others not handeled
     }
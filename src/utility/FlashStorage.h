@@ -54,7 +54,8 @@ enum class FlashStorageCommand : u8 {
 #pragma pack(push)
 #pragma pack(1)
 
-constexpr int SIZEOF_FLASH_STORAGE_TASK_ITEM_HEADER = 16;
+//Task items are only kept in RAM, so their size depends on the size of a pointer (4 on the nodes, 8 in a 64 bit simulator)
+constexpr int SIZEOF_FLASH_STORAGE_TASK_ITEM_HEADER = 12 + sizeof(void*);
 struct FlashStorageTaskItemHeader
 {
     FlashStorageCommand command;
@@ -65,16 +66,16 @@ struct FlashStorageTaskItemHeader
 };
 STATIC_ASSERT_SIZE(FlashStorageTaskItemHeader, SIZEOF_FLASH_STORAGE_TASK_ITEM_HEADER);
 
-constexpr int SIZEOF_FLASH_STORAGE_TASK_ITEM_WRITE_DATA = (SIZEOF_FLASH_STORAGE_TASK_ITEM_HEADER + 10);
+constexpr int SIZEOF_FLASH_STORAGE_TASK_ITEM_WRITE_DATA = (SIZEOF_FLASH_STORAGE_TASK_ITEM_HEADER + 2 * sizeof(void*) + 2);
 struct FlashStorageTaskItemWriteData
 {
     u32* dataSource;
     u32* dataDestination;
     u16 dataLength;
 };
-STATIC_ASSERT_SIZE(FlashStorageTaskItemWriteData, 10);
+STATIC_ASSERT_SIZE(FlashStorageTaskItemWriteData, 2 * sizeof(void*) + 2);
 
-constexpr int SIZEOF_FLASH_STORAGE_TASK_ITEM_WRITE_CACHED_DATA = (SIZEOF_FLASH_STORAGE_TASK_ITEM_HEADER + 8);
+constexpr int SIZEOF_FLASH_STORAGE_TASK_ITEM_WRITE_CACHED_DATA = (SIZEOF_FLASH_STORAGE_TASK_ITEM_HEADER + sizeof(void*) + 4);
 struct FlashStorageTaskItemWriteCachedData
 {
     u32* dataDestination;
@@ -84,7 +85,7 @@ struct FlashStorageTaskItemWriteCachedData
 };
 //We should pay attention that the data pointer is saved at a word aligned address so we can directly write to flash from this pointer
 static_assert(offsetof(FlashStorageTaskItemWriteCachedData, data) % sizeof(u32) == 0, "Payload offset must be word aligned.");
-STATIC_ASSERT_SIZE(FlashStorageTaskItemWriteCachedData, 9);
+STATIC_ASSERT_SIZE(FlashStorageTaskItemWriteCachedData, sizeof(void*) + 5);
 
 constexpr int SIZEOF_FLASH_STORAGE_TASK_ITEM_ERASE_PAGES = (SIZEOF_FLASH_STORAGE_TASK_ITEM_HEADER + 4);
 struct FlashStorageTaskItemErasePages
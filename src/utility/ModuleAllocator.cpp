@@ -52,6 +52,11 @@ u32 ModuleAllocator::GetMemorySize()
     return this->startSize;
 }
 
+u32 ModuleAllocator::GetUsedMemorySize() const
+{
+    return this->startSize - this->sizeLeft;
+}
+
 void * ModuleAllocator::AllocateMemory(u32 size)
 {
     if (sizeLeft < size)
@@ -51,6 +51,8 @@ public:
     void SetMemory(u8 *block, u32 size);
 
     u32 GetMemorySize();
+    //As memory is never given back, this is also the high-water mark
+    u32 GetUsedMemorySize() const;
 
     void* AllocateMemory(u32 size);
 };
@@ -37,6 +37,9 @@
  * This listener will be passed the userType and in some cases, it is even possible to store some
  * userData that will also be returned after the end of the operation.
  *
+ * CommitBatch combines multiple saves and deactivations so that the storage is defragmented at most once,
+ * all saved records are written contiguously and the listener is only called once for the whole batch.
+ *
  * GetRecordData is synchronous and will return the requested data immediately if available.
  *
  * Each record is stored using a recordId and only the latest version of a Record is accessable.
@@ -72,7 +75,9 @@
 #include <GlobalState.h>
 #include <FruityHal.h>
 
-#define TO_PAGE(addr) (u32)(((((u32)(addr)) - FLASH_REGION_START_ADDRESS)/FruityHal::GetCodePageSize()))
+static_assert(RECORD_STORAGE_NUM_PAGES <= RECORD_STORAGE_MAX_NUM_STATISTICS_PAGES, "Too many pages for the erase statistics");
+
+#define TO_PAGE(addr) (u32)(((((uintptr_t)(addr)) - FLASH_REGION_START_ADDRESS)/FruityHal::GetCodePageSize()))
 
 RecordStorage::RecordStorage()
     : opQueue(opBuffer, RECORD_STORAGE_QUEUE_SIZE)
@@ -167,6 +172,79 @@ RecordStorageResultCode RecordStorage::DeactivateRecord(u16 recordId, RecordStor
     }
 }
 
+RecordStorageResultCode RecordStorage::CommitBatch(const RecordStorageBatchItem* items, u8 numItems, RecordStorageEventListener* callback, u32 userType, ModuleIdWrapper lockDownModule)
+{
+    return RecordStorage::CommitBatch(items, numItems, callback, userType, nullptr, 0, lockDownModule);
+}
+
+RecordStorageResultCode RecordStorage::CommitBatch(const RecordStorageBatchItem* items, u8 numItems, RecordStorageEventListener* callback, u32 userType, u8* userData, u16 userDataLength, ModuleIdWrapper lockDownModule)
+{
+    if (recordStorageLockDown && lockDownModule != lockDownModuleId)
+    {
+        SIMEXCEPTION(RecordStorageIsLockedDownException);
+        return RecordStorageResultCode::RECORD_STORAGE_LOCK_DOWN;
+    }
+
+    //Calculate the space that all entries need in the queue
+    u32 entriesLength = 0;
+    for (u32 i = 0; i < numItems; i++)
+    {
+        if (items[i].type == RecordStorageOperationType::SAVE_RECORD)
+        {
+            entriesLength += SIZEOF_RECORD_STORAGE_BATCH_ENTRY + items[i].dataLength;
+        }
+        else if (items[i].type == RecordStorageOperationType::DEACTIVATE_RECORD)
+        {
+            entriesLength += SIZEOF_RECORD_STORAGE_BATCH_ENTRY;
+        }
+        else
+        {
+            SIMEXCEPTION(IllegalArgumentException);
+            return RecordStorageResultCode::INTERNAL_ERROR;
+        }
+    }
+
+    //A batch that is bigger than the whole queue can never be stored
+    if (SIZEOF_RECORD_STORAGE_BATCH_OP + entriesLength + userDataLength > RECORD_STORAGE_QUEUE_SIZE)
+    {
+        return RecordStorageResultCode::NO_SPACE;
+    }
+
+    //Cache the operation to be processed later
+    u8* buffer = opQueue.Reserve(SIZEOF_RECORD_STORAGE_BATCH_OP + entriesLength + userDataLength);
+
+    if (buffer != nullptr) {
+        BatchRecordOperation* op = (BatchRecordOperation*)buffer;
+        op->op.type = (u8)RecordStorageOperationType::BATCH;
+        op->op.callback = callback;
+        op->op.userType = userType;
+        op->op.userDataLength = userDataLength;
+        op->op.flashStorageErrorCode = FlashStorageError::SUCCESS;
+        op->stage = RecordStorageSaveStage::FIRST_STAGE;
+        op->numEntries = numItems;
+        op->numPendingWrites = 0;
+        op->entriesLength = entriesLength;
+
+        BatchRecordEntry* entry = (BatchRecordEntry*)op->data;
+        for (u32 i = 0; i < numItems; i++)
+        {
+            entry->type = items[i].type;
+            entry->recordId = items[i].recordId;
+            entry->dataLength = items[i].type == RecordStorageOperationType::SAVE_RECORD ? items[i].dataLength : 0;
+            if (entry->dataLength > 0) CheckedMemcpy(entry->data, items[i].data, entry->dataLength);
+
+            entry = (BatchRecordEntry*)((u8*)entry + SIZEOF_RECORD_STORAGE_BATCH_ENTRY + entry->dataLength);
+        }
+        if (userData != nullptr) CheckedMemcpy(buffer + (SIZEOF_RECORD_STORAGE_BATCH_OP + entriesLength), userData, userDataLength);
+
+        ProcessQueue(false);
+        return RecordStorageResultCode::SUCCESS;
+    }
+    else {
+        return RecordStorageResultCode::BUSY;
+    }
+}
+
 /* ######################
 # Public functions that allow write access
 ######################### */
@@ -256,7 +334,7 @@ void RecordStorage::SaveRecordInternal(SaveRecordOperation& op)
             for (u32 i = 0; i < RECORD_STORAGE_NUM_PAGES; i++) {
                 RecordStoragePage& page = getPage(i);
                 u16 freeSpaceAfterDefragment = GetFreeSpaceWhenDefragmented(page);
-                logt("ERROR", "freeSpace in page %u: %u", ((u32)&page - (u32)FLASH_REGION_START_ADDRESS) / (u32)FruityHal::GetCodePageSize(), freeSpaceAfterDefragment);
+                logt("ERROR", "freeSpace in page %u: %u", TO_PAGE(&page), freeSpaceAfterDefragment);
             }
 
             return RecordOperationFinished(op.op, RecordStorageResultCode::NO_SPACE);
@@ -301,6 +379,140 @@ void RecordStorage::DeactivateRecordInternal(DeactivateRecordOperation& op)
     }
 }
 
+//A batch writes all saved records contiguously with a single flash write and applies deactivations
+//in place afterwards. If a recordId is used multiple times within a batch, only its last entry is executed.
+void RecordStorage::CommitBatchInternal(BatchRecordOperation& op)
+{
+    //Every flash task of the batch notifies us, we must wait until the last one has executed
+    if (op.numPendingWrites > 0) {
+        return;
+    }
+
+    //If any of the previous operations failed, call the callback with an error code
+    if (op.op.flashStorageErrorCode != FlashStorageError::SUCCESS) {
+        return RecordOperationFinished(op.op, RecordStorageResultCode::BUSY);
+    }
+
+    if (op.stage == RecordStorageSaveStage::DEFRAGMENT_IF_NEEDED) {
+        logt("RS", "CommitBatch num %u, len %u", op.numEntries, op.entriesLength);
+
+        u16 batchRecordLength = GetBatchRecordLength(op);
+
+        //Defragment at most once for the whole batch if the records do not fit
+        if (batchRecordLength > 0 && GetFreeRecordSpace(batchRecordLength) == nullptr) {
+            RecordStoragePage* pageToDefragment = FindPageToDefragment();
+            if (pageToDefragment != nullptr) {
+                op.stage = RecordStorageSaveStage::SAVE;
+                return DefragmentPage(*pageToDefragment, false);
+            }
+        }
+
+        op.stage = RecordStorageSaveStage::SAVE;
+    }
+
+    if (op.stage == RecordStorageSaveStage::SAVE) {
+        u16 batchRecordLength = GetBatchRecordLength(op);
+
+        u8* freeSpace = nullptr;
+        if (batchRecordLength > 0) {
+            freeSpace = GetFreeRecordSpace(batchRecordLength);
+            if (freeSpace == nullptr) {
+                logt("ERROR", "no space in RS");
+                GS->logger.LogCustomError(CustomErrorTypes::FATAL_NO_RECORDSTORAGE_SPACE_LEFT, batchRecordLength);
+                return RecordOperationFinished(op.op, RecordStorageResultCode::NO_SPACE);
+            }
+        }
+
+        //Build all records in a single buffer
+        DYNAMIC_ARRAY(buffer, batchRecordLength == 0 ? 1 : batchRecordLength);
+        CheckedMemset(buffer, 0xFF, batchRecordLength);
+        u16 bufferOffset = 0;
+        u32 numDeactivations = 0;
+
+        const BatchRecordEntry* entry = (const BatchRecordEntry*)op.data;
+        for (u32 i = 0; i < op.numEntries; i++)
+        {
+            u16 recordLength = GetBatchEntryRecordLength(op, *entry);
+            if (recordLength > 0)
+            {
+                RecordStorageRecord* oldRecord = GetRecord(entry->recordId);
+
+                if (entry->type == RecordStorageOperationType::SAVE_RECORD)
+                {
+                    //Currently, we only support updating a record up to 65000 times
+                    if (oldRecord != nullptr && oldRecord->versionCounter == UINT16_MAX) {
+                        return RecordOperationFinished(op.op, RecordStorageResultCode::NO_SPACE);
+                    }
+
+                    RecordStorageRecord* newRecord = (RecordStorageRecord*)(buffer + bufferOffset);
+                    newRecord->recordActive = 1;
+                    newRecord->padding = (4 - entry->dataLength % 4) % 4;
+                    newRecord->recordLength = recordLength;
+                    newRecord->recordId = entry->recordId;
+                    newRecord->versionCounter = oldRecord == nullptr ? 1 : oldRecord->versionCounter + 1;
+                    CheckedMemcpy(newRecord->data, entry->data, entry->dataLength);
+                    newRecord->crc = Utility::CalculateCrc8(((u8*)newRecord) + 2, newRecord->recordLength - 2);
+
+                    bufferOffset += recordLength;
+                }
+                else
+                {
+                    numDeactivations++;
+                }
+            }
+            entry = (const BatchRecordEntry*)((const u8*)entry + SIZEOF_RECORD_STORAGE_BATCH_ENTRY + entry->dataLength);
+        }
+
+        op.stage = RecordStorageSaveStage::CALLBACKS_AND_FINISH;
+
+        //Nothing changed, so we do not need to write to flash
+        if (batchRecordLength == 0 && numDeactivations == 0) {
+            return RecordOperationFinished(op.op, RecordStorageResultCode::SUCCESS);
+        }
+
+        //Each flash task notifies us, the first error is kept and reported once all of them have executed.
+        //All tasks are counted upfront as the flash might notify us before CacheAndWriteData returns.
+        op.numPendingWrites = (batchRecordLength > 0 ? 1 : 0) + numDeactivations;
+        u32 numTasksToQueue = op.numPendingWrites;
+        FlashStorageError queueError = FlashStorageError::SUCCESS;
+
+        if (batchRecordLength > 0) {
+            numTasksToQueue--;
+            queueError = GS->flashStorage.CacheAndWriteData((u32*)buffer, (u32*)freeSpace, batchRecordLength, this, (u32)FlashUserTypes::DEFAULT);
+        }
+
+        entry = (const BatchRecordEntry*)op.data;
+        for (u32 i = 0; numTasksToQueue > 0 && queueError == FlashStorageError::SUCCESS && i < op.numEntries; i++)
+        {
+            if (entry->type == RecordStorageOperationType::DEACTIVATE_RECORD && GetBatchEntryRecordLength(op, *entry) > 0)
+            {
+                RecordStorageRecord newRecordHeader;
+                CheckedMemset(&newRecordHeader, 0xFF, SIZEOF_RECORD_STORAGE_RECORD_HEADER);
+                newRecordHeader.recordActive = 0;
+
+                numTasksToQueue--;
+                queueError = GS->flashStorage.CacheAndWriteData((u32*)&newRecordHeader, (u32*)GetRecord(entry->recordId), SIZEOF_RECORD_STORAGE_RECORD_HEADER, this, (u32)FlashUserTypes::DEFAULT);
+            }
+            entry = (const BatchRecordEntry*)((const u8*)entry + SIZEOF_RECORD_STORAGE_BATCH_ENTRY + entry->dataLength);
+        }
+
+        //The failed task and all that were not queued afterwards will never notify us
+        if (queueError != FlashStorageError::SUCCESS) {
+            op.op.flashStorageErrorCode = queueError;
+            op.numPendingWrites -= numTasksToQueue + 1;
+            if (op.numPendingWrites == 0) {
+                return RecordOperationFinished(op.op, RecordStorageResultCode::BUSY);
+            }
+        }
+        return;
+    }
+
+    if (op.stage == RecordStorageSaveStage::CALLBACKS_AND_FINISH)
+    {
+        return RecordOperationFinished(op.op, RecordStorageResultCode::SUCCESS);
+    }
+}
+
 RecordStorageResultCode RecordStorage::LockDownAndClearAllSettings(ModuleIdWrapper responsibleModuleForShutDown, RecordStorageEventListener * callback, u32 userType)
 {
     //Check if we already have locked down
@@ -322,6 +534,10 @@ RecordStorageResultCode RecordStorage::LockDownAndClearAllSettings(ModuleIdWrapp
     FlashStorageError flashRetVal = GS->flashStorage.ErasePages(TO_PAGE(startPage), RECORD_STORAGE_NUM_PAGES, this, (u32)FlashUserTypes::LOCK_DOWN);
     if (flashRetVal == FlashStorageError::SUCCESS)
     {
+        for (u32 i = 0; i < RECORD_STORAGE_NUM_PAGES; i++)
+        {
+            pageEraseCounters[i]++;
+        }
         recordStorageLockDown = true;
         return RecordStorageResultCode::SUCCESS;
     }
@@ -359,7 +575,7 @@ void RecordStorage::RepairPages()
             RecordStoragePageState pageState = GetPageState(page);
 
             if (pageState == RecordStoragePageState::CORRUPT) {
-                GS->flashStorage.ErasePage(((u32)&page - FLASH_REGION_START_ADDRESS) / FruityHal::GetCodePageSize(), nullptr, (u32)FlashUserTypes::DEFAULT);
+                ErasePage(page, nullptr);
                 return;
             }
         }
@@ -386,7 +602,7 @@ void RecordStorage::RepairPages()
             }
 
             //Clear the swap page
-            GS->flashStorage.ErasePage(((u32)swapPage - FLASH_REGION_START_ADDRESS) / FruityHal::GetCodePageSize(), nullptr, (u32)FlashUserTypes::DEFAULT);
+            ErasePage(*swapPage, nullptr);
             return;
         }
 
@@ -443,7 +659,7 @@ void RecordStorage::RepairPages()
 
                 //Now, we must check that the rest of the page is clean
                 u32* pageData = (u32*)&page;
-                u32 freeSpaceOffset = ((u32)record) - ((u32)pageData);
+                u32 freeSpaceOffset = (u32)(((u8*)record) - ((u8*)pageData));
                 for(u32 j=freeSpaceOffset; j<FruityHal::GetCodePageSize(); j+=sizeof(u32)){
                     if(pageData[j/4] != 0xFFFFFFFF){
                         repairStage = RepairStage::FINALIZE;
@@ -508,7 +724,8 @@ void RecordStorage::DefragmentPage(RecordStoragePage& pageToDefragment, bool for
             return;
         }
 
-        logt("RS", "Defragmenting Page %u (free %u, after %u)", ((u32)defragmentPage - (u32)FLASH_REGION_START_ADDRESS) / (u32)FruityHal::GetCodePageSize(), GetFreeSpaceOnPage(*defragmentPage), GetFreeSpaceWhenDefragmented(*defragmentPage));
+        logt("RS", "Defragmenting Page %u (free %u, after %u)", TO_PAGE(defragmentPage), GetFreeSpaceOnPage(*defragmentPage), GetFreeSpaceWhenDefragmented(*defragmentPage));
+        numDefragmentations++;
     }
 
     //If there are items in the flashStorage queue, we wait until we get called after the queue is empty
@@ -542,7 +759,7 @@ void RecordStorage::DefragmentPage(RecordStoragePage& pageToDefragment, bool for
                 }
                 //If the record was not found on the swap page, we must move it
                 if (!found) {
-                    logt("RS", "Moving record %u", (u32)record);
+                    logt("RS", "Moving record %u", record->recordId);
                     GS->flashStorage.CacheAndWriteData((u32*)record, (u32*)freeSpacePtr, record->recordLength, nullptr, (u32)FlashUserTypes::DEFAULT);
                     return;
                 }
@@ -591,7 +808,7 @@ void RecordStorage::DefragmentPage(RecordStoragePage& pageToDefragment, bool for
     else if (defragmentationStage == DefragmentationStage::ERASE_OLD_PAGE)
     {
         //Finally, erase the page that we just swapped
-        GS->flashStorage.ErasePage(((u32)defragmentPage - FLASH_REGION_START_ADDRESS) / FruityHal::GetCodePageSize(), this, (u32)FlashUserTypes::DEFAULT);
+        ErasePage(*defragmentPage, this);
 
         defragmentationStage = DefragmentationStage::FINALIZE;
     }
@@ -605,6 +822,92 @@ void RecordStorage::DefragmentPage(RecordStoragePage& pageToDefragment, bool for
 }
 
 
+void RecordStorage::ErasePage(RecordStoragePage& page, FlashStorageEventListener* callback)
+{
+    pageEraseCounters[((u8*)&page - startPage) / FruityHal::GetCodePageSize()]++;
+
+    GS->flashStorage.ErasePage(TO_PAGE(&page), callback, (u32)FlashUserTypes::DEFAULT);
+}
+
+void RecordStorage::TimerEventHandler(u16 passedTimeDs)
+{
+    timeSinceIdleDefragmentationCheckDs += passedTimeDs;
+    if (timeSinceIdleDefragmentationCheckDs >= RECORD_STORAGE_IDLE_DEFRAGMENTATION_CHECK_INTERVAL_DS)
+    {
+        timeSinceIdleDefragmentationCheckDs = 0;
+        DefragmentIfIdle();
+    }
+}
+
+//Defragmenting while nothing else happens means that saves rarely have to wait for a defragmentation.
+//To not wear out the flash, we only defragment once the garbage exceeds the configured percentage and
+//the remaining free space has become smaller than the space that would be reclaimed, which means that
+//a save would soon have to defragment anyway.
+bool RecordStorage::DefragmentIfIdle()
+{
+    if (RECORD_STORAGE_IDLE_DEFRAGMENTATION_GARBAGE_PERCENTAGE == 0) return false;
+
+    //The storage and the mesh must be quiet
+    if (!isInit
+        || recordStorageLockDown
+        || opQueue._numElements > 0
+        || repairStage != RepairStage::NO_REPAIR
+        || defragmentationStage != DefragmentationStage::NO_DEFRAGMENTATION
+        || GS->flashStorage.GetNumberOfActiveTasks() != 0
+        || GS->cm.GetPendingPackets() != 0
+    ) {
+        return false;
+    }
+
+    const RecordStorageStatistics statistics = GetStatistics();
+    const u32 totalSpace = statistics.liveSpace + statistics.garbageSpace + statistics.freeSpace;
+    if (totalSpace == 0
+        || statistics.garbageSpace * 100 < totalSpace * RECORD_STORAGE_IDLE_DEFRAGMENTATION_GARBAGE_PERCENTAGE
+        || statistics.freeSpace > statistics.garbageSpace
+    ) {
+        return false;
+    }
+
+    RecordStoragePage* pageToDefragment = FindPageToDefragment();
+    if (pageToDefragment == nullptr) return false;
+
+    logt("RS", "Idle defragmentation (garbage %u, free %u)", statistics.garbageSpace, statistics.freeSpace);
+
+    const u16 numDefragmentationsBefore = numDefragmentations;
+    DefragmentPage(*pageToDefragment, false);
+    if (numDefragmentations == numDefragmentationsBefore) return false;
+
+    numIdleDefragmentations++;
+    return true;
+}
+
+RecordStorageStatistics RecordStorage::GetStatistics() const
+{
+    RecordStorageStatistics statistics;
+    CheckedMemset(&statistics, 0, sizeof(statistics));
+
+    for (u32 i = 0; i < RECORD_STORAGE_NUM_PAGES; i++)
+    {
+        RecordStoragePage& page = getPage(i);
+        if (GetPageState(page) == RecordStoragePageState::ACTIVE)
+        {
+            const u16 freeSpace = GetFreeSpaceOnPage(page);
+            const u16 freeSpaceWhenDefragmented = GetFreeSpaceWhenDefragmented(page);
+
+            statistics.freeSpace += freeSpace;
+            statistics.garbageSpace += freeSpaceWhenDefragmented - freeSpace;
+            statistics.liveSpace += FruityHal::GetCodePageSize() - SIZEOF_RECORD_STORAGE_PAGE_HEADER - freeSpaceWhenDefragmented;
+
+            if (page.versionCounter > statistics.maxPageVersion) statistics.maxPageVersion = page.versionCounter;
+        }
+        statistics.pageEraseCounters[i] = pageEraseCounters[i];
+    }
+    statistics.numDefragmentations = numDefragmentations;
+    statistics.numIdleDefragmentations = numIdleDefragmentations;
+
+    return statistics;
+}
+
 /*##################################### 
 # Various functions to read and helpers
 ##################################### */
@@ -646,6 +949,21 @@ void RecordStorage::ExecuteCallback(RecordStorageOperation & op, RecordStorageRe
             DeactivateRecordOperation* dop = (DeactivateRecordOperation*)&op;
             op.callback->RecordStorageEventHandler(dop->recordId, code, op.userType, ((u8*)&op) + SIZEOF_RECORD_STORAGE_DEACTIVATE_RECORD_OP, op.userDataLength);
         }
+        else if (op.type == (u8)RecordStorageOperationType::BATCH)
+        {
+            //A batch has no single recordId, the listener must identify it using the userType
+            BatchRecordOperation* bop = (BatchRecordOperation*)&op;
+            if (op.userDataLength > 0)
+            {
+                DYNAMIC_ARRAY(buffer, op.userDataLength);
+                CheckedMemcpy(buffer, ((u8*)&op) + SIZEOF_RECORD_STORAGE_BATCH_OP + bop->entriesLength, op.userDataLength)
+                op.callback->RecordStorageEventHandler(RECORD_STORAGE_RECORD_ID_INVALID, code, op.userType, buffer, op.userDataLength);
+            }
+            else
+            {
+                op.callback->RecordStorageEventHandler(RECORD_STORAGE_RECORD_ID_INVALID, code, op.userType, nullptr, 0);
+            }
+        }
     }
 }
 
@@ -671,6 +989,50 @@ RecordStoragePage* RecordStorage::FindPageToDefragment() const
     return pageToDefragment;
 }
 
+u16 RecordStorage::GetBatchEntryRecordLength(const BatchRecordOperation& op, const BatchRecordEntry& entry) const
+{
+    //Entries are superseded by later entries for the same recordId
+    const BatchRecordEntry* laterEntry = (const BatchRecordEntry*)((const u8*)&entry + SIZEOF_RECORD_STORAGE_BATCH_ENTRY + entry.dataLength);
+    while ((const u8*)laterEntry < op.data + op.entriesLength)
+    {
+        if (laterEntry->recordId == entry.recordId) return 0;
+        laterEntry = (const BatchRecordEntry*)((const u8*)laterEntry + SIZEOF_RECORD_STORAGE_BATCH_ENTRY + laterEntry->dataLength);
+    }
+
+    RecordStorageRecord* oldRecord = GetRecord(entry.recordId);
+
+    if (entry.type == RecordStorageOperationType::DEACTIVATE_RECORD)
+    {
+        if (oldRecord == nullptr || oldRecord->recordActive == 0) return 0;
+        return SIZEOF_RECORD_STORAGE_RECORD_HEADER;
+    }
+
+    u8 padding = (4 - entry.dataLength % 4) % 4;
+    u16 recordLength = entry.dataLength + SIZEOF_RECORD_STORAGE_RECORD_HEADER + padding;
+
+    //Records that did not change do not have to be written again
+    if (oldRecord != nullptr && oldRecord->recordActive && oldRecord->recordLength == recordLength && oldRecord->padding == padding) {
+        if (memcmp(oldRecord->data, entry.data, entry.dataLength) == 0) return 0;
+    }
+
+    return recordLength;
+}
+
+u16 RecordStorage::GetBatchRecordLength(const BatchRecordOperation& op) const
+{
+    u16 length = 0;
+    const BatchRecordEntry* entry = (const BatchRecordEntry*)op.data;
+    for (u32 i = 0; i < op.numEntries; i++)
+    {
+        if (entry->type == RecordStorageOperationType::SAVE_RECORD)
+        {
+            length += GetBatchEntryRecordLength(op, *entry);
+        }
+        entry = (const BatchRecordEntry*)((const u8*)entry + SIZEOF_RECORD_STORAGE_BATCH_ENTRY + entry->dataLength);
+    }
+    return length;
+}
+
 RecordStoragePage& RecordStorage::getPage(u32 index) const
 {
     if (index >= RECORD_STORAGE_NUM_PAGES)
@@ -760,7 +1122,7 @@ u8* RecordStorage::GetFreeRecordSpace(u16 dataLength) const
         }
 
         //Check if we have enough space left till the end of the page
-        if(((u32)record - (u32)&page + dataLength) <= FruityHal::GetCodePageSize()){
+        if(((u32)((u8*)record - (u8*)&page) + dataLength) <= FruityHal::GetCodePageSize()){
             return (u8*)record;
         }
     }
@@ -779,7 +1141,7 @@ u16 RecordStorage::GetFreeSpaceOnPage(const RecordStoragePage& page) const
         record = (const RecordStorageRecord*)((const u8*)record + record->recordLength);
     }
 
-    return (FruityHal::GetCodePageSize() - ((u32)record - (u32)&page));
+    return (FruityHal::GetCodePageSize() - (u32)((u8*)record - (u8*)&page));
 }
 
 //Calculates the free storage that would be available when defragmenting the page
@@ -825,7 +1187,7 @@ RecordStoragePage* RecordStorage::GetSwapPage() const
 bool RecordStorage::IsRecordValid(const RecordStoragePage& page, RecordStorageRecord const * record) const
 {
     //Check if length is within page boundaries
-    if(record == nullptr || ((u32)record - (u32)&page) + record->recordLength > FruityHal::GetCodePageSize()){
+    if(record == nullptr || (u32)((u8*)record - (u8*)&page) + record->recordLength > FruityHal::GetCodePageSize()){
         return false;
     }
 
@@ -893,6 +1255,14 @@ void RecordStorage::FlashStorageItemExecuted(FlashStorageTaskItem* task, FlashSt
                 op->flashStorageErrorCode = errorCode;
                 DeactivateRecordInternal(*(DeactivateRecordOperation*)op);
             }
+            else if (op->type == (u8)RecordStorageOperationType::BATCH)
+            {
+                //A batch queues multiple flash tasks, so we must not overwrite the error of an earlier one
+                BatchRecordOperation* bop = (BatchRecordOperation*)op;
+                if (op->flashStorageErrorCode == FlashStorageError::SUCCESS) op->flashStorageErrorCode = errorCode;
+                if (task != nullptr && bop->numPendingWrites > 0) bop->numPendingWrites--;
+                CommitBatchInternal(*bop);
+            }
         }
 
         if (opQueue._numElements == 0) {
@@ -95,7 +95,8 @@ class RecordStorageEventListener;
 enum class RecordStorageOperationType : u8
 {
     SAVE_RECORD,
-    DEACTIVATE_RECORD
+    DEACTIVATE_RECORD,
+    BATCH,
 };
 
 enum class RecordStorageSaveStage : u16
@@ -161,7 +162,8 @@ typedef struct
 } RecordStoragePage;
 STATIC_ASSERT_SIZE(RecordStoragePage, 5);
 
-constexpr int SIZEOF_RECORD_STORAGE_OPERATION = 14;
+//Operations are only kept in RAM, so their size depends on the size of a pointer
+constexpr int SIZEOF_RECORD_STORAGE_OPERATION = 10 + sizeof(void*);
 typedef struct
 {
     RecordStorageEventListener* callback;
@@ -195,8 +197,44 @@ typedef struct
 
 }DeactivateRecordOperation;
 STATIC_ASSERT_SIZE(DeactivateRecordOperation, SIZEOF_RECORD_STORAGE_DEACTIVATE_RECORD_OP);
+
+//A batch operation is followed by numEntries BatchRecordEntries (each followed by its data)
+//and finally by the userData
+constexpr int SIZEOF_RECORD_STORAGE_BATCH_OP = (SIZEOF_RECORD_STORAGE_OPERATION + 6);
+typedef struct
+{
+    RecordStorageOperation op;
+    RecordStorageSaveStage stage;
+    u8 numEntries;
+    u8 numPendingWrites; //Flash tasks of the batch that have not yet executed
+    u16 entriesLength; //Total length of all entries including their data
+    u8 data[1];
+
+}BatchRecordOperation;
+STATIC_ASSERT_SIZE(BatchRecordOperation, SIZEOF_RECORD_STORAGE_BATCH_OP + 1);
+
+constexpr int SIZEOF_RECORD_STORAGE_BATCH_ENTRY = 6;
+typedef struct
+{
+    RecordStorageOperationType type;
+    u8 reserved;
+    u16 recordId;
+    u16 dataLength;
+    u8 data[1];
+
+}BatchRecordEntry;
+STATIC_ASSERT_SIZE(BatchRecordEntry, SIZEOF_RECORD_STORAGE_BATCH_ENTRY + 1);
 #pragma pack(pop)
 
+//Describes a single save or deactivation that should be part of a batch
+struct RecordStorageBatchItem
+{
+    RecordStorageOperationType type; //Either SAVE_RECORD or DEACTIVATE_RECORD
+    u16 recordId;
+    u8* data;       //Unused for DEACTIVATE_RECORD
+    u16 dataLength; //Unused for DEACTIVATE_RECORD
+};
+
 enum class RecordStorageResultCode : u8
 {
     SUCCESS                  = 0,
@@ -216,10 +254,28 @@ enum class RecordStoragePageState : u8
     ACTIVE,
 };
 
+//Erase counters are kept for up to this many pages as RECORD_STORAGE_NUM_PAGES is not known in this header
+constexpr u32 RECORD_STORAGE_MAX_NUM_STATISTICS_PAGES = 8;
+
+//Usage and wear information about the pages of the RecordStorage
+struct RecordStorageStatistics
+{
+    u32 liveSpace;       //Bytes used by the latest versions of all active records
+    u32 garbageSpace;    //Bytes used by outdated or deactivated records that a defragmentation would free
+    u32 freeSpace;       //Bytes that can still be written without defragmenting
+    u16 maxPageVersion;  //Incremented with every page swap, this is the persistent indicator for the total number of erase cycles
+    u16 numDefragmentations;     //Since reboot
+    u16 numIdleDefragmentations; //Since reboot, defragmentations that were not triggered by a save
+    u16 pageEraseCounters[RECORD_STORAGE_MAX_NUM_STATISTICS_PAGES]; //Since reboot
+};
+
 class RecordStorageEventListener;
 
 constexpr int RECORD_STORAGE_QUEUE_SIZE = 256;
 
+//Interval in which the RecordStorage checks if it should defragment while idle
+constexpr u16 RECORD_STORAGE_IDLE_DEFRAGMENTATION_CHECK_INTERVAL_DS = SEC_TO_DS(30);
+
 /**
  * The RecordStorage is able to manage multiple records in the flash. It is possible to create new
  * records, update records and delete records. It uses the FlashStorage class for storage operations.
@@ -251,13 +307,25 @@ class RecordStorage : public FlashStorageEventListener
 
         bool processQueueInProgress = false;
 
+        //Wear and defragmentation statistics since reboot
+        u16 pageEraseCounters[RECORD_STORAGE_MAX_NUM_STATISTICS_PAGES] = {};
+        u16 numDefragmentations = 0;
+        u16 numIdleDefragmentations = 0;
+        u16 timeSinceIdleDefragmentationCheckDs = 0;
+
         //Stores a record
         void SaveRecordInternal(SaveRecordOperation& op);
         //Removes a record
         void DeactivateRecordInternal(DeactivateRecordOperation& op);
+        //Stores and removes multiple records
+        void CommitBatchInternal(BatchRecordOperation& op);
                 
         void DefragmentPage(RecordStoragePage& pageToDefragment, bool force);
         void RepairPages();
+        //Erases a page and counts the erase for the wear statistics
+        void ErasePage(RecordStoragePage& page, FlashStorageEventListener* callback);
+        //Starts a defragmentation if the storage is idle and enough space is occupied by garbage
+        bool DefragmentIfIdle();
 
         void ProcessQueue(bool force);
 
@@ -276,6 +344,10 @@ class RecordStorage : public FlashStorageEventListener
         //Looks through all pages and returns the page with the most space after defragmentation
         RecordStoragePage * FindPageToDefragment() const;
         RecordStoragePage& getPage(u32 index) const;
+        //Returns the length that the entry will occupy in flash, 0 if nothing has to be written
+        u16 GetBatchEntryRecordLength(const BatchRecordOperation& op, const BatchRecordEntry& entry) const;
+        //Returns the length of all records of the batch that must be written contiguously
+        u16 GetBatchRecordLength(const BatchRecordOperation& op) const;
 
         bool isInit = false;
 
@@ -301,12 +373,20 @@ class RecordStorage : public FlashStorageEventListener
         RecordStorageResultCode SaveRecord(u16 recordId, u8* data, u16 dataLength, RecordStorageEventListener* callback, u32 userType, u8* userData, u16 userDataLength, ModuleIdWrapper lockDownModule = INVALID_WRAPPED_MODULE_ID);
         //Removes a record (Operation is queued)
         RecordStorageResultCode DeactivateRecord(u16 recordId, RecordStorageEventListener * callback, u32 userType, ModuleIdWrapper lockDownModule = INVALID_WRAPPED_MODULE_ID);
+        //Saves and removes multiple records with at most one defragmentation and a single callback (Operation is queued)
+        RecordStorageResultCode CommitBatch(const RecordStorageBatchItem* items, u8 numItems, RecordStorageEventListener* callback, u32 userType, ModuleIdWrapper lockDownModule = INVALID_WRAPPED_MODULE_ID);
+        //Allows to cache some information until the batch completes
+        RecordStorageResultCode CommitBatch(const RecordStorageBatchItem* items, u8 numItems, RecordStorageEventListener* callback, u32 userType, u8* userData, u16 userDataLength, ModuleIdWrapper lockDownModule = INVALID_WRAPPED_MODULE_ID);
         //Retrieves a record
         RecordStorageRecord* GetRecord(u16 recordId) const;
         //Retrieves the data of a record
         SizedData GetRecordData(u16 recordId) const;
         //Resets all settings
         RecordStorageResultCode LockDownAndClearAllSettings(ModuleIdWrapper responsibleModuleForLockDown, RecordStorageEventListener * callback, u32 userType);
+        //Returns the current space usage and wear of the pages
+        RecordStorageStatistics GetStatistics() const;
+
+        void TimerEventHandler(u16 passedTimeDs);
         
         //Listener
         void FlashStorageItemExecuted(FlashStorageTaskItem* task, FlashStorageError errorCode) override;
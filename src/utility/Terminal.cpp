@@ -844,7 +844,7 @@ void Terminal::StdioCheckAndProcessLine()
     if (cherrySimInstance->simConfig.terminalId != cherrySimInstance->currentNode->id && cherrySimInstance->simConfig.terminalId != 0) return;
 
 #if ((defined(__unix) || defined(_WIN32)))
-    if(!meshGwCommunication && _kbhit() != 0){ //FIXME: Not supported by eclipse console
+    if(!meshGwCommunication && !cherrySimInstance->externalTerminalInput && _kbhit() != 0){ //FIXME: Not supported by eclipse console
         printf("mhTerm: ");
         std::string line = ReadStdioLine();
         PutIntoTerminalCommandQueue(line, true);
@@ -869,6 +869,7 @@ void Terminal::StdioCheckAndProcessLine()
             
             StdioPutString(executionReplayLine.c_str());
         }
+        cherrySimInstance->RecordReplayCommand(message);
 
         const char *simPos = strstr(message.c_str(), "sim ");
         if (simPos == message.c_str())
@@ -74,7 +74,7 @@ namespace Utility
     const char serialAlphabet[] = "BCDFGHJKLMNPQRSTVWXYZ123456789";
 
     //General methods for loading settings
-    u32 GetSettingsPageBaseAddress();
+    uintptr_t GetSettingsPageBaseAddress();
     RecordStorageResultCode SaveModuleSettingsToFlash(const Module* module, ModuleConfiguration* configurationPointer, const u16 configurationLength, RecordStorageEventListener* listener, u32 userType, u8* userData, u16 userDataLength);
 #ifndef SIM_ENABLED
     SizedData GetStackWatcherAddress();
@@ -112,6 +112,11 @@ namespace Utility
     uint16_t CalculateCrc16(const uint8_t * p_data, const uint32_t size, const uint16_t * p_crc);
     u32 CalculateCrc32(const u8* message, const u32 messageLength, u32 previousCrc = 0);
     u32 CalculateCrc32String(const char* message, u32 previousCrc = 0);
+#ifdef SIM_ENABLED
+    //Calculate the CRC with a specific table variant instead of the configured one so that all variants can be tested
+    uint16_t CalculateCrc16Variant(const uint8_t* p_data, const uint32_t size, const uint16_t* p_crc, bool useTable);
+    u32 CalculateCrc32Variant(const u8* message, const u32 messageLength, u32 previousCrc, u32 tableSlices);
+#endif
 
     //Encryption Functionality
     void Aes128BlockEncrypt(const Aes128Block* messageBlock, const Aes128Block* key, Aes128Block* encryptedMessage);
@@ -0,0 +1,223 @@
+# Runs the cherrySim_tester in parallel worker processes.
+#
+# The simulator relies on process global state (cherrySimInstance, the swapped in GlobalState),
+# so tests can not run in threads of the same process. Instead, every test is executed in its own
+# cherrySim_tester process with its own working directory. This also isolates crashes and hangs:
+# a crashing or timed out test is reported as a failure and all other tests continue to run.
+#
+# Tests are scheduled longest first, based on the durations of previous runs that are stored in
+# a json file, which keeps all workers busy until the end. The gtest XML results of all tests are
+# merged into a single JUnit compatible XML file.
+#
+# Example:
+#   python3 runTestsParallel.py --tester ../../_build/cherrysim/cherrySim_tester --xml results.xml
+#   python3 runTestsParallel.py --tester ./cherrySim_tester --filter "*_scheduled*" -- Scheduled
+
+import argparse
+import concurrent.futures
+import json
+import os
+import shutil
+import subprocess
+import sys
+import threading
+import time
+import xml.etree.ElementTree as ET
+
+DEFAULT_FILTER = "*:-*_scheduled*:*_long*"
+DEFAULT_TIMEOUT_S = 30 * 60
+LOG_TAIL_LENGTH = 4000
+
+
+def listTests(tester, gtestFilter):
+    output = subprocess.run([tester, "--gtest_list_tests", "--gtest_filter=" + gtestFilter],
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True, check=True).stdout
+    tests = []
+    suite = None
+    for line in output.splitlines():
+        # Suites are not indented and end with a dot, tests are indented. Parameterized tests have a trailing comment.
+        name = line.split("#")[0].rstrip()
+        if not name:
+            continue
+        if not line.startswith(" "):
+            suite = name if name.endswith(".") else None
+        elif suite is not None:
+            tests.append(suite + name.strip())
+    return tests
+
+
+def loadDurations(path):
+    try:
+        with open(path, "r") as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return {}
+
+
+def storeDurations(path, durations):
+    tmpPath = path + ".tmp"
+    with open(tmpPath, "w") as f:
+        json.dump(durations, f, indent=1, sort_keys=True)
+    os.replace(tmpPath, path)
+
+
+def scheduleTests(tests, durations):
+    # Longest processing time first. Unknown tests are started early as they might be long ones.
+    known = [d for d in durations.values()]
+    unknownDuration = max(known) if known else 0.0
+    return sorted(tests, key=lambda test: durations.get(test, unknownDuration), reverse=True)
+
+
+def runTest(tester, test, workDir, timeoutS, extraArgs):
+    os.makedirs(workDir, exist_ok=True)
+    xmlPath = os.path.join(workDir, "result.xml")
+    logPath = os.path.join(workDir, "output.log")
+    # gtest_output has to be the first argument, see main() in CherrySimTester.cpp
+    command = [tester, "--gtest_output=xml:" + xmlPath, "--gtest_filter=" + test, "GitLab"] + extraArgs
+
+    startTime = time.monotonic()
+    status = "passed"
+    with open(logPath, "w") as log:
+        process = subprocess.Popen(command, cwd=workDir, stdout=log, stderr=subprocess.STDOUT)
+        try:
+            returnCode = process.wait(timeout=timeoutS)
+            if returnCode < 0 or not os.path.exists(xmlPath):
+                status = "crashed"
+            elif returnCode != 0:
+                status = "failed"
+        except subprocess.TimeoutExpired:
+            process.kill()
+            process.wait()
+            status = "timeout"
+    duration = time.monotonic() - startTime
+
+    return {"test": test, "status": status, "duration": duration, "xmlPath": xmlPath, "logPath": logPath,
+            "returnCode": process.returncode}
+
+
+def readLogTail(path):
+    try:
+        with open(path, "r", errors="replace") as f:
+            return f.read()[-LOG_TAIL_LENGTH:]
+    except OSError:
+        return ""
+
+
+def createTestCase(result):
+    suite, name = result["test"].split(".", 1)
+    testCase = ET.Element("testcase", {"name": name, "classname": suite, "status": "run",
+                                       "time": "%.3f" % result["duration"]})
+    if result["status"] == "timeout":
+        message = "Timed out after %.0f seconds" % result["duration"]
+    else:
+        message = "Crashed with return code %d" % result["returnCode"]
+    failure = ET.SubElement(testCase, "failure", {"message": message, "type": result["status"]})
+    failure.text = readLogTail(result["logPath"])
+    return testCase
+
+
+def mergeResults(results, xmlPath, wallTime):
+    suites = {}
+    for result in results:
+        testCases = []
+        if result["status"] in ("passed", "failed"):
+            try:
+                testCases = ET.parse(result["xmlPath"]).getroot().iter("testcase")
+                testCases = list(testCases)
+            except (OSError, ET.ParseError):
+                testCases = []
+        if not testCases:
+            testCases = [createTestCase(result)]
+        for testCase in testCases:
+            suites.setdefault(testCase.get("classname"), []).append(testCase)
+
+    root = ET.Element("testsuites", {"name": "AllTests", "time": "%.3f" % wallTime})
+    totalTests = 0
+    totalFailures = 0
+    for suiteName in sorted(suites):
+        testCases = suites[suiteName]
+        failures = sum(1 for testCase in testCases if testCase.find("failure") is not None)
+        suiteTime = sum(float(testCase.get("time", "0")) for testCase in testCases)
+        suite = ET.SubElement(root, "testsuite", {"name": suiteName, "tests": str(len(testCases)),
+                                                   "failures": str(failures), "errors": "0",
+                                                   "time": "%.3f" % suiteTime})
+        suite.extend(testCases)
+        totalTests += len(testCases)
+        totalFailures += failures
+    root.set("tests", str(totalTests))
+    root.set("failures", str(totalFailures))
+    root.set("errors", "0")
+    ET.ElementTree(root).write(xmlPath, encoding="utf-8", xml_declaration=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Runs the cherrySim_tester tests in parallel processes.")
+    parser.add_argument("--tester", required=True, help="Path to the cherrySim_tester executable")
+    parser.add_argument("--jobs", "-j", type=int, default=os.cpu_count(), help="Number of parallel worker processes")
+    parser.add_argument("--filter", default=DEFAULT_FILTER, help="gtest filter that selects the tests to run")
+    parser.add_argument("--timeout", type=float, default=DEFAULT_TIMEOUT_S, help="Timeout per test in seconds")
+    parser.add_argument("--durations", default=None,
+                        help="Json file with the test durations of previous runs, default: next to the tester")
+    parser.add_argument("--xml", default="cherrySimTestResults.xml", help="Path of the merged gtest XML result")
+    parser.add_argument("--workDir", default="cherrySimTestRuns",
+                        help="Directory in which every test gets its own working directory")
+    parser.add_argument("--keep", action="store_true", help="Keep the working directories of passed tests")
+    parser.add_argument("extraArgs", nargs="*", help="Additional arguments for the tester, e.g. Scheduled or SeedStart=1")
+    args = parser.parse_args()
+
+    tester = os.path.abspath(args.tester)
+    durationsPath = args.durations or (tester + ".durations.json")
+    durations = loadDurations(durationsPath)
+
+    tests = scheduleTests(listTests(tester, args.filter), durations)
+    if not tests:
+        print("No tests match the filter " + args.filter)
+        return 1
+    print("Running %d tests in %d processes" % (len(tests), args.jobs))
+
+    if os.path.exists(args.workDir):
+        shutil.rmtree(args.workDir)
+
+    results = []
+    printLock = threading.Lock()
+    startTime = time.monotonic()
+    with concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as executor:
+        futures = [executor.submit(runTest, tester, test, os.path.abspath(os.path.join(args.workDir, "%04d" % i)),
+                                   args.timeout, args.extraArgs)
+                   for i, test in enumerate(tests)]
+        for future in concurrent.futures.as_completed(futures):
+            result = future.result()
+            results.append(result)
+            with printLock:
+                print("[%4d/%d] %-8s %8.1fs %s" % (len(results), len(tests), result["status"].upper(),
+                                                   result["duration"], result["test"]))
+                if result["status"] != "passed":
+                    print("         Log: " + result["logPath"])
+            sys.stdout.flush()
+    wallTime = time.monotonic() - startTime
+
+    for result in results:
+        # Timeouts only tell us a lower bound, still better than nothing for the scheduling
+        durations[result["test"]] = round(result["duration"], 3)
+    storeDurations(durationsPath, durations)
+    mergeResults(results, args.xml, wallTime)
+
+    if not args.keep:
+        for result in results:
+            if result["status"] == "passed":
+                shutil.rmtree(os.path.dirname(result["xmlPath"]), ignore_errors=True)
+
+    notPassed = [result for result in results if result["status"] != "passed"]
+    serialTime = sum(result["duration"] for result in results)
+    print("")
+    print("%d of %d tests passed in %.1f seconds (%.1f seconds when run serially)"
+          % (len(results) - len(notPassed), len(results), wallTime, serialTime))
+    for result in sorted(notPassed, key=lambda r: r["test"]):
+        print("  %-8s %s" % (result["status"].upper(), result["test"]))
+    print("Merged results written to " + args.xml)
+
+    return 1 if notPassed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())